@@ -0,0 +1,427 @@
+#include "pch.h"
+
+#include "AppZoneHistoryStore.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+// Non-Localizable strings
+namespace NonLocalizable
+{
+    const wchar_t AppZoneHistorySnapshotExtension[] = L".bin";
+    const wchar_t AppZoneHistoryLogExtension[] = L".log";
+    const wchar_t TmpExtension[] = L".tmp";
+}
+
+namespace
+{
+    constexpr uint32_t C_SNAPSHOT_MAGIC = 0x53485a46; // "FZHS"
+    constexpr uint32_t C_LOG_MAGIC = 0x4c485a46; // "FZHL"
+    constexpr uint32_t C_FORMAT_VERSION = 1;
+
+    // Header: magic, version, sequence, then for the snapshot the payload size and checksum
+    constexpr size_t C_LOG_HEADER_SIZE = 2 * sizeof(uint32_t) + sizeof(uint64_t);
+    constexpr size_t C_SNAPSHOT_HEADER_SIZE = C_LOG_HEADER_SIZE + sizeof(uint64_t) + sizeof(uint32_t);
+    // Log record: payload size and checksum
+    constexpr size_t C_RECORD_HEADER_SIZE = 2 * sizeof(uint32_t);
+
+    // The log isn't compacted while it's smaller than this, even if the snapshot is smaller
+    constexpr uint64_t C_MIN_LOG_SIZE_TO_COMPACT = 64 * 1024;
+
+    uint32_t Checksum(const char* data, size_t size) noexcept
+    {
+        // FNV-1a
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= static_cast<uint8_t>(data[i]);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    class BinaryWriter
+    {
+    public:
+        explicit BinaryWriter(std::string& buffer) :
+            m_buffer(buffer)
+        {
+        }
+
+        template<typename T>
+        void Put(T value)
+        {
+            m_buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        void PutString(const std::wstring& value)
+        {
+            Put(static_cast<uint32_t>(value.size()));
+            for (wchar_t c : value)
+            {
+                Put(static_cast<uint16_t>(c));
+            }
+        }
+
+        void PutApp(const std::wstring& appPath, const std::vector<FancyZonesDataTypes::AppZoneHistoryData>& history)
+        {
+            PutString(appPath);
+            Put(static_cast<uint32_t>(history.size()));
+            for (const auto& data : history)
+            {
+                PutString(data.zoneSetUuid);
+                PutString(data.deviceId);
+                Put(static_cast<uint32_t>(data.zoneIndexSet.size()));
+                for (size_t index : data.zoneIndexSet)
+                {
+                    Put(static_cast<uint64_t>(index));
+                }
+            }
+        }
+
+    private:
+        std::string& m_buffer;
+    };
+
+    class BinaryReader
+    {
+    public:
+        BinaryReader(const char* data, size_t size) :
+            m_data(data),
+            m_size(size)
+        {
+        }
+
+        size_t Remaining() const noexcept { return m_size - m_offset; }
+
+        template<typename T>
+        bool Get(T& value) noexcept
+        {
+            if (Remaining() < sizeof(value))
+            {
+                return false;
+            }
+            std::memcpy(&value, m_data + m_offset, sizeof(value));
+            m_offset += sizeof(value);
+            return true;
+        }
+
+        bool GetString(std::wstring& value)
+        {
+            uint32_t length = 0;
+            if (!Get(length) || Remaining() / sizeof(uint16_t) < length)
+            {
+                return false;
+            }
+
+            value.resize(length);
+            for (auto& c : value)
+            {
+                uint16_t unit = 0;
+                Get(unit);
+                c = static_cast<wchar_t>(unit);
+            }
+            return true;
+        }
+
+        bool GetApp(std::wstring& appPath, std::vector<FancyZonesDataTypes::AppZoneHistoryData>& history)
+        {
+            uint32_t count = 0;
+            if (!GetString(appPath) || !Get(count))
+            {
+                return false;
+            }
+
+            history.clear();
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                FancyZonesDataTypes::AppZoneHistoryData data;
+                uint32_t indexCount = 0;
+                if (!GetString(data.zoneSetUuid) || !GetString(data.deviceId) || !Get(indexCount) ||
+                    Remaining() / sizeof(uint64_t) < indexCount)
+                {
+                    return false;
+                }
+
+                data.zoneIndexSet.resize(indexCount);
+                for (auto& index : data.zoneIndexSet)
+                {
+                    uint64_t value = 0;
+                    Get(value);
+                    index = static_cast<size_t>(value);
+                }
+                history.push_back(std::move(data));
+            }
+            return true;
+        }
+
+    private:
+        const char* m_data;
+        size_t m_size;
+        size_t m_offset = 0;
+    };
+
+    std::optional<std::string> ReadFile(const std::wstring& fileName)
+    {
+        std::ifstream file{ std::filesystem::path{ fileName }, std::ios::binary };
+        if (!file.is_open())
+        {
+            return std::nullopt;
+        }
+
+        using isbi = std::istreambuf_iterator<char>;
+        return std::string{ isbi{ file }, isbi{} };
+    }
+
+    void ApplyChange(AppZoneHistoryStore::TAppZoneHistoryMap& history, std::wstring appPath, std::vector<FancyZonesDataTypes::AppZoneHistoryData> appHistory)
+    {
+        if (appHistory.empty())
+        {
+            history.erase(appPath);
+        }
+        else
+        {
+            history[std::move(appPath)] = std::move(appHistory);
+        }
+    }
+}
+
+void AppZoneHistoryStore::Open(const std::wstring& jsonFileName)
+{
+    std::scoped_lock lock{ m_lock };
+    std::filesystem::path path{ jsonFileName };
+    m_snapshotFileName = path.replace_extension(NonLocalizable::AppZoneHistorySnapshotExtension).wstring();
+    m_logFileName = path.replace_extension(NonLocalizable::AppZoneHistoryLogExtension).wstring();
+    m_loaded = false;
+    m_history.clear();
+    m_sequence = 0;
+    m_snapshotSize = 0;
+    m_logSize = 0;
+    m_compactPending = false;
+}
+
+std::optional<AppZoneHistoryStore::TAppZoneHistoryMap> AppZoneHistoryStore::Load()
+{
+    std::scoped_lock lock{ m_lock };
+    m_loaded = true;
+    m_history.clear();
+    m_sequence = 0;
+    m_snapshotSize = 0;
+    m_logSize = 0;
+    m_compactPending = false;
+
+    const auto snapshot = ReadFile(m_snapshotFileName);
+    const auto log = ReadFile(m_logFileName);
+    if (!snapshot && !log)
+    {
+        return std::nullopt;
+    }
+
+    if (snapshot)
+    {
+        BinaryReader reader{ snapshot->data(), snapshot->size() };
+        uint32_t magic = 0, version = 0, checksum = 0, count = 0;
+        uint64_t payloadSize = 0;
+        if (!reader.Get(magic) || magic != C_SNAPSHOT_MAGIC || !reader.Get(version) || version != C_FORMAT_VERSION ||
+            !reader.Get(m_sequence) || !reader.Get(payloadSize) || !reader.Get(checksum) || payloadSize != reader.Remaining() ||
+            checksum != Checksum(snapshot->data() + C_SNAPSHOT_HEADER_SIZE, static_cast<size_t>(payloadSize)) || !reader.Get(count))
+        {
+            m_sequence = 0;
+            return std::nullopt;
+        }
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            std::wstring appPath;
+            std::vector<FancyZonesDataTypes::AppZoneHistoryData> appHistory;
+            if (!reader.GetApp(appPath, appHistory))
+            {
+                m_history.clear();
+                m_sequence = 0;
+                return std::nullopt;
+            }
+            ApplyChange(m_history, std::move(appPath), std::move(appHistory));
+        }
+        m_snapshotSize = snapshot->size();
+    }
+
+    if (log)
+    {
+        BinaryReader reader{ log->data(), log->size() };
+        uint32_t magic = 0, version = 0;
+        uint64_t sequence = 0;
+        // A log left from before the last snapshot is already part of it
+        if (reader.Get(magic) && magic == C_LOG_MAGIC && reader.Get(version) && version == C_FORMAT_VERSION &&
+            reader.Get(sequence) && sequence == m_sequence)
+        {
+            size_t validSize = C_LOG_HEADER_SIZE;
+            uint32_t size = 0, checksum = 0;
+            while (reader.Get(size) && reader.Get(checksum) && reader.Remaining() >= size)
+            {
+                const char* payload = log->data() + validSize + C_RECORD_HEADER_SIZE;
+                if (checksum != Checksum(payload, size))
+                {
+                    break;
+                }
+
+                BinaryReader recordReader{ payload, size };
+                std::wstring appPath;
+                std::vector<FancyZonesDataTypes::AppZoneHistoryData> appHistory;
+                if (!recordReader.GetApp(appPath, appHistory))
+                {
+                    break;
+                }
+                ApplyChange(m_history, std::move(appPath), std::move(appHistory));
+
+                validSize += C_RECORD_HEADER_SIZE + size;
+                reader = BinaryReader{ log->data() + validSize, log->size() - validSize };
+            }
+
+            // Drop a record cut short, so the next ones are appended after the valid ones
+            if (validSize < log->size())
+            {
+                std::error_code error;
+                std::filesystem::resize_file(std::filesystem::path{ m_logFileName }, validSize, error);
+                if (error)
+                {
+                    validSize = 0;
+                }
+            }
+            m_logSize = validSize;
+        }
+    }
+
+    return m_history;
+}
+
+bool AppZoneHistoryStore::Update(const std::vector<Change>& changes)
+{
+    EnsureLoaded();
+
+    std::scoped_lock lock{ m_lock };
+    std::string records;
+    for (const auto& change : changes)
+    {
+        std::string payload;
+        BinaryWriter{ payload }.PutApp(change.appPath, change.history);
+
+        BinaryWriter writer{ records };
+        writer.Put(static_cast<uint32_t>(payload.size()));
+        writer.Put(Checksum(payload.data(), payload.size()));
+        records += payload;
+
+        ApplyChange(m_history, change.appPath, change.history);
+    }
+
+    const uint64_t logSize = m_logSize + records.size();
+    if (m_compactPending || (logSize > C_MIN_LOG_SIZE_TO_COMPACT && logSize > m_snapshotSize))
+    {
+        return WriteSnapshot();
+    }
+
+    // The history in memory is already updated, a failed append is recovered by writing a snapshot
+    return AppendToLog(records) || WriteSnapshot();
+}
+
+bool AppZoneHistoryStore::Replace(const TAppZoneHistoryMap& history)
+{
+    std::scoped_lock lock{ m_lock };
+    m_loaded = true;
+    m_history = history;
+    return WriteSnapshot();
+}
+
+void AppZoneHistoryStore::EnsureLoaded()
+{
+    bool loaded = false;
+    {
+        std::scoped_lock lock{ m_lock };
+        loaded = m_loaded;
+    }
+
+    if (!loaded)
+    {
+        Load();
+    }
+}
+
+bool AppZoneHistoryStore::WriteSnapshot()
+{
+    std::string payload;
+    BinaryWriter payloadWriter{ payload };
+    payloadWriter.Put(static_cast<uint32_t>(m_history.size()));
+    for (const auto& [appPath, history] : m_history)
+    {
+        payloadWriter.PutApp(appPath, history);
+    }
+
+    const uint64_t sequence = m_sequence + 1;
+    std::string snapshot;
+    BinaryWriter writer{ snapshot };
+    writer.Put(C_SNAPSHOT_MAGIC);
+    writer.Put(C_FORMAT_VERSION);
+    writer.Put(sequence);
+    writer.Put(static_cast<uint64_t>(payload.size()));
+    writer.Put(Checksum(payload.data(), payload.size()));
+    snapshot += payload;
+
+    // Written next to the snapshot and renamed over it, so a crash leaves either the old or the new one
+    const std::wstring tmpFileName = m_snapshotFileName + NonLocalizable::TmpExtension;
+    {
+        std::ofstream file{ std::filesystem::path{ tmpFileName }, std::ios::binary | std::ios::trunc };
+        file.write(snapshot.data(), snapshot.size());
+        if (!file.good())
+        {
+            file.close();
+            std::error_code error;
+            std::filesystem::remove(std::filesystem::path{ tmpFileName }, error);
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(std::filesystem::path{ tmpFileName }, std::filesystem::path{ m_snapshotFileName }, error);
+    if (error)
+    {
+        std::filesystem::remove(std::filesystem::path{ tmpFileName }, error);
+        return false;
+    }
+
+    // The old log no longer matches the sequence of the snapshot, the next change starts a new one
+    m_sequence = sequence;
+    m_snapshotSize = snapshot.size();
+    m_logSize = 0;
+    m_compactPending = false;
+    std::filesystem::remove(std::filesystem::path{ m_logFileName }, error);
+    return true;
+}
+
+bool AppZoneHistoryStore::AppendToLog(const std::string& records)
+{
+    std::string data;
+    auto mode = std::ios::binary | std::ios::app;
+    if (m_logSize == 0)
+    {
+        BinaryWriter writer{ data };
+        writer.Put(C_LOG_MAGIC);
+        writer.Put(C_FORMAT_VERSION);
+        writer.Put(m_sequence);
+        mode = std::ios::binary | std::ios::trunc;
+    }
+    data += records;
+
+    std::ofstream file{ std::filesystem::path{ m_logFileName }, mode };
+    file.write(data.data(), data.size());
+    file.flush();
+    if (!file.good())
+    {
+        // Records appended after a partly written one would be ignored, only a snapshot can follow
+        m_compactPending = true;
+        return false;
+    }
+
+    m_logSize += data.size();
+    return true;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "FancyZonesDataTypes.h"
+
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Binary storage of the app zone history, so saving a window drop costs as much as the change and not as
+ * the whole history. The history is kept in a snapshot file and in a log file next to the JSON history file.
+ * Each change of the history of an application is appended to the log as a record, and once the log grows
+ * larger than the snapshot both are compacted into a new snapshot. The JSON file is only read to import the
+ * history the first time the store is used, and written when FancyZones exits.
+ */
+class AppZoneHistoryStore
+{
+public:
+    using TAppZoneHistoryMap = std::unordered_map<std::wstring, std::vector<FancyZonesDataTypes::AppZoneHistoryData>>;
+
+    struct Change
+    {
+        std::wstring appPath;
+        // New history of the application, empty if it was removed
+        std::vector<FancyZonesDataTypes::AppZoneHistoryData> history;
+    };
+
+    /**
+     * Use the store files next to the JSON app zone history file. Nothing is read until the history is loaded.
+     *
+     * @param   jsonFileName Path of the JSON app zone history file.
+     */
+    void Open(const std::wstring& jsonFileName);
+
+    /**
+     * Read the snapshot and apply the records of the log. A record cut short by a crash ends the log.
+     *
+     * @returns The stored history, nullopt if neither file exists or the snapshot is damaged, in which case
+     *          the history is imported from the JSON file.
+     */
+    std::optional<TAppZoneHistoryMap> Load();
+
+    /**
+     * Append the changed applications to the log, and compact the log into a new snapshot when it grew too large.
+     */
+    bool Update(const std::vector<Change>& changes);
+
+    /**
+     * Write the whole history as a new snapshot and empty the log.
+     */
+    bool Replace(const TAppZoneHistoryMap& history);
+
+private:
+    void EnsureLoaded();
+    bool WriteSnapshot();
+    bool AppendToLog(const std::string& records);
+
+    std::mutex m_lock;
+    std::wstring m_snapshotFileName;
+    std::wstring m_logFileName;
+    bool m_loaded = false;
+
+    // Stored history, snapshot with the log applied
+    TAppZoneHistoryMap m_history;
+    // Incremented by each snapshot, the log is only applied to the snapshot of the same sequence
+    uint64_t m_sequence = 0;
+    uint64_t m_snapshotSize = 0;
+    // Size of the valid part of the log, 0 if a new log has to be started
+    uint64_t m_logSize = 0;
+    // Set when an append failed, the next change is written as a snapshot
+    bool m_compactPending = false;
+};
@@ -0,0 +1,114 @@
+#include "pch.h"
+
+#include "DeferredWriter.h"
+
+DeferredWriter::DeferredWriter(std::function<void()> write, std::chrono::milliseconds delay, std::chrono::milliseconds maxDelay) :
+    m_write(std::move(write)),
+    m_delay(delay),
+    m_maxDelay(maxDelay)
+{
+}
+
+DeferredWriter::~DeferredWriter()
+{
+    Stop();
+}
+
+void DeferredWriter::Schedule()
+{
+    bool wake = false;
+    {
+        std::scoped_lock lock(m_mutex);
+        const auto now = std::chrono::steady_clock::now();
+        if (!m_pending)
+        {
+            m_pending = true;
+            m_firstRequest = now;
+            wake = true;
+        }
+        m_lastRequest = now;
+
+        // While stopping, the pending write is done by Stop()
+        if (!m_thread.joinable() && !m_stop)
+        {
+            m_thread = std::thread([this] { Run(); });
+        }
+    }
+
+    // A thread already waiting on a pending write picks up the new deadline when it wakes up
+    if (wake)
+    {
+        m_cv.notify_one();
+    }
+}
+
+void DeferredWriter::Flush()
+{
+    WritePending();
+}
+
+void DeferredWriter::Stop()
+{
+    std::thread thread;
+    {
+        std::scoped_lock lock(m_mutex);
+        m_stop = true;
+        thread = std::move(m_thread);
+    }
+    m_cv.notify_one();
+
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+
+    {
+        std::scoped_lock lock(m_mutex);
+        m_stop = false;
+    }
+
+    WritePending();
+}
+
+void DeferredWriter::Run()
+{
+    std::unique_lock lock(m_mutex);
+    while (!m_stop)
+    {
+        if (!m_pending)
+        {
+            m_cv.wait(lock);
+            continue;
+        }
+
+        const auto idleDeadline = m_lastRequest + m_delay;
+        const auto maxDeadline = m_firstRequest + m_maxDelay;
+        const auto deadline = idleDeadline < maxDeadline ? idleDeadline : maxDeadline;
+        if (std::chrono::steady_clock::now() < deadline)
+        {
+            m_cv.wait_until(lock, deadline);
+            continue;
+        }
+
+        lock.unlock();
+        WritePending();
+        lock.lock();
+    }
+}
+
+void DeferredWriter::WritePending()
+{
+    // The pending flag is taken while holding the write lock, so a flush returns only after
+    // a write started by the background thread is done
+    std::scoped_lock writeLock(m_writeMutex);
+    {
+        std::scoped_lock lock(m_mutex);
+        if (!m_pending)
+        {
+            return;
+        }
+        m_pending = false;
+    }
+
+    m_write();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/**
+ * Runs a write callback on a background thread once the data it persists stops changing for a while.
+ * Changes made while a write is pending are coalesced into that write, so the callers never wait on disk I/O.
+ * The thread is started on the first request and runs until Stop() is called or the writer is destroyed.
+ */
+class DeferredWriter final
+{
+public:
+    /**
+     * @param   write    Persists the current data, called on the background thread or on the thread calling Flush() or Stop().
+     * @param   delay    Time without new requests after which the pending write is done.
+     * @param   maxDelay Longest time a write stays pending while requests keep coming.
+     */
+    DeferredWriter(std::function<void()> write, std::chrono::milliseconds delay, std::chrono::milliseconds maxDelay);
+    ~DeferredWriter();
+
+    DeferredWriter(const DeferredWriter&) = delete;
+    DeferredWriter& operator=(const DeferredWriter&) = delete;
+
+    /**
+     * Request a write of the data, which changed.
+     */
+    void Schedule();
+    /**
+     * Do the pending write, if any, on the calling thread.
+     */
+    void Flush();
+    /**
+     * Stop the background thread and do the pending write, if any, on the calling thread. A later request
+     * starts the thread again.
+     */
+    void Stop();
+
+private:
+    void Run();
+    void WritePending();
+
+    std::function<void()> m_write;
+    std::chrono::milliseconds m_delay;
+    std::chrono::milliseconds m_maxDelay;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_pending = false;
+    bool m_stop = false;
+    std::chrono::steady_clock::time_point m_firstRequest;
+    std::chrono::steady_clock::time_point m_lastRequest;
+    std::thread m_thread;
+
+    // Held while writing, so a flush and the background thread never write at the same time
+    std::mutex m_writeMutex;
+};
@@ -0,0 +1,131 @@
+#include "pch.h"
+#include "ExcludedAppsMatcher.h"
+
+#include <algorithm>
+#include <queue>
+
+ExcludedAppsMatcher::ExcludedAppsMatcher(const std::vector<std::wstring>& apps)
+{
+    m_lengths.reserve(apps.size());
+    for (const auto& app : apps)
+    {
+        const size_t index = m_lengths.size();
+        m_lengths.push_back(app.length());
+        if (app.empty())
+        {
+            m_hasEmptyApp = true;
+            continue;
+        }
+
+        size_t node = 0;
+        for (wchar_t c : app)
+        {
+            auto& children = m_nodes[node].children;
+            auto child = std::lower_bound(children.begin(), children.end(), c, [](const auto& entry, wchar_t value) { return entry.first < value; });
+            if (child != children.end() && child->first == c)
+            {
+                node = child->second;
+            }
+            else
+            {
+                const size_t next = m_nodes.size();
+                children.insert(child, { c, next });
+                m_nodes.emplace_back();
+                node = next;
+            }
+        }
+
+        // A duplicate has the same occurrences, the first one is enough
+        if (m_nodes[node].app == C_NO_NODE)
+        {
+            m_nodes[node].app = index;
+        }
+    }
+
+    // Fail links, breadth first so the links of the shorter prefixes are known
+    std::queue<size_t> queue;
+    for (const auto& [c, child] : m_nodes[0].children)
+    {
+        queue.push(child);
+    }
+
+    while (!queue.empty())
+    {
+        const size_t node = queue.front();
+        queue.pop();
+        for (const auto& [c, child] : m_nodes[node].children)
+        {
+            size_t fail = m_nodes[node].fail;
+            while (fail != 0 && Child(fail, c) == C_NO_NODE)
+            {
+                fail = m_nodes[fail].fail;
+            }
+
+            const size_t next = Child(fail, c);
+            m_nodes[child].fail = next != C_NO_NODE ? next : 0;
+
+            const auto& failNode = m_nodes[m_nodes[child].fail];
+            m_nodes[child].output = failNode.app != C_NO_NODE ? m_nodes[child].fail : failNode.output;
+            queue.push(child);
+        }
+    }
+}
+
+bool ExcludedAppsMatcher::Matches(std::wstring_view path) const
+{
+    const auto lastSlash = path.rfind(L'\\');
+    if (lastSlash == std::wstring_view::npos)
+    {
+        return false;
+    }
+
+    // The last occurrence of an empty name is at the end of the path
+    if (m_hasEmptyApp && lastSlash + 1 == path.length())
+    {
+        return true;
+    }
+
+    // End of the last occurrence of each application
+    std::vector<size_t> lastEnd(m_lengths.size(), C_NO_NODE);
+    size_t state = 0;
+    for (size_t i = 0; i < path.length(); ++i)
+    {
+        size_t next = Child(state, path[i]);
+        while (next == C_NO_NODE && state != 0)
+        {
+            state = m_nodes[state].fail;
+            next = Child(state, path[i]);
+        }
+        state = next != C_NO_NODE ? next : 0;
+
+        for (size_t node = state; node != 0; node = m_nodes[node].output)
+        {
+            if (m_nodes[node].app != C_NO_NODE)
+            {
+                lastEnd[m_nodes[node].app] = i;
+            }
+        }
+    }
+
+    for (size_t app = 0; app < m_lengths.size(); ++app)
+    {
+        if (lastEnd[app] == C_NO_NODE)
+        {
+            continue;
+        }
+
+        const size_t pos = lastEnd[app] + 1 - m_lengths[app];
+        if (pos <= lastSlash + 1 && pos + m_lengths[app] > lastSlash)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t ExcludedAppsMatcher::Child(size_t node, wchar_t c) const noexcept
+{
+    const auto& children = m_nodes[node].children;
+    auto child = std::lower_bound(children.begin(), children.end(), c, [](const auto& entry, wchar_t value) { return entry.first < value; });
+    return child != children.end() && child->first == c ? child->second : C_NO_NODE;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Matches a process path against all the excluded applications at once, with an Aho-Corasick automaton built
+ * from the excluded applications, instead of searching the path for each of them.
+ */
+class ExcludedAppsMatcher
+{
+public:
+    ExcludedAppsMatcher() = default;
+
+    /**
+     * @param   apps Upper case names or path parts of the excluded applications.
+     */
+    explicit ExcludedAppsMatcher(const std::vector<std::wstring>& apps);
+
+    /**
+     * @param   path Upper case path of the process.
+     *
+     * @returns True if the last occurrence of an excluded application in the path contains the first character
+     *          of the file name, or the backslash before it.
+     */
+    bool Matches(std::wstring_view path) const;
+
+private:
+    static constexpr size_t C_NO_NODE = static_cast<size_t>(-1);
+
+    struct Node
+    {
+        // Sorted by character
+        std::vector<std::pair<wchar_t, size_t>> children;
+        size_t fail = 0;
+        // Index of the application ending at this node, C_NO_NODE if none
+        size_t app = C_NO_NODE;
+        // Closest node of the fail chain where an application ends, the root if none
+        size_t output = 0;
+    };
+
+    size_t Child(size_t node, wchar_t c) const noexcept;
+
+    std::vector<Node> m_nodes{ Node{} };
+    std::vector<size_t> m_lengths;
+    bool m_hasEmptyApp = false;
+};
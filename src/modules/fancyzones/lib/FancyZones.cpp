@@ -10,7 +10,9 @@
 #include "lib/ZoneWindow.h"
 #include "lib/FancyZonesData.h"
 #include "lib/ZoneSet.h"
+#include "lib/ZonedWindows.h"
 #include "lib/FileWatcher.h"
+#include "lib/ProcessInfoCache.h"
 #include "lib/WindowMoveHandler.h"
 #include "lib/FancyZonesWinHookEventIDs.h"
 #include "lib/util.h"
@@ -307,6 +309,9 @@ FancyZones::Run() noexcept
 
     VirtualDesktopInitialize();
 
+    // Windows zoned before FancyZones was restarted
+    ZonedWindowsInstance().LoadFromWindowProperties();
+
     m_dpiUnawareThread.submit(OnThreadExecutor::task_t{ [] {
                           SetThreadDpiAwarenessContext(DPI_AWARENESS_CONTEXT_UNAWARE);
                           SetThreadDpiHostingBehavior(DPI_HOSTING_BEHAVIOR_MIXED);
@@ -333,6 +338,10 @@ FancyZones::Destroy() noexcept
     {
         SetEvent(m_terminateVirtualDesktopTrackerEvent.get());
     }
+
+    // Stop the writer thread here rather than when the data is destroyed while the module is unloaded
+    FancyZonesDataInstance().FlushAppZoneHistory();
+    ProcessInfoCacheInstance().Clear();
 }
 
 // IFancyZonesCallback
@@ -357,7 +366,7 @@ bool FancyZones::ShouldProcessNewWindow(HWND window) noexcept
     // Avoid processing splash screens, already stamped (zoned) windows, or those windows
     // that belong to excluded applications list.
     if (IsSplashScreen(window) ||
-        (reinterpret_cast<size_t>(::GetProp(window, ZonedWindowProperties::PropertyMultipleZoneID)) != 0) ||
+        ZonedWindowsInstance().IsZoned(window) ||
         !IsCandidateForLastKnownZone(window, m_settings->GetSettings()->excludedAppsArray))
     {
         return false;
@@ -751,6 +760,9 @@ void FancyZones::ToggleEditor() noexcept
 
 void FancyZones::SettingsChanged() noexcept
 {
+    // The excluded applications may have changed
+    ProcessInfoCacheInstance().ExcludedAppsChanged();
+
     // Update the hotkey
     UnregisterHotKey(m_window, 1);
     RegisterHotKey(m_window, 1, m_settings->GetSettings()->editorHotkey.get_modifiers(), m_settings->GetSettings()->editorHotkey.get_code());
@@ -1005,31 +1017,16 @@ void FancyZones::UpdateZoneWindows() noexcept
 
 void FancyZones::UpdateWindowsPositions() noexcept
 {
-    auto callback = [](HWND window, LPARAM data) -> BOOL {
-        size_t bitmask = reinterpret_cast<size_t>(::GetProp(window, ZonedWindowProperties::PropertyMultipleZoneID));
-
-        if (bitmask != 0)
+    // Moving a window stamps it again, so iterate over a copy of the zoned windows
+    for (const auto& [window, zoneIds] : ZonedWindowsInstance().GetAll())
+    {
+        std::unique_lock writeLock(m_lock);
+        auto zoneWindow = m_workAreaHandler.GetWorkArea(window);
+        if (zoneWindow)
         {
-            std::vector<size_t> indexSet;
-            for (int i = 0; i < std::numeric_limits<size_t>::digits; i++)
-            {
-                if ((1ull << i) & bitmask)
-                {
-                    indexSet.push_back(i);
-                }
-            }
-
-            auto strongThis = reinterpret_cast<FancyZones*>(data);
-            std::unique_lock writeLock(strongThis->m_lock);
-            auto zoneWindow = strongThis->m_workAreaHandler.GetWorkArea(window);
-            if (zoneWindow)
-            {
-                strongThis->m_windowMoveHandler.MoveWindowIntoZoneByIndexSet(window, indexSet, zoneWindow);
-            }
+            m_windowMoveHandler.MoveWindowIntoZoneByIndexSet(window, zoneIds, zoneWindow);
         }
-        return TRUE;
-    };
-    EnumWindows(callback, reinterpret_cast<LPARAM>(this));
+    }
 }
 
 void FancyZones::CycleActiveZoneSet(DWORD vkCode) noexcept
@@ -3,7 +3,9 @@
 #include "FancyZonesDataTypes.h"
 #include "JsonHelpers.h"
 #include "ZoneSet.h"
+#include "ZonedWindows.h"
 #include "Settings.h"
+#include "ProcessInfoCache.h"
 
 #include <common/utils/json.h>
 #include <fancyzones/lib/util.h>
@@ -15,7 +17,6 @@
 #include <regex>
 #include <sstream>
 #include <unordered_set>
-#include <common/utils/process_path.h>
 #include <common/logger/logger.h>
 
 // Non-localizable strings
@@ -33,6 +34,13 @@ namespace NonLocalizable
 
 namespace
 {
+    // Window drops in a quick succession are written to the app zone history file once
+    constexpr std::chrono::milliseconds C_APP_ZONE_HISTORY_SAVE_DELAY{ 1000 };
+    constexpr std::chrono::milliseconds C_APP_ZONE_HISTORY_SAVE_MAX_DELAY{ 5000 };
+    // The JSON file is rewritten as a whole, so it's exported less often than the store is written
+    constexpr std::chrono::milliseconds C_APP_ZONE_HISTORY_EXPORT_DELAY{ 10000 };
+    constexpr std::chrono::milliseconds C_APP_ZONE_HISTORY_EXPORT_MAX_DELAY{ 60000 };
+
     std::wstring ExtractVirtualDesktopId(const std::wstring& deviceId)
     {
         // Format: <device-id>_<resolution>_<virtual-desktop-id>
@@ -144,13 +152,16 @@ FancyZonesData& FancyZonesDataInstance()
     return instance;
 }
 
-FancyZonesData::FancyZonesData()
+FancyZonesData::FancyZonesData() :
+    appZoneHistoryWriter([this] { WriteAppZoneHistory(); }, C_APP_ZONE_HISTORY_SAVE_DELAY, C_APP_ZONE_HISTORY_SAVE_MAX_DELAY),
+    appZoneHistoryExporter([this] { ExportAppZoneHistory(); }, C_APP_ZONE_HISTORY_EXPORT_DELAY, C_APP_ZONE_HISTORY_EXPORT_MAX_DELAY)
 {
     std::wstring saveFolderPath = PTSettingsHelper::get_module_save_folder_location(NonLocalizable::FancyZonesStr);
 
     zonesSettingsFileName = saveFolderPath + L"\\" + std::wstring(NonLocalizable::FancyZonesDataFile);
     appZoneHistoryFileName = saveFolderPath + L"\\" + std::wstring(NonLocalizable::FancyZonesAppZoneHistoryFile);
     editorParametersFileName = saveFolderPath + L"\\" + std::wstring(NonLocalizable::FancyZonesEditorParametersFile);
+    appZoneHistoryStore.Open(appZoneHistoryFileName);
 }
 
 std::optional<FancyZonesDataTypes::DeviceInfoData> FancyZonesData::FindDeviceInfo(const std::wstring& zoneWindowId) const
@@ -289,14 +300,14 @@ void FancyZonesData::RemoveDeletedDesktops(const std::vector<std::wstring>& acti
 
     if (dirtyFlag)
     {
-        SaveAppZoneHistoryAndZoneSettings();
+        SaveZoneSettings();
     }
 }
 
 bool FancyZonesData::IsAnotherWindowOfApplicationInstanceZoned(HWND window, const std::wstring_view& deviceId) const
 {
     std::scoped_lock lock{ dataLock };
-    auto processPath = get_process_path(window);
+    auto processPath = ProcessInfoCacheInstance().GetProcessPath(window);
     if (!processPath.empty())
     {
         auto history = appZoneHistoryMap.find(processPath);
@@ -331,7 +342,7 @@ bool FancyZonesData::IsAnotherWindowOfApplicationInstanceZoned(HWND window, cons
 void FancyZonesData::UpdateProcessIdToHandleMap(HWND window, const std::wstring_view& deviceId)
 {
     std::scoped_lock lock{ dataLock };
-    auto processPath = get_process_path(window);
+    auto processPath = ProcessInfoCacheInstance().GetProcessPath(window);
     if (!processPath.empty())
     {
         auto history = appZoneHistoryMap.find(processPath);
@@ -355,7 +366,7 @@ void FancyZonesData::UpdateProcessIdToHandleMap(HWND window, const std::wstring_
 std::vector<size_t> FancyZonesData::GetAppLastZoneIndexSet(HWND window, const std::wstring_view& deviceId, const std::wstring_view& zoneSetId) const
 {
     std::scoped_lock lock{ dataLock };
-    auto processPath = get_process_path(window);
+    auto processPath = ProcessInfoCacheInstance().GetProcessPath(window);
     if (!processPath.empty())
     {
         auto history = appZoneHistoryMap.find(processPath);
@@ -378,7 +389,7 @@ std::vector<size_t> FancyZonesData::GetAppLastZoneIndexSet(HWND window, const st
 bool FancyZonesData::RemoveAppLastZone(HWND window, const std::wstring_view& deviceId, const std::wstring_view& zoneSetId)
 {
     std::scoped_lock lock{ dataLock };
-    auto processPath = get_process_path(window);
+    auto processPath = ProcessInfoCacheInstance().GetProcessPath(window);
     if (!processPath.empty())
     {
         auto history = appZoneHistoryMap.find(processPath);
@@ -398,11 +409,10 @@ bool FancyZonesData::RemoveAppLastZone(HWND window, const std::wstring_view& dev
                     }
 
                     // if there is another instance of same application placed in the same zone don't erase history
-                    size_t windowZoneStamp = reinterpret_cast<size_t>(::GetProp(window, ZonedWindowProperties::PropertyMultipleZoneID));
+                    const auto windowZones = ZonedWindowsInstance().GetZones(window);
                     for (auto placedWindow : data->processIdToHandleMap)
                     {
-                        size_t placedWindowZoneStamp = reinterpret_cast<size_t>(::GetProp(placedWindow.second, ZonedWindowProperties::PropertyMultipleZoneID));
-                        if (IsWindow(placedWindow.second) && (windowZoneStamp == placedWindowZoneStamp))
+                        if (IsWindow(placedWindow.second) && (windowZones == ZonedWindowsInstance().GetZones(placedWindow.second)))
                         {
                             return false;
                         }
@@ -413,7 +423,7 @@ bool FancyZonesData::RemoveAppLastZone(HWND window, const std::wstring_view& dev
                     {
                         appZoneHistoryMap.erase(processPath);
                     }
-                    SaveAppZoneHistory();
+                    SaveAppZoneHistory(processPath);
                     return true;
                 }
                 else
@@ -436,7 +446,7 @@ bool FancyZonesData::SetAppLastZones(HWND window, const std::wstring& deviceId,
         return false;
     }
 
-    auto processPath = get_process_path(window);
+    auto processPath = ProcessInfoCacheInstance().GetProcessPath(window);
     if (processPath.empty())
     {
         return false;
@@ -457,7 +467,7 @@ bool FancyZonesData::SetAppLastZones(HWND window, const std::wstring& deviceId,
                 data.processIdToHandleMap[processId] = window;
                 data.zoneSetUuid = zoneSetId;
                 data.zoneIndexSet = zoneIndexSet;
-                SaveAppZoneHistory();
+                SaveAppZoneHistory(processPath);
                 return true;
             }
         }
@@ -481,7 +491,7 @@ bool FancyZonesData::SetAppLastZones(HWND window, const std::wstring& deviceId,
         appZoneHistoryMap[processPath] = std::vector<FancyZonesDataTypes::AppZoneHistoryData>{ data };
     }
 
-    SaveAppZoneHistory();
+    SaveAppZoneHistory(processPath);
     return true;
 }
 
@@ -504,16 +514,39 @@ void FancyZonesData::LoadFancyZonesData()
 {
     if (!std::filesystem::exists(zonesSettingsFileName))
     {
+        LoadAppZoneHistory();
         SaveAppZoneHistoryAndZoneSettings();
     }
     else
     {
-        json::JsonObject fancyZonesDataJSON = GetPersistFancyZonesJSON();
+        // The app zone history in the JSON files is only read when it's imported into the store
+        json::JsonObject fancyZonesDataJSON = json::from_file(zonesSettingsFileName).value_or(json::JsonObject{});
 
-        appZoneHistoryMap = JSONHelpers::ParseAppZoneHistory(fancyZonesDataJSON);
         deviceInfoMap = JSONHelpers::ParseDeviceInfos(fancyZonesDataJSON);
         customZoneSetsMap = JSONHelpers::ParseCustomZoneSets(fancyZonesDataJSON);
+        LoadAppZoneHistory();
+    }
+}
+
+void FancyZonesData::LoadAppZoneHistory()
+{
+    std::scoped_lock lock{ dataLock };
+    if (appZoneHistoryLoaded)
+    {
+        return;
+    }
+    appZoneHistoryLoaded = true;
+
+    if (auto history = appZoneHistoryStore.Load(); history.has_value())
+    {
+        appZoneHistoryMap = std::move(*history);
+        return;
     }
+
+    // First run with the store, or its files are damaged
+    appZoneHistoryMap = JSONHelpers::ParseAppZoneHistory(GetPersistFancyZonesJSON());
+    SaveAppZoneHistory();
+    exportedAppZoneHistoryGeneration = appZoneHistoryGeneration;
 }
 
 void FancyZonesData::SaveAppZoneHistoryAndZoneSettings() const
@@ -531,9 +564,102 @@ void FancyZonesData::SaveZoneSettings() const
 
 void FancyZonesData::SaveAppZoneHistory() const
 {
-    Logger::trace("FancyZonesData::SaveAppZoneHistory()");
+    {
+        std::scoped_lock lock{ dataLock };
+        allAppZoneHistoryChanged = true;
+        ++appZoneHistoryGeneration;
+    }
+    appZoneHistoryWriter.Schedule();
+    appZoneHistoryExporter.Schedule();
+}
+
+void FancyZonesData::SaveAppZoneHistory(const std::wstring& appPath)
+{
+    {
+        std::scoped_lock lock{ dataLock };
+        changedAppZoneHistory.insert(appPath);
+        ++appZoneHistoryGeneration;
+    }
+    appZoneHistoryWriter.Schedule();
+    appZoneHistoryExporter.Schedule();
+}
+
+void FancyZonesData::FlushAppZoneHistory()
+{
+    appZoneHistoryWriter.Stop();
+    appZoneHistoryExporter.Stop();
+
+    // Retry an export that failed
+    ExportAppZoneHistory();
+}
+
+void FancyZonesData::ExportAppZoneHistory()
+{
+    // Keep the JSON file up to date for older versions of FancyZones
+    std::wstring fileName;
+    JSONHelpers::TAppZoneHistoryMap appZoneHistory;
+    uint64_t generation = 0;
+    {
+        std::scoped_lock lock{ dataLock };
+        if (appZoneHistoryGeneration == exportedAppZoneHistoryGeneration)
+        {
+            return;
+        }
+        fileName = appZoneHistoryFileName;
+        appZoneHistory = appZoneHistoryMap;
+        generation = appZoneHistoryGeneration;
+    }
+
+    if (JSONHelpers::SaveAppZoneHistory(fileName, appZoneHistory))
+    {
+        std::scoped_lock lock{ dataLock };
+        exportedAppZoneHistoryGeneration = generation;
+    }
+}
+
+void FancyZonesData::WriteAppZoneHistory()
+{
+    // Called by the writer, only the changed applications are copied, and written without holding the lock
+    std::optional<JSONHelpers::TAppZoneHistoryMap> appZoneHistory;
+    std::vector<AppZoneHistoryStore::Change> changes;
+    uint64_t generation = 0;
+    {
+        std::scoped_lock lock{ dataLock };
+        if (appZoneHistoryGeneration == savedAppZoneHistoryGeneration)
+        {
+            return;
+        }
+
+        if (allAppZoneHistoryChanged)
+        {
+            appZoneHistory = appZoneHistoryMap;
+        }
+        else
+        {
+            for (const auto& appPath : changedAppZoneHistory)
+            {
+                auto history = appZoneHistoryMap.find(appPath);
+                changes.push_back({ appPath, history != std::end(appZoneHistoryMap) ? history->second : std::vector<FancyZonesDataTypes::AppZoneHistoryData>{} });
+            }
+        }
+        changedAppZoneHistory.clear();
+        allAppZoneHistoryChanged = false;
+        generation = appZoneHistoryGeneration;
+    }
+
+    Logger::trace("FancyZonesData::WriteAppZoneHistory()");
+    const bool saved = appZoneHistory.has_value() ? appZoneHistoryStore.Replace(*appZoneHistory) : appZoneHistoryStore.Update(changes);
+
     std::scoped_lock lock{ dataLock };
-    JSONHelpers::SaveAppZoneHistory(appZoneHistoryFileName, appZoneHistoryMap);
+    if (saved)
+    {
+        savedAppZoneHistoryGeneration = generation;
+    }
+    else
+    {
+        // The changes taken are lost, the next write replaces the whole history
+        allAppZoneHistoryChanged = true;
+    }
 }
 
 void FancyZonesData::SaveFancyZonesEditorParameters(bool spanZonesAcrossMonitors, const std::wstring& virtualDesktopId, const HMONITOR& targetMonitor) const
@@ -609,6 +735,7 @@ void FancyZonesData::RemoveDesktopAppZoneHistory(const std::wstring& desktopId)
             if (ExtractVirtualDesktopId(desktopIt->deviceId) == desktopId)
             {
                 desktopIt = perDesktopData.erase(desktopIt);
+                SaveAppZoneHistory(it->first);
             }
             else
             {
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "JsonHelpers.h"
+#include "AppZoneHistoryStore.h"
+#include "DeferredWriter.h"
 
 #include <common/SettingsAPI/settings_helpers.h>
 #include <common/utils/json.h>
@@ -8,6 +10,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <optional>
 #include <vector>
 #include <winnt.h>
@@ -84,6 +87,8 @@ public:
     void SaveAppZoneHistoryAndZoneSettings() const;
     void SaveZoneSettings() const;
     void SaveAppZoneHistory() const;
+    // Writes the pending app zone history changes, stops the background writer and exports the history to JSON
+    void FlushAppZoneHistory();
 
     void SaveFancyZonesEditorParameters(bool spanZonesAcrossMonitors, const std::wstring& virtualDesktopId, const HMONITOR& targetMonitor) const;
 
@@ -123,9 +128,15 @@ private:
         std::wstring result = PTSettingsHelper::get_module_save_folder_location(moduleName);
         zonesSettingsFileName = result + L"\\" + std::wstring(L"zones-settings.json");
         appZoneHistoryFileName = result + L"\\" + std::wstring(L"app-zone-history.json");
+        appZoneHistoryStore.Open(appZoneHistoryFileName);
+        appZoneHistoryLoaded = false;
     }
 #endif
     void RemoveDesktopAppZoneHistory(const std::wstring& desktopId);
+    void LoadAppZoneHistory();
+    void SaveAppZoneHistory(const std::wstring& appPath);
+    void WriteAppZoneHistory();
+    void ExportAppZoneHistory();
 
     // Maps app path to app's zone history data
     std::unordered_map<std::wstring, std::vector<FancyZonesDataTypes::AppZoneHistoryData>> appZoneHistoryMap{};
@@ -139,6 +150,21 @@ private:
     std::wstring editorParametersFileName;
 
     mutable std::recursive_mutex dataLock;
+
+    // Applications whose history changed since it was last written, or all of them
+    std::unordered_set<std::wstring> changedAppZoneHistory;
+    mutable bool allAppZoneHistoryChanged = false;
+    // Incremented on every change of the app zone history, which is written when it differs from the saved one
+    mutable uint64_t appZoneHistoryGeneration = 0;
+    uint64_t savedAppZoneHistoryGeneration = 0;
+    uint64_t exportedAppZoneHistoryGeneration = 0;
+    // Once loaded, the history in memory is the most recent one, FancyZones being the only one changing it
+    bool appZoneHistoryLoaded = false;
+    AppZoneHistoryStore appZoneHistoryStore;
+    // Declared last so they stop, writing the pending changes, before the data is destroyed
+    mutable DeferredWriter appZoneHistoryWriter;
+    // Keeps the JSON file close to the store when FancyZones doesn't exit cleanly
+    mutable DeferredWriter appZoneHistoryExporter;
 };
 
 FancyZonesData& FancyZonesDataInstance();
@@ -1,68 +1,437 @@
 #include "pch.h"
 #include "FileWatcher.h"
 
-std::optional<FILETIME> FileWatcher::MyFileTime()
+#include <common/logger/logger.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <map>
+#include <mutex>
+
+namespace
 {
-    HANDLE hFile = CreateFileW(m_path.c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr);
-    std::optional<FILETIME> result;
-    if (hFile != INVALID_HANDLE_VALUE)
+    constexpr DWORD C_NOTIFY_BUFFER_SIZE = 16 * 1024;
+    constexpr DWORD C_NOTIFY_FILTER = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_CREATION;
+    // Completion key of the packets posted to wake the thread up, the directories use their address
+    constexpr ULONG_PTR C_WAKE_KEY = 0;
+    // Interval at which a folder that can't be watched is opened again, and its files checked
+    constexpr std::chrono::milliseconds C_RETRY_DELAY{ 1000 };
+
+    std::optional<uint64_t> HashFile(const std::wstring& path)
     {
-        FILETIME lastWrite;
-        if (GetFileTime(hFile, nullptr, nullptr, &lastWrite))
+        wil::unique_hfile file{ CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+        if (!file)
         {
-            result = lastWrite;
+            return std::nullopt;
         }
 
-        CloseHandle(hFile);
+        // FNV-1a
+        uint64_t hash = 14695981039346656037ull;
+        BYTE buffer[4096];
+        DWORD read = 0;
+        while (ReadFile(file.get(), buffer, sizeof(buffer), &read, nullptr) && read > 0)
+        {
+            for (DWORD i = 0; i < read; ++i)
+            {
+                hash ^= buffer[i];
+                hash *= 1099511628211ull;
+            }
+        }
+        return hash;
     }
 
-    return result;
-}
+    class FileWatcherService
+    {
+    public:
+        static FileWatcherService& Instance()
+        {
+            static FileWatcherService instance;
+            return instance;
+        }
 
-void FileWatcher::Run()
-{
-    while (1)
+        size_t Add(const std::wstring& path, std::function<void()> callback, std::chrono::milliseconds debounce);
+        void Remove(size_t id);
+
+    private:
+        struct Directory
+        {
+            std::wstring path;
+            wil::unique_hfile handle;
+            OVERLAPPED overlapped{};
+            // DWORD aligned, as FILE_NOTIFY_INFORMATION requires
+            std::vector<DWORD> buffer = std::vector<DWORD>(C_NOTIFY_BUFFER_SIZE / sizeof(DWORD));
+            size_t watchCount = 0;
+            // Whether a read is in progress, the directory can't be freed before it completes
+            bool pending = false;
+            bool closing = false;
+            // Set while the folder can't be watched, time of the next attempt
+            std::optional<std::chrono::steady_clock::time_point> retry;
+        };
+
+        struct Watch
+        {
+            std::wstring path;
+            std::wstring fileName;
+            std::function<void()> callback;
+            std::chrono::milliseconds debounce;
+            std::optional<uint64_t> hash;
+            std::optional<std::chrono::steady_clock::time_point> due;
+            Directory* directory;
+        };
+
+        void Run();
+        bool Open(Directory& directory);
+        void Retry(Directory& directory);
+        void StartRead(Directory& directory);
+        void OnNotification(Directory& directory, DWORD bytes);
+        DWORD CheckWatches(std::unique_lock<std::mutex>& lock);
+
+        std::mutex m_lock;
+        std::condition_variable m_cv;
+        wil::unique_handle m_port;
+        bool m_running = false;
+        DWORD m_threadId = 0;
+        // Watch whose callback is running, 0 if none
+        size_t m_runningCallback = 0;
+        size_t m_nextId = 1;
+        std::map<size_t, Watch> m_watches;
+        // Keyed by lowercase path
+        std::map<std::wstring, std::unique_ptr<Directory>> m_directories;
+        // Directories no longer watched, waiting for their read to be cancelled
+        std::vector<std::unique_ptr<Directory>> m_closing;
+    };
+
+    size_t FileWatcherService::Add(const std::wstring& path, std::function<void()> callback, std::chrono::milliseconds debounce)
     {
-        auto lastWrite = MyFileTime();
-        if (!m_lastWrite.has_value())
+        const std::filesystem::path filePath{ path };
+        std::wstring directoryPath = filePath.parent_path().wstring();
+        std::wstring directoryKey = directoryPath;
+        std::transform(directoryKey.begin(), directoryKey.end(), directoryKey.begin(), towlower);
+        auto hash = HashFile(path);
+
+        std::unique_lock lock(m_lock);
+        if (!m_port)
         {
-            m_lastWrite = lastWrite;
+            m_port.reset(CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1));
+            if (!m_port)
+            {
+                Logger::error(L"Failed to create the completion port of the file watchers");
+            }
         }
-        else if (lastWrite.has_value())
+
+        auto& directory = m_directories[directoryKey];
+        if (!directory)
         {
-            if (m_lastWrite->dwHighDateTime != lastWrite->dwHighDateTime ||
-                m_lastWrite->dwLowDateTime != lastWrite->dwLowDateTime)
+            directory = std::make_unique<Directory>();
+            directory->path = directoryPath;
+            if (!Open(*directory))
             {
-                m_lastWrite = lastWrite;
-                m_callback();
+                Logger::error(L"Failed to watch {}", directoryPath);
+                Retry(*directory);
             }
         }
+        directory->watchCount++;
+
+        const size_t id = m_nextId++;
+        m_watches.emplace(id, Watch{ path, filePath.filename().wstring(), std::move(callback), debounce, hash, std::nullopt, directory.get() });
+
+        if (!m_running && m_port)
+        {
+            // The thread exits by itself once nothing is watched
+            m_running = true;
+            std::thread([this] { Run(); }).detach();
+        }
+        else if (m_port)
+        {
+            // The read of a new directory is started by the thread
+            PostQueuedCompletionStatus(m_port.get(), 0, C_WAKE_KEY, nullptr);
+        }
+
+        return id;
+    }
+
+    void FileWatcherService::Remove(size_t id)
+    {
+        std::unique_lock lock(m_lock);
+        const bool onThread = GetCurrentThreadId() == m_threadId;
 
-        if (WaitForSingleObject(m_abortEvent, m_refreshPeriod) == WAIT_OBJECT_0)
+        // After the watcher is removed its callback isn't called, unless it's removed from that callback
+        m_cv.wait(lock, [&] { return m_runningCallback != id || onThread; });
+
+        auto watch = m_watches.find(id);
+        if (watch == m_watches.end())
         {
             return;
         }
+
+        Directory* directory = watch->second.directory;
+        m_watches.erase(watch);
+        if (--directory->watchCount == 0)
+        {
+            auto it = std::find_if(m_directories.begin(), m_directories.end(), [&](const auto& entry) { return entry.second.get() == directory; });
+            it->second->closing = true;
+            m_closing.push_back(std::move(it->second));
+            m_directories.erase(it);
+        }
+
+        if (m_running)
+        {
+            PostQueuedCompletionStatus(m_port.get(), 0, C_WAKE_KEY, nullptr);
+
+            // Wait for the thread to exit when nothing is left to watch, so the module can be unloaded
+            if (m_watches.empty() && !onThread)
+            {
+                m_cv.wait(lock, [&] { return !m_running || !m_watches.empty(); });
+            }
+        }
     }
-}
 
-FileWatcher::FileWatcher(const std::wstring& path, std::function<void()> callback, DWORD refreshPeriod) :
-    m_refreshPeriod(refreshPeriod),
-    m_path(path),
-    m_callback(callback)
-{
-    m_abortEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
-    if (m_abortEvent)
+    void FileWatcherService::Run()
     {
-        m_thread = std::thread([this]() { Run(); });
+        std::unique_lock lock(m_lock);
+        m_threadId = GetCurrentThreadId();
+
+        while (true)
+        {
+            // All the reads are issued by this thread
+            const auto now = std::chrono::steady_clock::now();
+            for (auto& [key, directory] : m_directories)
+            {
+                if (directory->retry && *directory->retry <= now)
+                {
+                    // The changes of the files weren't notified, they are checked on every attempt
+                    directory->retry.reset();
+                    for (auto& [id, watch] : m_watches)
+                    {
+                        if (watch.directory == directory.get() && !watch.due)
+                        {
+                            watch.due = now;
+                        }
+                    }
+
+                    if (!Open(*directory))
+                    {
+                        Retry(*directory);
+                    }
+                }
+
+                if (directory->handle && !directory->pending)
+                {
+                    StartRead(*directory);
+                }
+            }
+
+            for (auto it = m_closing.begin(); it != m_closing.end();)
+            {
+                if ((*it)->pending)
+                {
+                    CancelIoEx((*it)->handle.get(), &(*it)->overlapped);
+                    ++it;
+                }
+                else
+                {
+                    it = m_closing.erase(it);
+                }
+            }
+
+            if (m_watches.empty() && m_closing.empty())
+            {
+                break;
+            }
+
+            DWORD timeout = CheckWatches(lock);
+            for (const auto& [key, directory] : m_directories)
+            {
+                if (directory->retry)
+                {
+                    const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(*directory->retry - std::chrono::steady_clock::now()).count();
+                    timeout = std::min<DWORD>(timeout, static_cast<DWORD>(std::max<long long>(remaining, 0)));
+                }
+            }
+
+            lock.unlock();
+            DWORD bytes = 0;
+            ULONG_PTR key = C_WAKE_KEY;
+            OVERLAPPED* overlapped = nullptr;
+            const BOOL succeeded = GetQueuedCompletionStatus(m_port.get(), &bytes, &key, &overlapped, timeout);
+            const DWORD error = succeeded ? ERROR_SUCCESS : GetLastError();
+            lock.lock();
+
+            if (overlapped && key != C_WAKE_KEY)
+            {
+                auto& directory = *reinterpret_cast<Directory*>(key);
+                directory.pending = false;
+                if (directory.closing)
+                {
+                    continue;
+                }
+
+                if (succeeded)
+                {
+                    OnNotification(directory, bytes);
+                }
+                else if (error != ERROR_OPERATION_ABORTED)
+                {
+                    Logger::error(L"Failed to read the changes of {}, error {}", directory.path, error);
+                    Retry(directory);
+                }
+            }
+        }
+
+        m_threadId = 0;
+        m_running = false;
+        m_cv.notify_all();
+    }
+
+    bool FileWatcherService::Open(Directory& directory)
+    {
+        directory.handle.reset(CreateFileW(directory.path.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr));
+        if (!directory.handle || !m_port || !CreateIoCompletionPort(directory.handle.get(), m_port.get(), reinterpret_cast<ULONG_PTR>(&directory), 0))
+        {
+            directory.handle.reset();
+            return false;
+        }
+        return true;
+    }
+
+    void FileWatcherService::Retry(Directory& directory)
+    {
+        // Until the folder is watched again, its files are polled
+        directory.handle.reset();
+        directory.retry = std::chrono::steady_clock::now() + C_RETRY_DELAY;
     }
+
+    void FileWatcherService::StartRead(Directory& directory)
+    {
+        directory.overlapped = OVERLAPPED{};
+        if (ReadDirectoryChangesW(directory.handle.get(), directory.buffer.data(), static_cast<DWORD>(directory.buffer.size() * sizeof(DWORD)), FALSE, C_NOTIFY_FILTER, nullptr, &directory.overlapped, nullptr))
+        {
+            directory.pending = true;
+        }
+        else
+        {
+            Logger::error(L"Failed to watch {}, error {}", directory.path, GetLastError());
+            Retry(directory);
+        }
+    }
+
+    void FileWatcherService::OnNotification(Directory& directory, DWORD bytes)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        auto notify = [&](const wchar_t* name, size_t length) {
+            for (auto& [id, watch] : m_watches)
+            {
+                if (watch.directory == &directory &&
+                    (!name || CompareStringOrdinal(name, static_cast<int>(length), watch.fileName.c_str(), static_cast<int>(watch.fileName.size()), TRUE) == CSTR_EQUAL))
+                {
+                    // Every notification delays the check, so a burst of writes is checked once
+                    watch.due = now + watch.debounce;
+                }
+            }
+        };
+
+        if (bytes == 0)
+        {
+            // The buffer overflowed, any file could have changed
+            notify(nullptr, 0);
+            return;
+        }
+
+        const BYTE* data = reinterpret_cast<const BYTE*>(directory.buffer.data());
+        for (DWORD offset = 0;;)
+        {
+            const auto* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(data + offset);
+            notify(info->FileName, info->FileNameLength / sizeof(wchar_t));
+            if (info->NextEntryOffset == 0)
+            {
+                break;
+            }
+            offset += info->NextEntryOffset;
+        }
+    }
+
+    DWORD FileWatcherService::CheckWatches(std::unique_lock<std::mutex>& lock)
+    {
+        auto now = std::chrono::steady_clock::now();
+        std::vector<size_t> dueWatches;
+        for (auto& [id, watch] : m_watches)
+        {
+            if (watch.due && *watch.due <= now)
+            {
+                watch.due.reset();
+                dueWatches.push_back(id);
+            }
+        }
+
+        for (size_t id : dueWatches)
+        {
+            auto watch = m_watches.find(id);
+            if (watch == m_watches.end())
+            {
+                continue;
+            }
+
+            const std::wstring path = watch->second.path;
+            lock.unlock();
+            const auto hash = HashFile(path);
+            const bool exists = GetFileAttributesW(path.c_str()) != INVALID_FILE_ATTRIBUTES;
+            lock.lock();
+
+            // Removed while its file was read
+            watch = m_watches.find(id);
+            if (watch == m_watches.end())
+            {
+                continue;
+            }
+
+            if (!hash && exists)
+            {
+                // Still being written by another process, check again later
+                watch->second.due = std::chrono::steady_clock::now() + watch->second.debounce;
+                continue;
+            }
+
+            if (hash == watch->second.hash)
+            {
+                continue;
+            }
+
+            watch->second.hash = hash;
+            if (hash)
+            {
+                auto callback = watch->second.callback;
+                m_runningCallback = id;
+                lock.unlock();
+                callback();
+                lock.lock();
+                m_runningCallback = 0;
+                m_cv.notify_all();
+            }
+        }
+
+        // Wait until the next check
+        now = std::chrono::steady_clock::now();
+        DWORD timeout = INFINITE;
+        for (const auto& [id, watch] : m_watches)
+        {
+            if (watch.due)
+            {
+                const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(*watch.due - now).count();
+                timeout = std::min<DWORD>(timeout, static_cast<DWORD>(std::max<long long>(remaining, 0)));
+            }
+        }
+        return timeout;
+    }
+}
+
+FileWatcher::FileWatcher(const std::wstring& path, std::function<void()> callback, DWORD debounceMillis) :
+    m_id(FileWatcherService::Instance().Add(path, std::move(callback), std::chrono::milliseconds(debounceMillis)))
+{
 }
 
 FileWatcher::~FileWatcher()
 {
-    if (m_abortEvent)
-    {
-        SetEvent(m_abortEvent);
-        m_thread.join();
-        CloseHandle(m_abortEvent);
-    }
+    FileWatcherService::Instance().Remove(m_id);
 }
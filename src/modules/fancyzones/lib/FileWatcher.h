@@ -2,18 +2,26 @@
 
 #include "pch.h"
 
+/**
+ * Calls back when the content of a file changes. All the watchers share one thread, waiting on the change
+ * notifications of the folders of the watched files. Notifications are debounced, so a file saved by an editor
+ * in several steps is checked once, and the callback is only called when the hash of the content of the file
+ * changed, so touching the file without changing it is ignored.
+ */
 class FileWatcher
 {
-    DWORD m_refreshPeriod;
-    std::wstring m_path;
-    std::optional<FILETIME> m_lastWrite;
-    std::function<void()> m_callback;
-    HANDLE m_abortEvent;
-    std::thread m_thread;
-    
-    std::optional<FILETIME> MyFileTime();
-    void Run();
+    size_t m_id;
+
 public:
-    FileWatcher(const std::wstring& path, std::function<void()> callback, DWORD refreshPeriod = 1000);
+    /**
+     * @param   path           Path of the watched file. While its folder can't be watched, it's opened again and the file
+     *                         is checked every second.
+     * @param   callback       Called on the thread of the watchers after the content of the file changed.
+     * @param   debounceMillis Time without notifications for the file after which its content is checked.
+     */
+    FileWatcher(const std::wstring& path, std::function<void()> callback, DWORD debounceMillis = 200);
     ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
 };
@@ -7,6 +7,7 @@
 #include "util.h"
 
 #include <common/logger/logger.h>
+#include <common/utils/winapi_error.h>
 
 #include <filesystem>
 #include <optional>
@@ -119,6 +120,44 @@ namespace
     {
         return DeleteFileW(tmpFilePath.data());
     }
+
+    // Writes to a temporary file next to the target and renames it over the target, so readers
+    // never see a partially written file
+    bool WriteFileAtomically(const std::wstring& fileName, const json::JsonObject& root)
+    {
+        const std::wstring tmpFileName = fileName + L".tmp";
+        {
+            const std::string content = winrt::to_string(root.Stringify());
+            wil::unique_hfile file{ CreateFileW(tmpFileName.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr) };
+            if (!file)
+            {
+                auto err = get_last_error_message(GetLastError());
+                Logger::error(L"Failed to create {}. {}", tmpFileName, err.has_value() ? err.value() : L"");
+                return false;
+            }
+
+            // Flushed before the rename, or a crash could leave the target renamed over an empty file
+            DWORD written = 0;
+            if (!WriteFile(file.get(), content.data(), static_cast<DWORD>(content.size()), &written, nullptr) || written != content.size() || !FlushFileBuffers(file.get()))
+            {
+                auto err = get_last_error_message(GetLastError());
+                Logger::error(L"Failed to write {}. {}", tmpFileName, err.has_value() ? err.value() : L"");
+                file.reset();
+                DeleteTmpFile(tmpFileName);
+                return false;
+            }
+        }
+
+        if (!MoveFileExW(tmpFileName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+        {
+            auto err = get_last_error_message(GetLastError());
+            Logger::error(L"Failed to replace {}. {}", fileName, err.has_value() ? err.value() : L"");
+            DeleteTmpFile(tmpFileName);
+            return false;
+        }
+
+        return true;
+    }
 }
 
 namespace JSONHelpers
@@ -557,16 +596,17 @@ namespace JSONHelpers
         }
     }
 
-    void SaveAppZoneHistory(const std::wstring& appZoneHistoryFileName, const TAppZoneHistoryMap& appZoneHistoryMap)
+    bool SaveAppZoneHistory(const std::wstring& appZoneHistoryFileName, const TAppZoneHistoryMap& appZoneHistoryMap)
     {
-        json::JsonObject root{};
-
-        root.SetNamedValue(NonLocalizable::AppZoneHistoryStr, JSONHelpers::SerializeAppZoneHistory(appZoneHistoryMap));
-
-        auto before = json::from_file(appZoneHistoryFileName);
-        if (!before.has_value() || before.value().Stringify() != root.Stringify())
+        try
+        {
+            json::JsonObject root{};
+            root.SetNamedValue(NonLocalizable::AppZoneHistoryStr, JSONHelpers::SerializeAppZoneHistory(appZoneHistoryMap));
+            return WriteFileAtomically(appZoneHistoryFileName, root);
+        }
+        catch (const winrt::hresult_error&)
         {
-            json::to_file(appZoneHistoryFileName, root);
+            return false;
         }
     }
 
@@ -0,0 +1,180 @@
+#include "pch.h"
+#include "ProcessInfoCache.h"
+
+#include <common/logger/logger.h>
+
+// Non-Localizable strings
+namespace NonLocalizable
+{
+    const wchar_t ApplicationFrameHost[] = L"ApplicationFrameHost.exe";
+    const wchar_t PowerToysAppPowerLauncher[] = L"POWERLAUNCHER.EXE";
+    const wchar_t PowerToysAppFZEditor[] = L"FANCYZONESEDITOR.EXE";
+}
+
+namespace
+{
+    std::wstring ToUpper(std::wstring text)
+    {
+        CharUpperBuffW(text.data(), static_cast<DWORD>(text.length()));
+        return text;
+    }
+}
+
+ProcessInfoCache& ProcessInfoCacheInstance()
+{
+    static ProcessInfoCache instance;
+    return instance;
+}
+
+ProcessInfoCache::~ProcessInfoCache()
+{
+    Clear();
+}
+
+std::wstring ProcessInfoCache::GetProcessPath(HWND window) noexcept
+{
+    return Get(window, nullptr).path;
+}
+
+bool ProcessInfoCache::IsExcluded(HWND window, const std::vector<std::wstring>& excludedApps) noexcept
+{
+    return Get(window, &excludedApps).excluded;
+}
+
+void ProcessInfoCache::ExcludedAppsChanged() noexcept
+{
+    std::scoped_lock lock(m_lock);
+    m_matcherStale = true;
+}
+
+void ProcessInfoCache::Clear() noexcept
+{
+    std::unordered_map<DWORD, std::unique_ptr<Process>> processes;
+    {
+        std::scoped_lock lock(m_lock);
+        processes.swap(m_processes);
+        // The settings may change before FancyZones runs again
+        m_matcherStale = true;
+    }
+
+    // Waits for the exit callbacks already running, they don't find their process anymore
+    for (auto& [pid, process] : processes)
+    {
+        UnregisterWaitEx(process->wait, INVALID_HANDLE_VALUE);
+    }
+}
+
+ProcessInfoCache::Info ProcessInfoCache::Get(HWND window, const std::vector<std::wstring>* excludedApps) noexcept
+{
+    DWORD pid{};
+    GetWindowThreadProcessId(window, &pid);
+    auto info = Get(pid, excludedApps);
+    if (info.isFrameHost)
+    {
+        // It is a UWP app, the window of the app is a child window created by a process with a different id
+        DWORD appPid = pid;
+        EnumChildWindows(
+            window, [](HWND hwnd, LPARAM param) -> BOOL {
+                auto appPidPtr = reinterpret_cast<DWORD*>(param);
+                DWORD childPid;
+                GetWindowThreadProcessId(hwnd, &childPid);
+                if (childPid != *appPidPtr)
+                {
+                    *appPidPtr = childPid;
+                    return FALSE;
+                }
+                return TRUE;
+            },
+            reinterpret_cast<LPARAM>(&appPid));
+
+        if (appPid != pid)
+        {
+            info = Get(appPid, excludedApps);
+        }
+    }
+    return info;
+}
+
+ProcessInfoCache::Info ProcessInfoCache::Get(DWORD pid, const std::vector<std::wstring>* excludedApps) noexcept
+{
+    std::unique_lock lock(m_lock);
+    if (excludedApps && m_matcherStale)
+    {
+        // The settings changed, the verdicts of the cached processes are stale
+        auto apps = *excludedApps;
+        apps.push_back(NonLocalizable::PowerToysAppPowerLauncher);
+        apps.push_back(NonLocalizable::PowerToysAppFZEditor);
+        m_matcher = ExcludedAppsMatcher(apps);
+        m_generation++;
+        m_matcherStale = false;
+    }
+
+    auto it = m_processes.find(pid);
+    if (it == m_processes.end())
+    {
+        // Opened outside the lock, the next lookups of other processes don't wait for it
+        lock.unlock();
+        auto process = std::make_unique<Process>();
+        process->cache = this;
+        process->pid = pid;
+        process->handle.reset(OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ | SYNCHRONIZE, FALSE, pid));
+        if (process->handle)
+        {
+            process->path.resize(MAX_PATH);
+            DWORD length = static_cast<DWORD>(process->path.length());
+            if (!QueryFullProcessImageNameW(process->handle.get(), 0, process->path.data(), &length))
+            {
+                length = 0;
+            }
+            process->path.resize(length);
+            process->isFrameHost = process->path.ends_with(NonLocalizable::ApplicationFrameHost);
+        }
+        lock.lock();
+
+        it = m_processes.find(pid);
+        if (it == m_processes.end())
+        {
+            if (!process->handle)
+            {
+                // Can't be queried, and can't be told when it exits, so it isn't cached
+                return Info{ .path = {}, .isFrameHost = false, .excluded = false };
+            }
+
+            if (!RegisterWaitForSingleObject(&process->wait, process->handle.get(), OnProcessExit, process.get(), INFINITE, WT_EXECUTEONLYONCE))
+            {
+                Logger::warn(L"Failed to wait for the exit of process {}", pid);
+                return Info{ .path = process->path, .isFrameHost = process->isFrameHost, .excluded = excludedApps && m_matcher.Matches(ToUpper(process->path)) };
+            }
+            it = m_processes.emplace(pid, std::move(process)).first;
+        }
+    }
+
+    auto& process = *it->second;
+    if (excludedApps && process.verdictGeneration != m_generation)
+    {
+        process.excluded = m_matcher.Matches(ToUpper(process.path));
+        process.verdictGeneration = m_generation;
+    }
+    return Info{ .path = process.path, .isFrameHost = process.isFrameHost, .excluded = process.excluded };
+}
+
+void CALLBACK ProcessInfoCache::OnProcessExit(PVOID context, BOOLEAN /*timedOut*/)
+{
+    auto* exited = static_cast<Process*>(context);
+    auto* cache = exited->cache;
+    std::unique_ptr<Process> process;
+    {
+        std::scoped_lock lock(cache->m_lock);
+        auto it = cache->m_processes.find(exited->pid);
+        if (it == cache->m_processes.end() || it->second.get() != exited)
+        {
+            // Cleared, the process is freed by Clear
+            return;
+        }
+        process = std::move(it->second);
+        cache->m_processes.erase(it);
+    }
+
+    // Can't wait for the callback from the callback itself
+    UnregisterWaitEx(process->wait, nullptr);
+}
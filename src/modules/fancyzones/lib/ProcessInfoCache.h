@@ -0,0 +1,79 @@
+#pragma once
+
+#include "ExcludedAppsMatcher.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Path of the processes owning the windows, and whether they are excluded from zoning, so a process is only
+ * opened the first time one of its windows is seen. Each cached process is kept open, which prevents its id from
+ * being reused, and is dropped when the process exits. The exclusion verdicts are computed again after
+ * ExcludedAppsChanged() is called.
+ */
+class ProcessInfoCache
+{
+public:
+    ~ProcessInfoCache();
+
+    /**
+     * @returns Path of the executable of the process owning the window, or of the application hosted by the
+     *          window for modern apps. Empty if the process can't be queried.
+     */
+    std::wstring GetProcessPath(HWND window) noexcept;
+
+    /**
+     * @param   excludedApps Upper case names of the applications excluded by the settings.
+     *
+     * @returns True if the process owning the window is one of the excluded applications or a PowerToys window.
+     */
+    bool IsExcluded(HWND window, const std::vector<std::wstring>& excludedApps) noexcept;
+
+    /**
+     * Drop the exclusion verdicts, called when the settings change. The excluded applications of the next
+     * lookup are the ones matched from then on.
+     */
+    void ExcludedAppsChanged() noexcept;
+
+    /**
+     * Drop all the cached processes, called when FancyZones is destroyed.
+     */
+    void Clear() noexcept;
+
+private:
+    struct Process
+    {
+        ProcessInfoCache* cache;
+        DWORD pid;
+        wil::unique_handle handle;
+        HANDLE wait = nullptr;
+        std::wstring path;
+        bool isFrameHost = false;
+        bool excluded = false;
+        // Generation of the excluded applications the verdict was computed with, 0 if not computed yet
+        size_t verdictGeneration = 0;
+    };
+
+    struct Info
+    {
+        std::wstring path;
+        bool isFrameHost;
+        bool excluded;
+    };
+
+    Info Get(HWND window, const std::vector<std::wstring>* excludedApps) noexcept;
+    Info Get(DWORD pid, const std::vector<std::wstring>* excludedApps) noexcept;
+    static void CALLBACK OnProcessExit(PVOID context, BOOLEAN timedOut);
+
+    std::mutex m_lock;
+    std::unordered_map<DWORD, std::unique_ptr<Process>> m_processes;
+    ExcludedAppsMatcher m_matcher;
+    // Generation of the matcher, 0 until it's built from the excluded applications of a lookup
+    size_t m_generation = 0;
+    bool m_matcherStale = true;
+};
+
+ProcessInfoCache& ProcessInfoCacheInstance();
@@ -5,7 +5,10 @@
 // Zoned window properties are not localized.
 namespace ZonedWindowProperties
 {
+    // Bitmask of the zones of a zoned window with an id below 64, see ZonedWindows
     const wchar_t PropertyMultipleZoneID[]  = L"FancyZones_zones";
+    // Number of the record of a zoned window, see ZonedWindows
+    const wchar_t PropertyZoneRecordID[]    = L"FancyZones_ZoneRecord";
     const wchar_t PropertyRestoreSizeID[]   = L"FancyZones_RestoreSize";
     const wchar_t PropertyRestoreOriginID[] = L"FancyZones_RestoreOrigin";
 
@@ -10,6 +10,7 @@
 #include "FancyZonesData.h"
 #include "Settings.h"
 #include "ZoneWindow.h"
+#include "ZonedWindows.h"
 #include "util.h"
 
 // Non-Localizable strings
@@ -255,7 +256,7 @@ void WindowMoveHandler::MoveSizeEnd(HWND window, POINT const& ptScreen, const st
                 }
             }
         }
-        ::RemoveProp(window, ZonedWindowProperties::PropertyMultipleZoneID);
+        ZonedWindowsInstance().Remove(window);
     }
 
     m_inMoveSize = false;
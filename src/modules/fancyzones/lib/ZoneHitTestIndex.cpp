@@ -0,0 +1,144 @@
+#include "pch.h"
+
+#include "ZoneHitTestIndex.h"
+
+#include <algorithm>
+#include <intrin.h>
+#include <limits>
+
+namespace
+{
+    constexpr size_t C_BITS_PER_WORD = 64;
+
+    inline void SetBit(std::vector<uint64_t>& words, size_t offset, size_t position)
+    {
+        words[offset + position / C_BITS_PER_WORD] |= 1ull << (position % C_BITS_PER_WORD);
+    }
+
+    inline unsigned long LowestBit(uint64_t word) noexcept
+    {
+        unsigned long bit = 0;
+        _BitScanForward64(&bit, word);
+        return bit;
+    }
+}
+
+ZoneHitTestIndex::ZoneHitTestIndex(const std::vector<std::pair<size_t, RECT>>& zones, int sensitivityRadius) :
+    m_words((zones.size() + C_BITS_PER_WORD - 1) / C_BITS_PER_WORD)
+{
+    std::vector<std::pair<LONG, LONG>> columns;
+    std::vector<std::pair<LONG, LONG>> rows;
+    for (const auto& [zoneId, rect] : zones)
+    {
+        m_ids.push_back(zoneId);
+        m_rects.push_back(rect);
+        m_areas.push_back(max(rect.bottom - rect.top, 0) * max(rect.right - rect.left, 0));
+        columns.emplace_back(rect.left, rect.right);
+        rows.emplace_back(rect.top, rect.bottom);
+    }
+
+    m_x.Build(columns, sensitivityRadius, m_words);
+    m_y.Build(rows, sensitivityRadius, m_words);
+
+    m_overlaps.assign(m_rects.size() * m_words, 0);
+    for (size_t i = 0; i < m_rects.size(); ++i)
+    {
+        for (size_t j = i + 1; j < m_rects.size(); ++j)
+        {
+            const RECT& rectI = m_rects[i];
+            const RECT& rectJ = m_rects[j];
+            if (max(rectI.top, rectJ.top) + sensitivityRadius < min(rectI.bottom, rectJ.bottom) &&
+                max(rectI.left, rectJ.left) + sensitivityRadius < min(rectI.right, rectJ.right))
+            {
+                SetBit(m_overlaps, i * m_words, j);
+                SetBit(m_overlaps, j * m_words, i);
+            }
+        }
+    }
+}
+
+void ZoneHitTestIndex::HitTest(POINT pt, Result& result) const
+{
+    result.captured.clear();
+    result.strictlyCaptured = false;
+    result.overlap = false;
+
+    const size_t column = m_x.SlabFromCoordinate(pt.x);
+    const size_t row = m_y.SlabFromCoordinate(pt.y);
+    const auto [left, right] = m_x.SlabRange(column);
+    const auto [top, bottom] = m_y.SlabRange(row);
+    result.cell = RECT{ left, top, right, bottom };
+
+    const uint64_t* capturedX = m_x.captured.data() + column * m_words;
+    const uint64_t* capturedY = m_y.captured.data() + row * m_words;
+    const uint64_t* strictX = m_x.strict.data() + column * m_words;
+    const uint64_t* strictY = m_y.strict.data() + row * m_words;
+    for (size_t word = 0; word < m_words; ++word)
+    {
+        for (uint64_t bits = capturedX[word] & capturedY[word]; bits != 0; bits &= bits - 1)
+        {
+            result.captured.push_back(word * C_BITS_PER_WORD + LowestBit(bits));
+        }
+
+        result.strictlyCaptured = result.strictlyCaptured || (strictX[word] & strictY[word]) != 0;
+    }
+
+    for (size_t position : result.captured)
+    {
+        const uint64_t* overlaps = m_overlaps.data() + position * m_words;
+        for (size_t word = 0; word < m_words && !result.overlap; ++word)
+        {
+            result.overlap = (overlaps[word] & capturedX[word] & capturedY[word]) != 0;
+        }
+
+        if (result.overlap)
+        {
+            break;
+        }
+    }
+}
+
+void ZoneHitTestIndex::Axis::Build(const std::vector<std::pair<LONG, LONG>>& ranges, int sensitivityRadius, size_t words)
+{
+    // A zone captures the coordinates in [start - radius, end + radius], and strictly covers [start, end)
+    bounds.clear();
+    for (const auto& [start, end] : ranges)
+    {
+        bounds.push_back(start - sensitivityRadius);
+        bounds.push_back(end + sensitivityRadius + 1);
+        bounds.push_back(start);
+        bounds.push_back(end);
+    }
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+    const size_t slabCount = bounds.size() + 1;
+    captured.assign(slabCount * words, 0);
+    strict.assign(slabCount * words, 0);
+    for (size_t position = 0; position < ranges.size(); ++position)
+    {
+        const auto& [start, end] = ranges[position];
+        for (size_t slab = SlabFromCoordinate(start - sensitivityRadius); slab < SlabFromCoordinate(end + sensitivityRadius + 1); ++slab)
+        {
+            SetBit(captured, slab * words, position);
+        }
+
+        for (size_t slab = SlabFromCoordinate(start); slab < SlabFromCoordinate(end); ++slab)
+        {
+            SetBit(strict, slab * words, position);
+        }
+    }
+}
+
+size_t ZoneHitTestIndex::Axis::SlabFromCoordinate(LONG coordinate) const noexcept
+{
+    return std::upper_bound(bounds.begin(), bounds.end(), coordinate) - bounds.begin();
+}
+
+std::pair<LONG, LONG> ZoneHitTestIndex::Axis::SlabRange(size_t slab) const noexcept
+{
+    return {
+        slab == 0 ? std::numeric_limits<LONG>::min() : bounds[slab - 1],
+        slab == bounds.size() ? std::numeric_limits<LONG>::max() : bounds[slab]
+    };
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "pch.h"
+
+#include <vector>
+
+/**
+ * Spatial index answering which zones of a layout are under a point, used by ZoneSet::ZonesFromPoint.
+ * The edges of the zones, with and without the sensitivity radius, split each axis into slabs. For
+ * every slab the zones covering it are kept as a bit set, so the zones under a point are the intersection
+ * of the sets of its column and of its row. Whether two zones overlap is computed once for each pair.
+ * Zones are referred to by their position in the list of zone ids and rectangles the index is built from.
+ */
+class ZoneHitTestIndex
+{
+public:
+    struct Result
+    {
+        // Positions of the zones within the sensitivity radius of the point, in ascending order
+        std::vector<size_t> captured;
+        // Whether the point is strictly inside any zone
+        bool strictlyCaptured = false;
+        // Whether any two captured zones overlap by more than the sensitivity radius
+        bool overlap = false;
+        // Cell of the point, within which captured, strictlyCaptured and overlap are the same
+        RECT cell{};
+    };
+
+    ZoneHitTestIndex() = default;
+    ZoneHitTestIndex(const std::vector<std::pair<size_t, RECT>>& zones, int sensitivityRadius);
+
+    size_t ZoneId(size_t position) const noexcept { return m_ids[position]; }
+    const RECT& ZoneRect(size_t position) const noexcept { return m_rects[position]; }
+    long ZoneArea(size_t position) const noexcept { return m_areas[position]; }
+
+    void HitTest(POINT pt, Result& result) const;
+
+private:
+    struct Axis
+    {
+        // Sorted boundaries, slab i spans [bounds[i - 1], bounds[i])
+        std::vector<LONG> bounds;
+        // For each slab, the words of the zones within the sensitivity radius and of the zones strictly covering it
+        std::vector<uint64_t> captured;
+        std::vector<uint64_t> strict;
+
+        void Build(const std::vector<std::pair<LONG, LONG>>& ranges, int sensitivityRadius, size_t words);
+        size_t SlabFromCoordinate(LONG coordinate) const noexcept;
+        std::pair<LONG, LONG> SlabRange(size_t slab) const noexcept;
+    };
+
+    std::vector<size_t> m_ids;
+    std::vector<RECT> m_rects;
+    std::vector<long> m_areas;
+    size_t m_words = 0;
+    Axis m_x;
+    Axis m_y;
+    // For each zone, the words of the zones it overlaps
+    std::vector<uint64_t> m_overlaps;
+};
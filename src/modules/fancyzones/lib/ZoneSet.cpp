@@ -6,12 +6,12 @@
 #include "FancyZonesDataTypes.h"
 #include "Settings.h"
 #include "Zone.h"
+#include "ZoneHitTestIndex.h"
+#include "ZonedWindows.h"
 #include "util.h"
 
-#include <common/logger/logger.h>
 #include <common/display/dpi_aware.h>
 
-#include <limits>
 #include <map>
 #include <utility>
 
@@ -101,11 +101,6 @@ namespace
             .columnsPercents = { 2500, 2500, 2500, 2500 },
             .cellChildMap = { { 0, 1, 2, 3 }, { 4, 1, 5, 6 }, { 7, 8, 9, 10 } } }),
     };
-
-    inline void StampWindow(HWND window, size_t bitmask) noexcept
-    {
-        SetProp(window, ZonedWindowProperties::PropertyMultipleZoneID, reinterpret_cast<HANDLE>(bitmask));
-    }
 }
 
 struct ZoneSet : winrt::implements<ZoneSet, IZoneSet>
@@ -130,6 +125,8 @@ public:
     IFACEMETHODIMP_(std::vector<size_t>)
     ZonesFromPoint(POINT pt) const noexcept;
     IFACEMETHODIMP_(std::vector<size_t>)
+    ZonesFromPointWithRegion(POINT pt, RECT& region) const noexcept;
+    IFACEMETHODIMP_(std::vector<size_t>)
     GetZoneIndexSetFromWindow(HWND window) const noexcept;
     IFACEMETHODIMP_(ZonesMap)
     GetZones()const noexcept override { return m_zones; }
@@ -159,13 +156,18 @@ private:
     bool CalculateUniquePriorityGridLayout(Rect workArea, int zoneCount, int spacing) noexcept;
     bool CalculateCustomLayout(Rect workArea, int spacing) noexcept;
     bool CalculateGridZones(Rect workArea, FancyZonesDataTypes::GridLayoutInfo gridLayoutInfo, int spacing);
-    std::vector<size_t> ZoneSelectSubregion(const std::vector<size_t>& capturedZones, POINT pt) const;
+    const ZoneHitTestIndex& HitTestIndex() const;
+
+    // The captured zones and the result are positions in the hit-test index.
+    size_t ZoneSelectSubregion(const std::vector<size_t>& capturedZones, POINT pt) const;
 
     // `compare` should return true if the first argument is a better choice than the second argument.
     template<class CompareF>
-    std::vector<size_t> ZoneSelectPriority(const std::vector<size_t>& capturedZones, CompareF compare) const;
+    size_t ZoneSelectPriority(const std::vector<size_t>& capturedZones, CompareF compare) const;
 
     ZonesMap m_zones;
+    // Built from m_zones by CalculateZones, or on first use after zones were added
+    mutable std::optional<ZoneHitTestIndex> m_hitTestIndex;
     std::map<HWND, std::vector<size_t>> m_windowIndexSet;
 
     // Needed for ExtendWindowByDirectionAndPosition
@@ -184,6 +186,7 @@ IFACEMETHODIMP ZoneSet::AddZone(winrt::com_ptr<IZone> zone) noexcept
         return S_FALSE;
     }
     m_zones[zoneId] = zone;
+    m_hitTestIndex.reset();
 
     return S_OK;
 }
@@ -191,91 +194,50 @@ IFACEMETHODIMP ZoneSet::AddZone(winrt::com_ptr<IZone> zone) noexcept
 IFACEMETHODIMP_(std::vector<size_t>)
 ZoneSet::ZonesFromPoint(POINT pt) const noexcept
 {
-    std::vector<size_t> capturedZones;
-    std::vector<size_t> strictlyCapturedZones;
-    for (const auto& [zoneId, zone] : m_zones)
-    {
-        const RECT& zoneRect = zone->GetZoneRect();
-        if (zoneRect.left - m_config.SensitivityRadius <= pt.x && pt.x <= zoneRect.right + m_config.SensitivityRadius &&
-            zoneRect.top - m_config.SensitivityRadius <= pt.y && pt.y <= zoneRect.bottom + m_config.SensitivityRadius)
-        {
-            capturedZones.emplace_back(zoneId);
-        }
-            
-        if (zoneRect.left <= pt.x && pt.x < zoneRect.right &&
-            zoneRect.top <= pt.y && pt.y < zoneRect.bottom)
-        {
-            strictlyCapturedZones.emplace_back(zoneId);
-        }
-    }
+    RECT region;
+    return ZonesFromPointWithRegion(pt, region);
+}
+
+IFACEMETHODIMP_(std::vector<size_t>)
+ZoneSet::ZonesFromPointWithRegion(POINT pt, RECT& region) const noexcept
+{
+    const ZoneHitTestIndex& index = HitTestIndex();
+    ZoneHitTestIndex::Result hit;
+    index.HitTest(pt, hit);
+    region = hit.cell;
 
     // If only one zone is captured, but it's not strictly captured
     // don't consider it as captured
-    if (capturedZones.size() == 1 && strictlyCapturedZones.size() == 0)
+    if (hit.captured.size() == 1 && !hit.strictlyCaptured)
     {
         return {};
     }
 
     // If captured zones do not overlap, return all of them
     // Otherwise, return one of them based on the chosen selection algorithm.
-    bool overlap = false;
-    for (size_t i = 0; i < capturedZones.size(); ++i)
+    if (hit.overlap)
     {
-        for (size_t j = i + 1; j < capturedZones.size(); ++j)
-        {
-            RECT rectI;
-            RECT rectJ;
-            try
-            {
-                rectI = m_zones.at(capturedZones[i])->GetZoneRect();
-                rectJ = m_zones.at(capturedZones[j])->GetZoneRect();
-            }
-            catch (std::out_of_range)
-            {
-                return {};
-            }
+        using Algorithm = Settings::OverlappingZonesAlgorithm;
 
-            if (max(rectI.top, rectJ.top) + m_config.SensitivityRadius < min(rectI.bottom, rectJ.bottom) &&
-                max(rectI.left, rectJ.left) + m_config.SensitivityRadius < min(rectI.right, rectJ.right))
-            {
-                overlap = true;
-                break;
-            }
-        }
-        if (overlap)
+        switch (m_config.SelectionAlgorithm)
         {
-            break;
+        case Algorithm::Smallest:
+            return { index.ZoneId(ZoneSelectPriority(hit.captured, [&](size_t zone1, size_t zone2) { return index.ZoneArea(zone1) < index.ZoneArea(zone2); })) };
+        case Algorithm::Largest:
+            return { index.ZoneId(ZoneSelectPriority(hit.captured, [&](size_t zone1, size_t zone2) { return index.ZoneArea(zone1) > index.ZoneArea(zone2); })) };
+        case Algorithm::Positional:
+            // The chosen zone depends on the position within the cell
+            region = RECT{ pt.x, pt.y, pt.x + 1, pt.y + 1 };
+            return { index.ZoneId(ZoneSelectSubregion(hit.captured, pt)) };
         }
     }
 
-    if (overlap)
+    std::vector<size_t> capturedZones;
+    capturedZones.reserve(hit.captured.size());
+    for (size_t position : hit.captured)
     {
-        auto zoneArea = [](auto zone) {
-            RECT rect = zone->GetZoneRect();
-            return max(rect.bottom - rect.top, 0) * max(rect.right - rect.left, 0);
-        };
-
-        try
-        {
-            using Algorithm = Settings::OverlappingZonesAlgorithm;
-
-            switch (m_config.SelectionAlgorithm)
-            {
-            case Algorithm::Smallest:
-                return ZoneSelectPriority(capturedZones, [&](auto zone1, auto zone2) { return zoneArea(zone1) < zoneArea(zone2); });
-            case Algorithm::Largest:
-                return ZoneSelectPriority(capturedZones, [&](auto zone1, auto zone2) { return zoneArea(zone1) > zoneArea(zone2); });
-            case Algorithm::Positional:
-                return ZoneSelectSubregion(capturedZones, pt);
-            }
-        }
-        catch (std::out_of_range)
-        {
-            Logger::error("Exception out_of_range was thrown in ZoneSet::ZonesFromPoint");
-            return { capturedZones[0] };
-        }
+        capturedZones.emplace_back(index.ZoneId(position));
     }
-
     return capturedZones;
 }
 
@@ -315,7 +277,6 @@ ZoneSet::MoveWindowIntoZoneByIndexSet(HWND window, HWND workAreaWindow, const st
 
     RECT size;
     bool sizeEmpty = true;
-    size_t bitmask = 0;
 
     m_windowIndexSet[window] = {};
 
@@ -340,18 +301,13 @@ ZoneSet::MoveWindowIntoZoneByIndexSet(HWND window, HWND workAreaWindow, const st
 
             m_windowIndexSet[window].push_back(id);
         }
-
-        if (id < std::numeric_limits<size_t>::digits)
-        {
-            bitmask |= 1ull << id;
-        }
     }
 
     if (!sizeEmpty)
     {
         SaveWindowSizeAndOrigin(window);
         SizeWindowToRect(window, size);
-        StampWindow(window, bitmask);
+        ZonedWindowsInstance().Stamp(window, m_windowIndexSet[window]);
     }
 }
 
@@ -591,6 +547,10 @@ ZoneSet::CalculateZones(RECT workAreaRect, int zoneCount, int spacing) noexcept
         break;
     }
 
+    // Built now rather than on the first move of a drag
+    m_hitTestIndex.reset();
+    HitTestIndex();
+
     return success;
 }
 
@@ -943,8 +903,26 @@ std::vector<size_t> ZoneSet::GetCombinedZoneRange(const std::vector<size_t>& ini
     return result;
 }
 
-std::vector<size_t> ZoneSet::ZoneSelectSubregion(const std::vector<size_t>& capturedZones, POINT pt) const
+const ZoneHitTestIndex& ZoneSet::HitTestIndex() const
+{
+    if (!m_hitTestIndex)
+    {
+        std::vector<std::pair<size_t, RECT>> zones;
+        zones.reserve(m_zones.size());
+        for (const auto& [zoneId, zone] : m_zones)
+        {
+            zones.emplace_back(zoneId, zone->GetZoneRect());
+        }
+        m_hitTestIndex.emplace(zones, m_config.SensitivityRadius);
+    }
+
+    return *m_hitTestIndex;
+}
+
+size_t ZoneSet::ZoneSelectSubregion(const std::vector<size_t>& capturedZones, POINT pt) const
 {
+    const ZoneHitTestIndex& index = HitTestIndex();
+
     auto expand = [&](RECT& rect) {
         rect.top -= m_config.SensitivityRadius / 2;
         rect.bottom += m_config.SensitivityRadius / 2;
@@ -953,12 +931,12 @@ std::vector<size_t> ZoneSet::ZoneSelectSubregion(const std::vector<size_t>& capt
     };
 
     // Compute the overlapped rectangle.
-    RECT overlap = m_zones.at(capturedZones[0])->GetZoneRect();
+    RECT overlap = index.ZoneRect(capturedZones[0]);
     expand(overlap);
 
     for (size_t i = 1; i < capturedZones.size(); ++i)
     {
-        RECT current = m_zones.at(capturedZones[i])->GetZoneRect();
+        RECT current = index.ZoneRect(capturedZones[i]);
         expand(current);
 
         overlap.top = max(overlap.top, current.top);
@@ -985,23 +963,23 @@ std::vector<size_t> ZoneSet::ZoneSelectSubregion(const std::vector<size_t>& capt
 
     zoneIndex = std::clamp(zoneIndex, size_t(0), capturedZones.size() - 1);
 
-    return { capturedZones[zoneIndex] };
+    return capturedZones[zoneIndex];
 }
 
 template<class CompareF>
-std::vector<size_t> ZoneSet::ZoneSelectPriority(const std::vector<size_t>& capturedZones, CompareF compare) const
+size_t ZoneSet::ZoneSelectPriority(const std::vector<size_t>& capturedZones, CompareF compare) const
 {
     size_t chosen = 0;
 
     for (size_t i = 1; i < capturedZones.size(); ++i)
     {
-        if (compare(m_zones.at(capturedZones[i]), m_zones.at(capturedZones[chosen])))
+        if (compare(capturedZones[i], capturedZones[chosen]))
         {
             chosen = i;
         }
     }
 
-    return { capturedZones[chosen] };
+    return capturedZones[chosen];
 }
 
 winrt::com_ptr<IZoneSet> MakeZoneSet(ZoneSetConfig const& config) noexcept
@@ -37,6 +37,15 @@ interface __declspec(uuid("{E4839EB7-669D-49CF-84A9-71A2DFD851A3}")) IZoneSet :
      * @returns Vector of indices, corresponding to the current set of zones - the zones considered active.
      */
     IFACEMETHOD_(std::vector<size_t>, ZonesFromPoint)(POINT pt) const = 0;
+    /**
+     * Get zones from cursor coordinates, along with the region around the cursor where they don't change.
+     *
+     * @param   pt     Cursor coordinates.
+     * @param   region Set to a rectangle containing the cursor, ZonesFromPoint returns the same zones for
+     *                 any point within it.
+     * @returns Vector of indices, corresponding to the current set of zones - the zones considered active.
+     */
+    IFACEMETHOD_(std::vector<size_t>, ZonesFromPointWithRegion)(POINT pt, RECT& region) const = 0;
     /**
      * Get index set of the zones to which the window was assigned.
      *
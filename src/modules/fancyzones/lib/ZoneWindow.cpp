@@ -72,7 +72,7 @@ private:
     void UpdateActiveZoneSet(_In_opt_ IZoneSet* zoneSet) noexcept;
     LRESULT WndProc(UINT message, WPARAM wparam, LPARAM lparam) noexcept;
     void OnKeyUp(WPARAM wparam) noexcept;
-    std::vector<size_t> ZonesFromPoint(POINT pt) noexcept;
+    std::vector<size_t> ZonesFromPoint(POINT pt, RECT& region) noexcept;
     void CycleActiveZoneSetInternal(DWORD wparam, Trace::ZoneWindow::InputMode mode) noexcept;
 
     winrt::com_ptr<IZoneWindowHost> m_host;
@@ -84,6 +84,9 @@ private:
     std::vector<winrt::com_ptr<IZoneSet>> m_zoneSets;
     std::vector<size_t> m_initialHighlightZone;
     std::vector<size_t> m_highlightZone;
+    // Zones under the cursor at the last drag update, the same anywhere within m_hitTestRegion
+    std::optional<RECT> m_hitTestRegion;
+    std::vector<size_t> m_hitTestZones;
     WPARAM m_keyLast{};
     size_t m_keyCycle{};
     static const UINT m_showAnimationDuration = 200; // ms
@@ -154,6 +157,7 @@ IFACEMETHODIMP ZoneWindow::MoveSizeEnter(HWND window) noexcept
     m_windowMoveSize = window;
     m_highlightZone = {};
     m_initialHighlightZone = {};
+    m_hitTestRegion = std::nullopt;
     ShowZoneWindow();
     return S_OK;
 }
@@ -166,7 +170,21 @@ IFACEMETHODIMP ZoneWindow::MoveSizeUpdate(POINT const& ptScreen, bool dragEnable
 
     if (dragEnabled)
     {
-        auto highlightZone = ZonesFromPoint(ptClient);
+        const bool inHitTestRegion = m_hitTestRegion && PtInRect(&*m_hitTestRegion, ptClient);
+        if (inHitTestRegion && !selectManyZones && m_initialHighlightZone.empty() && m_highlightZone == m_hitTestZones)
+        {
+            // Nothing changes until the cursor leaves the region of the last hit-test
+            return S_OK;
+        }
+
+        if (!inHitTestRegion)
+        {
+            RECT region{};
+            m_hitTestZones = ZonesFromPoint(ptClient, region);
+            m_hitTestRegion = region;
+        }
+
+        auto highlightZone = m_hitTestZones;
 
         if (selectManyZones)
         {
@@ -440,6 +458,7 @@ void ZoneWindow::CalculateZoneSet() noexcept
 void ZoneWindow::UpdateActiveZoneSet(_In_opt_ IZoneSet* zoneSet) noexcept
 {
     m_activeZoneSet.copy_from(zoneSet);
+    m_hitTestRegion = std::nullopt;
 
     if (m_activeZoneSet)
     {
@@ -495,12 +514,13 @@ void ZoneWindow::OnKeyUp(WPARAM wparam) noexcept
     }
 }
 
-std::vector<size_t> ZoneWindow::ZonesFromPoint(POINT pt) noexcept
+std::vector<size_t> ZoneWindow::ZonesFromPoint(POINT pt, RECT& region) noexcept
 {
     if (m_activeZoneSet)
     {
-        return m_activeZoneSet->ZonesFromPoint(pt);
+        return m_activeZoneSet->ZonesFromPointWithRegion(pt, region);
     }
+    region = {};
     return {};
 }
 
@@ -2,6 +2,7 @@
 #include "ZoneWindowDrawing.h"
 
 #include <algorithm>
+#include <cmath>
 #include <map>
 #include <string>
 #include <vector>
@@ -13,6 +14,33 @@ namespace NonLocalizable
     const wchar_t SegoeUiFont[] = L"Segoe ui";
 }
 
+namespace
+{
+    // Pace of the show animation
+    constexpr std::chrono::microseconds C_FRAME_INTERVAL{ 16667 };
+
+    bool Intersects(const D2D1_RECT_F& a, const D2D1_RECT_F& b)
+    {
+        return a.left < b.right && b.left < a.right && a.top < b.bottom && b.top < a.bottom;
+    }
+
+    bool AreEqual(const D2D1_RECT_F& a, const D2D1_RECT_F& b)
+    {
+        return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+    }
+
+    bool AreEqual(const D2D1_COLOR_F& a, const D2D1_COLOR_F& b)
+    {
+        return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+    }
+
+    D2D1_COLOR_F WithAlpha(D2D1_COLOR_F color, float alpha)
+    {
+        color.a *= alpha;
+        return color;
+    }
+}
+
 float ZoneWindowDrawing::GetAnimationAlpha()
 {
     // Lock is being held
@@ -88,8 +116,9 @@ ZoneWindowDrawing::ZoneWindowDrawing(HWND window)
         96.f,
         96.f);
     
+    // The content is kept between frames, so a frame only draws the zones that changed
     auto renderTargetSize = D2D1::SizeU(m_clientRect.right - m_clientRect.left, m_clientRect.bottom - m_clientRect.top);
-    auto hwndRenderTargetProperties = D2D1::HwndRenderTargetProperties(window, renderTargetSize);
+    auto hwndRenderTargetProperties = D2D1::HwndRenderTargetProperties(window, renderTargetSize, D2D1_PRESENT_OPTIONS_RETAIN_CONTENTS);
 
     hr = GetD2DFactory()->CreateHwndRenderTarget(renderTargetProperties, hwndRenderTargetProperties, &m_renderTarget);
 
@@ -99,112 +128,157 @@ ZoneWindowDrawing::ZoneWindowDrawing(HWND window)
         return;
     }
 
-    m_renderThread = std::thread([this]() {
-        while (!m_abortThread)
-        {
-            // Force repeated rendering while in the animation loop.
-            // Yield if low latency locking was requested
-            if (!m_lowLatencyLock)
-            {
-                float animationAlpha;
-                {
-                    std::unique_lock lock(m_mutex);
-                    animationAlpha = GetAnimationAlpha();
-                }
+    // The brushes are created once, each frame only sets their colors
+    m_renderTarget->CreateSolidColorBrush(D2D1::ColorF(D2D1::ColorF::Black), m_borderBrush.put());
+    m_renderTarget->CreateSolidColorBrush(D2D1::ColorF(D2D1::ColorF::Black), m_inactiveBrush.put());
+    m_renderTarget->CreateSolidColorBrush(D2D1::ColorF(D2D1::ColorF::Black), m_highlightBrush.put());
+    m_renderTarget->CreateSolidColorBrush(D2D1::ColorF(D2D1::ColorF::Black), m_textBrush.put());
 
-                if (animationAlpha < 1.f)
-                {
-                    m_shouldRender = true;
-                }
-            }
+    auto writeFactory = GetWriteFactory();
+    if (writeFactory && SUCCEEDED(writeFactory->CreateTextFormat(NonLocalizable::SegoeUiFont, nullptr, DWRITE_FONT_WEIGHT_NORMAL, DWRITE_FONT_STYLE_NORMAL, DWRITE_FONT_STRETCH_NORMAL, 80.f, L"en-US", m_textFormat.put())))
+    {
+        m_textFormat->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_CENTER);
+        m_textFormat->SetParagraphAlignment(DWRITE_PARAGRAPH_ALIGNMENT_CENTER);
+    }
 
-            Render();
-        }
-    });
+    m_renderThread = std::thread([this]() { RenderLoop(); });
 }
 
-void ZoneWindowDrawing::Render()
+void ZoneWindowDrawing::Invalidate(const D2D1_RECT_F& rect)
 {
-    std::unique_lock lock(m_mutex);
-
-    if (!m_renderTarget)
+    // Lock is being held
+    // Covers the border drawn around the zone, snapped to pixels for the aliased clip
+    auto bounds = D2D1::RectF(std::floor(rect.left - 1.f), std::floor(rect.top - 1.f), std::ceil(rect.right + 1.f), std::ceil(rect.bottom + 1.f));
+    if (m_dirtyRect)
     {
-        return;
+        bounds = D2D1::RectF((std::min)(bounds.left, m_dirtyRect->left),
+                             (std::min)(bounds.top, m_dirtyRect->top),
+                             (std::max)(bounds.right, m_dirtyRect->right),
+                             (std::max)(bounds.bottom, m_dirtyRect->bottom));
     }
+    m_dirtyRect = bounds;
+}
 
-    m_cv.wait(lock, [this]() { return (bool)m_shouldRender; });
-
-    m_renderTarget->BeginDraw();
-    
-    float animationAlpha = GetAnimationAlpha();
-
-    // Draw backdrop
-    m_renderTarget->Clear(D2D1::ColorF(0.f, 0.f, 0.f, 0.f));
-
-    ID2D1SolidColorBrush* textBrush = nullptr;
-    IDWriteTextFormat* textFormat = nullptr;
-
-    m_renderTarget->CreateSolidColorBrush(D2D1::ColorF(D2D1::ColorF::Black, animationAlpha), &textBrush);
-    auto writeFactory = GetWriteFactory();
-
-    if (writeFactory)
+ZoneWindowDrawing::Frame ZoneWindowDrawing::TakeFrame()
+{
+    // Lock is being held
+    Frame frame{
+        .rects = m_sceneRects,
+        .dirtyRect = m_dirtyRect,
+        .borderColor = m_borderColor,
+        .inactiveColor = m_inactiveColor,
+        .highlightColor = m_highlightColor,
+        .animationAlpha = GetAnimationAlpha()
+    };
+
+    // Every zone fades in while the window is shown
+    if (m_fullRedraw || frame.animationAlpha < 1.f)
     {
-        writeFactory->CreateTextFormat(NonLocalizable::SegoeUiFont, nullptr, DWRITE_FONT_WEIGHT_NORMAL, DWRITE_FONT_STYLE_NORMAL, DWRITE_FONT_STRETCH_NORMAL, 80.f, L"en-US", &textFormat);
+        frame.dirtyRect.reset();
     }
 
-    for (auto drawableRect : m_sceneRects)
-    {
-        ID2D1SolidColorBrush* borderBrush = nullptr;
-        ID2D1SolidColorBrush* fillBrush = nullptr;
+    m_fullRedraw = false;
+    m_dirtyRect.reset();
+    m_shouldRender = false;
+    return frame;
+}
 
-        // Need to copy the rect from m_sceneRects
-        drawableRect.borderColor.a *= animationAlpha;
-        drawableRect.fillColor.a *= animationAlpha;
+void ZoneWindowDrawing::RenderLoop()
+{
+    auto nextFrame = std::chrono::steady_clock::now();
+    bool animating = false;
 
-        m_renderTarget->CreateSolidColorBrush(drawableRect.borderColor, &borderBrush);
-        m_renderTarget->CreateSolidColorBrush(drawableRect.fillColor, &fillBrush);
+    std::unique_lock lock(m_mutex);
+    while (true)
+    {
+        m_cv.wait(lock, [this]() { return m_abortThread || m_shouldRender; });
 
-        if (fillBrush)
+        // Changes made while the window fades in are drawn by the next frame of the animation
+        if (animating)
         {
-            m_renderTarget->FillRectangle(drawableRect.rect, fillBrush);
-            fillBrush->Release();
+            m_cv.wait_until(lock, nextFrame, [this]() { return (bool)m_abortThread; });
         }
 
-        if (borderBrush)
+        if (m_abortThread)
         {
-            m_renderTarget->DrawRectangle(drawableRect.rect, borderBrush);
-            borderBrush->Release();
+            break;
         }
 
-        std::wstring idStr = std::to_wstring(drawableRect.id + 1);
+        nextFrame = std::chrono::steady_clock::now() + C_FRAME_INTERVAL;
+        auto frame = TakeFrame();
 
-        if (textFormat && textBrush)
+        // Drawn without the lock, so the zones can be updated while the frame is presented
+        lock.unlock();
+        Render(frame);
+        lock.lock();
+
+        // Keep drawing until the animation ends, the last frame is drawn fully opaque
+        animating = frame.animationAlpha < 1.f;
+        if (animating)
         {
-            textFormat->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_CENTER);
-            textFormat->SetParagraphAlignment(DWRITE_PARAGRAPH_ALIGNMENT_CENTER);
-            m_renderTarget->DrawTextW(idStr.c_str(), (UINT32)idStr.size(), textFormat, drawableRect.rect, textBrush);
+            m_fullRedraw = true;
+            m_shouldRender = true;
         }
     }
+}
 
-    if (textFormat)
+void ZoneWindowDrawing::Render(const Frame& frame)
+{
+    if (!m_renderTarget)
     {
-        textFormat->Release();
+        return;
     }
 
-    if (textBrush)
+    m_renderTarget->BeginDraw();
+
+    if (frame.dirtyRect)
+    {
+        m_renderTarget->PushAxisAlignedClip(*frame.dirtyRect, D2D1_ANTIALIAS_MODE_ALIASED);
+    }
+
+    // Draw backdrop
+    m_renderTarget->Clear(D2D1::ColorF(0.f, 0.f, 0.f, 0.f));
+
+    if (m_borderBrush && m_inactiveBrush && m_highlightBrush && m_textBrush)
+    {
+        m_borderBrush->SetColor(WithAlpha(frame.borderColor, frame.animationAlpha));
+        m_inactiveBrush->SetColor(WithAlpha(frame.inactiveColor, frame.animationAlpha));
+        m_highlightBrush->SetColor(WithAlpha(frame.highlightColor, frame.animationAlpha));
+        m_textBrush->SetColor(D2D1::ColorF(D2D1::ColorF::Black, frame.animationAlpha));
+
+        // First draw the inactive zones, then the active zones on top of them
+        for (bool highlighted : { false, true })
+        {
+            for (const auto& drawableRect : frame.rects)
+            {
+                if (drawableRect.highlighted != highlighted ||
+                    (frame.dirtyRect && !Intersects(drawableRect.rect, *frame.dirtyRect)))
+                {
+                    continue;
+                }
+
+                m_renderTarget->FillRectangle(drawableRect.rect, highlighted ? m_highlightBrush.get() : m_inactiveBrush.get());
+                m_renderTarget->DrawRectangle(drawableRect.rect, m_borderBrush.get());
+
+                if (drawableRect.textLayout)
+                {
+                    m_renderTarget->DrawTextLayout(D2D1::Point2F(drawableRect.rect.left, drawableRect.rect.top), drawableRect.textLayout.get(), m_textBrush.get());
+                }
+            }
+        }
+    }
+
+    if (frame.dirtyRect)
     {
-        textBrush->Release();
+        m_renderTarget->PopAxisAlignedClip();
     }
 
     m_renderTarget->EndDraw();
-    m_shouldRender = false;
 }
 
 void ZoneWindowDrawing::Hide()
 {
-    m_lowLatencyLock = true;
     std::unique_lock lock(m_mutex);
-    m_lowLatencyLock = false;
 
     if (m_animation)
     {
@@ -215,9 +289,7 @@ void ZoneWindowDrawing::Hide()
 
 void ZoneWindowDrawing::Show(unsigned animationMillis)
 {
-    m_lowLatencyLock = true;
     std::unique_lock lock(m_mutex);
-    m_lowLatencyLock = false;
 
     if (!m_animation)
     {
@@ -226,6 +298,7 @@ void ZoneWindowDrawing::Show(unsigned animationMillis)
         {
             m_animation.emplace(AnimationInfo{ std::chrono::steady_clock().now(), animationMillis });
         }
+        m_fullRedraw = true;
         m_shouldRender = true;
         m_cv.notify_all();
     }
@@ -235,12 +308,6 @@ void ZoneWindowDrawing::DrawActiveZoneSet(const IZoneSet::ZonesMap& zones,
                        const std::vector<size_t>& highlightZones,
                        winrt::com_ptr<IZoneWindowHost> host)
 {
-    m_lowLatencyLock = true;
-    std::unique_lock lock(m_mutex);
-    m_lowLatencyLock = false;
-
-    m_sceneRects = {};
-
     auto borderColor = ConvertColor(host->GetZoneBorderColor());
     auto inactiveColor = ConvertColor(host->GetZoneColor());
     auto highlightColor = ConvertColor(host->GetZoneHighlightColor());
@@ -254,7 +321,7 @@ void ZoneWindowDrawing::DrawActiveZoneSet(const IZoneSet::ZonesMap& zones,
         isHighlighted[x] = true;
     }
 
-    // First draw the inactive zones
+    std::vector<DrawableRect> sceneRects;
     for (const auto& [zoneId, zone] : zones)
     {
         if (!zone)
@@ -262,49 +329,73 @@ void ZoneWindowDrawing::DrawActiveZoneSet(const IZoneSet::ZonesMap& zones,
             continue;
         }
 
-        if (!isHighlighted[zoneId])
-        {
-            DrawableRect drawableRect{
-                .rect = ConvertRect(zone->GetZoneRect()),
-                .borderColor = borderColor,
-                .fillColor = inactiveColor,
-                .id = zone->Id()
-            };
-
-            m_sceneRects.push_back(drawableRect);
-        }
+        sceneRects.push_back(DrawableRect{
+            .rect = ConvertRect(zone->GetZoneRect()),
+            .id = zone->Id(),
+            .highlighted = isHighlighted[zoneId],
+            .textLayout = nullptr
+        });
     }
 
-    // Draw the active zones on top of the inactive zones
-    for (const auto& [zoneId, zone] : zones)
+    std::unique_lock lock(m_mutex);
+
+    if (!AreEqual(borderColor, m_borderColor) || !AreEqual(inactiveColor, m_inactiveColor) || !AreEqual(highlightColor, m_highlightColor))
     {
-        if (!zone)
+        m_borderColor = borderColor;
+        m_inactiveColor = inactiveColor;
+        m_highlightColor = highlightColor;
+        m_fullRedraw = true;
+    }
+
+    const bool sameLayout = std::equal(sceneRects.begin(), sceneRects.end(), m_sceneRects.begin(), m_sceneRects.end(), [](const DrawableRect& a, const DrawableRect& b) {
+        return AreEqual(a.rect, b.rect) && a.id == b.id;
+    });
+
+    if (sameLayout)
+    {
+        // Only the zones whose highlight changed are drawn again
+        for (size_t i = 0; i < sceneRects.size(); ++i)
         {
-            continue;
+            if (m_sceneRects[i].highlighted != sceneRects[i].highlighted)
+            {
+                m_sceneRects[i].highlighted = sceneRects[i].highlighted;
+                Invalidate(m_sceneRects[i].rect);
+            }
         }
-
-        if (isHighlighted[zoneId])
+    }
+    else
+    {
+        // The zone numbers are laid out once for the layout
+        auto writeFactory = GetWriteFactory();
+        for (auto& drawableRect : sceneRects)
         {
-            DrawableRect drawableRect{
-                .rect = ConvertRect(zone->GetZoneRect()),
-                .borderColor = borderColor,
-                .fillColor = highlightColor,
-                .id = zone->Id()
-            };
-
-            m_sceneRects.push_back(drawableRect);
+            if (writeFactory && m_textFormat)
+            {
+                std::wstring idStr = std::to_wstring(drawableRect.id + 1);
+                writeFactory->CreateTextLayout(idStr.c_str(),
+                                               (UINT32)idStr.size(),
+                                               m_textFormat.get(),
+                                               drawableRect.rect.right - drawableRect.rect.left,
+                                               drawableRect.rect.bottom - drawableRect.rect.top,
+                                               drawableRect.textLayout.put());
+            }
         }
+
+        m_sceneRects = std::move(sceneRects);
+        m_fullRedraw = true;
     }
 
-    m_shouldRender = true;
-    m_cv.notify_all();
+    if (m_fullRedraw || m_dirtyRect)
+    {
+        m_shouldRender = true;
+        m_cv.notify_all();
+    }
 }
 
 void ZoneWindowDrawing::ForceRender()
 {
-    m_lowLatencyLock = true;
     std::unique_lock lock(m_mutex);
-    m_lowLatencyLock = false;
+    m_fullRedraw = true;
     m_shouldRender = true;
     m_cv.notify_all();
 }
@@ -317,7 +408,10 @@ ZoneWindowDrawing::~ZoneWindowDrawing()
         m_shouldRender = true;
     }
     m_cv.notify_all();
-    m_renderThread.join();
+    if (m_renderThread.joinable())
+    {
+        m_renderThread.join();
+    }
 
     if (m_renderTarget)
     {
@@ -17,9 +17,10 @@ class ZoneWindowDrawing
     struct DrawableRect
     {
         D2D1_RECT_F rect;
-        D2D1_COLOR_F borderColor;
-        D2D1_COLOR_F fillColor;
         size_t id;
+        bool highlighted;
+        // Laid out once for the zone, null if DirectWrite isn't available
+        winrt::com_ptr<IDWriteTextLayout> textLayout;
     };
 
     struct AnimationInfo
@@ -28,24 +29,51 @@ class ZoneWindowDrawing
         unsigned duration;
     };
 
+    // What the render thread draws, taken from the scene while the lock is held
+    struct Frame
+    {
+        std::vector<DrawableRect> rects;
+        // Part of the window to draw again, the whole window if empty
+        std::optional<D2D1_RECT_F> dirtyRect;
+        D2D1_COLOR_F borderColor;
+        D2D1_COLOR_F inactiveColor;
+        D2D1_COLOR_F highlightColor;
+        float animationAlpha;
+    };
+
     HWND m_window = nullptr;
     RECT m_clientRect{};
     ID2D1HwndRenderTarget* m_renderTarget = nullptr;
     std::optional<AnimationInfo> m_animation;
 
+    // Only used by the render thread once it's started
+    winrt::com_ptr<ID2D1SolidColorBrush> m_borderBrush;
+    winrt::com_ptr<ID2D1SolidColorBrush> m_inactiveBrush;
+    winrt::com_ptr<ID2D1SolidColorBrush> m_highlightBrush;
+    winrt::com_ptr<ID2D1SolidColorBrush> m_textBrush;
+    winrt::com_ptr<IDWriteTextFormat> m_textFormat;
+
     std::mutex m_mutex;
+    // Zones in the order of the zone set, the highlighted ones are drawn on top of the others
     std::vector<DrawableRect> m_sceneRects;
+    D2D1_COLOR_F m_borderColor{};
+    D2D1_COLOR_F m_inactiveColor{};
+    D2D1_COLOR_F m_highlightColor{};
+    bool m_fullRedraw = true;
+    std::optional<D2D1_RECT_F> m_dirtyRect;
 
     float GetAnimationAlpha();
     static ID2D1Factory* GetD2DFactory();
     static IDWriteFactory* GetWriteFactory();
     static D2D1_COLOR_F ConvertColor(COLORREF color);
     static D2D1_RECT_F ConvertRect(RECT rect);
-    void Render();
+    void Invalidate(const D2D1_RECT_F& rect);
+    Frame TakeFrame();
+    void RenderLoop();
+    void Render(const Frame& frame);
 
     std::atomic<bool> m_shouldRender = false;
     std::atomic<bool> m_abortThread = false;
-    std::atomic<bool> m_lowLatencyLock = false;
     std::condition_variable m_cv;
     std::thread m_renderThread;
 
@@ -0,0 +1,164 @@
+#include "pch.h"
+
+#include "ZonedWindows.h"
+
+#include "Settings.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+    size_t GetBitmask(HWND window) noexcept
+    {
+        return reinterpret_cast<size_t>(::GetProp(window, ZonedWindowProperties::PropertyMultipleZoneID));
+    }
+
+    void SetBitmask(HWND window, const std::vector<size_t>& zoneIds) noexcept
+    {
+        size_t bitmask = 0;
+        for (size_t id : zoneIds)
+        {
+            if (id < std::numeric_limits<size_t>::digits)
+            {
+                bitmask |= 1ull << id;
+            }
+        }
+
+        if (bitmask != 0)
+        {
+            SetProp(window, ZonedWindowProperties::PropertyMultipleZoneID, reinterpret_cast<HANDLE>(bitmask));
+        }
+        else
+        {
+            ::RemoveProp(window, ZonedWindowProperties::PropertyMultipleZoneID);
+        }
+    }
+
+    std::vector<size_t> ZonesFromBitmask(size_t bitmask)
+    {
+        std::vector<size_t> zoneIds;
+        for (size_t i = 0; i < std::numeric_limits<size_t>::digits; i++)
+        {
+            if ((1ull << i) & bitmask)
+            {
+                zoneIds.push_back(i);
+            }
+        }
+        return zoneIds;
+    }
+}
+
+void ZonedWindows::Stamp(HWND window, const std::vector<size_t>& zoneIds)
+{
+    std::vector<size_t> sortedIds = zoneIds;
+    std::sort(sortedIds.begin(), sortedIds.end());
+    sortedIds.erase(std::unique(sortedIds.begin(), sortedIds.end()), sortedIds.end());
+
+    std::unique_lock lock(m_lock);
+    auto it = m_records.find(window);
+    if (it != m_records.end() && IsLive(window, it->second))
+    {
+        SetBitmask(window, sortedIds);
+        it->second.zoneIds = std::move(sortedIds);
+        return;
+    }
+
+    if (!AddRecord(window, sortedIds) && it != m_records.end())
+    {
+        m_records.erase(it);
+    }
+}
+
+void ZonedWindows::Remove(HWND window)
+{
+    std::unique_lock lock(m_lock);
+    m_records.erase(window);
+    ::RemoveProp(window, ZonedWindowProperties::PropertyZoneRecordID);
+    ::RemoveProp(window, ZonedWindowProperties::PropertyMultipleZoneID);
+}
+
+void ZonedWindows::LoadFromWindowProperties()
+{
+    auto callback = [](HWND window, LPARAM data) -> BOOL {
+        const size_t bitmask = GetBitmask(window);
+        if (bitmask != 0)
+        {
+            auto zonedWindows = reinterpret_cast<ZonedWindows*>(data);
+            auto it = zonedWindows->m_records.find(window);
+            if (it == zonedWindows->m_records.end() || !IsLive(window, it->second))
+            {
+                zonedWindows->AddRecord(window, ZonesFromBitmask(bitmask));
+            }
+        }
+        return TRUE;
+    };
+
+    std::unique_lock lock(m_lock);
+    EnumWindows(callback, reinterpret_cast<LPARAM>(this));
+}
+
+bool ZonedWindows::IsZoned(HWND window) const
+{
+    std::shared_lock lock(m_lock);
+    auto it = m_records.find(window);
+    return (it != m_records.end() && IsLive(window, it->second)) || GetBitmask(window) != 0;
+}
+
+std::vector<size_t> ZonedWindows::GetZones(HWND window) const
+{
+    std::shared_lock lock(m_lock);
+    auto it = m_records.find(window);
+    if (it != m_records.end() && IsLive(window, it->second))
+    {
+        return it->second.zoneIds;
+    }
+
+    return ZonesFromBitmask(GetBitmask(window));
+}
+
+std::vector<std::pair<HWND, std::vector<size_t>>> ZonedWindows::GetAll()
+{
+    std::vector<std::pair<HWND, std::vector<size_t>>> result;
+
+    std::unique_lock lock(m_lock);
+    result.reserve(m_records.size());
+    for (auto it = m_records.begin(); it != m_records.end();)
+    {
+        if (IsLive(it->first, it->second))
+        {
+            result.emplace_back(it->first, it->second.zoneIds);
+            ++it;
+        }
+        else
+        {
+            it = m_records.erase(it);
+        }
+    }
+
+    return result;
+}
+
+bool ZonedWindows::IsLive(HWND window, const Record& record) noexcept
+{
+    return ::GetProp(window, ZonedWindowProperties::PropertyZoneRecordID) == reinterpret_cast<HANDLE>(record.stamp);
+}
+
+bool ZonedWindows::AddRecord(HWND window, std::vector<size_t> zoneIds)
+{
+    const size_t stamp = m_nextStamp++;
+    if (!SetProp(window, ZonedWindowProperties::PropertyZoneRecordID, reinterpret_cast<HANDLE>(stamp)))
+    {
+        return false;
+    }
+
+    SetBitmask(window, zoneIds);
+    m_records[window] = Record{ stamp, std::move(zoneIds) };
+    return true;
+}
+
+ZonedWindows& ZonedWindowsInstance()
+{
+    static ZonedWindows instance;
+    return instance;
+}
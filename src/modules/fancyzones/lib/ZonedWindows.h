@@ -0,0 +1,62 @@
+#pragma once
+
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Zones of the windows placed by FancyZones, kept in a table keyed by window handle. Zones are referred to
+ * by their ids, so there is no limit on the number of zones, and restoring the windows after a layout change
+ * only visits the zoned ones. Each window is stamped with a property holding the number of its record,
+ * which tells the record of a live window from one left by a destroyed window whose handle was reused.
+ *
+ * The table only lives as long as the process, so the zones with an id below 64 are also kept in a bitmask
+ * property of the window, like before the table existed. Windows the table doesn't know are read from that
+ * property, which keeps the windows zoned across a restart of FancyZones.
+ */
+class ZonedWindows
+{
+public:
+    /**
+     * Record the zones of the window, replacing the previous ones.
+     *
+     * @param   window  Handle of the zoned window.
+     * @param   zoneIds Ids of the zones the window was moved into.
+     */
+    void Stamp(HWND window, const std::vector<size_t>& zoneIds);
+    void Remove(HWND window);
+
+    /**
+     * Record the windows zoned by a previous FancyZones process, from their bitmask property. Called when
+     * FancyZones starts, so the zoned windows are restored after a layout change.
+     */
+    void LoadFromWindowProperties();
+
+    bool IsZoned(HWND window) const;
+    /**
+     * @returns Ids of the zones of the window in ascending order, empty if the window isn't zoned. Read from
+     *          the bitmask property if the table doesn't know the window.
+     */
+    std::vector<size_t> GetZones(HWND window) const;
+    /**
+     * @returns The zoned windows with their zone ids. Records of destroyed windows are dropped.
+     */
+    std::vector<std::pair<HWND, std::vector<size_t>>> GetAll();
+
+private:
+    struct Record
+    {
+        size_t stamp;
+        std::vector<size_t> zoneIds;
+    };
+
+    static bool IsLive(HWND window, const Record& record) noexcept;
+    // m_lock is held
+    bool AddRecord(HWND window, std::vector<size_t> zoneIds);
+
+    mutable std::shared_mutex m_lock;
+    std::unordered_map<HWND, Record> m_records;
+    size_t m_nextStamp = 1;
+};
+
+ZonedWindows& ZonedWindowsInstance();
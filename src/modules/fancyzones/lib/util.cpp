@@ -1,9 +1,9 @@
 #include "pch.h"
 #include "util.h"
 #include "Settings.h"
+#include "ProcessInfoCache.h"
 
 #include <common/display/dpi_aware.h>
-#include <common/utils/process_path.h>
 #include <common/utils/window.h>
 
 #include <array>
@@ -13,49 +13,6 @@
 
 #include <fancyzones/lib/FancyZonesDataTypes.h>
 
-// Non-Localizable strings
-namespace NonLocalizable
-{
-    const wchar_t PowerToysAppPowerLauncher[] = L"POWERLAUNCHER.EXE";
-    const wchar_t PowerToysAppFZEditor[] = L"FANCYZONESEDITOR.EXE";
-}
-
-bool find_app_name_in_path(const std::wstring& where, const std::vector<std::wstring>& what)
-{
-    for (const auto& row : what)
-    {
-        const auto pos = where.rfind(row);
-        const auto last_slash = where.rfind('\\');
-        //Check that row occurs in where, and its last occurrence contains in itself the first character after the last backslash.
-        if (pos != std::wstring::npos && pos <= last_slash + 1 && pos + row.length() > last_slash)
-        {
-            return true;
-        }
-    }
-    return false;
-}
-namespace
-{
-    bool IsZonableByProcessPath(const std::wstring& processPath, const std::vector<std::wstring>& excludedApps)
-    {
-        // Filter out user specified apps
-        CharUpperBuffW(const_cast<std::wstring&>(processPath).data(), (DWORD)processPath.length());
-        if (find_app_name_in_path(processPath, excludedApps))
-        {
-            return false;
-        }
-        if (find_app_name_in_path(processPath, { NonLocalizable::PowerToysAppPowerLauncher }))
-        {
-            return false;
-        }
-        if (find_app_name_in_path(processPath, { NonLocalizable::PowerToysAppFZEditor }))
-        {
-            return false;
-        }
-        return true;
-    }
-}
-
 namespace FancyZonesUtils
 {
     std::wstring TrimDeviceId(const std::wstring& deviceId)
@@ -390,10 +347,9 @@ namespace FancyZonesUtils
         {
             return false;
         }
-        auto process_path = get_process_path(window);
         // Check for Cortana:
         if (strcmp(class_name.data(), "Windows.UI.Core.CoreWindow") == 0 &&
-            process_path.ends_with(L"SearchUI.exe"))
+            ProcessInfoCacheInstance().GetProcessPath(window).ends_with(L"SearchUI.exe"))
         {
             return false;
         }
@@ -409,7 +365,7 @@ namespace FancyZonesUtils
             return false;
         }
 
-        return IsZonableByProcessPath(get_process_path(window), excludedApps);
+        return !ProcessInfoCacheInstance().IsExcluded(window, excludedApps);
     }
 
     bool IsCandidateForZoning(HWND window, const std::vector<std::wstring>& excludedApps) noexcept
@@ -419,7 +375,7 @@ namespace FancyZonesUtils
             return false;
         }
 
-        return IsZonableByProcessPath(get_process_path(window), excludedApps);
+        return !ProcessInfoCacheInstance().IsExcluded(window, excludedApps);
     }
 
     bool IsWindowMaximized(HWND window) noexcept
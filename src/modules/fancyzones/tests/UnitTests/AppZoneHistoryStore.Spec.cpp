@@ -0,0 +1,149 @@
+#include "pch.h"
+#include "lib\AppZoneHistoryStore.h"
+
+#include <filesystem>
+#include <fstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace FancyZonesUnitTests
+{
+    TEST_CLASS (AppZoneHistoryStoreUnitTests)
+    {
+        std::filesystem::path m_folder;
+        std::wstring m_jsonFileName;
+
+        static FancyZonesDataTypes::AppZoneHistoryData Data(const std::wstring& deviceId, std::vector<size_t> zoneIndexSet)
+        {
+            return FancyZonesDataTypes::AppZoneHistoryData{ .zoneSetUuid = L"{33A2B101-06E0-437B-A61E-CDBECF502906}",
+                                                            .deviceId = deviceId,
+                                                            .zoneIndexSet = std::move(zoneIndexSet) };
+        }
+
+        static void AssertEqual(const AppZoneHistoryStore::TAppZoneHistoryMap& expected, const AppZoneHistoryStore::TAppZoneHistoryMap& actual)
+        {
+            Assert::AreEqual(expected.size(), actual.size());
+            for (const auto& [appPath, history] : expected)
+            {
+                Assert::IsTrue(actual.contains(appPath));
+                const auto& actualHistory = actual.at(appPath);
+                Assert::AreEqual(history.size(), actualHistory.size());
+                for (size_t i = 0; i < history.size(); ++i)
+                {
+                    Assert::AreEqual(history[i].zoneSetUuid, actualHistory[i].zoneSetUuid);
+                    Assert::AreEqual(history[i].deviceId, actualHistory[i].deviceId);
+                    Assert::IsTrue(history[i].zoneIndexSet == actualHistory[i].zoneIndexSet);
+                }
+            }
+        }
+
+        std::optional<AppZoneHistoryStore::TAppZoneHistoryMap> Reload()
+        {
+            AppZoneHistoryStore store;
+            store.Open(m_jsonFileName);
+            return store.Load();
+        }
+
+        TEST_METHOD_INITIALIZE(Init)
+        {
+            m_folder = std::filesystem::temp_directory_path() / L"FancyZonesAppZoneHistoryStoreTests";
+            std::filesystem::remove_all(m_folder);
+            std::filesystem::create_directories(m_folder);
+            m_jsonFileName = (m_folder / L"app-zone-history.json").wstring();
+        }
+
+        TEST_METHOD_CLEANUP(Cleanup)
+        {
+            std::filesystem::remove_all(m_folder);
+        }
+
+    public:
+        TEST_METHOD (LoadWithoutFiles)
+        {
+            Assert::IsFalse(Reload().has_value());
+        }
+
+        TEST_METHOD (UpdateAndReload)
+        {
+            AppZoneHistoryStore store;
+            store.Open(m_jsonFileName);
+            Assert::IsTrue(store.Update({ { L"app1", { Data(L"device-1", { 0 }) } }, { L"app2", { Data(L"device-1", { 1, 2 }) } } }));
+            Assert::IsTrue(store.Update({ { L"app1", { Data(L"device-2", { 3 }) } }, { L"app2", {} } }));
+
+            const auto actual = Reload();
+            Assert::IsTrue(actual.has_value());
+            AssertEqual({ { L"app1", { Data(L"device-2", { 3 }) } } }, *actual);
+        }
+
+        TEST_METHOD (ReplaceAndReload)
+        {
+            const AppZoneHistoryStore::TAppZoneHistoryMap expected{ { L"app1", { Data(L"device-1", { 0 }), Data(L"device-2", { 5 }) } } };
+            AppZoneHistoryStore store;
+            store.Open(m_jsonFileName);
+            Assert::IsTrue(store.Update({ { L"app2", { Data(L"device-1", { 1 }) } } }));
+            Assert::IsTrue(store.Replace(expected));
+
+            const auto actual = Reload();
+            Assert::IsTrue(actual.has_value());
+            AssertEqual(expected, *actual);
+        }
+
+        TEST_METHOD (RecordCutShortIsIgnored)
+        {
+            {
+                AppZoneHistoryStore store;
+                store.Open(m_jsonFileName);
+                Assert::IsTrue(store.Update({ { L"app1", { Data(L"device-1", { 0 }) } } }));
+            }
+
+            std::ofstream{ m_folder / L"app-zone-history.log", std::ios::binary | std::ios::app } << "\x40garbage";
+
+            {
+                AppZoneHistoryStore store;
+                store.Open(m_jsonFileName);
+                Assert::IsTrue(store.Load().has_value());
+                Assert::IsTrue(store.Update({ { L"app2", { Data(L"device-1", { 1 }) } } }));
+            }
+
+            const auto actual = Reload();
+            Assert::IsTrue(actual.has_value());
+            AssertEqual({ { L"app1", { Data(L"device-1", { 0 }) } }, { L"app2", { Data(L"device-1", { 1 }) } } }, *actual);
+        }
+
+        TEST_METHOD (LogIsCompacted)
+        {
+            AppZoneHistoryStore::TAppZoneHistoryMap expected;
+            AppZoneHistoryStore store;
+            store.Open(m_jsonFileName);
+            for (size_t i = 0; i < 5000; ++i)
+            {
+                const std::wstring appPath = L"app" + std::to_wstring(i % 10);
+                expected[appPath] = { Data(L"device-1", { i }) };
+                Assert::IsTrue(store.Update({ { appPath, expected[appPath] } }));
+            }
+
+            const auto logFileName = m_folder / L"app-zone-history.log";
+            Assert::IsTrue(!std::filesystem::exists(logFileName) || std::filesystem::file_size(logFileName) < 64 * 1024);
+
+            const auto actual = Reload();
+            Assert::IsTrue(actual.has_value());
+            AssertEqual(expected, *actual);
+        }
+
+        TEST_METHOD (DamagedSnapshot)
+        {
+            {
+                AppZoneHistoryStore store;
+                store.Open(m_jsonFileName);
+                Assert::IsTrue(store.Replace({ { L"app1", { Data(L"device-1", { 0 }) } } }));
+            }
+
+            std::fstream file{ m_folder / L"app-zone-history.bin", std::ios::in | std::ios::out | std::ios::binary };
+            file.seekp(-1, std::ios::end);
+            file.put('X');
+            file.close();
+
+            Assert::IsFalse(Reload().has_value());
+        }
+    };
+}
@@ -0,0 +1,67 @@
+#include "pch.h"
+#include "lib\DeferredWriter.h"
+
+#include <atomic>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace FancyZonesUnitTests
+{
+    TEST_CLASS (DeferredWriterUnitTests)
+    {
+    public:
+        TEST_METHOD (NoRequestNoWrite)
+        {
+            std::atomic<int> writes = 0;
+            DeferredWriter writer([&] { ++writes; }, std::chrono::milliseconds(10), std::chrono::milliseconds(100));
+            writer.Flush();
+            writer.Stop();
+            Assert::AreEqual(0, writes.load());
+        }
+
+        TEST_METHOD (RequestsAreCoalesced)
+        {
+            std::atomic<int> writes = 0;
+            DeferredWriter writer([&] { ++writes; }, std::chrono::hours(1), std::chrono::hours(1));
+            for (int i = 0; i < 100; ++i)
+            {
+                writer.Schedule();
+            }
+            Assert::AreEqual(0, writes.load());
+
+            writer.Flush();
+            Assert::AreEqual(1, writes.load());
+
+            // Nothing left to write
+            writer.Flush();
+            Assert::AreEqual(1, writes.load());
+        }
+
+        TEST_METHOD (WriteAfterDelay)
+        {
+            std::atomic<int> writes = 0;
+            DeferredWriter writer([&] { ++writes; }, std::chrono::milliseconds(10), std::chrono::milliseconds(100));
+            writer.Schedule();
+            for (int i = 0; i < 500 && writes == 0; ++i)
+            {
+                Sleep(10);
+            }
+            Assert::AreEqual(1, writes.load());
+        }
+
+        TEST_METHOD (StopWritesPendingRequest)
+        {
+            std::atomic<int> writes = 0;
+            {
+                DeferredWriter writer([&] { ++writes; }, std::chrono::hours(1), std::chrono::hours(1));
+                writer.Schedule();
+                writer.Stop();
+                Assert::AreEqual(1, writes.load());
+
+                // The thread starts again on the next request
+                writer.Schedule();
+            }
+            Assert::AreEqual(2, writes.load());
+        }
+    };
+}
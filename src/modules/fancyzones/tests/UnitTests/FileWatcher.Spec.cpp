@@ -0,0 +1,113 @@
+#include "pch.h"
+#include "lib\FileWatcher.h"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace FancyZonesUnitTests
+{
+    TEST_CLASS (FileWatcherUnitTests)
+    {
+        std::filesystem::path m_folder;
+
+        void Write(const std::filesystem::path& path, const std::string& content)
+        {
+            std::ofstream{ path, std::ios::binary | std::ios::trunc } << content;
+        }
+
+        static bool WaitFor(const std::atomic<int>& value, int expected)
+        {
+            for (int i = 0; i < 500 && value < expected; ++i)
+            {
+                Sleep(10);
+            }
+            return value == expected;
+        }
+
+        TEST_METHOD_INITIALIZE(Init)
+        {
+            m_folder = std::filesystem::temp_directory_path() / L"FancyZonesFileWatcherTests";
+            std::filesystem::remove_all(m_folder);
+            std::filesystem::create_directories(m_folder);
+        }
+
+        TEST_METHOD_CLEANUP(Cleanup)
+        {
+            std::filesystem::remove_all(m_folder);
+        }
+
+    public:
+        TEST_METHOD (ContentChanged)
+        {
+            const auto path = m_folder / L"watched.json";
+            Write(path, "{}");
+
+            std::atomic<int> calls = 0;
+            FileWatcher watcher(path.wstring(), [&] { ++calls; }, 10);
+            Write(path, "{ \"changed\": true }");
+            Assert::IsTrue(WaitFor(calls, 1));
+        }
+
+        TEST_METHOD (SameContentIgnored)
+        {
+            const auto path = m_folder / L"watched.json";
+            Write(path, "{}");
+
+            std::atomic<int> calls = 0;
+            FileWatcher watcher(path.wstring(), [&] { ++calls; }, 10);
+            Write(path, "{}");
+            Sleep(300);
+            Assert::AreEqual(0, calls.load());
+        }
+
+        TEST_METHOD (BurstDebounced)
+        {
+            const auto path = m_folder / L"watched.json";
+            Write(path, "{}");
+
+            std::atomic<int> calls = 0;
+            FileWatcher watcher(path.wstring(), [&] { ++calls; }, 200);
+            for (int i = 0; i < 10; ++i)
+            {
+                Write(path, std::to_string(i));
+            }
+            Assert::IsTrue(WaitFor(calls, 1));
+            Sleep(300);
+            Assert::AreEqual(1, calls.load());
+        }
+
+        TEST_METHOD (OtherFilesIgnored)
+        {
+            const auto path = m_folder / L"watched.json";
+            const auto otherPath = m_folder / L"other.json";
+            Write(path, "{}");
+
+            std::atomic<int> calls = 0;
+            std::atomic<int> otherCalls = 0;
+            FileWatcher watcher(path.wstring(), [&] { ++calls; }, 10);
+            FileWatcher otherWatcher(otherPath.wstring(), [&] { ++otherCalls; }, 10);
+            Write(otherPath, "{}");
+            Assert::IsTrue(WaitFor(otherCalls, 1));
+            Assert::AreEqual(0, calls.load());
+        }
+
+        TEST_METHOD (FolderCreatedLater)
+        {
+            const auto folder = m_folder / L"later";
+            const auto path = folder / L"watched.json";
+
+            // The folder is opened again until it can be watched
+            std::atomic<int> calls = 0;
+            FileWatcher watcher(path.wstring(), [&] { ++calls; }, 10);
+            std::filesystem::create_directories(folder);
+            Write(path, "{}");
+            Assert::IsTrue(WaitFor(calls, 1));
+
+            Write(path, "{ \"changed\": true }");
+            Assert::IsTrue(WaitFor(calls, 2));
+        }
+    };
+}
@@ -1778,6 +1778,47 @@ namespace FancyZonesUnitTests
                 Assert::IsTrue(std::vector<size_t>{ expectedZoneIndex } == data.GetAppLastZoneIndexSet(window, deviceId, zoneSetId));
             }
 
+            TEST_METHOD (AppLastZoneIndexWrittenOnFlush)
+            {
+                const std::wstring deviceId = L"device-id";
+                const std::wstring zoneSetId = L"zoneset-uuid";
+                const auto window = Mocks::WindowCreate(m_hInst);
+                FancyZonesData data;
+                data.SetSettingsModulePath(m_moduleName);
+                const auto& jsonPath = data.appZoneHistoryFileName;
+
+                Assert::IsTrue(data.SetAppLastZones(window, deviceId, zoneSetId, { 1 }));
+                Assert::IsTrue(data.SetAppLastZones(window, deviceId, zoneSetId, { 2 }));
+                data.FlushAppZoneHistory();
+
+                const auto actual = json::from_file(jsonPath);
+                Assert::IsTrue(actual.has_value());
+                const auto history = actual->GetNamedArray(L"app-zone-history");
+                Assert::AreEqual(1u, history.Size());
+                Assert::IsFalse(std::filesystem::exists(jsonPath + L".tmp"));
+            }
+
+            TEST_METHOD (AppLastZoneIndexExportedWithoutFlush)
+            {
+                const std::wstring deviceId = L"device-id";
+                const std::wstring zoneSetId = L"zoneset-uuid";
+                const auto window = Mocks::WindowCreate(m_hInst);
+                FancyZonesData data;
+                data.SetSettingsModulePath(m_moduleName);
+                const auto& jsonPath = data.appZoneHistoryFileName;
+
+                // The JSON file is exported in the background, in case FancyZones doesn't exit cleanly
+                Assert::IsTrue(data.SetAppLastZones(window, deviceId, zoneSetId, { 1 }));
+                for (int i = 0; i < 300 && !std::filesystem::exists(jsonPath); ++i)
+                {
+                    Sleep(100);
+                }
+
+                const auto actual = json::from_file(jsonPath);
+                Assert::IsTrue(actual.has_value());
+                Assert::AreEqual(1u, actual->GetNamedArray(L"app-zone-history").Size());
+            }
+
             TEST_METHOD (AppLastZoneIndexZero)
             {
                 const std::wstring zoneSetId = L"zoneset-uuid";
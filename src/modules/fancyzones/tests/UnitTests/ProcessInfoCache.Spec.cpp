@@ -0,0 +1,112 @@
+#include "pch.h"
+#include "Util.h"
+#include "lib\ExcludedAppsMatcher.h"
+#include "lib\ProcessInfoCache.h"
+
+#include <common/utils/process_path.h>
+
+#include <filesystem>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace FancyZonesUnitTests
+{
+    TEST_CLASS (ExcludedAppsMatcherUnitTests)
+    {
+    public:
+        TEST_METHOD (NoApps)
+        {
+            ExcludedAppsMatcher matcher(std::vector<std::wstring>{});
+            Assert::IsFalse(matcher.Matches(L"C:\\WINDOWS\\NOTEPAD.EXE"));
+        }
+
+        TEST_METHOD (FileName)
+        {
+            ExcludedAppsMatcher matcher({ L"CALC.EXE", L"NOTEPAD.EXE" });
+            Assert::IsTrue(matcher.Matches(L"C:\\WINDOWS\\NOTEPAD.EXE"));
+            Assert::IsFalse(matcher.Matches(L"C:\\WINDOWS\\EXPLORER.EXE"));
+        }
+
+        TEST_METHOD (BeginningOfFileName)
+        {
+            ExcludedAppsMatcher matcher({ L"NOTE" });
+            Assert::IsTrue(matcher.Matches(L"C:\\WINDOWS\\NOTEPAD.EXE"));
+            Assert::IsFalse(matcher.Matches(L"C:\\WINDOWS\\ONENOTE.EXE"));
+        }
+
+        TEST_METHOD (FolderAndFileName)
+        {
+            ExcludedAppsMatcher matcher({ L"WINDOWS\\NOTEPAD" });
+            Assert::IsTrue(matcher.Matches(L"C:\\WINDOWS\\NOTEPAD.EXE"));
+            Assert::IsFalse(matcher.Matches(L"C:\\WINDOWS\\SYSTEM32\\NOTEPAD.EXE"));
+        }
+
+        TEST_METHOD (FolderOnly)
+        {
+            ExcludedAppsMatcher matcher({ L"WINDOWS" });
+            Assert::IsFalse(matcher.Matches(L"C:\\WINDOWS\\NOTEPAD.EXE"));
+        }
+
+        TEST_METHOD (OnlyLastOccurrenceCounts)
+        {
+            ExcludedAppsMatcher matcher({ L"E" });
+            Assert::IsFalse(matcher.Matches(L"C:\\TOOLS\\EDIT.EXE"));
+        }
+
+        TEST_METHOD (OverlappingApps)
+        {
+            ExcludedAppsMatcher matcher({ L"ABCD", L"BC", L"\\BCX" });
+            Assert::IsTrue(matcher.Matches(L"C:\\ABCD\\BCX.EXE"));
+            Assert::IsFalse(matcher.Matches(L"C:\\ABCD\\ABC.EXE"));
+        }
+
+        TEST_METHOD (PathWithoutFolder)
+        {
+            ExcludedAppsMatcher matcher({ L"NOTEPAD.EXE" });
+            Assert::IsFalse(matcher.Matches(L"NOTEPAD.EXE"));
+            Assert::IsFalse(matcher.Matches(L""));
+        }
+    };
+
+    TEST_CLASS (ProcessInfoCacheUnitTests)
+    {
+        HINSTANCE m_hInst{};
+
+        TEST_METHOD_INITIALIZE(Init)
+        {
+            m_hInst = (HINSTANCE)GetModuleHandleW(nullptr);
+        }
+
+    public:
+        TEST_METHOD (ProcessPath)
+        {
+            ProcessInfoCache cache;
+            const auto window = Mocks::WindowCreate(m_hInst);
+            Assert::AreEqual(get_process_path(window), cache.GetProcessPath(window));
+            Assert::AreEqual(get_process_path(window), cache.GetProcessPath(window));
+        }
+
+        TEST_METHOD (ProcessPathOfInvalidWindow)
+        {
+            ProcessInfoCache cache;
+            Assert::AreEqual(std::wstring{}, cache.GetProcessPath(Mocks::Window()));
+        }
+
+        TEST_METHOD (ExcludedAppsChanged)
+        {
+            ProcessInfoCache cache;
+            const auto window = Mocks::WindowCreate(m_hInst);
+            std::wstring fileName = std::filesystem::path(get_process_path(window)).filename().wstring();
+            CharUpperBuffW(fileName.data(), static_cast<DWORD>(fileName.length()));
+
+            Assert::IsFalse(cache.IsExcluded(window, {}));
+
+            // The verdict is kept until the settings change
+            Assert::IsFalse(cache.IsExcluded(window, { fileName }));
+            cache.ExcludedAppsChanged();
+            Assert::IsTrue(cache.IsExcluded(window, { fileName }));
+            cache.ExcludedAppsChanged();
+            Assert::IsFalse(cache.IsExcluded(window, { L"NOTEPAD.EXE" }));
+        }
+    };
+}
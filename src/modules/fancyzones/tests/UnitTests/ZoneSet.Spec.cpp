@@ -294,6 +294,79 @@ namespace FancyZonesUnitTests
                 compareZones(zone4, m_set->GetZones()[actual[3]]);
             }
 
+            TEST_METHOD (ZoneFromPointOverlappingLargest)
+            {
+                ZoneSetConfig config(m_id, m_layoutType, Mocks::Monitor(), DefaultValues::SensitivityRadius, Settings::OverlappingZonesAlgorithm::Largest);
+                auto set = MakeZoneSet(config);
+                winrt::com_ptr<IZone> zone1 = MakeZone({ 0, 0, 100, 100 }, 1);
+                set->AddZone(zone1);
+                winrt::com_ptr<IZone> zone2 = MakeZone({ 10, 10, 150, 150 }, 2);
+                set->AddZone(zone2);
+                winrt::com_ptr<IZone> zone3 = MakeZone({ 10, 10, 50, 50 }, 3);
+                set->AddZone(zone3);
+
+                auto actual = set->ZonesFromPoint(POINT{ 40, 40 });
+                Assert::IsTrue(actual.size() == 1);
+                compareZones(zone2, set->GetZones()[actual[0]]);
+            }
+
+            TEST_METHOD (ZoneFromPointManyZones)
+            {
+                // More zones than bits in a word of the hit-test index
+                const int size = 50, columns = 10, rows = 10;
+                for (int row = 0; row < rows; row++)
+                {
+                    for (int col = 0; col < columns; col++)
+                    {
+                        m_set->AddZone(MakeZone({ col * size, row * size, (col + 1) * size, (row + 1) * size }, row * columns + col));
+                    }
+                }
+
+                for (int row = 0; row < rows; row++)
+                {
+                    for (int col = 0; col < columns; col++)
+                    {
+                        auto actual = m_set->ZonesFromPoint(POINT{ col * size + size / 2, row * size + size / 2 });
+                        Assert::IsTrue(actual.size() == 1);
+                        Assert::AreEqual(static_cast<size_t>(row * columns + col), actual[0]);
+                    }
+                }
+
+                auto actual = m_set->ZonesFromPoint(POINT{ size, size });
+                Assert::IsTrue(std::vector<size_t>{ 0, 1, 10, 11 } == actual);
+            }
+
+            TEST_METHOD (ZoneFromPointAfterAddZone)
+            {
+                m_set->AddZone(MakeZone({ 0, 0, 100, 100 }, 0));
+                Assert::IsTrue(m_set->ZonesFromPoint(POINT{ 300, 50 }).size() == 0);
+
+                m_set->AddZone(MakeZone({ 200, 0, 400, 100 }, 1));
+                Assert::IsTrue(std::vector<size_t>{ 1 } == m_set->ZonesFromPoint(POINT{ 300, 50 }));
+            }
+
+            TEST_METHOD (ZoneFromPointWithRegion)
+            {
+                m_set->AddZone(MakeZone({ 0, 0, 100, 100 }, 0));
+                m_set->AddZone(MakeZone({ 100, 0, 200, 100 }, 1));
+
+                for (POINT pt : { POINT{ 50, 50 }, POINT{ 100, 50 }, POINT{ 150, 10 }, POINT{ 500, 500 } })
+                {
+                    RECT region{};
+                    auto expected = m_set->ZonesFromPointWithRegion(pt, region);
+                    Assert::IsTrue(expected == m_set->ZonesFromPoint(pt));
+                    Assert::IsTrue(PtInRect(&region, pt));
+
+                    // Same zones at the corners of the region, within the tested range
+                    const LONG left = max(region.left, -1000L), top = max(region.top, -1000L);
+                    const LONG right = min(region.right, 1000L) - 1, bottom = min(region.bottom, 1000L) - 1;
+                    for (POINT corner : { POINT{ left, top }, POINT{ right, top }, POINT{ left, bottom }, POINT{ right, bottom } })
+                    {
+                        Assert::IsTrue(expected == m_set->ZonesFromPoint(corner));
+                    }
+                }
+            }
+
             TEST_METHOD (ZoneIndexFromWindowUnknown)
             {
                 winrt::com_ptr<IZone> zone = MakeZone({ 0, 0, 100, 100 }, 1);
@@ -0,0 +1,116 @@
+#include "pch.h"
+#include "lib\ZonedWindows.h"
+#include "lib\Settings.h"
+
+#include "Util.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace FancyZonesUnitTests
+{
+    TEST_CLASS (ZonedWindowsUnitTests)
+    {
+        HWND m_window{};
+
+        TEST_METHOD_INITIALIZE(Init)
+        {
+            m_window = CreateWindowExW(0, L"STATIC", L"", WS_POPUP, 0, 0, 1, 1, nullptr, nullptr, nullptr, nullptr);
+            Assert::IsNotNull(m_window);
+        }
+
+        TEST_METHOD_CLEANUP(Cleanup)
+        {
+            if (IsWindow(m_window))
+            {
+                DestroyWindow(m_window);
+            }
+        }
+
+    public:
+        TEST_METHOD (NotZoned)
+        {
+            ZonedWindows zonedWindows;
+            Assert::IsFalse(zonedWindows.IsZoned(m_window));
+            Assert::IsTrue(zonedWindows.GetZones(m_window).empty());
+        }
+
+        TEST_METHOD (StampMoreThan64Zones)
+        {
+            ZonedWindows zonedWindows;
+            zonedWindows.Stamp(m_window, { 100, 3, 70, 3 });
+
+            Assert::IsTrue(zonedWindows.IsZoned(m_window));
+            Assert::IsTrue(std::vector<size_t>{ 3, 70, 100 } == zonedWindows.GetZones(m_window));
+
+            zonedWindows.Stamp(m_window, { 1 });
+            Assert::IsTrue(std::vector<size_t>{ 1 } == zonedWindows.GetZones(m_window));
+        }
+
+        TEST_METHOD (StampInvalidWindow)
+        {
+            ZonedWindows zonedWindows;
+            HWND window = Mocks::Window();
+            zonedWindows.Stamp(window, { 0 });
+
+            Assert::IsFalse(zonedWindows.IsZoned(window));
+            Assert::IsTrue(zonedWindows.GetAll().empty());
+        }
+
+        TEST_METHOD (Remove)
+        {
+            ZonedWindows zonedWindows;
+            zonedWindows.Stamp(m_window, { 0 });
+            zonedWindows.Remove(m_window);
+
+            Assert::IsFalse(zonedWindows.IsZoned(m_window));
+            Assert::IsNull(GetProp(m_window, ZonedWindowProperties::PropertyMultipleZoneID));
+        }
+
+        TEST_METHOD (DestroyedWindowIsDropped)
+        {
+            ZonedWindows zonedWindows;
+            HWND other = CreateWindowExW(0, L"STATIC", L"", WS_POPUP, 0, 0, 1, 1, nullptr, nullptr, nullptr, nullptr);
+            zonedWindows.Stamp(m_window, { 0 });
+            zonedWindows.Stamp(other, { 1, 2 });
+            DestroyWindow(other);
+
+            auto all = zonedWindows.GetAll();
+            Assert::AreEqual(static_cast<size_t>(1), all.size());
+            Assert::IsTrue(all[0].first == m_window);
+            Assert::IsTrue(std::vector<size_t>{ 0 } == all[0].second);
+        }
+
+        TEST_METHOD (StampBitmaskProperty)
+        {
+            ZonedWindows zonedWindows;
+            zonedWindows.Stamp(m_window, { 0, 2, 70 });
+
+            // Zones from 64 on don't fit in the property
+            Assert::IsTrue(reinterpret_cast<HANDLE>(0b101) == GetProp(m_window, ZonedWindowProperties::PropertyMultipleZoneID));
+        }
+
+        TEST_METHOD (UnknownWindowFromBitmaskProperty)
+        {
+            ZonedWindows zonedWindows;
+            SetProp(m_window, ZonedWindowProperties::PropertyMultipleZoneID, reinterpret_cast<HANDLE>(0b110));
+
+            Assert::IsTrue(zonedWindows.IsZoned(m_window));
+            Assert::IsTrue(std::vector<size_t>{ 1, 2 } == zonedWindows.GetZones(m_window));
+        }
+
+        TEST_METHOD (LoadFromWindowProperties)
+        {
+            // Zoned by a previous FancyZones process
+            ZonedWindows previous;
+            previous.Stamp(m_window, { 1, 3 });
+
+            ZonedWindows zonedWindows;
+            zonedWindows.LoadFromWindowProperties();
+
+            auto all = zonedWindows.GetAll();
+            auto it = std::find_if(all.begin(), all.end(), [&](const auto& zoned) { return zoned.first == m_window; });
+            Assert::IsTrue(it != all.end());
+            Assert::IsTrue(std::vector<size_t>{ 1, 3 } == it->second);
+        }
+    };
+}
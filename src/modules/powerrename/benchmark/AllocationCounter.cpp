@@ -0,0 +1,126 @@
+#include "pch.h"
+#include "Benchmark.h"
+#include <atomic>
+#include <new>
+
+// Replaces the global operator new and operator delete to count the allocations of
+// the benchmark and of the library code it runs.  Each block is prefixed with its
+// size so the live bytes can be tracked without sized deallocation.
+
+namespace
+{
+    // Keeps the blocks aligned like malloc does
+    const size_t c_headerSize = 16;
+
+    std::atomic<size_t> s_allocations = 0;
+    std::atomic<size_t> s_allocatedBytes = 0;
+    std::atomic<size_t> s_liveBytes = 0;
+    std::atomic<size_t> s_peakBytes = 0;
+
+    void* CountedAllocate(size_t size) noexcept
+    {
+        BYTE* block = static_cast<BYTE*>(malloc(size + c_headerSize));
+        if (!block)
+        {
+            return nullptr;
+        }
+        *reinterpret_cast<size_t*>(block) = size;
+
+        s_allocations.fetch_add(1, std::memory_order_relaxed);
+        s_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+        const size_t live = s_liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+        size_t peak = s_peakBytes.load(std::memory_order_relaxed);
+        while (live > peak && !s_peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+        {
+        }
+        return block + c_headerSize;
+    }
+
+    void CountedFree(void* p) noexcept
+    {
+        if (p)
+        {
+            BYTE* block = static_cast<BYTE*>(p) - c_headerSize;
+            s_liveBytes.fetch_sub(*reinterpret_cast<size_t*>(block), std::memory_order_relaxed);
+            free(block);
+        }
+    }
+
+    void* CountedAllocateOrThrow(size_t size)
+    {
+        void* p = CountedAllocate(size ? size : 1);
+        if (!p)
+        {
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+}
+
+namespace Benchmark
+{
+    AllocationStats GetAllocationStats()
+    {
+        AllocationStats stats;
+        stats.allocations = s_allocations.load(std::memory_order_relaxed);
+        stats.allocatedBytes = s_allocatedBytes.load(std::memory_order_relaxed);
+        stats.liveBytes = s_liveBytes.load(std::memory_order_relaxed);
+        stats.peakBytes = s_peakBytes.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    void ResetPeakBytes()
+    {
+        s_peakBytes.store(s_liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+void* operator new(size_t size)
+{
+    return CountedAllocateOrThrow(size);
+}
+
+void* operator new[](size_t size)
+{
+    return CountedAllocateOrThrow(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return CountedAllocate(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return CountedAllocate(size ? size : 1);
+}
+
+void operator delete(void* p) noexcept
+{
+    CountedFree(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    CountedFree(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    CountedFree(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    CountedFree(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    CountedFree(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+    CountedFree(p);
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+#include <random>
+
+// Minimal timing helpers shared by the benchmarks.  Each benchmark prints one
+// tab separated line per measurement: group, name, items and nanoseconds per item.
+namespace Benchmark
+{
+    // Number of times each measurement is repeated, the fastest run is reported
+    const int c_repetitions = 5;
+
+    // Runs fn, which processes itemCount items, and returns the best time per item
+    template<typename Fn>
+    double MeasureNsPerItem(size_t itemCount, Fn&& fn)
+    {
+        double best = 0;
+        for (int i = 0; i < c_repetitions; i++)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            fn();
+            const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            const double perItem = elapsed / (itemCount ? itemCount : 1);
+            if (i == 0 || perItem < best)
+            {
+                best = perItem;
+            }
+        }
+        return best;
+    }
+
+    inline void Report(_In_ PCWSTR group, _In_ PCWSTR name, size_t itemCount, double nsPerItem)
+    {
+        wprintf(L"%s\t%s\t%zu\t%.1f\n", group, name, itemCount, nsPerItem);
+    }
+
+    // Counters of the C++ heap allocations of the process, kept by the operator new
+    // and operator delete of the benchmark.  Allocations of the shell and of COM, like
+    // CoTaskMemAlloc, aren't counted.
+    struct AllocationStats
+    {
+        size_t allocations = 0;
+        size_t allocatedBytes = 0;
+        size_t liveBytes = 0;
+        // Largest liveBytes since the last ResetPeakBytes call
+        size_t peakBytes = 0;
+    };
+
+    AllocationStats GetAllocationStats();
+    void ResetPeakBytes();
+
+    // Keeps the compiler from discarding a computed value
+    template<typename T>
+    void DoNotOptimize(const T& value)
+    {
+        static volatile const void* sink;
+        sink = &value;
+    }
+
+    // Deterministic file names resembling what users rename: camera and phone
+    // captures, documents, downloads and names with non-ASCII characters.
+    inline std::vector<std::wstring> GenerateFileNames(size_t count, unsigned int seed = 1)
+    {
+        static const PCWSTR prefixes[] = { L"IMG_", L"DSC", L"VID_", L"Screenshot ", L"Quarterly Report ", L"invoice-", L"R\u00e9sum\u00e9 ", L"\u00c9t\u00e9 \u00e0 Paris ", L"\u5199\u771f_", L"\u0424\u043e\u0442\u043e " };
+        static const PCWSTR extensions[] = { L".jpg", L".JPG", L".png", L".mp4", L".docx", L".pdf", L".txt", L".HEIC", L"" };
+
+        std::mt19937 random(seed);
+        std::vector<std::wstring> names;
+        names.reserve(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            std::wstring name = prefixes[random() % ARRAYSIZE(prefixes)];
+            name += std::to_wstring(20000000 + random() % 1000000);
+            if (random() % 3 == 0)
+            {
+                name += L" (copy ";
+                name += std::to_wstring(random() % 10);
+                name += L")";
+            }
+            name += extensions[random() % ARRAYSIZE(extensions)];
+            names.push_back(std::move(name));
+        }
+        return names;
+    }
+}
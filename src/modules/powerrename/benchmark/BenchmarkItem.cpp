@@ -0,0 +1,23 @@
+#include "pch.h"
+#include "BenchmarkItem.h"
+
+HRESULT CBenchmarkItem::s_CreateInstance(_In_ PCWSTR path, _In_ UINT depth, _In_ bool isFolder, _In_ const SYSTEMTIME& time, _Outptr_ IPowerRenameItem** ppItem)
+{
+    *ppItem = nullptr;
+    CBenchmarkItem* newItem = new CBenchmarkItem();
+    HRESULT hr = SHStrDup(path, &newItem->m_path);
+    if (SUCCEEDED(hr))
+    {
+        hr = SHStrDup(PathFindFileName(path), &newItem->m_originalName);
+    }
+    if (SUCCEEDED(hr))
+    {
+        newItem->m_depth = depth;
+        newItem->m_isFolder = isFolder;
+        newItem->m_time = time;
+        newItem->m_isTimeParsed = true;
+        hr = newItem->QueryInterface(IID_PPV_ARGS(ppItem));
+    }
+    newItem->Release();
+    return hr;
+}
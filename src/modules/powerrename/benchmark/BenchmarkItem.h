@@ -0,0 +1,11 @@
+#pragma once
+#include "pch.h"
+#include <PowerRenameItem.h>
+
+// Item of a synthetic corpus, with a path and no shell item behind it
+class CBenchmarkItem :
+    public CPowerRenameItem
+{
+public:
+    static HRESULT s_CreateInstance(_In_ PCWSTR path, _In_ UINT depth, _In_ bool isFolder, _In_ const SYSTEMTIME& time, _Outptr_ IPowerRenameItem** ppItem);
+};
@@ -0,0 +1,86 @@
+#include "pch.h"
+#include "Benchmark.h"
+#include <algorithm>
+#include <LiteralMatcher.h>
+
+namespace
+{
+    const size_t c_nameCount = 200000;
+
+    // The search done before CLiteralMatcher: copy and lowercase both strings per call
+    size_t FindByCopy(std::wstring data, std::wstring toSearch, bool caseInsensitive, size_t pos)
+    {
+        if (caseInsensitive)
+        {
+            std::transform(data.begin(), data.end(), data.begin(), ::towlower);
+            std::transform(toSearch.begin(), toSearch.end(), toSearch.begin(), ::towlower);
+        }
+        return data.find(toSearch, pos);
+    }
+
+    size_t CountByCopy(const std::vector<std::wstring>& names, const std::wstring& searchTerm, bool caseInsensitive)
+    {
+        size_t count = 0;
+        for (const auto& name : names)
+        {
+            size_t pos = FindByCopy(name, searchTerm, caseInsensitive, 0);
+            while (pos != std::wstring::npos)
+            {
+                count++;
+                pos = FindByCopy(name, searchTerm, caseInsensitive, pos + searchTerm.length());
+            }
+        }
+        return count;
+    }
+
+    size_t CountByMatcher(const std::vector<std::wstring>& names, const std::wstring& searchTerm, bool caseInsensitive)
+    {
+        const CLiteralMatcher matcher(searchTerm, caseInsensitive);
+        size_t count = 0;
+        for (const auto& name : names)
+        {
+            size_t pos = matcher.Find(name.c_str(), name.length(), 0);
+            while (pos != std::wstring::npos)
+            {
+                count++;
+                pos = matcher.Find(name.c_str(), name.length(), pos + searchTerm.length());
+            }
+        }
+        return count;
+    }
+}
+
+void RunLiteralMatcherBenchmarks()
+{
+    const std::vector<std::wstring> names = Benchmark::GenerateFileNames(c_nameCount);
+
+    struct
+    {
+        PCWSTR label;
+        PCWSTR searchTerm;
+        bool caseInsensitive;
+    } cases[] = {
+        { L"short-ci", L"img", true },
+        { L"short-cs", L"IMG", false },
+        { L"extension-ci", L".jpg", true },
+        { L"long-ci", L"quarterly report 2", true },
+        { L"single-ci", L"k", true },
+        { L"nonascii-ci", L"r\u00e9sum\u00e9", true },
+        { L"nomatch-ci", L"zzzzzz", true },
+    };
+
+    for (const auto& c : cases)
+    {
+        size_t byCopy = 0;
+        size_t byMatcher = 0;
+        const double copyNs = Benchmark::MeasureNsPerItem(names.size(), [&] { byCopy = CountByCopy(names, c.searchTerm, c.caseInsensitive); });
+        const double matcherNs = Benchmark::MeasureNsPerItem(names.size(), [&] { byMatcher = CountByMatcher(names, c.searchTerm, c.caseInsensitive); });
+        if (byCopy != byMatcher)
+        {
+            fwprintf(stderr, L"%s: %zu matches by copy, %zu by matcher\n", c.label, byCopy, byMatcher);
+        }
+
+        Benchmark::Report(L"literal", (std::wstring(c.label) + L"/copy").c_str(), names.size(), copyNs);
+        Benchmark::Report(L"literal", (std::wstring(c.label) + L"/matcher").c_str(), names.size(), matcherNs);
+    }
+}
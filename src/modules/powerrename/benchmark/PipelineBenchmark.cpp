@@ -0,0 +1,339 @@
+#include "pch.h"
+#include "Benchmark.h"
+#include "SyntheticCorpus.h"
+#include <psapi.h>
+#include <Helpers.h>
+#include <PowerRenameManager.h>
+#include <RenameJournal.h>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const wchar_t c_usage[] =
+        L"Usage: PowerRenameBenchmark.exe --pipeline [options]\n"
+        L"Generates a folder tree, then drives the rename manager through enumeration,\n"
+        L"regex preview, enumeration numbering and plan building.  Writes one JSON line\n"
+        L"per stage: items/s, allocations and peak memory.\n"
+        L"\n"
+        L"Options:\n"
+        L"  --depth <n>           Levels of folders below the root\n"
+        L"  --fan-out <n>         Folders in each folder\n"
+        L"  --files <n>           Files in each folder\n"
+        L"  --name-length <min>-<max>\n"
+        L"  --unicode <percent>   Characters of the names outside of ASCII\n"
+        L"  --extensions <mix>    Extensions and weights, like jpg:30,txt:20,:10\n"
+        L"  --seed <n>\n"
+        L"  --search <term>       Regex searched in the names without extension, defaults\n"
+        L"                        to the whole name\n"
+        L"  --replace <term>\n"
+        L"  --root <folder>       Folder to create the tree in, defaults to the temp folder\n"
+        L"  --keep                Don't delete the tree afterwards\n";
+
+    struct PipelineOptions
+    {
+        SyntheticCorpusOptions corpus;
+        std::wstring searchTerm = L"^(.+)$";
+        std::wstring replaceTerm = L"$1 renamed";
+        std::wstring root;
+        bool keep = false;
+    };
+
+    bool ParseOptions(int argc, wchar_t* argv[], _Out_ PipelineOptions& options)
+    {
+        options = {};
+        for (int i = 1; i < argc; i++)
+        {
+            const std::wstring arg = argv[i];
+            if (arg == L"--keep")
+            {
+                options.keep = true;
+                continue;
+            }
+            if (i + 1 >= argc)
+            {
+                return false;
+            }
+
+            if (arg == L"--depth")
+            {
+                options.corpus.depth = wcstoul(argv[++i], nullptr, 10);
+            }
+            else if (arg == L"--fan-out")
+            {
+                options.corpus.fanOut = wcstoul(argv[++i], nullptr, 10);
+            }
+            else if (arg == L"--files")
+            {
+                options.corpus.filesPerFolder = wcstoul(argv[++i], nullptr, 10);
+            }
+            else if (arg == L"--name-length")
+            {
+                wchar_t* end = nullptr;
+                options.corpus.minNameLength = wcstoul(argv[++i], &end, 10);
+                options.corpus.maxNameLength = (*end == L'-') ? wcstoul(end + 1, nullptr, 10) : options.corpus.minNameLength;
+            }
+            else if (arg == L"--unicode")
+            {
+                options.corpus.unicodePercent = wcstoul(argv[++i], nullptr, 10);
+            }
+            else if (arg == L"--extensions")
+            {
+                if (!ParseExtensionMix(argv[++i], options.corpus))
+                {
+                    return false;
+                }
+            }
+            else if (arg == L"--seed")
+            {
+                options.corpus.seed = wcstoul(argv[++i], nullptr, 10);
+            }
+            else if (arg == L"--search")
+            {
+                options.searchTerm = argv[++i];
+            }
+            else if (arg == L"--replace")
+            {
+                options.replaceTerm = argv[++i];
+            }
+            else if (arg == L"--root")
+            {
+                options.root = argv[++i];
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Counts the regex passes of the manager that ended
+    class CPipelineEvents :
+        public IPowerRenameManagerEvents
+    {
+    public:
+        // IUnknown
+        IFACEMETHODIMP QueryInterface(_In_ REFIID riid, _Outptr_ void** ppv)
+        {
+            static const QITAB qit[] = {
+                QITABENT(CPipelineEvents, IPowerRenameManagerEvents),
+                { 0 }
+            };
+            return QISearch(this, qit, riid, ppv);
+        }
+
+        IFACEMETHODIMP_(ULONG) AddRef() { return InterlockedIncrement(&m_refCount); }
+
+        IFACEMETHODIMP_(ULONG) Release()
+        {
+            long refCount = InterlockedDecrement(&m_refCount);
+            if (refCount == 0)
+            {
+                delete this;
+            }
+            return refCount;
+        }
+
+        // IPowerRenameManagerEvents
+        IFACEMETHODIMP OnItemAdded(_In_ IPowerRenameItem*) { return S_OK; }
+        IFACEMETHODIMP OnItemsUpdated(_In_ UINT, _In_ UINT) { return S_OK; }
+        IFACEMETHODIMP OnError(_In_ IPowerRenameItem*) { return S_OK; }
+        IFACEMETHODIMP OnRegExStarted(_In_ DWORD) { return S_OK; }
+        IFACEMETHODIMP OnRegExCanceled(_In_ DWORD)
+        {
+            m_regExPassesEnded++;
+            return S_OK;
+        }
+        IFACEMETHODIMP OnRegExCompleted(_In_ DWORD)
+        {
+            m_regExPassesEnded++;
+            return S_OK;
+        }
+        IFACEMETHODIMP OnRenameStarted() { return S_OK; }
+        IFACEMETHODIMP OnRenameCompleted() { return S_OK; }
+
+        UINT GetRegExPassesEnded() const { return m_regExPassesEnded; }
+
+    private:
+        long m_refCount = 1;
+        UINT m_regExPassesEnded = 0;
+    };
+
+    // Dispatches the messages the regex worker posts to the manager until the pass
+    // started after passesEnded were counted ends
+    void WaitForRegExPass(_In_ const CPipelineEvents& events, UINT passesEnded)
+    {
+        while (events.GetRegExPassesEnded() == passesEnded)
+        {
+            MsgWaitForMultipleObjects(0, nullptr, FALSE, INFINITE, QS_ALLINPUT);
+            MSG msg;
+            while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
+            {
+                TranslateMessage(&msg);
+                DispatchMessage(&msg);
+            }
+        }
+    }
+
+    // Measures one stage and writes its JSON line
+    class CStage
+    {
+    public:
+        CStage(_In_ PCWSTR name) :
+            m_name(name)
+        {
+            Benchmark::ResetPeakBytes();
+            m_allocationsBefore = Benchmark::GetAllocationStats();
+            m_start = std::chrono::steady_clock::now();
+        }
+
+        void Report(size_t itemCount)
+        {
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+            const Benchmark::AllocationStats allocations = Benchmark::GetAllocationStats();
+            PROCESS_MEMORY_COUNTERS memory = { sizeof(memory) };
+            GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory));
+
+            wprintf(L"{\"stage\":\"%s\",\"items\":%zu,\"seconds\":%.6f,\"itemsPerSecond\":%.0f,"
+                    L"\"allocations\":%zu,\"allocatedBytes\":%zu,\"peakHeapBytes\":%zu,\"retainedHeapBytes\":%lld,\"peakWorkingSetBytes\":%zu}\n",
+                    m_name,
+                    itemCount,
+                    seconds,
+                    seconds > 0 ? itemCount / seconds : 0,
+                    allocations.allocations - m_allocationsBefore.allocations,
+                    allocations.allocatedBytes - m_allocationsBefore.allocatedBytes,
+                    allocations.peakBytes - m_allocationsBefore.liveBytes,
+                    static_cast<long long>(allocations.liveBytes) - static_cast<long long>(m_allocationsBefore.liveBytes),
+                    static_cast<size_t>(memory.PeakWorkingSetSize));
+            fflush(stdout);
+        }
+
+    private:
+        PCWSTR m_name;
+        Benchmark::AllocationStats m_allocationsBefore;
+        std::chrono::steady_clock::time_point m_start;
+    };
+
+    HRESULT RunPipeline(_In_ const PipelineOptions& options, _In_ const fs::path& root)
+    {
+        UINT corpusItemCount = 0;
+        HRESULT hr = S_OK;
+        {
+            CStage stage(L"corpus");
+            hr = CreateSyntheticCorpus(options.corpus, root, &corpusItemCount);
+            stage.Report(corpusItemCount);
+        }
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        CComPtr<IPowerRenameManager> manager;
+        hr = CPowerRenameManager::s_CreateInstance(&manager);
+        CComPtr<IPowerRenameRegEx> renameRegEx;
+        if (SUCCEEDED(hr))
+        {
+            hr = manager->GetRenameRegEx(&renameRegEx);
+        }
+        CComPtr<IShellItem> rootItem;
+        CComPtr<IShellItemArray> selection;
+        if (SUCCEEDED(hr))
+        {
+            hr = SHCreateItemFromParsingName(root.c_str(), nullptr, IID_PPV_ARGS(&rootItem));
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = SHCreateShellItemArrayFromShellItem(rootItem, IID_PPV_ARGS(&selection));
+        }
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        CPipelineEvents* events = new CPipelineEvents();
+        DWORD cookie = 0;
+        manager->Advise(events, &cookie);
+
+        UINT itemCount = 0;
+        {
+            // The root folder is selected, like renaming a folder with its content
+            CStage stage(L"enumerate");
+            hr = EnumerateDataObject(selection, manager);
+            manager->GetItemCount(&itemCount);
+            stage.Report(itemCount);
+        }
+
+        const DWORD flags = UseRegularExpressions | NameOnly;
+        if (SUCCEEDED(hr))
+        {
+            // Passes without a search term, not measured
+            UINT passesEnded = events->GetRegExPassesEnded();
+            renameRegEx->PutFlags(flags);
+            WaitForRegExPass(*events, passesEnded);
+            passesEnded = events->GetRegExPassesEnded();
+            renameRegEx->PutReplaceTerm(options.replaceTerm.c_str());
+            WaitForRegExPass(*events, passesEnded);
+
+            CStage stage(L"preview");
+            passesEnded = events->GetRegExPassesEnded();
+            renameRegEx->PutSearchTerm(options.searchTerm.c_str());
+            WaitForRegExPass(*events, passesEnded);
+            stage.Report(itemCount);
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            CStage stage(L"numbering");
+            const UINT passesEnded = events->GetRegExPassesEnded();
+            renameRegEx->PutFlags(flags | EnumerateItems);
+            WaitForRegExPass(*events, passesEnded);
+            stage.Report(itemCount);
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            CStage stage(L"plan");
+            std::vector<RenamePlanItem> plan;
+            hr = static_cast<CPowerRenameManager*>(manager.p)->GetRenamePlan(plan);
+            stage.Report(plan.size());
+        }
+
+        manager->UnAdvise(cookie);
+        manager->Shutdown();
+        events->Release();
+        return hr;
+    }
+}
+
+int RunPipelineBenchmark(int argc, wchar_t* argv[])
+{
+    PipelineOptions options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        fwprintf(stderr, L"%s", c_usage);
+        return 1;
+    }
+
+    if (FAILED(CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE)))
+    {
+        return 1;
+    }
+
+    const fs::path parent = options.root.empty() ? fs::temp_directory_path() : fs::path(options.root);
+    const fs::path root = parent / (L"PowerRenameBenchmark-" + std::to_wstring(GetCurrentProcessId()));
+    HRESULT hr = RunPipeline(options, root);
+    if (FAILED(hr))
+    {
+        fwprintf(stderr, L"Pipeline failed: 0x%08lx\n", static_cast<unsigned long>(hr));
+    }
+
+    if (!options.keep)
+    {
+        std::error_code error;
+        fs::remove_all(root, error);
+    }
+
+    CoUninitialize();
+    return SUCCEEDED(hr) ? 0 : 1;
+}
@@ -0,0 +1,56 @@
+#include "pch.h"
+
+void RunLiteralMatcherBenchmarks();
+void RunVisibleItemIndexBenchmarks();
+void RunRegExBenchmarks();
+void RunRenamePlanBenchmarks();
+int RunPipelineBenchmark(int argc, wchar_t* argv[]);
+
+EXTERN_C IMAGE_DOS_HEADER __ImageBase;
+
+// Used by the rename manager for its message window
+HINSTANCE g_hInst = reinterpret_cast<HINSTANCE>(&__ImageBase);
+
+namespace
+{
+    struct BenchmarkGroup
+    {
+        PCWSTR name;
+        void (*run)();
+    };
+
+    const BenchmarkGroup c_benchmarkGroups[] = {
+        { L"literal", RunLiteralMatcherBenchmarks },
+        { L"visible", RunVisibleItemIndexBenchmarks },
+        { L"regex", RunRegExBenchmarks },
+        { L"plan", RunRenamePlanBenchmarks },
+    };
+}
+
+// Usage: PowerRenameBenchmark.exe [group...]
+// Runs the given benchmark groups, or all of them when none is given.
+// Usage: PowerRenameBenchmark.exe --pipeline [options]
+// Runs the manager end to end on a generated folder tree, see PipelineBenchmark.cpp.
+int wmain(int argc, wchar_t* argv[])
+{
+    if (argc > 1 && _wcsicmp(argv[1], L"--pipeline") == 0)
+    {
+        return RunPipelineBenchmark(argc - 1, argv + 1);
+    }
+
+    wprintf(L"group\tname\titems\tns/item\n");
+    for (const auto& group : c_benchmarkGroups)
+    {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc && !selected; i++)
+        {
+            selected = _wcsicmp(argv[i], group.name) == 0;
+        }
+
+        if (selected)
+        {
+            group.run();
+        }
+    }
+    return 0;
+}
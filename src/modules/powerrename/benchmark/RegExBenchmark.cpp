@@ -0,0 +1,150 @@
+#include "pch.h"
+#include "Benchmark.h"
+#include <regex>
+#include <boost/regex.hpp>
+#include <LinearRegEx.h>
+
+namespace
+{
+    const size_t c_nameCount = 100000;
+
+    struct RegExCase
+    {
+        PCWSTR label;
+        PCWSTR search;
+        PCWSTR replace;
+        bool allOccurrences;
+    };
+
+    // Search terms of PowerRenameRegExBoostTests the linear engine supports, and a few
+    // rename patterns for the generated names
+    const RegExCase c_cases[] = {
+        { L"literal", L"Foo", L"boo", false },
+        { L"single-all", L"B", L"BBB", true },
+        { L"dotstar-all", L".*", L"Foo", true },
+        { L"dotplus-all", L".+", L"Foo", true },
+        { L"groups", L"(foo)(bar)", L"$2_$1", false },
+        { L"digits", L"\\d+", L"#", true },
+        { L"camera", L"^(IMG|DSC|VID)_?(\\d+)", L"Photo $2", false },
+        { L"extension", L"\\.(jpe?g|png|heic)$", L".$1", false },
+        { L"copy-suffix", L" \\(copy (\\d)\\)", L"_$1", false },
+        { L"nomatch", L"zz+y", L"x", true },
+    };
+
+    struct Engines
+    {
+        std::wregex stdPattern;
+        boost::wregex boostPattern;
+        CLinearRegEx linearPattern;
+        CLinearRegEx::Replacement linearReplacement;
+    };
+
+    bool Prepare(_In_ const RegExCase& c, _Out_ Engines& engines)
+    {
+        engines.stdPattern = std::wregex(c.search, std::regex_constants::icase | std::regex_constants::ECMAScript);
+        engines.boostPattern = boost::wregex(c.search, boost::regex::icase | boost::regex::ECMAScript);
+        return engines.linearPattern.Compile(c.search, true) &&
+               engines.linearPattern.PrepareReplacement(c.replace, engines.linearReplacement);
+    }
+
+    void MeasureCase(_In_ const RegExCase& c, _In_ const std::vector<std::wstring>& names)
+    {
+        Engines engines;
+        if (!Prepare(c, engines))
+        {
+            fwprintf(stderr, L"%s: not supported by the linear engine\n", c.label);
+            return;
+        }
+
+        const auto stdFlags = c.allOccurrences ? std::regex_constants::format_default : std::regex_constants::format_first_only;
+        const auto boostFlags = c.allOccurrences ? boost::regex_constants::format_default : boost::regex_constants::format_first_only;
+        size_t mismatches = 0;
+        for (const auto& name : names)
+        {
+            if (std::regex_replace(name, engines.stdPattern, c.replace, stdFlags) != engines.linearPattern.Replace(name, engines.linearReplacement, c.allOccurrences))
+            {
+                mismatches++;
+            }
+        }
+        if (mismatches)
+        {
+            fwprintf(stderr, L"%s: %zu results differ from std\n", c.label, mismatches);
+        }
+
+        const double stdNs = Benchmark::MeasureNsPerItem(names.size(), [&] {
+            for (const auto& name : names)
+            {
+                Benchmark::DoNotOptimize(std::regex_replace(name, engines.stdPattern, c.replace, stdFlags));
+            }
+        });
+        const double boostNs = Benchmark::MeasureNsPerItem(names.size(), [&] {
+            for (const auto& name : names)
+            {
+                Benchmark::DoNotOptimize(boost::regex_replace(name, engines.boostPattern, c.replace, boostFlags));
+            }
+        });
+        const double linearNs = Benchmark::MeasureNsPerItem(names.size(), [&] {
+            for (const auto& name : names)
+            {
+                Benchmark::DoNotOptimize(engines.linearPattern.Replace(name, engines.linearReplacement, c.allOccurrences));
+            }
+        });
+
+        Benchmark::Report(L"regex", (std::wstring(c.label) + L"/std").c_str(), names.size(), stdNs);
+        Benchmark::Report(L"regex", (std::wstring(c.label) + L"/boost").c_str(), names.size(), boostNs);
+        Benchmark::Report(L"regex", (std::wstring(c.label) + L"/linear").c_str(), names.size(), linearNs);
+    }
+
+    // (a+)+b on a run of a: backtracking doubles its work with each character
+    void MeasurePathological()
+    {
+        const RegExCase c = { L"nested", L"(a+)+b", L"x", false };
+        Engines engines;
+        if (!Prepare(c, engines))
+        {
+            return;
+        }
+
+        for (size_t length : { 16, 20, 24 })
+        {
+            const std::wstring name(length, L'a');
+            const std::wstring label = std::wstring(c.label) + L"-" + std::to_wstring(length);
+            const double stdNs = Benchmark::MeasureNsPerItem(1, [&] {
+                try
+                {
+                    Benchmark::DoNotOptimize(std::regex_replace(name, engines.stdPattern, c.replace));
+                }
+                catch (std::regex_error)
+                {
+                }
+            });
+            // Boost gives up with an error once its complexity limit is reached
+            const double boostNs = Benchmark::MeasureNsPerItem(1, [&] {
+                try
+                {
+                    Benchmark::DoNotOptimize(boost::regex_replace(name, engines.boostPattern, c.replace));
+                }
+                catch (std::runtime_error)
+                {
+                }
+            });
+            const double linearNs = Benchmark::MeasureNsPerItem(1, [&] {
+                Benchmark::DoNotOptimize(engines.linearPattern.Replace(name, engines.linearReplacement, false));
+            });
+
+            Benchmark::Report(L"regex", (label + L"/std").c_str(), 1, stdNs);
+            Benchmark::Report(L"regex", (label + L"/boost").c_str(), 1, boostNs);
+            Benchmark::Report(L"regex", (label + L"/linear").c_str(), 1, linearNs);
+        }
+    }
+}
+
+void RunRegExBenchmarks()
+{
+    const std::vector<std::wstring> names = Benchmark::GenerateFileNames(c_nameCount);
+    for (const auto& c : c_cases)
+    {
+        MeasureCase(c, names);
+    }
+    MeasurePathological();
+}
@@ -0,0 +1,122 @@
+#include "pch.h"
+#include "Benchmark.h"
+#include "BenchmarkItem.h"
+#include <filesystem>
+#include <PowerRenameItemStore.h>
+#include <RenameJournal.h>
+#include <srwlock.h>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const UINT c_itemCount = 1000000;
+    // Folders nest up to this depth below the selected folder
+    const UINT c_maxDepth = 8;
+
+    // Items spread over folders of every depth, the new names of renamedPercent of them
+    // set like a regex pass would
+    void CreateCorpus(_Inout_ CPowerRenameItemStore& store, UINT renamedPercent)
+    {
+        const std::vector<std::wstring> names = Benchmark::GenerateFileNames(c_itemCount);
+        std::mt19937 random(1);
+        CNamePool& pool = store.AddNewNamePool();
+        SYSTEMTIME time = { 0 };
+        for (UINT i = 0; i < c_itemCount; i++)
+        {
+            const UINT depth = random() % (c_maxDepth + 1);
+            std::wstring path = L"c:\\corpus";
+            for (UINT d = 0; d < depth; d++)
+            {
+                path += L"\\folder" + std::to_wstring(random() % 4);
+            }
+            path += L"\\" + names[i];
+
+            CComPtr<IPowerRenameItem> item;
+            UINT index = 0;
+            if (SUCCEEDED(CBenchmarkItem::s_CreateInstance(path.c_str(), depth, false, time, &item)) &&
+                SUCCEEDED(store.Add(item, &index)) &&
+                random() % 100 < renamedPercent)
+            {
+                const std::wstring newName = L"renamed " + names[i];
+                item->PutNewName(newName.c_str());
+                store.PutNewName(index, newName.c_str(), pool);
+            }
+        }
+    }
+
+    // What the file operation worker did before GetRenamePlan: one bucket per item, and
+    // every item looked up through the manager, under its items lock, once to read its
+    // depth and once more to read its names
+    void GetMatrixPlan(_In_ CSRWLock& lock, _In_ const CPowerRenameItemStore& store, DWORD flags, _Inout_ std::vector<RenamePlanItem>& plan)
+    {
+        auto getItemByIndex = [&](UINT index) {
+            CSRWSharedAutoLock autoLock(&lock);
+            return CComPtr<IPowerRenameItem>(store.GetItem(index));
+        };
+
+        const UINT itemCount = store.Count();
+        std::vector<std::vector<UINT>> matrix(itemCount);
+        for (UINT u = 0; u < itemCount; u++)
+        {
+            UINT depth = 0;
+            getItemByIndex(u)->GetDepth(&depth);
+            matrix[depth].push_back(u);
+        }
+
+        for (LONG v = itemCount - 1; v >= 0; v--)
+        {
+            for (auto it : matrix[v])
+            {
+                CComPtr<IPowerRenameItem> spItem = getItemByIndex(it);
+                bool shouldRename = false;
+                if (SUCCEEDED(spItem->ShouldRenameItem(flags, &shouldRename)) && shouldRename)
+                {
+                    PWSTR newName = nullptr;
+                    PWSTR path = nullptr;
+                    if (SUCCEEDED(spItem->GetNewName(&newName)) && SUCCEEDED(spItem->GetPath(&path)))
+                    {
+                        RenamePlanItem item;
+                        item.depth = v;
+                        item.parentPath = fs::path(path).parent_path().wstring();
+                        item.originalName = fs::path(path).filename().wstring();
+                        item.newName = newName;
+                        plan.push_back(std::move(item));
+                    }
+                    CoTaskMemFree(newName);
+                    CoTaskMemFree(path);
+                }
+            }
+        }
+    }
+}
+
+void RunRenamePlanBenchmarks()
+{
+    const UINT renamedPercents[] = { 100, 10 };
+    for (UINT renamedPercent : renamedPercents)
+    {
+        CPowerRenameItemStore store;
+        CreateCorpus(store, renamedPercent);
+        CSRWLock lock;
+
+        size_t planSize = 0;
+        const double matrixNs = Benchmark::MeasureNsPerItem(c_itemCount, [&] {
+            std::vector<RenamePlanItem> plan;
+            GetMatrixPlan(lock, store, 0, plan);
+            planSize = plan.size();
+        });
+        Benchmark::DoNotOptimize(planSize);
+
+        const double countingNs = Benchmark::MeasureNsPerItem(c_itemCount, [&] {
+            std::vector<RenamePlanItem> plan;
+            store.GetRenamePlan(0, plan);
+            planSize = plan.size();
+        });
+        Benchmark::DoNotOptimize(planSize);
+
+        const std::wstring label = std::to_wstring(renamedPercent) + L"%";
+        Benchmark::Report(L"plan", (label + L"/matrix").c_str(), c_itemCount, matrixNs);
+        Benchmark::Report(L"plan", (label + L"/counting-sort").c_str(), c_itemCount, countingNs);
+    }
+}
@@ -0,0 +1,163 @@
+#include "pch.h"
+#include "SyntheticCorpus.h"
+#include <random>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const wchar_t c_asciiCharacters[] = L"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 _-";
+    // Letters and digits, at the start of c_asciiCharacters
+    const size_t c_alphanumericCount = 62;
+
+    // Ranges of the characters outside of ASCII, all valid in file names
+    const struct
+    {
+        wchar_t first;
+        wchar_t last;
+    } c_unicodeRanges[] = {
+        { 0x00E0, 0x00F6 }, // Accented Latin
+        { 0x0410, 0x044F }, // Cyrillic
+        { 0x4E00, 0x4FFF }, // CJK ideographs
+    };
+
+    class CNameGenerator
+    {
+    public:
+        CNameGenerator(_In_ const SyntheticCorpusOptions& options) :
+            m_options(options), m_random(options.seed)
+        {
+            for (const auto& extension : options.extensions)
+            {
+                m_extensionWeight += extension.second;
+            }
+        }
+
+        std::wstring GetName(bool withExtension)
+        {
+            const UINT minLength = max(m_options.minNameLength, 1u);
+            const UINT length = minLength + m_random() % (max(m_options.maxNameLength, minLength) - minLength + 1);
+            std::wstring name;
+            name.reserve(length + 8);
+            for (UINT i = 0; i < length; i++)
+            {
+                if (m_random() % 100 < m_options.unicodePercent)
+                {
+                    const auto& range = c_unicodeRanges[m_random() % ARRAYSIZE(c_unicodeRanges)];
+                    name += static_cast<wchar_t>(range.first + m_random() % (range.last - range.first + 1));
+                }
+                else
+                {
+                    // Names can't end with a space
+                    const size_t count = (i + 1 == length) ? c_alphanumericCount : ARRAYSIZE(c_asciiCharacters) - 1;
+                    name += c_asciiCharacters[m_random() % count];
+                }
+            }
+
+            if (withExtension && m_extensionWeight > 0)
+            {
+                UINT pick = m_random() % m_extensionWeight;
+                for (const auto& extension : m_options.extensions)
+                {
+                    if (pick < extension.second)
+                    {
+                        name += extension.first;
+                        break;
+                    }
+                    pick -= extension.second;
+                }
+            }
+            return name;
+        }
+
+    private:
+        const SyntheticCorpusOptions& m_options;
+        std::mt19937 m_random;
+        UINT m_extensionWeight = 0;
+    };
+
+    HRESULT CreateFolderContent(_In_ const SyntheticCorpusOptions& options, _Inout_ CNameGenerator& names, _In_ const fs::path& folder, UINT depth, _Inout_ UINT* itemCount)
+    {
+        for (UINT i = 0; i < options.filesPerFolder; i++)
+        {
+            // Two random names may be the same, the second one is skipped
+            const fs::path path = folder / names.GetName(true);
+            HANDLE file = CreateFile(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(file);
+                (*itemCount)++;
+            }
+            else if (GetLastError() != ERROR_FILE_EXISTS)
+            {
+                return HRESULT_FROM_WIN32(GetLastError());
+            }
+        }
+
+        if (depth < options.depth)
+        {
+            for (UINT i = 0; i < options.fanOut; i++)
+            {
+                const fs::path path = folder / names.GetName(false);
+                if (!CreateDirectory(path.c_str(), nullptr))
+                {
+                    if (GetLastError() == ERROR_ALREADY_EXISTS)
+                    {
+                        continue;
+                    }
+                    return HRESULT_FROM_WIN32(GetLastError());
+                }
+
+                (*itemCount)++;
+                HRESULT hr = CreateFolderContent(options, names, path, depth + 1, itemCount);
+                if (FAILED(hr))
+                {
+                    return hr;
+                }
+            }
+        }
+        return S_OK;
+    }
+}
+
+bool ParseExtensionMix(_In_ const std::wstring& mix, _Inout_ SyntheticCorpusOptions& options)
+{
+    options.extensions.clear();
+    size_t start = 0;
+    while (start <= mix.length())
+    {
+        size_t end = mix.find(L',', start);
+        if (end == std::wstring::npos)
+        {
+            end = mix.length();
+        }
+
+        const std::wstring entry = mix.substr(start, end - start);
+        const size_t colon = entry.find(L':');
+        if (colon == std::wstring::npos)
+        {
+            return false;
+        }
+
+        std::wstring extension = entry.substr(0, colon);
+        if (!extension.empty() && extension[0] != L'.')
+        {
+            extension.insert(0, 1, L'.');
+        }
+        options.extensions.push_back({ extension, wcstoul(entry.c_str() + colon + 1, nullptr, 10) });
+        start = end + 1;
+    }
+    return !options.extensions.empty();
+}
+
+HRESULT CreateSyntheticCorpus(_In_ const SyntheticCorpusOptions& options, _In_ const fs::path& root, _Out_ UINT* itemCount)
+{
+    *itemCount = 0;
+    if (!CreateDirectory(root.c_str(), nullptr))
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    CNameGenerator names(options);
+    return CreateFolderContent(options, names, root, 0, itemCount);
+}
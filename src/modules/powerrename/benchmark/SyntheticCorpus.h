@@ -0,0 +1,42 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Shape of a folder tree generated for the benchmarks
+struct SyntheticCorpusOptions
+{
+    // Levels of folders below the root
+    UINT depth = 3;
+    // Folders in each folder above the deepest level
+    UINT fanOut = 4;
+    // Files in each folder, the root included
+    UINT filesPerFolder = 200;
+    // Length of the names without their extension, uniformly distributed
+    UINT minNameLength = 4;
+    UINT maxNameLength = 32;
+    // Percentage of the characters of the names outside of ASCII: accented Latin,
+    // Cyrillic and CJK
+    UINT unicodePercent = 10;
+    // Extensions of the files and their weights.  An empty extension gives names
+    // without one.
+    std::vector<std::pair<std::wstring, UINT>> extensions = {
+        { L".jpg", 30 },
+        { L".png", 10 },
+        { L".mp4", 5 },
+        { L".docx", 10 },
+        { L".pdf", 10 },
+        { L".txt", 20 },
+        { L".tar.gz", 5 },
+        { L"", 10 },
+    };
+    unsigned int seed = 1;
+};
+
+// Parses an extension mix like "jpg:30,txt:20,:10" into options.extensions
+bool ParseExtensionMix(_In_ const std::wstring& mix, _Inout_ SyntheticCorpusOptions& options);
+
+// Creates the folders and the empty files of the corpus in root, which must not
+// exist.  itemCount receives the number of files and folders created below root.
+HRESULT CreateSyntheticCorpus(_In_ const SyntheticCorpusOptions& options, _In_ const std::filesystem::path& root, _Out_ UINT* itemCount);
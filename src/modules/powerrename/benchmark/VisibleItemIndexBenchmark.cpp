@@ -0,0 +1,106 @@
+#include "pch.h"
+#include "Benchmark.h"
+#include <VisibleItemIndex.h>
+
+namespace
+{
+    const UINT c_itemCount = 1000000;
+    // Rows of the list view painted for each page when scrolling
+    const UINT c_rowsPerPage = 40;
+    // The linear scan is O(n) per row, it only paints this many pages spread over the list
+    const UINT c_scanPageCount = 10;
+
+    // What the manager did before CVisibleItemIndex for each painted row: count the
+    // visible items, then walk the bitmap up to the row
+    UINT ScanRow(const std::vector<bool>& isVisible, UINT row)
+    {
+        UINT count = 0;
+        for (size_t i = 0; i < isVisible.size(); i++)
+        {
+            if (isVisible[i])
+            {
+                count++;
+            }
+        }
+
+        UINT visibleIndex = 0;
+        for (size_t i = 0; i < isVisible.size() && row < count; i++)
+        {
+            if (isVisible[i])
+            {
+                if (visibleIndex == row)
+                {
+                    return static_cast<UINT>(i);
+                }
+                visibleIndex++;
+            }
+        }
+        return 0;
+    }
+}
+
+void RunVisibleItemIndexBenchmarks()
+{
+    struct
+    {
+        PCWSTR label;
+        UINT visiblePercent;
+    } cases[] = {
+        { L"all", 100 },
+        { L"half", 50 },
+        { L"tenth", 10 },
+        { L"sparse", 1 },
+    };
+
+    for (const auto& c : cases)
+    {
+        std::mt19937 random(1);
+        std::vector<bool> isVisible(c_itemCount);
+        CVisibleItemIndex index;
+        for (UINT i = 0; i < c_itemCount; i++)
+        {
+            isVisible[i] = random() % 100 < c.visiblePercent;
+            index.Insert(i, isVisible[i]);
+        }
+        const UINT visibleCount = index.Count();
+
+        // Scroll from the top to the bottom of the list, painting every row
+        UINT checksum = 0;
+        const double selectNs = Benchmark::MeasureNsPerItem(visibleCount, [&] {
+            for (UINT row = 0; row < visibleCount; row++)
+            {
+                if (row < index.Count())
+                {
+                    checksum += index.Select(row);
+                }
+            }
+        });
+        Benchmark::DoNotOptimize(checksum);
+
+        const double scanNs = Benchmark::MeasureNsPerItem(static_cast<size_t>(c_scanPageCount) * c_rowsPerPage, [&] {
+            for (UINT page = 0; page < c_scanPageCount; page++)
+            {
+                const UINT firstRow = static_cast<UINT>(static_cast<ULONGLONG>(visibleCount) * page / c_scanPageCount);
+                for (UINT row = firstRow; row < firstRow + c_rowsPerPage; row++)
+                {
+                    checksum += ScanRow(isVisible, row);
+                }
+            }
+        });
+        Benchmark::DoNotOptimize(checksum);
+
+        // SetVisible evaluating every item again when a few of them changed
+        const double updateNs = Benchmark::MeasureNsPerItem(c_itemCount, [&] {
+            for (UINT i = 0; i < c_itemCount; i++)
+            {
+                index.Set(i, i % 100000 == 0 ? !isVisible[i] : isVisible[i]);
+            }
+            index.Update();
+        });
+
+        const std::wstring label = c.label;
+        Benchmark::Report(L"visible", (label + L"/scroll-scan").c_str(), static_cast<size_t>(c_scanPageCount) * c_rowsPerPage, scanNs);
+        Benchmark::Report(L"visible", (label + L"/scroll-select").c_str(), visibleCount, selectNs);
+        Benchmark::Report(L"visible", (label + L"/set-visible").c_str(), c_itemCount, updateNs);
+    }
+}
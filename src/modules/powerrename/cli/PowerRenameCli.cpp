@@ -0,0 +1,462 @@
+#include "pch.h"
+#include <fcntl.h>
+#include <io.h>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <PowerRenameEngine.h>
+#include <PowerRenameRegEx.h>
+#include <Settings.h>
+#include <RenameJournal.h>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const wchar_t c_usage[] =
+        L"Usage: PowerRenameCli.exe --search <term> [--replace <term>] [options]\n"
+        L"       PowerRenameCli.exe --resume <journal> | --rollback <journal> [--batch <n>]\n"
+        L"Reads one path per line, UTF-8, from stdin or --input and writes the planned\n"
+        L"renames as JSON lines: {\"path\":...,\"newName\":...}\n"
+        L"\n"
+        L"Options:\n"
+        L"  --input <file>        Read the paths from file instead of stdin\n"
+        L"  --root <folder>       Paths not directly in folder are subfolder content\n"
+        L"  --regex               Use regular expressions\n"
+        L"  --boost               Use the Boost regex library\n"
+        L"  --backtracking        Don't use the linear time regex engine\n"
+        L"  --case-sensitive      Match case\n"
+        L"  --match-all           Match all occurrences\n"
+        L"  --name-only           Only rename the file name\n"
+        L"  --extension-only      Only rename the extension\n"
+        L"  --exclude-files       Don't rename files\n"
+        L"  --exclude-folders     Don't rename folders\n"
+        L"  --exclude-subfolders  Don't rename subfolder content\n"
+        L"  --enumerate           Enumerate items\n"
+        L"  --uppercase, --lowercase, --titlecase\n"
+        L"  --no-stat             Don't read the paths from disk, every path is a file\n"
+        L"  --all                 Also write the paths keeping their name, with a null newName\n"
+        L"  --journal <file>      Rename the items on disk, journaling the plan to file\n"
+        L"  --resume <file>       Finish the renames of an interrupted journal\n"
+        L"  --rollback <file>     Give the items renamed by a journal their original name\n"
+        L"  --batch <n>           Renames per journal batch\n";
+
+    struct Options
+    {
+        std::wstring searchTerm;
+        std::wstring replaceTerm;
+        std::wstring input;
+        std::wstring root;
+        DWORD flags = 0;
+        bool useBoostLib = false;
+        bool useLinearRegEx = true;
+        bool stat = true;
+        bool all = false;
+        std::wstring journal;
+        std::wstring resume;
+        std::wstring rollback;
+        size_t batchSize = CRenameJournal::c_defaultBatchSize;
+    };
+
+    bool ParseOptions(int argc, wchar_t* argv[], _Out_ Options& options)
+    {
+        static const struct
+        {
+            PCWSTR name;
+            DWORD flag;
+        } c_flagOptions[] = {
+            { L"--regex", UseRegularExpressions },
+            { L"--case-sensitive", CaseSensitive },
+            { L"--match-all", MatchAllOccurences },
+            { L"--name-only", NameOnly },
+            { L"--extension-only", ExtensionOnly },
+            { L"--exclude-files", ExcludeFiles },
+            { L"--exclude-folders", ExcludeFolders },
+            { L"--exclude-subfolders", ExcludeSubfolders },
+            { L"--enumerate", EnumerateItems },
+            { L"--uppercase", Uppercase },
+            { L"--lowercase", Lowercase },
+            { L"--titlecase", Titlecase },
+        };
+
+        options = {};
+        bool hasSearchTerm = false;
+        for (int i = 1; i < argc; i++)
+        {
+            const std::wstring arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+            if (arg == L"--search" && hasValue)
+            {
+                options.searchTerm = argv[++i];
+                hasSearchTerm = true;
+            }
+            else if (arg == L"--replace" && hasValue)
+            {
+                options.replaceTerm = argv[++i];
+            }
+            else if (arg == L"--input" && hasValue)
+            {
+                options.input = argv[++i];
+            }
+            else if (arg == L"--root" && hasValue)
+            {
+                options.root = argv[++i];
+            }
+            else if (arg == L"--boost")
+            {
+                options.useBoostLib = true;
+            }
+            else if (arg == L"--backtracking")
+            {
+                options.useLinearRegEx = false;
+            }
+            else if (arg == L"--no-stat")
+            {
+                options.stat = false;
+            }
+            else if (arg == L"--all")
+            {
+                options.all = true;
+            }
+            else if (arg == L"--journal" && hasValue)
+            {
+                options.journal = argv[++i];
+            }
+            else if (arg == L"--resume" && hasValue)
+            {
+                options.resume = argv[++i];
+            }
+            else if (arg == L"--rollback" && hasValue)
+            {
+                options.rollback = argv[++i];
+            }
+            else if (arg == L"--batch" && hasValue)
+            {
+                options.batchSize = wcstoul(argv[++i], nullptr, 10);
+            }
+            else
+            {
+                bool found = false;
+                for (const auto& flagOption : c_flagOptions)
+                {
+                    if (arg == flagOption.name)
+                    {
+                        options.flags |= flagOption.flag;
+                        found = true;
+                        break;
+                    }
+                }
+
+                if (!found)
+                {
+                    fwprintf(stderr, L"Unknown option %s\n", arg.c_str());
+                    return false;
+                }
+            }
+        }
+
+        // An interrupted journal holds its plan
+        return hasSearchTerm || !options.resume.empty() || !options.rollback.empty();
+    }
+
+    std::wstring Utf8ToWide(const std::string& text)
+    {
+        std::wstring result;
+        const int length = MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), nullptr, 0);
+        if (length > 0)
+        {
+            result.resize(length);
+            MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), result.data(), length);
+        }
+        return result;
+    }
+
+    void AppendUtf8(_Inout_ std::string& output, const std::wstring& text)
+    {
+        const int length = WideCharToMultiByte(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), nullptr, 0, nullptr, nullptr);
+        if (length > 0)
+        {
+            const size_t offset = output.size();
+            output.resize(offset + length);
+            WideCharToMultiByte(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), output.data() + offset, length, nullptr, nullptr);
+        }
+    }
+
+    void AppendJsonString(_Inout_ std::string& output, const std::wstring& text)
+    {
+        std::wstring escaped;
+        escaped.reserve(text.size() + 2);
+        escaped += L'"';
+        for (wchar_t c : text)
+        {
+            switch (c)
+            {
+            case L'"':
+                escaped += L"\\\"";
+                break;
+            case L'\\':
+                escaped += L"\\\\";
+                break;
+            case L'\n':
+                escaped += L"\\n";
+                break;
+            case L'\r':
+                escaped += L"\\r";
+                break;
+            case L'\t':
+                escaped += L"\\t";
+                break;
+            default:
+                if (c < 0x20)
+                {
+                    wchar_t code[8];
+                    StringCchPrintf(code, ARRAYSIZE(code), L"\\u%04x", c);
+                    escaped += code;
+                }
+                else
+                {
+                    escaped += c;
+                }
+            }
+        }
+        escaped += L'"';
+        AppendUtf8(output, escaped);
+    }
+
+    std::vector<std::wstring> ReadPaths(std::istream& input)
+    {
+        std::vector<std::wstring> paths;
+        std::string line;
+        while (std::getline(input, line))
+        {
+            // Skip a UTF-8 byte order mark and Windows line endings
+            if (paths.empty() && line.compare(0, 3, "\xEF\xBB\xBF") == 0)
+            {
+                line.erase(0, 3);
+            }
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            if (!line.empty())
+            {
+                paths.push_back(Utf8ToWide(line));
+            }
+        }
+        return paths;
+    }
+
+    // Reads the attributes and the local creation time of path, like CPowerRenameItem does
+    HRESULT GetItemFromDisk(const std::wstring& path, _Inout_ PowerRenameEngineItem& item)
+    {
+        WIN32_FILE_ATTRIBUTE_DATA data = { 0 };
+        if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data))
+        {
+            return HRESULT_FROM_WIN32(GetLastError());
+        }
+
+        item.isFolder = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+
+        SYSTEMTIME systemTime, localTime;
+        if (FileTimeToSystemTime(&data.ftCreationTime, &systemTime) &&
+            SystemTimeToTzSpecificLocalTime(nullptr, &systemTime, &localTime))
+        {
+            item.time = localTime;
+        }
+        return S_OK;
+    }
+
+    bool PrintProgress(const RenameProgress& progress)
+    {
+        fwprintf(stderr, L"%zu/%zu renamed, %zu failed, %zu rolled back, %.0f items/s\n", progress.done, progress.total, progress.failed, progress.rolledBack, progress.itemsPerSecond);
+        return true;
+    }
+
+    // Executes the plan of journal, or rolls it back, and deletes it once nothing is left to do
+    int RunJournal(CRenameJournal& journal, bool rollBack, size_t batchSize)
+    {
+        CFileSystemRenameExecutor executor;
+        HRESULT hr = rollBack ? journal.RollBack(executor, batchSize, PrintProgress) : journal.Execute(executor, batchSize, PrintProgress);
+        if (FAILED(hr))
+        {
+            fwprintf(stderr, L"Failed to rename the items: 0x%08lx\n", static_cast<unsigned long>(hr));
+            return 1;
+        }
+
+        const RenameProgress& progress = journal.GetProgress();
+        fwprintf(stderr, L"%zu batches, %zu items in %.3fs\n", progress.batches, progress.processed, progress.elapsedSeconds);
+        if ((rollBack ? progress.done : progress.failed) == 0)
+        {
+            journal.Finish();
+        }
+        return progress.failed == 0 ? 0 : 2;
+    }
+
+    int ResumeJournal(const std::wstring& path, bool rollBack, size_t batchSize)
+    {
+        std::unique_ptr<CRenameJournal> journal;
+        HRESULT hr = CRenameJournal::s_Open(path, journal);
+        if (FAILED(hr))
+        {
+            fwprintf(stderr, L"Can't open the journal %s: 0x%08lx\n", path.c_str(), static_cast<unsigned long>(hr));
+            return 1;
+        }
+        if (journal->IsFinished())
+        {
+            return 0;
+        }
+        return RunJournal(*journal, rollBack, batchSize);
+    }
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    // Paths and JSON are UTF-8, without line ending translation
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        fwprintf(stderr, L"%s", c_usage);
+        return 1;
+    }
+
+    if (!options.resume.empty() || !options.rollback.empty())
+    {
+        return ResumeJournal(options.resume.empty() ? options.rollback : options.resume, options.resume.empty(), options.batchSize);
+    }
+
+    std::vector<std::wstring> paths;
+    if (options.input.empty())
+    {
+        paths = ReadPaths(std::cin);
+    }
+    else
+    {
+        std::ifstream input(options.input, std::ios::binary);
+        if (!input)
+        {
+            fwprintf(stderr, L"Can't open %s\n", options.input.c_str());
+            return 1;
+        }
+        paths = ReadPaths(input);
+    }
+
+    const fs::path root = options.root.empty() ? fs::path() : fs::path(options.root).lexically_normal();
+
+    std::string output;
+    std::vector<PowerRenameEngineItem> items;
+    items.reserve(paths.size());
+    for (auto& path : paths)
+    {
+        PowerRenameEngineItem item;
+        if (options.stat)
+        {
+            HRESULT hr = GetItemFromDisk(path, item);
+            if (FAILED(hr))
+            {
+                char error[32];
+                sprintf_s(error, ",\"error\":\"0x%08lx\"}\n", static_cast<unsigned long>(hr));
+                output += "{\"path\":";
+                AppendJsonString(output, path);
+                output += error;
+                continue;
+            }
+        }
+
+        if (!root.empty())
+        {
+            item.isSubFolderContent = fs::path(path).parent_path().lexically_normal() != root;
+        }
+
+        item.path = std::move(path);
+        items.push_back(std::move(item));
+    }
+
+    CSettingsInstance().SetUseBoostLib(options.useBoostLib);
+    CSettingsInstance().SetUseLinearRegEx(options.useLinearRegEx);
+
+    CComPtr<IPowerRenameRegEx> renameRegEx;
+    HRESULT hr = CPowerRenameRegEx::s_CreateInstance(&renameRegEx);
+    if (SUCCEEDED(hr))
+    {
+        hr = renameRegEx->PutFlags(options.flags);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = renameRegEx->PutSearchTerm(options.searchTerm.c_str());
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = renameRegEx->PutReplaceTerm(options.replaceTerm.c_str());
+    }
+
+    std::vector<std::optional<std::wstring>> newNames;
+    if (SUCCEEDED(hr))
+    {
+        hr = GetRenamedFileNames(renameRegEx, items, newNames);
+    }
+    if (FAILED(hr))
+    {
+        fwprintf(stderr, L"Failed to compute the new names: 0x%08lx\n", static_cast<unsigned long>(hr));
+        return 1;
+    }
+
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        if (!newNames[i] && !options.all)
+        {
+            continue;
+        }
+
+        output += "{\"path\":";
+        AppendJsonString(output, items[i].path);
+        output += ",\"newName\":";
+        if (newNames[i])
+        {
+            AppendJsonString(output, *newNames[i]);
+        }
+        else
+        {
+            output += "null";
+        }
+        output += "}\n";
+
+        if (output.size() >= 1 << 20)
+        {
+            fwrite(output.data(), 1, output.size(), stdout);
+            output.clear();
+        }
+    }
+
+    fwrite(output.data(), 1, output.size(), stdout);
+
+    if (!options.journal.empty())
+    {
+        std::vector<RenamePlanItem> plan;
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            if (newNames[i])
+            {
+                const fs::path path(items[i].path);
+                RenamePlanItem item;
+                item.depth = static_cast<UINT>(std::distance(path.begin(), path.end()));
+                item.parentPath = path.parent_path().wstring();
+                item.originalName = path.filename().wstring();
+                item.newName = *newNames[i];
+                plan.push_back(std::move(item));
+            }
+        }
+
+        std::unique_ptr<CRenameJournal> journal;
+        hr = CRenameJournal::s_Create(options.journal, plan, journal);
+        if (FAILED(hr))
+        {
+            fwprintf(stderr, L"Can't create the journal %s: 0x%08lx\n", options.journal.c_str(), static_cast<unsigned long>(hr));
+            return 1;
+        }
+        return RunJournal(*journal, false, options.batchSize);
+    }
+    return 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "targetver.h"
+
+#define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers
+// Windows Header Files
+#include <windows.h>
+
+// C RunTime Header Files
+#include <cstdlib>
+#include <cstdio>
+#include <cwchar>
+#include <atlbase.h>
+#include <strsafe.h>
+#include <pathcch.h>
+#include <shobjidl.h>
+#include <shlwapi.h>
@@ -0,0 +1,242 @@
+#include "pch.h"
+#include "DatedReplaceTerm.h"
+#include <algorithm>
+#include <string_view>
+
+namespace
+{
+    // 0 for Sunday, like SYSTEMTIME::wDayOfWeek, which isn't set by every caller
+    int GetDayOfWeek(int year, int month, int day)
+    {
+        static const int monthOffsets[] = { 0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4 };
+        if (month < 3)
+        {
+            year--;
+        }
+        return (year + year / 4 - year / 100 + year / 400 + monthOffsets[month - 1] + day) % 7;
+    }
+
+    void AppendNumber(_Inout_ std::wstring& result, unsigned int value, size_t minDigits)
+    {
+        wchar_t digits[8];
+        size_t count = 0;
+        do
+        {
+            digits[count++] = static_cast<wchar_t>(L'0' + value % 10);
+            value /= 10;
+        } while (value > 0 && count < ARRAYSIZE(digits));
+
+        for (size_t i = count; i < minDigits; i++)
+        {
+            result += L'0';
+        }
+        while (count > 0)
+        {
+            result += digits[--count];
+        }
+    }
+
+    std::wstring GetDateName(_In_ PCWSTR localeName, _In_ const SYSTEMTIME& date, _In_ PCWSTR format)
+    {
+        wchar_t name[MAX_PATH] = { 0 };
+        if (GetDateFormatEx(localeName, 0, &date, format, name, ARRAYSIZE(name), nullptr) > 1)
+        {
+            LCMapStringEx(localeName, LCMAP_UPPERCASE, name, 1, name, 1, nullptr, nullptr, 0);
+        }
+        return name;
+    }
+}
+
+CDatedReplaceTerm::CDatedReplaceTerm(_In_ PCWSTR replaceTerm)
+{
+    // Longest first, so $YYYY isn't read as $YY followed by YY
+    static const struct
+    {
+        std::wstring_view text;
+        Field field;
+    } tokens[] = {
+        { L"YYYY", Field::Year4 },
+        { L"YY", Field::Year2 },
+        { L"Y", Field::Year1 },
+        { L"MMMM", Field::MonthName },
+        { L"MMM", Field::MonthAbbreviation },
+        { L"MM", Field::Month2 },
+        { L"M", Field::Month1 },
+        { L"DDDD", Field::DayName },
+        { L"DDD", Field::DayAbbreviation },
+        { L"DD", Field::Day2 },
+        { L"D", Field::Day1 },
+        { L"hh", Field::Hour2 },
+        { L"h", Field::Hour1 },
+        { L"mm", Field::Minute2 },
+        { L"m", Field::Minute1 },
+        { L"ss", Field::Second2 },
+        { L"s", Field::Second1 },
+        { L"fff", Field::Millisecond3 },
+        { L"ff", Field::Millisecond2 },
+        { L"f", Field::Millisecond1 },
+    };
+
+    const std::wstring_view term(replaceTerm ? replaceTerm : L"");
+    size_t literalStart = 0;
+    auto addLiteral = [&](size_t end) {
+        if (end > literalStart)
+        {
+            m_tokens.push_back({ Field::Literal, m_literals.length(), end - literalStart });
+            m_literals.append(term.substr(literalStart, end - literalStart));
+        }
+    };
+
+    bool hasNames = false;
+    size_t pos = 0;
+    while (pos < term.length())
+    {
+        if (term[pos] != L'$')
+        {
+            pos++;
+            continue;
+        }
+        if (pos + 1 < term.length() && term[pos + 1] == L'$')
+        {
+            // Escaped, left for the regex formatting
+            pos += 2;
+            continue;
+        }
+
+        const auto token = std::find_if(std::begin(tokens), std::end(tokens), [&](const auto& token) {
+            return term.compare(pos + 1, token.text.length(), token.text) == 0;
+        });
+        if (token == std::end(tokens))
+        {
+            pos++;
+            continue;
+        }
+
+        addLiteral(pos);
+        m_tokens.push_back({ token->field, 0, 0 });
+        m_dated = true;
+        hasNames = hasNames || token->field == Field::MonthName || token->field == Field::MonthAbbreviation ||
+                   token->field == Field::DayName || token->field == Field::DayAbbreviation;
+        pos += 1 + token->text.length();
+        literalStart = pos;
+    }
+    addLiteral(term.length());
+
+    if (hasNames)
+    {
+        _ReadNames();
+    }
+}
+
+std::wstring CDatedReplaceTerm::Format(_In_ const SYSTEMTIME& time) const
+{
+    const bool validDate = time.wMonth >= 1 && time.wMonth <= 12;
+    std::wstring result;
+    result.reserve(m_literals.length() + 8 * m_tokens.size());
+    for (const Token& token : m_tokens)
+    {
+        switch (token.field)
+        {
+        case Field::Literal:
+            result.append(m_literals, token.start, token.length);
+            break;
+        case Field::Year4:
+            AppendNumber(result, time.wYear, 4);
+            break;
+        case Field::Year2:
+            AppendNumber(result, time.wYear % 100, 2);
+            break;
+        case Field::Year1:
+            AppendNumber(result, time.wYear % 10, 1);
+            break;
+        case Field::MonthName:
+            if (validDate)
+            {
+                result += m_monthNames[time.wMonth - 1];
+            }
+            break;
+        case Field::MonthAbbreviation:
+            if (validDate)
+            {
+                result += m_monthAbbreviations[time.wMonth - 1];
+            }
+            break;
+        case Field::Month2:
+            AppendNumber(result, time.wMonth, 2);
+            break;
+        case Field::Month1:
+            AppendNumber(result, time.wMonth, 1);
+            break;
+        case Field::DayName:
+            if (validDate)
+            {
+                result += m_dayNames[GetDayOfWeek(time.wYear, time.wMonth, time.wDay)];
+            }
+            break;
+        case Field::DayAbbreviation:
+            if (validDate)
+            {
+                result += m_dayAbbreviations[GetDayOfWeek(time.wYear, time.wMonth, time.wDay)];
+            }
+            break;
+        case Field::Day2:
+            AppendNumber(result, time.wDay, 2);
+            break;
+        case Field::Day1:
+            AppendNumber(result, time.wDay, 1);
+            break;
+        case Field::Hour2:
+            AppendNumber(result, time.wHour, 2);
+            break;
+        case Field::Hour1:
+            AppendNumber(result, time.wHour, 1);
+            break;
+        case Field::Minute2:
+            AppendNumber(result, time.wMinute, 2);
+            break;
+        case Field::Minute1:
+            AppendNumber(result, time.wMinute, 1);
+            break;
+        case Field::Second2:
+            AppendNumber(result, time.wSecond, 2);
+            break;
+        case Field::Second1:
+            AppendNumber(result, time.wSecond, 1);
+            break;
+        case Field::Millisecond3:
+            AppendNumber(result, time.wMilliseconds, 3);
+            break;
+        case Field::Millisecond2:
+            AppendNumber(result, time.wMilliseconds / 10, 2);
+            break;
+        case Field::Millisecond1:
+            AppendNumber(result, time.wMilliseconds / 100, 1);
+            break;
+        }
+    }
+    return result;
+}
+
+void CDatedReplaceTerm::_ReadNames()
+{
+    wchar_t localeName[LOCALE_NAME_MAX_LENGTH];
+    if (GetUserDefaultLocaleName(localeName, LOCALE_NAME_MAX_LENGTH) == 0)
+    {
+        StringCchCopy(localeName, LOCALE_NAME_MAX_LENGTH, L"en_US");
+    }
+
+    for (WORD month = 1; month <= 12; month++)
+    {
+        const SYSTEMTIME date = { 2000, month, 0, 1 };
+        m_monthNames[month - 1] = GetDateName(localeName, date, L"MMMM");
+        m_monthAbbreviations[month - 1] = GetDateName(localeName, date, L"MMM");
+    }
+
+    // January 2nd 2000 was a Sunday
+    for (WORD day = 0; day < 7; day++)
+    {
+        const SYSTEMTIME date = { 2000, 1, day, static_cast<WORD>(2 + day) };
+        m_dayNames[day] = GetDateName(localeName, date, L"dddd");
+        m_dayAbbreviations[day] = GetDateName(localeName, date, L"ddd");
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "pch.h"
+#include <string>
+#include <vector>
+
+// A replace term compiled into its literal parts and its date and time tokens
+// ($YYYY, $MMM, $DD, $hh, $fff...), so the name of each item is formatted without
+// parsing the term again.  A token is escaped by doubling its $, like the back
+// references of the replace term: $$ is kept as is for the regex formatting.
+// The month and day names are read from the user locale once, when compiling.
+// Format doesn't change the term, so a compiled term can be shared by threads.
+class CDatedReplaceTerm
+{
+public:
+    explicit CDatedReplaceTerm(_In_ PCWSTR replaceTerm);
+
+    // Whether the term has date or time tokens
+    bool IsDated() const { return m_dated; }
+
+    // The replace term with the tokens replaced by the fields of time
+    std::wstring Format(_In_ const SYSTEMTIME& time) const;
+
+private:
+    enum class Field : BYTE
+    {
+        Literal,
+        Year4,
+        Year2,
+        Year1,
+        MonthName,
+        MonthAbbreviation,
+        Month2,
+        Month1,
+        DayName,
+        DayAbbreviation,
+        Day2,
+        Day1,
+        Hour2,
+        Hour1,
+        Minute2,
+        Minute1,
+        Second2,
+        Second1,
+        Millisecond3,
+        Millisecond2,
+        Millisecond1,
+    };
+
+    struct Token
+    {
+        Field field;
+        // Part of m_literals, for Literal tokens
+        size_t start;
+        size_t length;
+    };
+
+    void _ReadNames();
+
+    std::vector<Token> m_tokens;
+    std::wstring m_literals;
+    bool m_dated = false;
+
+    // Only read when the term has name tokens.  The days are indexed from Sunday,
+    // like SYSTEMTIME::wDayOfWeek.
+    std::wstring m_monthNames[12];
+    std::wstring m_monthAbbreviations[12];
+    std::wstring m_dayNames[7];
+    std::wstring m_dayAbbreviations[7];
+};
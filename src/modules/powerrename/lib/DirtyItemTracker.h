@@ -0,0 +1,101 @@
+#pragma once
+#include "pch.h"
+#include <atomic>
+#include <vector>
+
+// Collects the indexes of the items updated by the regex workers so the manager
+// thread can notify listeners once per frame instead of once per item.
+// MarkDirty can be called concurrently from any number of worker threads.
+// Reset and Flush are only called from the manager thread.
+class CDirtyItemTracker
+{
+public:
+    // Minimum time between two flush requests, about one frame
+    static const ULONGLONG c_flushIntervalMs = 16;
+    // Dirty items after which a flush is requested even if the interval hasn't elapsed
+    static const UINT c_flushItemThreshold = 4096;
+
+    void Reset(_In_ UINT itemCount)
+    {
+        m_bits = std::vector<std::atomic<ULONGLONG>>((itemCount + 63) / 64);
+        m_pendingCount = 0;
+        m_flushPending = false;
+        m_lastFlushTick = GetTickCount64();
+    }
+
+    // Returns true if the caller should ask the manager thread to Flush
+    bool MarkDirty(_In_ UINT index)
+    {
+        const size_t word = index / 64;
+        if (word >= m_bits.size())
+        {
+            return false;
+        }
+
+        const ULONGLONG bit = 1ULL << (index % 64);
+        if (m_bits[word].fetch_or(bit) & bit)
+        {
+            // Already dirty, a flush will pick it up
+            return false;
+        }
+
+        const UINT pendingCount = ++m_pendingCount;
+        if (m_flushPending ||
+            (pendingCount < c_flushItemThreshold && GetTickCount64() - m_lastFlushTick < c_flushIntervalMs))
+        {
+            return false;
+        }
+
+        return !m_flushPending.exchange(true);
+    }
+
+    // Clears the dirty items and returns the range containing them.
+    // Returns false if no item was dirty.
+    bool Flush(_Out_ UINT* firstIndex, _Out_ UINT* lastIndex)
+    {
+        *firstIndex = 0;
+        *lastIndex = 0;
+
+        m_pendingCount = 0;
+        m_lastFlushTick = GetTickCount64();
+        m_flushPending = false;
+
+        bool found = false;
+        for (size_t word = 0; word < m_bits.size(); word++)
+        {
+            // Items marked after their word was exchanged are kept for the next flush
+            ULONGLONG bits = m_bits[word].exchange(0);
+            if (bits == 0)
+            {
+                continue;
+            }
+
+            UINT first = static_cast<UINT>(word * 64);
+            UINT last = first + 63;
+            while (!(bits & 1))
+            {
+                bits >>= 1;
+                first++;
+            }
+            while (!(bits >> (last - first)))
+            {
+                last--;
+            }
+
+            if (!found)
+            {
+                *firstIndex = first;
+                found = true;
+            }
+            *lastIndex = last;
+        }
+
+        return found;
+    }
+
+private:
+    std::vector<std::atomic<ULONGLONG>> m_bits;
+    std::atomic<UINT> m_pendingCount = 0;
+    std::atomic<bool> m_flushPending = false;
+    std::atomic<ULONGLONG> m_lastFlushTick = 0;
+};
@@ -0,0 +1,171 @@
+#include "pch.h"
+#include "ExtensionHistogram.h"
+
+namespace
+{
+    const UINT c_initialTableSize = 64;
+
+    UINT HashExtension(_In_reads_(length) const wchar_t* extension, UINT length)
+    {
+        // FNV-1a
+        UINT hash = 2166136261u;
+        for (UINT i = 0; i < length; i++)
+        {
+            hash = (hash ^ extension[i]) * 16777619u;
+        }
+        return hash;
+    }
+}
+
+void CExtensionHistogram::Add(_In_ PCWSTR name)
+{
+    m_nameCount++;
+
+    // Like std::filesystem::path::extension, a name starting with its only dot and
+    // the names "." and ".." have no extension
+    const wchar_t* extension = nullptr;
+    const size_t nameLength = wcslen(name);
+    const wchar_t* lastDot = wcsrchr(name, L'.');
+    if (lastDot && lastDot != name && wcscmp(name, L"..") != 0)
+    {
+        extension = lastDot;
+    }
+    const UINT length = extension ? static_cast<UINT>(name + nameLength - extension) : 0;
+    if (!extension)
+    {
+        extension = name + nameLength;
+    }
+
+    if (m_table.empty())
+    {
+        m_table.resize(c_initialTableSize);
+    }
+
+    const UINT hash = HashExtension(extension, length);
+    UINT slot = _FindSlot(extension, length, hash);
+    if (m_table[slot] == 0)
+    {
+        if (m_entries.size() >= c_maxExtensions)
+        {
+            m_otherCount++;
+            return;
+        }
+
+        Extension entry;
+        entry.text.assign(extension, length);
+        entry.hash = hash;
+        m_entries.push_back(std::move(entry));
+        m_table[slot] = static_cast<UINT>(m_entries.size());
+        if (m_entries.size() * 2 > m_table.size())
+        {
+            _Grow();
+        }
+        slot = _FindSlot(extension, length, hash);
+    }
+
+    const UINT entryIndex = m_table[slot] - 1;
+    m_entries[entryIndex].count++;
+    _UpdateTop(entryIndex);
+}
+
+void CExtensionHistogram::Clear()
+{
+    m_entries.clear();
+    m_table.clear();
+    m_topUsed = 0;
+    m_nameCount = 0;
+    m_otherCount = 0;
+}
+
+std::vector<CExtensionHistogram::Entry> CExtensionHistogram::GetTop() const
+{
+    std::vector<Entry> top(m_topUsed);
+    for (UINT i = 0; i < m_topUsed; i++)
+    {
+        top[i].extension = m_entries[m_top[i]].text.c_str();
+        top[i].count = m_entries[m_top[i]].count;
+    }
+    return top;
+}
+
+std::wstring CExtensionHistogram::GetTopList() const
+{
+    std::wstring list;
+    for (UINT i = 0; i < m_topUsed; i++)
+    {
+        const Extension& entry = m_entries[m_top[i]];
+        list.append(entry.text);
+        list.append(L":");
+        list.append(std::to_wstring(entry.count));
+        list.append(L",");
+    }
+    return list;
+}
+
+UINT CExtensionHistogram::_FindSlot(_In_reads_(length) const wchar_t* extension, UINT length, UINT hash) const
+{
+    const UINT mask = static_cast<UINT>(m_table.size()) - 1;
+    for (UINT slot = hash & mask;; slot = (slot + 1) & mask)
+    {
+        if (m_table[slot] == 0)
+        {
+            return slot;
+        }
+
+        const Extension& entry = m_entries[m_table[slot] - 1];
+        if (entry.hash == hash && entry.text.length() == length && wmemcmp(entry.text.data(), extension, length) == 0)
+        {
+            return slot;
+        }
+    }
+}
+
+void CExtensionHistogram::_Grow()
+{
+    m_table.assign(m_table.size() * 2, 0);
+    const UINT mask = static_cast<UINT>(m_table.size()) - 1;
+    for (UINT i = 0; i < m_entries.size(); i++)
+    {
+        UINT slot = m_entries[i].hash & mask;
+        while (m_table[slot] != 0)
+        {
+            slot = (slot + 1) & mask;
+        }
+        m_table[slot] = i + 1;
+    }
+}
+
+void CExtensionHistogram::_UpdateTop(UINT entryIndex)
+{
+    // Counts only grow by one, so an extension enters the top by taking the place of
+    // the last one, then moves up past the ones it now exceeds
+    Extension& entry = m_entries[entryIndex];
+    UINT position = entry.topIndex;
+    if (position == c_topCount)
+    {
+        if (m_topUsed < c_topCount)
+        {
+            position = m_topUsed++;
+        }
+        else if (entry.count > m_entries[m_top[c_topCount - 1]].count)
+        {
+            position = c_topCount - 1;
+            m_entries[m_top[position]].topIndex = c_topCount;
+        }
+        else
+        {
+            return;
+        }
+        m_top[position] = entryIndex;
+        entry.topIndex = position;
+    }
+
+    while (position > 0 && m_entries[m_top[position - 1]].count < entry.count)
+    {
+        m_top[position] = m_top[position - 1];
+        m_entries[m_top[position]].topIndex = position;
+        position--;
+        m_top[position] = entryIndex;
+        entry.topIndex = position;
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "pch.h"
+#include <string>
+#include <vector>
+
+// Counts the extensions of the names added, for telemetry.  Each extension is
+// stored once and looked up in an open addressing table, so adding a name doesn't
+// allocate once its extension was seen.  The c_topCount most used extensions are
+// kept sorted as the counts grow, so reading them doesn't depend on the number of
+// names or of extensions.
+// At most c_maxExtensions different extensions are counted, the names with other
+// ones are only counted as others.  Not thread safe.
+class CExtensionHistogram
+{
+public:
+    static const UINT c_topCount = 16;
+    static const UINT c_maxExtensions = 4096;
+
+    struct Entry
+    {
+        PCWSTR extension = nullptr;
+        UINT count = 0;
+    };
+
+    // Counts the extension of name, the part from its last dot like
+    // std::filesystem::path::extension.  Names without one count as the empty extension.
+    void Add(_In_ PCWSTR name);
+    void Clear();
+
+    // The most used extensions, most used first
+    std::vector<Entry> GetTop() const;
+    UINT GetNameCount() const { return m_nameCount; }
+    // Names whose extension wasn't counted since c_maxExtensions were already
+    UINT GetOtherCount() const { return m_otherCount; }
+
+    // "extension:count," for each of the most used extensions, the format of the
+    // telemetry of the rename operation
+    std::wstring GetTopList() const;
+
+private:
+    struct Extension
+    {
+        std::wstring text;
+        UINT hash = 0;
+        UINT count = 0;
+        // Position in m_top, c_topCount when not in it
+        UINT topIndex = c_topCount;
+    };
+
+    // Position in m_table of the extension, or of the empty slot to add it to
+    UINT _FindSlot(_In_reads_(length) const wchar_t* extension, UINT length, UINT hash) const;
+    void _Grow();
+    void _UpdateTop(UINT entryIndex);
+
+    std::vector<Extension> m_entries;
+    // Open addressing table of the indexes in m_entries plus one, 0 for empty slots.
+    // A power of two, kept at most half full.
+    std::vector<UINT> m_table;
+
+    // Indexes in m_entries of the most used extensions, by decreasing count
+    UINT m_top[c_topCount] = {};
+    UINT m_topUsed = 0;
+
+    UINT m_nameCount = 0;
+    UINT m_otherCount = 0;
+};
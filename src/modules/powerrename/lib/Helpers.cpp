@@ -1,6 +1,8 @@
 #include "pch.h"
 #include "Helpers.h"
-#include <regex>
+#include "PowerRenameEnum.h"
+#include "UniqueNameResolver.h"
+#include "DatedReplaceTerm.h"
 #include <ShlGuid.h>
 #include <cstring>
 #include <filesystem>
@@ -169,113 +171,23 @@ HRESULT GetTransformedFileName(_Out_ PWSTR result, UINT cchMax, _In_ PCWSTR sour
     return hr;
 }
 
-bool isFileTimeUsed(_In_ PCWSTR source) 
+bool isFileTimeUsed(_In_ PCWSTR source)
 {
-    bool used = false;
-    std::wstring patterns[] = { L"(([^\\$]|^)(\\$\\$)*)\\$Y", L"(([^\\$]|^)(\\$\\$)*)\\$M", L"(([^\\$]|^)(\\$\\$)*)\\$D", 
-        L"(([^\\$]|^)(\\$\\$)*)\\$h", L"(([^\\$]|^)(\\$\\$)*)\\$m", L"(([^\\$]|^)(\\$\\$)*)\\$s", L"(([^\\$]|^)(\\$\\$)*)\\$f" };
-    size_t patternsLength = ARRAYSIZE(patterns);
-    for (size_t i = 0; !used && i < patternsLength; i++)
-    {
-        if (std::regex_search(source, std::wregex(patterns[i])))
-        {
-            used = true;
-        }
-    }
-    return used;
+    return CDatedReplaceTerm(source).IsDated();
 }
 
 HRESULT GetDatedFileName(_Out_ PWSTR result, UINT cchMax, _In_ PCWSTR source, SYSTEMTIME fileTime)
 {
-    std::locale::global(std::locale(""));
-    HRESULT hr = E_INVALIDARG;     
+    HRESULT hr = E_INVALIDARG;
     if (source && wcslen(source) > 0)
     {
-        std::wstring res(source);
-        wchar_t replaceTerm[MAX_PATH] = { 0 };
-        wchar_t formattedDate[MAX_PATH] = { 0 };
-
-        wchar_t localeName[LOCALE_NAME_MAX_LENGTH];
-        if (GetUserDefaultLocaleName(localeName, LOCALE_NAME_MAX_LENGTH) == 0)
-        {
-            StringCchCopy(localeName, LOCALE_NAME_MAX_LENGTH, L"en_US");
-        }
-
-        StringCchPrintf(replaceTerm, MAX_PATH, TEXT("%s%04d"), L"$01", fileTime.wYear);
-        res = regex_replace(res, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$YYYY"), replaceTerm);
-
-        StringCchPrintf(replaceTerm, MAX_PATH, TEXT("%s%02d"), L"$01", (fileTime.wYear % 100));
-        res = regex_replace(res, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$YY"), replaceTerm);
-
-        StringCchPrintf(replaceTerm, MAX_PATH, TEXT("%s%d"), L"$01", (fileTime.wYear % 10));
-        res = regex_replace(res, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$Y"), replaceTerm);
-        
-        GetDateFormatEx(localeName, NULL, &fileTime, L"MMMM", formattedDate, MAX_PATH, NULL);
-        formattedDate[0] = towupper(formattedDate[0]);
-        StringCchPrintf(replaceTerm, MAX_PATH, TEXT("%s%s"), L"$01", formattedDate);
-        res = regex_replace(res, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$MMMM"), replaceTerm);
-        
-        GetDateFormatEx(localeName, NULL, &fileTime, L"MMM", formattedDate, MAX_PATH, NULL);
-        formattedDate[0] = towupper(formattedDate[0]);
-        StringCchPrintf(replaceTerm, MAX_PATH, TEXT("%s%s"), L"$01", formattedDate);
-        res = regex_replace(res, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$MMM"), replaceTerm);
-                
-        StringCchPrintf(replaceTerm, MAX_PATH, TEXT("%s%02d"), L"$01", fileTime.wMonth);
-        res = regex_replace(res, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$MM"), replaceTerm);
-
-        StringCchPrintf(replaceTerm, MAX_PATH, TEXT("%s%d"), L"$01", fileTime.wMonth);
-        res = regex_replace(res, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$M"), replaceTerm);
-
-        GetDateFormatEx(localeName, NULL, &fileTime, L"dddd", formattedDate, MAX_PATH, NULL);
-        formattedDate[0] = towupper(formattedDate[0]);
-        StringCchPrintf(replaceTerm, MAX_PATH, TEXT("%s%s"), L"$01", formattedDate);
-        res = regex_replace(res, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$DDDD"), replaceTerm);
-        
-        GetDateFormatEx(localeName, NULL, &fileTime, L"ddd", formattedDate, MAX_PATH, NULL);
-        formattedDate[0] = towupper(formattedDate[0]);
-        StringCchPrintf(replaceTerm, MAX_PATH, TEXT("%s%s"), L"$01", formattedDate);
-        res = regex_replace(res, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$DDD"), replaceTerm);
-
-        StringCchPrintf(replaceTerm, MAX_PATH, TEXT("%s%02d"), L"$01", fileTime.wDay);
-        res = regex_replace(res, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$DD"), replaceTerm);
-
-        StringCchPrintf(replaceTerm, MAX_PATH, TEXT("%s%d"), L"$01", fileTime.wDay);
-        res = regex_replace(res, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$D"), replaceTerm);
-
-        StringCchPrintf(replaceTerm, MAX_PATH, TEXT("%s%02d"), L"$01", fileTime.wHour);
-        res = regex_replace(res, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$hh"), replaceTerm);
-
-        StringCchPrintf(replaceTerm, MAX_PATH, TEXT("%s%d"), L"$01", fileTime.wHour);
-        res = regex_replace(res, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$h"), replaceTerm);
-
-        StringCchPrintf(replaceTerm, MAX_PATH, TEXT("%s%02d"), L"$01", fileTime.wMinute);
-        res = regex_replace(res, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$mm"), replaceTerm);
-
-        StringCchPrintf(replaceTerm, MAX_PATH, TEXT("%s%d"), L"$01", fileTime.wMinute);
-        res = regex_replace(res, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$m"), replaceTerm);
-
-        StringCchPrintf(replaceTerm, MAX_PATH, TEXT("%s%02d"), L"$01", fileTime.wSecond);
-        res = regex_replace(res, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$ss"), replaceTerm);
-
-        StringCchPrintf(replaceTerm, MAX_PATH, TEXT("%s%d"), L"$01", fileTime.wSecond);
-        res = regex_replace(res, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$s"), replaceTerm);
-
-        StringCchPrintf(replaceTerm, MAX_PATH, TEXT("%s%03d"), L"$01", fileTime.wMilliseconds);
-        res = regex_replace(res, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$fff"), replaceTerm);
-
-        StringCchPrintf(replaceTerm, MAX_PATH, TEXT("%s%02d"), L"$01", fileTime.wMilliseconds/10);
-        res = regex_replace(res, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$ff"), replaceTerm);
-
-        StringCchPrintf(replaceTerm, MAX_PATH, TEXT("%s%d"), L"$01", fileTime.wMilliseconds/100);
-        res = regex_replace(res, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$f"), replaceTerm);
-
-        hr = StringCchCopy(result, cchMax, res.c_str());
+        hr = StringCchCopy(result, cchMax, CDatedReplaceTerm(source).Format(fileTime).c_str());
     }
 
     return hr;
 }
 
-HRESULT _GetShellItemArrayFromDataOject(_In_ IUnknown* dataSource, _COM_Outptr_ IShellItemArray** items)
+HRESULT GetShellItemArrayFromDataObject(_In_ IUnknown* dataSource, _COM_Outptr_ IShellItemArray** items)
 {
     *items = nullptr;
     CComPtr<IDataObject> dataObj;
@@ -292,231 +204,66 @@ HRESULT _GetShellItemArrayFromDataOject(_In_ IUnknown* dataSource, _COM_Outptr_
     return hr;
 }
 
-HRESULT _ParseEnumItems(_In_ IEnumShellItems* pesi, _In_ IPowerRenameManager* psrm, _In_ int depth = 0)
-{
-    HRESULT hr = E_INVALIDARG;
-
-    // We shouldn't get this deep since we only enum the contents of
-    // regular folders but adding just in case
-    if ((pesi) && (depth < (MAX_PATH / 2)))
-    {
-        hr = S_OK;
-
-        ULONG celtFetched;
-        CComPtr<IShellItem> spsi;
-        while ((S_OK == pesi->Next(1, &spsi, &celtFetched)) && (SUCCEEDED(hr)))
-        {
-            CComPtr<IPowerRenameItemFactory> spsrif;
-            hr = psrm->GetRenameItemFactory(&spsrif);
-            if (SUCCEEDED(hr))
-            {
-                CComPtr<IPowerRenameItem> spNewItem;
-                hr = spsrif->Create(spsi, &spNewItem);
-                if (SUCCEEDED(hr))
-                {
-                    spNewItem->PutDepth(depth);
-                    hr = psrm->AddItem(spNewItem);
-                }
-
-                if (SUCCEEDED(hr))
-                {
-                    bool isFolder = false;
-                    if (SUCCEEDED(spNewItem->GetIsFolder(&isFolder)) && isFolder)
-                    {
-                        // Bind to the IShellItem for the IEnumShellItems interface
-                        CComPtr<IEnumShellItems> spesiNext;
-                        hr = spsi->BindToHandler(nullptr, BHID_EnumItems, IID_PPV_ARGS(&spesiNext));
-                        if (SUCCEEDED(hr))
-                        {
-                            // Parse the folder contents recursively
-                            hr = _ParseEnumItems(spesiNext, psrm, depth + 1);
-                        }
-                    }
-                }
-            }
-
-            spsi = nullptr;
-        }
-    }
-
-    return hr;
-}
-
 // Iterate through the data source and add paths to the rotation manager
 HRESULT EnumerateDataObject(_In_ IUnknown* dataSource, _In_ IPowerRenameManager* psrm)
 {
-    CComPtr<IShellItemArray> spsia;
-    HRESULT hr = E_FAIL;
-    if (SUCCEEDED(_GetShellItemArrayFromDataOject(dataSource, &spsia)))
-    {
-        CComPtr<IEnumShellItems> spesi;
-        if (SUCCEEDED(spsia->EnumItems(&spesi)))
-        {
-            hr = _ParseEnumItems(spesi, psrm);
-        }
-    }
-
-    return hr;
-}
+    CComPtr<IPowerRenameItemFactory> spsrif;
+    HRESULT hr = psrm->GetRenameItemFactory(&spsrif);
 
-BOOL GetEnumeratedFileName(__out_ecount(cchMax) PWSTR pszUniqueName, UINT cchMax, __in PCWSTR pszTemplate, __in_opt PCWSTR pszDir, unsigned long ulMinLong, __inout unsigned long* pulNumUsed)
-{
-    PWSTR pszName = nullptr;
-    HRESULT hr = S_OK;
-    BOOL fRet = FALSE;
-    int cchDir = 0;
-
-    if (0 != cchMax && pszUniqueName)
-    {
-        *pszUniqueName = 0;
-        if (pszDir)
-        {
-            hr = StringCchCopy(pszUniqueName, cchMax, pszDir);
-            if (SUCCEEDED(hr))
-            {
-                hr = PathCchAddBackslashEx(pszUniqueName, cchMax, &pszName, nullptr);
-                if (SUCCEEDED(hr))
-                {
-                    cchDir = lstrlen(pszDir);
-                }
-            }
-        }
-        else
-        {
-            cchDir = 0;
-            pszName = pszUniqueName;
-        }
-    }
-    else
+    CPowerRenameEnum enumerator;
+    if (SUCCEEDED(hr))
     {
-        hr = E_INVALIDARG;
+        hr = enumerator.Start(dataSource, spsrif, nullptr, 0);
     }
 
-    int cchTmp = 0;
-    int cchStem = 0;
-    PCWSTR pszStem = nullptr;
-    PCWSTR pszRest = nullptr;
-    wchar_t szFormat[MAX_PATH] = { 0 };
-
-    if (SUCCEEDED(hr))
+    std::vector<CComPtr<IPowerRenameItem>> items;
+    while (hr == S_OK)
     {
-        pszStem = pszTemplate;
-
-        pszRest = StrChr(pszTemplate, L'(');
-        while (pszRest)
+        items.clear();
+        hr = enumerator.GetItems(items, c_enumChunkSize, INFINITE);
+        for (auto& item : items)
         {
-            PCWSTR pszEndUniq = CharNext(pszRest);
-            while (*pszEndUniq && *pszEndUniq >= L'0' && *pszEndUniq <= L'9')
-            {
-                pszEndUniq++;
-            }
-
-            if (*pszEndUniq == L')')
+            HRESULT hrAdd = psrm->AddItem(item);
+            if (FAILED(hrAdd))
             {
+                hr = hrAdd;
                 break;
             }
-
-            pszRest = StrChr(CharNext(pszRest), L'(');
-        }
-
-        if (!pszRest)
-        {
-            pszRest = PathFindExtension(pszTemplate);
-            cchStem = (int)(pszRest - pszTemplate);
-
-            hr = StringCchCopy(szFormat, ARRAYSIZE(szFormat), L" (%lu)");
-        }
-        else
-        {
-            pszRest++;
-
-            cchStem = (int)(pszRest - pszTemplate);
-
-            while (*pszRest && *pszRest >= L'0' && *pszRest <= L'9')
-            {
-                pszRest++;
-            }
-
-            hr = StringCchCopy(szFormat, ARRAYSIZE(szFormat), L"%lu");
         }
     }
 
-    unsigned long ulMax = 0;
-    unsigned long ulMin = 0;
-    if (SUCCEEDED(hr))
+    return SUCCEEDED(hr) ? S_OK : hr;
+}
+
+BOOL GetEnumeratedFileName(__out_ecount(cchMax) PWSTR pszUniqueName, UINT cchMax, __in PCWSTR pszTemplate, __in_opt PCWSTR pszDir, unsigned long ulMinLong, __inout unsigned long* pulNumUsed)
+{
+    if (0 == cchMax || !pszUniqueName)
     {
-        int cchFormat = lstrlen(szFormat);
-        if (cchFormat < 3)
-        {
-            *pszUniqueName = L'\0';
-            return FALSE;
-        }
-        ulMin = ulMinLong;
-        cchTmp = cchMax - cchDir - cchStem - (cchFormat - 3);
-        switch (cchTmp)
-        {
-        case 1:
-            ulMax = 10;
-            break;
-        case 2:
-            ulMax = 100;
-            break;
-        case 3:
-            ulMax = 1000;
-            break;
-        case 4:
-            ulMax = 10000;
-            break;
-        case 5:
-            ulMax = 100000;
-            break;
-        default:
-            if (cchTmp <= 0)
-            {
-                ulMax = ulMin;
-            }
-            else
-            {
-                ulMax = 1000000;
-            }
-            break;
-        }
+        return FALSE;
     }
 
-    if (SUCCEEDED(hr))
+    // Reads the names of pszDir once instead of probing the file system for each number.
+    // Callers naming several items should keep a CUniqueNameResolver for the whole batch.
+    CUniqueNameResolver resolver;
+    std::wstring uniqueName;
+    std::wstring path;
+    BOOL fRet = resolver.GetEnumeratedName(pszDir ? pszDir : L"", pszTemplate, ulMinLong, uniqueName, pulNumUsed) == S_OK;
+    if (fRet)
     {
-        hr = StringCchCopyN(pszName, pszUniqueName + cchMax - pszName, pszStem, cchStem);
-        if (SUCCEEDED(hr))
+        if (pszDir)
         {
-            PWSTR pszDigit = pszName + cchStem;
-
-            for (unsigned long ul = ulMin; ((ul < ulMax) && (!fRet)); ul++)
-            {
-                wchar_t szTemp[MAX_PATH] = { 0 };
-                hr = StringCchPrintf(szTemp, ARRAYSIZE(szTemp), szFormat, ul);
-                if (SUCCEEDED(hr))
-                {
-                    hr = StringCchCat(szTemp, ARRAYSIZE(szTemp), pszRest);
-                    if (SUCCEEDED(hr))
-                    {
-                        hr = StringCchCopy(pszDigit, pszUniqueName + cchMax - pszDigit, szTemp);
-                        if (SUCCEEDED(hr))
-                        {
-                            if (!PathFileExists(pszUniqueName))
-                            {
-                                (*pulNumUsed) = ul;
-                                fRet = TRUE;
-                            }
-                        }
-                    }
-                }
-            }
+            wchar_t szDir[MAX_PATH] = { 0 };
+            fRet = SUCCEEDED(StringCchCopy(szDir, ARRAYSIZE(szDir), pszDir)) &&
+                   SUCCEEDED(PathCchAddBackslash(szDir, ARRAYSIZE(szDir)));
+            path = szDir;
         }
+        path += uniqueName;
     }
 
-    if (!fRet)
+    if (!fRet || FAILED(StringCchCopy(pszUniqueName, cchMax, path.c_str())))
     {
         *pszUniqueName = L'\0';
+        fRet = FALSE;
     }
 
     return fRet;
@@ -528,7 +275,7 @@ bool DataObjectContainsRenamableItem(_In_ IUnknown* dataSource)
 {
     bool hasRenamable = false;
     CComPtr<IShellItemArray> spsia;
-    if (SUCCEEDED(_GetShellItemArrayFromDataOject(dataSource, &spsia)))
+    if (SUCCEEDED(GetShellItemArrayFromDataObject(dataSource, &spsia)))
     {
         CComPtr<IEnumShellItems> spesi;
         if (SUCCEEDED(spsia->EnumItems(&spesi)))
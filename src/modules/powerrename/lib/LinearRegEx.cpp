@@ -0,0 +1,1380 @@
+#include "pch.h"
+#include "LinearRegEx.h"
+#include "LiteralMatcher.h"
+#include <algorithm>
+#include <atomic>
+#include <cwctype>
+#include <map>
+#include <unordered_map>
+
+namespace
+{
+    // Counted repeats are expanded into copies of their operand, larger counts are left
+    // to the backtracking engines
+    const UINT c_maxRepeat = 64;
+    const size_t c_maxInstructions = 8 * 1024;
+    const UINT c_maxNesting = 64;
+    // States the lazy DFA of a thread can create for a pattern before it stops being used
+    const size_t c_maxDfaStates = 1024;
+    const UINT c_unbounded = UINT_MAX;
+    const size_t c_noPosition = std::wstring::npos;
+
+    enum class Op : BYTE
+    {
+        Char,
+        Class,
+        Any,
+        Match,
+        Jmp,
+        Split,
+        Save,
+        AssertBegin,
+        AssertEnd,
+        WordBoundary,
+        NotWordBoundary,
+    };
+
+    struct Instruction
+    {
+        Op op;
+        wchar_t c;
+        // Class index, save slot, jump target or preferred target of a split
+        UINT x;
+        // Other target of a split
+        UINT y;
+    };
+
+    const BYTE c_classDigit = 0x1;
+    const BYTE c_classNotDigit = 0x2;
+    const BYTE c_classWord = 0x4;
+    const BYTE c_classNotWord = 0x8;
+    const BYTE c_classSpace = 0x10;
+    const BYTE c_classNotSpace = 0x20;
+
+    bool IsWordChar(_In_ wchar_t c)
+    {
+        return c == L'_' || iswalnum(c);
+    }
+
+    bool IsLineTerminator(_In_ wchar_t c)
+    {
+        return c == L'\n' || c == L'\r' || c == 0x2028 || c == 0x2029;
+    }
+
+    struct CharSet
+    {
+        std::vector<std::pair<wchar_t, wchar_t>> ranges;
+        BYTE builtins = 0;
+        bool negated = false;
+
+        bool Contains(_In_ wchar_t c) const
+        {
+            for (auto& range : ranges)
+            {
+                if (c >= range.first && c <= range.second)
+                {
+                    return true;
+                }
+            }
+            return ((builtins & c_classDigit) && iswdigit(c)) ||
+                   ((builtins & c_classNotDigit) && !iswdigit(c)) ||
+                   ((builtins & c_classWord) && IsWordChar(c)) ||
+                   ((builtins & c_classNotWord) && !IsWordChar(c)) ||
+                   ((builtins & c_classSpace) && iswspace(c)) ||
+                   ((builtins & c_classNotSpace) && !iswspace(c));
+        }
+    };
+
+    struct Node
+    {
+        enum class Kind
+        {
+            Empty,
+            Char,
+            Any,
+            Class,
+            Concat,
+            Alternate,
+            Repeat,
+            Group,
+            Assert,
+        };
+
+        Kind kind = Kind::Empty;
+        wchar_t c = 0;
+        // Class index of a class
+        UINT index = 0;
+        // Capture group of a group, -1 when it doesn't capture
+        int group = -1;
+        Op assertion = Op::AssertBegin;
+        UINT min = 0;
+        UINT max = 0;
+        bool greedy = true;
+        std::vector<std::unique_ptr<Node>> children;
+    };
+    typedef std::unique_ptr<Node> NodePtr;
+
+    NodePtr MakeNode(_In_ Node::Kind kind)
+    {
+        auto node = std::make_unique<Node>();
+        node->kind = kind;
+        return node;
+    }
+
+    bool IsNullable(_In_ const Node& node)
+    {
+        switch (node.kind)
+        {
+        case Node::Kind::Empty:
+        case Node::Kind::Assert:
+            return true;
+        case Node::Kind::Concat:
+            return std::all_of(node.children.begin(), node.children.end(), [](auto& child) { return IsNullable(*child); });
+        case Node::Kind::Alternate:
+            return std::any_of(node.children.begin(), node.children.end(), [](auto& child) { return IsNullable(*child); });
+        case Node::Kind::Repeat:
+            return node.min == 0 || IsNullable(*node.children[0]);
+        case Node::Kind::Group:
+            return IsNullable(*node.children[0]);
+        default:
+            return false;
+        }
+    }
+
+    bool HasCapture(_In_ const Node& node)
+    {
+        return node.group >= 0 || std::any_of(node.children.begin(), node.children.end(), [](auto& child) { return HasCapture(*child); });
+    }
+
+    // Whether a match of node can leave one of its groups out
+    bool MaySkipCapture(_In_ const Node& node)
+    {
+        switch (node.kind)
+        {
+        case Node::Kind::Alternate:
+            return HasCapture(node);
+        case Node::Kind::Repeat:
+            return node.min == 0 ? HasCapture(node) : MaySkipCapture(*node.children[0]);
+        default:
+            return std::any_of(node.children.begin(), node.children.end(), [](auto& child) { return MaySkipCapture(*child); });
+        }
+    }
+
+    // Recursive descent parser for the supported subset.  Anything else, including
+    // syntax errors, makes Parse return null.
+    class CParser
+    {
+    public:
+        CParser(_In_ const std::wstring& pattern, _Inout_ std::vector<CharSet>& classes) :
+            m_pattern(pattern), m_classes(classes)
+        {
+        }
+
+        NodePtr Parse()
+        {
+            NodePtr root = _ParseAlternation();
+            return (root && m_pos == m_pattern.length()) ? std::move(root) : nullptr;
+        }
+
+        UINT GroupCount() const { return m_groupCount; }
+
+    private:
+        bool _AtEnd() const { return m_pos >= m_pattern.length(); }
+        wchar_t _Peek() const { return _AtEnd() ? L'\0' : m_pattern[m_pos]; }
+
+        NodePtr _ParseAlternation()
+        {
+            if (++m_nesting > c_maxNesting)
+            {
+                return nullptr;
+            }
+
+            NodePtr first = _ParseConcatenation();
+            if (!first || _Peek() != L'|')
+            {
+                m_nesting--;
+                return first;
+            }
+
+            NodePtr alternate = MakeNode(Node::Kind::Alternate);
+            alternate->children.push_back(std::move(first));
+            while (!_AtEnd() && _Peek() == L'|')
+            {
+                m_pos++;
+                NodePtr next = _ParseConcatenation();
+                if (!next)
+                {
+                    return nullptr;
+                }
+                alternate->children.push_back(std::move(next));
+            }
+            m_nesting--;
+            return alternate;
+        }
+
+        NodePtr _ParseConcatenation()
+        {
+            NodePtr concat = MakeNode(Node::Kind::Concat);
+            while (!_AtEnd() && _Peek() != L'|' && _Peek() != L')')
+            {
+                NodePtr next = _ParseRepeat();
+                if (!next)
+                {
+                    return nullptr;
+                }
+                concat->children.push_back(std::move(next));
+            }
+            return concat;
+        }
+
+        NodePtr _ParseRepeat()
+        {
+            NodePtr atom = _ParseAtom();
+            if (!atom || _AtEnd())
+            {
+                return atom;
+            }
+
+            UINT min = 0;
+            UINT max = 0;
+            switch (_Peek())
+            {
+            case L'*':
+                max = c_unbounded;
+                m_pos++;
+                break;
+            case L'+':
+                min = 1;
+                max = c_unbounded;
+                m_pos++;
+                break;
+            case L'?':
+                max = 1;
+                m_pos++;
+                break;
+            case L'{':
+                if (!_ParseCount(min, max))
+                {
+                    return nullptr;
+                }
+                break;
+            default:
+                return atom;
+            }
+
+            NodePtr repeat = MakeNode(Node::Kind::Repeat);
+            repeat->min = min;
+            repeat->max = max;
+            if (_Peek() == L'?')
+            {
+                repeat->greedy = false;
+                m_pos++;
+            }
+
+            // Stacked quantifiers are a syntax error, and quantified assertions are read
+            // differently by each engine
+            if (wcschr(L"*+?{", _Peek()) && !_AtEnd())
+            {
+                return nullptr;
+            }
+            if (atom->kind == Node::Kind::Assert)
+            {
+                return nullptr;
+            }
+
+            // The automaton doesn't follow the rules backtracking engines have for
+            // iterations matching nothing, nor for the groups of an earlier iteration
+            if ((max > 1 || max == c_unbounded) && (IsNullable(*atom) || MaySkipCapture(*atom)))
+            {
+                return nullptr;
+            }
+
+            repeat->children.push_back(std::move(atom));
+            return repeat;
+        }
+
+        bool _ParseCount(_Out_ UINT& min, _Out_ UINT& max)
+        {
+            min = max = 0;
+            m_pos++;
+            if (!_ParseNumber(min))
+            {
+                return false;
+            }
+
+            max = min;
+            if (_Peek() == L',')
+            {
+                m_pos++;
+                max = c_unbounded;
+                if (_Peek() != L'}' && !_ParseNumber(max))
+                {
+                    return false;
+                }
+            }
+
+            if (_Peek() != L'}' || _AtEnd() || max < min || min > c_maxRepeat || (max != c_unbounded && max > c_maxRepeat))
+            {
+                return false;
+            }
+            m_pos++;
+            return true;
+        }
+
+        bool _ParseNumber(_Out_ UINT& value)
+        {
+            value = 0;
+            size_t start = m_pos;
+            while (!_AtEnd() && iswdigit(_Peek()) && _Peek() <= L'9')
+            {
+                value = value * 10 + (_Peek() - L'0');
+                if (value > c_maxRepeat)
+                {
+                    value = c_maxRepeat + 1;
+                }
+                m_pos++;
+            }
+            return m_pos > start;
+        }
+
+        NodePtr _ParseAtom()
+        {
+            const wchar_t c = _Peek();
+            m_pos++;
+            switch (c)
+            {
+            case L'(':
+            {
+                int group = -1;
+                if (_Peek() == L'?')
+                {
+                    // Only non capturing groups, not lookarounds or named groups
+                    if (m_pos + 1 >= m_pattern.length() || m_pattern[m_pos + 1] != L':')
+                    {
+                        return nullptr;
+                    }
+                    m_pos += 2;
+                }
+                else
+                {
+                    if (m_groupCount >= CLinearRegEx::c_maxGroups)
+                    {
+                        return nullptr;
+                    }
+                    group = ++m_groupCount;
+                }
+
+                NodePtr child = _ParseAlternation();
+                if (!child || _Peek() != L')' || _AtEnd())
+                {
+                    return nullptr;
+                }
+                m_pos++;
+
+                NodePtr node = MakeNode(Node::Kind::Group);
+                node->group = group;
+                node->children.push_back(std::move(child));
+                return node;
+            }
+            case L'[':
+                return _ParseClass();
+            case L'.':
+                return MakeNode(Node::Kind::Any);
+            case L'^':
+            case L'$':
+            {
+                NodePtr node = MakeNode(Node::Kind::Assert);
+                node->assertion = c == L'^' ? Op::AssertBegin : Op::AssertEnd;
+                return node;
+            }
+            case L'\\':
+                return _ParseEscape();
+            case L'*':
+            case L'+':
+            case L'?':
+            case L'{':
+            case L'}':
+            case L']':
+                // Either an error or read as a literal depending on the engine
+                return nullptr;
+            default:
+            {
+                NodePtr node = MakeNode(Node::Kind::Char);
+                node->c = c;
+                return node;
+            }
+            }
+        }
+
+        NodePtr _ParseEscape()
+        {
+            if (_AtEnd())
+            {
+                return nullptr;
+            }
+
+            const wchar_t c = _Peek();
+            if (c == L'b' || c == L'B')
+            {
+                m_pos++;
+                NodePtr node = MakeNode(Node::Kind::Assert);
+                node->assertion = c == L'b' ? Op::WordBoundary : Op::NotWordBoundary;
+                return node;
+            }
+
+            wchar_t literal = 0;
+            BYTE builtin = 0;
+            if (!_ParseEscapedChar(false, literal, builtin))
+            {
+                return nullptr;
+            }
+
+            if (builtin)
+            {
+                CharSet set;
+                set.builtins = builtin;
+                m_classes.push_back(set);
+                NodePtr node = MakeNode(Node::Kind::Class);
+                node->index = static_cast<UINT>(m_classes.size() - 1);
+                return node;
+            }
+
+            NodePtr node = MakeNode(Node::Kind::Char);
+            node->c = literal;
+            return node;
+        }
+
+        // Reads the escape after a backslash, either a character or a class like \d
+        bool _ParseEscapedChar(_In_ bool inClass, _Out_ wchar_t& literal, _Out_ BYTE& builtin)
+        {
+            literal = 0;
+            builtin = 0;
+            if (_AtEnd())
+            {
+                return false;
+            }
+
+            const wchar_t c = m_pattern[m_pos++];
+            switch (c)
+            {
+            case L'd':
+                builtin = c_classDigit;
+                return true;
+            case L'D':
+                builtin = c_classNotDigit;
+                return true;
+            case L'w':
+                builtin = c_classWord;
+                return true;
+            case L'W':
+                builtin = c_classNotWord;
+                return true;
+            case L's':
+                builtin = c_classSpace;
+                return true;
+            case L'S':
+                builtin = c_classNotSpace;
+                return true;
+            case L't':
+                literal = L'\t';
+                return true;
+            case L'n':
+                literal = L'\n';
+                return true;
+            case L'r':
+                literal = L'\r';
+                return true;
+            case L'f':
+                literal = L'\f';
+                return true;
+            case L'v':
+                literal = L'\v';
+                return true;
+            case L'b':
+                // Only reached in a class, where it's a backspace
+                literal = L'\b';
+                return inClass;
+            case L'0':
+                // \0 followed by digits is an octal escape for some engines
+                literal = L'\0';
+                return !iswdigit(_Peek()) || _AtEnd();
+            case L'x':
+                return _ParseHex(2, literal);
+            case L'u':
+                return _ParseHex(4, literal);
+            default:
+                // Letters and digits are back references or engine specific escapes,
+                // other characters stand for themselves
+                if (iswalnum(c) || c == L'_')
+                {
+                    return false;
+                }
+                literal = c;
+                return true;
+            }
+        }
+
+        bool _ParseHex(_In_ UINT digits, _Out_ wchar_t& value)
+        {
+            value = 0;
+            for (UINT u = 0; u < digits; u++)
+            {
+                if (_AtEnd() || !iswxdigit(_Peek()))
+                {
+                    return false;
+                }
+                const wchar_t c = m_pattern[m_pos++];
+                value = static_cast<wchar_t>(value * 16 + (c <= L'9' ? c - L'0' : (towlower(c) - L'a' + 10)));
+            }
+            return true;
+        }
+
+        NodePtr _ParseClass()
+        {
+            CharSet set;
+            if (_Peek() == L'^')
+            {
+                set.negated = true;
+                m_pos++;
+            }
+
+            // An empty class is read differently by each engine
+            if (_Peek() == L']')
+            {
+                return nullptr;
+            }
+
+            while (!_AtEnd() && _Peek() != L']')
+            {
+                wchar_t first = 0;
+                BYTE builtin = 0;
+                if (!_ParseClassAtom(first, builtin))
+                {
+                    return nullptr;
+                }
+                if (builtin)
+                {
+                    set.builtins |= builtin;
+                    continue;
+                }
+
+                wchar_t last = first;
+                if (_Peek() == L'-' && m_pos + 1 < m_pattern.length() && m_pattern[m_pos + 1] != L']')
+                {
+                    m_pos++;
+                    if (!_ParseClassAtom(last, builtin) || builtin || last < first)
+                    {
+                        return nullptr;
+                    }
+                }
+                set.ranges.emplace_back(first, last);
+            }
+
+            if (_AtEnd())
+            {
+                return nullptr;
+            }
+            m_pos++;
+
+            m_classes.push_back(std::move(set));
+            NodePtr node = MakeNode(Node::Kind::Class);
+            node->index = static_cast<UINT>(m_classes.size() - 1);
+            return node;
+        }
+
+        bool _ParseClassAtom(_Out_ wchar_t& c, _Out_ BYTE& builtin)
+        {
+            builtin = 0;
+            c = m_pattern[m_pos++];
+            if (c == L'\\')
+            {
+                return _ParseEscapedChar(true, c, builtin);
+            }
+
+            // Leave [:alpha:] and the other POSIX classes to the engines supporting them
+            return !(c == L'[' && wcschr(L":.=", _Peek()) && !_AtEnd());
+        }
+
+        const std::wstring& m_pattern;
+        std::vector<CharSet>& m_classes;
+        size_t m_pos = 0;
+        UINT m_groupCount = 0;
+        UINT m_nesting = 0;
+    };
+
+    std::atomic<ULONGLONG> s_nextProgramId = 1;
+}
+
+struct CLinearRegEx::Program
+{
+    struct Class
+    {
+        CharSet set;
+        // Whether each ASCII character matches
+        bool ascii[128];
+    };
+
+    ULONGLONG id = 0;
+    std::vector<Instruction> instructions;
+    std::vector<Class> classes;
+    UINT groupCount = 0;
+    bool caseInsensitive = false;
+    // The lazy DFA doesn't track the previous character \b needs
+    bool useDfa = true;
+
+    size_t SlotCount() const { return 2 * (static_cast<size_t>(groupCount) + 1); }
+
+    bool ClassMatches(_In_ UINT index, _In_ wchar_t c) const
+    {
+        const Class& cls = classes[index];
+        if (c < ARRAYSIZE(cls.ascii))
+        {
+            return cls.ascii[c];
+        }
+        return _ClassMatchesSlow(cls.set, c);
+    }
+
+    bool _ClassMatchesSlow(_In_ const CharSet& set, _In_ wchar_t c) const
+    {
+        bool contains = set.Contains(c);
+        if (!contains && caseInsensitive)
+        {
+            contains = set.Contains(CLiteralMatcher::FoldCase(c)) || set.Contains(towupper(c));
+        }
+        return contains != set.negated;
+    }
+
+    // Whether the consuming instruction at pc accepts c
+    bool Accepts(_In_ UINT pc, _In_ wchar_t c) const
+    {
+        const Instruction& instruction = instructions[pc];
+        switch (instruction.op)
+        {
+        case Op::Char:
+            return (caseInsensitive ? CLiteralMatcher::FoldCase(c) : c) == instruction.c;
+        case Op::Class:
+            return ClassMatches(instruction.x, c);
+        case Op::Any:
+            return !IsLineTerminator(c);
+        default:
+            return false;
+        }
+    }
+
+    bool Emit(_In_ const Node& node)
+    {
+        switch (node.kind)
+        {
+        case Node::Kind::Empty:
+            break;
+        case Node::Kind::Char:
+            _Add(Op::Char, caseInsensitive ? CLiteralMatcher::FoldCase(node.c) : node.c);
+            break;
+        case Node::Kind::Any:
+            _Add(Op::Any);
+            break;
+        case Node::Kind::Class:
+            _Add(Op::Class, 0, node.index);
+            break;
+        case Node::Kind::Assert:
+            _Add(node.assertion);
+            useDfa = useDfa && node.assertion != Op::WordBoundary && node.assertion != Op::NotWordBoundary;
+            break;
+        case Node::Kind::Concat:
+            for (auto& child : node.children)
+            {
+                if (!Emit(*child))
+                {
+                    return false;
+                }
+            }
+            break;
+        case Node::Kind::Group:
+            if (node.group >= 0)
+            {
+                _Add(Op::Save, 0, 2 * node.group);
+            }
+            if (!Emit(*node.children[0]))
+            {
+                return false;
+            }
+            if (node.group >= 0)
+            {
+                _Add(Op::Save, 0, 2 * node.group + 1);
+            }
+            break;
+        case Node::Kind::Alternate:
+            return _EmitAlternate(node);
+        case Node::Kind::Repeat:
+            return _EmitRepeat(node);
+        }
+        return instructions.size() <= c_maxInstructions;
+    }
+
+    bool _EmitAlternate(_In_ const Node& node)
+    {
+        // split L1, L2; L1: a; jmp end; L2: split ...; last alternative
+        std::vector<UINT> jumps;
+        for (size_t i = 0; i < node.children.size(); i++)
+        {
+            const bool last = i + 1 == node.children.size();
+            const UINT split = last ? 0 : _Add(Op::Split);
+            if (!last)
+            {
+                instructions[split].x = split + 1;
+            }
+            if (!Emit(*node.children[i]))
+            {
+                return false;
+            }
+            if (!last)
+            {
+                jumps.push_back(_Add(Op::Jmp));
+                instructions[split].y = _Next();
+            }
+        }
+        for (UINT jump : jumps)
+        {
+            instructions[jump].x = _Next();
+        }
+        return instructions.size() <= c_maxInstructions;
+    }
+
+    bool _EmitRepeat(_In_ const Node& node)
+    {
+        const Node& child = *node.children[0];
+        if (node.max == c_unbounded && node.min > 0)
+        {
+            // min - 1 copies, then L: child; split L, next
+            for (UINT u = 0; u + 1 < node.min; u++)
+            {
+                if (!Emit(child))
+                {
+                    return false;
+                }
+            }
+            const UINT loop = _Next();
+            if (!Emit(child))
+            {
+                return false;
+            }
+            const UINT split = _Add(Op::Split);
+            _SetSplit(split, loop, _Next(), node.greedy);
+            return instructions.size() <= c_maxInstructions;
+        }
+
+        for (UINT u = 0; u < node.min; u++)
+        {
+            if (!Emit(child))
+            {
+                return false;
+            }
+        }
+
+        if (node.max == c_unbounded)
+        {
+            // L: split body, end; body: child; jmp L; end:
+            const UINT split = _Add(Op::Split);
+            if (!Emit(child))
+            {
+                return false;
+            }
+            const UINT jump = _Add(Op::Jmp);
+            instructions[jump].x = split;
+            _SetSplit(split, split + 1, _Next(), node.greedy);
+            return instructions.size() <= c_maxInstructions;
+        }
+
+        // Nested optional copies all skipping to the end: split body, end; body: child; ...
+        std::vector<UINT> splits;
+        for (UINT u = node.min; u < node.max; u++)
+        {
+            splits.push_back(_Add(Op::Split));
+            if (!Emit(child))
+            {
+                return false;
+            }
+        }
+        for (UINT split : splits)
+        {
+            _SetSplit(split, split + 1, _Next(), node.greedy);
+        }
+        return instructions.size() <= c_maxInstructions;
+    }
+
+    void _SetSplit(_In_ UINT split, _In_ UINT body, _In_ UINT skip, _In_ bool greedy)
+    {
+        instructions[split].x = greedy ? body : skip;
+        instructions[split].y = greedy ? skip : body;
+    }
+
+    UINT _Add(_In_ Op op, _In_ wchar_t c = 0, _In_ UINT x = 0)
+    {
+        instructions.push_back({ op, c, x, 0 });
+        return static_cast<UINT>(instructions.size() - 1);
+    }
+
+    UINT _Next() const { return static_cast<UINT>(instructions.size()); }
+};
+
+namespace
+{
+    // Threads of the Pike VM at one position, in priority order, with their captures
+    class CThreadList
+    {
+    public:
+        void Reset(_In_ size_t programSize, _In_ size_t slotCount)
+        {
+            m_slotCount = slotCount;
+            m_pcs.resize(programSize);
+            m_captures.resize(programSize * slotCount);
+            m_stamps.assign(programSize, 0);
+            m_generation = 0;
+            Clear();
+        }
+
+        void Clear()
+        {
+            m_count = 0;
+            if (++m_generation == 0)
+            {
+                std::fill(m_stamps.begin(), m_stamps.end(), 0);
+                m_generation = 1;
+            }
+        }
+
+        // Returns false if pc was already visited at this position
+        bool Visit(_In_ UINT pc)
+        {
+            if (m_stamps[pc] == m_generation)
+            {
+                return false;
+            }
+            m_stamps[pc] = m_generation;
+            return true;
+        }
+
+        void Add(_In_ UINT pc, _In_ const size_t* captures)
+        {
+            m_pcs[m_count] = pc;
+            std::copy(captures, captures + m_slotCount, m_captures.begin() + m_count * m_slotCount);
+            m_count++;
+        }
+
+        size_t Count() const { return m_count; }
+        UINT GetPc(_In_ size_t index) const { return m_pcs[index]; }
+        const size_t* GetCaptures(_In_ size_t index) const { return m_captures.data() + index * m_slotCount; }
+
+    private:
+        std::vector<UINT> m_pcs;
+        std::vector<size_t> m_captures;
+        std::vector<UINT> m_stamps;
+        UINT m_generation = 0;
+        size_t m_count = 0;
+        size_t m_slotCount = 0;
+    };
+
+    // Following the non consuming instructions from a pc, either to another pc or to
+    // restore a capture slot once the branch taken first is done
+    struct Frame
+    {
+        UINT pc;
+        int restoreSlot;
+        size_t restoreValue;
+    };
+
+    // Reused by the searches of a thread so a search doesn't allocate
+    struct VmScratch
+    {
+        CThreadList lists[2];
+        std::vector<Frame> stack;
+        std::vector<size_t> captures;
+    };
+    thread_local VmScratch t_vmScratch;
+
+    struct DfaState
+    {
+        // Consuming instructions, Match and AssertEnd reached, sorted
+        std::vector<UINT> pcs;
+        bool match = false;
+        bool matchAtEnd = false;
+        int next[128];
+        std::unordered_map<wchar_t, int> nextOther;
+    };
+
+    // Lazy DFA of the last pattern a thread ran.  Replace runs on several threads at
+    // the same time, each builds the states it needs.
+    struct DfaCache
+    {
+        ULONGLONG programId = 0;
+        bool full = false;
+        std::vector<std::unique_ptr<DfaState>> states;
+        std::map<std::vector<UINT>, int> index;
+        std::vector<UINT> stack;
+        std::vector<bool> visited;
+        std::vector<UINT> touched;
+    };
+    thread_local DfaCache t_dfaCache;
+}
+
+CLinearRegEx::CLinearRegEx() = default;
+CLinearRegEx::~CLinearRegEx() = default;
+CLinearRegEx::CLinearRegEx(CLinearRegEx&&) noexcept = default;
+CLinearRegEx& CLinearRegEx::operator=(CLinearRegEx&&) noexcept = default;
+
+bool CLinearRegEx::Compile(_In_ const std::wstring& pattern, _In_ bool caseInsensitive)
+{
+    m_program.reset();
+
+    std::vector<CharSet> sets;
+    CParser parser(pattern, sets);
+    NodePtr root = parser.Parse();
+    if (!root)
+    {
+        return false;
+    }
+
+    auto program = std::make_unique<Program>();
+    program->id = s_nextProgramId++;
+    program->groupCount = parser.GroupCount();
+    program->caseInsensitive = caseInsensitive;
+    program->classes.resize(sets.size());
+    for (size_t i = 0; i < sets.size(); i++)
+    {
+        Program::Class& cls = program->classes[i];
+        cls.set = std::move(sets[i]);
+        for (wchar_t c = 0; c < ARRAYSIZE(cls.ascii); c++)
+        {
+            cls.ascii[c] = program->_ClassMatchesSlow(cls.set, c);
+        }
+    }
+
+    program->_Add(Op::Save, 0, 0);
+    if (!program->Emit(*root))
+    {
+        return false;
+    }
+    program->_Add(Op::Save, 0, 1);
+    program->_Add(Op::Match);
+
+    m_program = std::move(program);
+    return true;
+}
+
+UINT CLinearRegEx::GroupCount() const
+{
+    return m_program ? m_program->groupCount : 0;
+}
+
+bool CLinearRegEx::PrepareReplacement(_In_ const std::wstring& replaceTerm, _Out_ Replacement& replacement) const
+{
+    replacement.clear();
+    ReplacePart part;
+    for (size_t i = 0; i < replaceTerm.length(); i++)
+    {
+        if (replaceTerm[i] != L'$')
+        {
+            part.text += replaceTerm[i];
+            continue;
+        }
+
+        const wchar_t next = i + 1 < replaceTerm.length() ? replaceTerm[i + 1] : L'\0';
+        const wchar_t after = i + 2 < replaceTerm.length() ? replaceTerm[i + 2] : L'\0';
+        if (next == L'$')
+        {
+            part.text += L'$';
+            i++;
+        }
+        else if (next >= L'1' && next <= L'9' && !(after >= L'0' && after <= L'9') && static_cast<UINT>(next - L'0') <= GroupCount())
+        {
+            part.group = next - L'0';
+            replacement.push_back(std::move(part));
+            part = ReplacePart();
+            i++;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (!part.text.empty())
+    {
+        replacement.push_back(std::move(part));
+    }
+    return true;
+}
+
+bool CLinearRegEx::Search(_In_reads_(length) const wchar_t* data, _In_ size_t length, _In_ size_t start, _In_ bool notNull, _In_ bool continuous, _Out_ Match& match) const
+{
+    match = Match();
+    if (!m_program || start > length)
+    {
+        return false;
+    }
+
+    const Program& program = *m_program;
+    const size_t slotCount = program.SlotCount();
+    VmScratch& scratch = t_vmScratch;
+    CThreadList* current = &scratch.lists[0];
+    CThreadList* next = &scratch.lists[1];
+    current->Reset(program.instructions.size(), slotCount);
+    next->Reset(program.instructions.size(), slotCount);
+    scratch.captures.resize(slotCount);
+
+    // Adds the thread at pc and the ones it leads to without consuming, in priority order
+    auto addThread = [&](CThreadList& list, UINT startPc, size_t position, const size_t* captures) {
+        std::copy(captures, captures + slotCount, scratch.captures.begin());
+        scratch.stack.clear();
+        scratch.stack.push_back({ startPc, -1, 0 });
+        while (!scratch.stack.empty())
+        {
+            Frame frame = scratch.stack.back();
+            scratch.stack.pop_back();
+            if (frame.restoreSlot >= 0)
+            {
+                scratch.captures[frame.restoreSlot] = frame.restoreValue;
+                continue;
+            }
+
+            UINT pc = frame.pc;
+            while (list.Visit(pc))
+            {
+                const Instruction& instruction = program.instructions[pc];
+                bool follow = true;
+                switch (instruction.op)
+                {
+                case Op::Jmp:
+                    pc = instruction.x;
+                    continue;
+                case Op::Split:
+                    scratch.stack.push_back({ instruction.y, -1, 0 });
+                    pc = instruction.x;
+                    continue;
+                case Op::Save:
+                    scratch.stack.push_back({ 0, static_cast<int>(instruction.x), scratch.captures[instruction.x] });
+                    scratch.captures[instruction.x] = position;
+                    break;
+                case Op::AssertBegin:
+                    follow = position == 0;
+                    break;
+                case Op::AssertEnd:
+                    follow = position == length;
+                    break;
+                case Op::WordBoundary:
+                case Op::NotWordBoundary:
+                {
+                    const bool before = position > 0 && IsWordChar(data[position - 1]);
+                    const bool after = position < length && IsWordChar(data[position]);
+                    follow = (before != after) == (instruction.op == Op::WordBoundary);
+                    break;
+                }
+                default:
+                    list.Add(pc, scratch.captures.data());
+                    follow = false;
+                    break;
+                }
+
+                if (!follow)
+                {
+                    break;
+                }
+                pc++;
+            }
+        }
+    };
+
+    std::vector<size_t> noCaptures(slotCount, c_noPosition);
+    bool matched = false;
+    for (size_t position = start;; position++)
+    {
+        // A thread starting here has a lower priority than the ones that started earlier
+        if (!matched && (position == start || !continuous))
+        {
+            addThread(*current, 0, position, noCaptures.data());
+        }
+        if (current->Count() == 0 && (matched || continuous))
+        {
+            break;
+        }
+
+        for (size_t i = 0; i < current->Count(); i++)
+        {
+            const UINT pc = current->GetPc(i);
+            const size_t* captures = current->GetCaptures(i);
+            if (program.instructions[pc].op == Op::Match)
+            {
+                if (notNull && captures[0] == position)
+                {
+                    continue;
+                }
+                // The threads after this one have a lower priority
+                matched = true;
+                match.groups.assign(captures, captures + slotCount);
+                break;
+            }
+            if (position < length && program.Accepts(pc, data[position]))
+            {
+                addThread(*next, pc + 1, position + 1, captures);
+            }
+        }
+
+        std::swap(current, next);
+        next->Clear();
+        if (position >= length)
+        {
+            break;
+        }
+    }
+
+    if (matched)
+    {
+        match.start = match.groups[0];
+        match.end = match.groups[1];
+    }
+    return matched;
+}
+
+bool CLinearRegEx::_CanMatch(_In_reads_(length) const wchar_t* data, _In_ size_t length) const
+{
+    const Program& program = *m_program;
+    if (!program.useDfa)
+    {
+        return true;
+    }
+
+    DfaCache& cache = t_dfaCache;
+    if (cache.programId != program.id)
+    {
+        cache.programId = program.id;
+        cache.full = false;
+        cache.states.clear();
+        cache.index.clear();
+        cache.visited.assign(program.instructions.size(), false);
+    }
+    if (cache.full)
+    {
+        return true;
+    }
+
+    // Leaves reached from the pcs of starts without consuming, no priority is kept
+    auto closure = [&](const std::vector<UINT>& starts, bool atStart, bool atEnd) {
+        std::vector<UINT> leaves;
+        cache.stack.assign(starts.begin(), starts.end());
+        while (!cache.stack.empty())
+        {
+            UINT pc = cache.stack.back();
+            cache.stack.pop_back();
+            if (cache.visited[pc])
+            {
+                continue;
+            }
+            cache.visited[pc] = true;
+            cache.touched.push_back(pc);
+
+            const Instruction& instruction = program.instructions[pc];
+            switch (instruction.op)
+            {
+            case Op::Jmp:
+                cache.stack.push_back(instruction.x);
+                break;
+            case Op::Split:
+                cache.stack.push_back(instruction.y);
+                cache.stack.push_back(instruction.x);
+                break;
+            case Op::Save:
+                cache.stack.push_back(pc + 1);
+                break;
+            case Op::AssertBegin:
+                if (atStart)
+                {
+                    cache.stack.push_back(pc + 1);
+                }
+                break;
+            case Op::AssertEnd:
+                if (atEnd)
+                {
+                    cache.stack.push_back(pc + 1);
+                }
+                else
+                {
+                    leaves.push_back(pc);
+                }
+                break;
+            default:
+                leaves.push_back(pc);
+                break;
+            }
+        }
+        for (UINT pc : cache.touched)
+        {
+            cache.visited[pc] = false;
+        }
+        cache.touched.clear();
+        std::sort(leaves.begin(), leaves.end());
+        return leaves;
+    };
+
+    auto findState = [&](std::vector<UINT> pcs, bool atStart) {
+        // The start state is told apart since ^ can still match at its end
+        std::vector<UINT> key = pcs;
+        if (atStart)
+        {
+            key.push_back(UINT_MAX);
+        }
+        auto it = cache.index.find(key);
+        if (it != cache.index.end())
+        {
+            return it->second;
+        }
+        if (cache.states.size() >= c_maxDfaStates)
+        {
+            cache.full = true;
+            return -1;
+        }
+
+        auto state = std::make_unique<DfaState>();
+        std::vector<UINT> ends;
+        for (UINT pc : pcs)
+        {
+            if (program.instructions[pc].op == Op::Match)
+            {
+                state->match = true;
+            }
+            else if (program.instructions[pc].op == Op::AssertEnd)
+            {
+                ends.push_back(pc + 1);
+            }
+        }
+        for (UINT pc : closure(ends, atStart, true))
+        {
+            state->matchAtEnd = state->matchAtEnd || program.instructions[pc].op == Op::Match;
+        }
+        std::fill(std::begin(state->next), std::end(state->next), -1);
+        state->pcs = std::move(pcs);
+
+        const int index = static_cast<int>(cache.states.size());
+        cache.states.push_back(std::move(state));
+        cache.index.emplace(std::move(key), index);
+        return index;
+    };
+
+    auto step = [&](int from, wchar_t c) {
+        int* cached = nullptr;
+        DfaState& state = *cache.states[from];
+        if (c < ARRAYSIZE(state.next))
+        {
+            cached = &state.next[c];
+        }
+        else
+        {
+            auto it = state.nextOther.find(c);
+            if (it != state.nextOther.end())
+            {
+                return it->second;
+            }
+        }
+        if (cached && *cached >= 0)
+        {
+            return *cached;
+        }
+
+        // Threads moving past c, and a new one since a match can start at any position
+        std::vector<UINT> targets{ 0 };
+        for (UINT pc : state.pcs)
+        {
+            if (program.Accepts(pc, c))
+            {
+                targets.push_back(pc + 1);
+            }
+        }
+        const int to = findState(closure(targets, false, false), false);
+        if (to >= 0)
+        {
+            if (cached)
+            {
+                *cached = to;
+            }
+            else
+            {
+                state.nextOther.emplace(c, to);
+            }
+        }
+        return to;
+    };
+
+    int state = cache.states.empty() ? findState(closure({ 0 }, true, false), true) : 0;
+    for (size_t i = 0; i < length && state >= 0; i++)
+    {
+        if (cache.states[state]->match)
+        {
+            return true;
+        }
+        state = step(state, data[i]);
+    }
+    return state < 0 || cache.states[state]->match || cache.states[state]->matchAtEnd;
+}
+
+std::wstring CLinearRegEx::Replace(_In_ const std::wstring& source, _In_ const Replacement& replacement, _In_ bool allOccurrences) const
+{
+    const wchar_t* data = source.c_str();
+    const size_t length = source.length();
+    if (!m_program || !_CanMatch(data, length))
+    {
+        return source;
+    }
+
+    std::wstring result;
+    size_t copied = 0;
+    size_t searchFrom = 0;
+    bool afterEmptyMatch = false;
+    Match match;
+    for (;;)
+    {
+        // After an empty match, look for a non empty one at the same position before
+        // moving on, like regex_iterator does
+        bool found = false;
+        if (afterEmptyMatch)
+        {
+            found = Search(data, length, searchFrom, true, true, match);
+            if (!found && searchFrom < length)
+            {
+                found = Search(data, length, searchFrom + 1, false, false, match);
+            }
+        }
+        else
+        {
+            found = Search(data, length, searchFrom, false, false, match);
+        }
+        if (!found)
+        {
+            break;
+        }
+
+        result.append(data + copied, match.start - copied);
+        for (auto& part : replacement)
+        {
+            result += part.text;
+            if (part.group >= 0)
+            {
+                const size_t groupStart = match.groups[2 * part.group];
+                const size_t groupEnd = match.groups[2 * part.group + 1];
+                if (groupStart != c_noPosition && groupEnd != c_noPosition)
+                {
+                    result.append(data + groupStart, groupEnd - groupStart);
+                }
+            }
+        }
+        copied = match.end;
+
+        if (!allOccurrences)
+        {
+            break;
+        }
+        afterEmptyMatch = match.start == match.end;
+        searchFrom = match.end;
+    }
+
+    result.append(data + copied, length - copied);
+    return result;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+// Regular expression matcher running in time linear in the length of the input, for
+// the ECMAScript subset rename patterns use: literals, ., classes, \d \w \s and their
+// negations, ^ $ \b \B, greedy and lazy quantifiers, alternation and groups.
+// The pattern is compiled to a Thompson NFA.  A lazy DFA built from it tells whether
+// a name can match at all, then a Pike VM finds the match and its captures with the
+// same leftmost-first priorities as a backtracking engine.
+// Patterns using anything else (back references, lookarounds, ...) aren't compiled,
+// the caller keeps using a backtracking engine for them.
+// A compiled pattern can be used by several threads at the same time.
+class CLinearRegEx
+{
+public:
+    // Capture groups a pattern can have
+    static const UINT c_maxGroups = 32;
+
+    // Part of a replace term, either literal text or a group of the match
+    struct ReplacePart
+    {
+        std::wstring text;
+        // Group inserted after text, -1 for none
+        int group = -1;
+    };
+    typedef std::vector<ReplacePart> Replacement;
+
+    struct Match
+    {
+        size_t start = 0;
+        size_t end = 0;
+        // Start and end of group n at 2 * n and 2 * n + 1, group 0 being the whole match.
+        // npos for the groups that didn't participate.
+        std::vector<size_t> groups;
+    };
+
+    CLinearRegEx();
+    ~CLinearRegEx();
+    CLinearRegEx(CLinearRegEx&&) noexcept;
+    CLinearRegEx& operator=(CLinearRegEx&&) noexcept;
+
+    // Returns false if the pattern uses something the automaton doesn't support
+    bool Compile(_In_ const std::wstring& pattern, _In_ bool caseInsensitive);
+    bool IsCompiled() const { return m_program != nullptr; }
+    // Number of capture groups, not counting the whole match
+    UINT GroupCount() const;
+
+    // Parses a replace term made of text, $$ and $1 to $9.  Returns false if it uses
+    // another $ sequence, whose meaning depends on the backtracking engine and on the
+    // rewrite CPowerRenameRegEx applies to the replace term before it.
+    bool PrepareReplacement(_In_ const std::wstring& replaceTerm, _Out_ Replacement& replacement) const;
+
+    // Finds the first match starting at or after start.  With notNull an empty match
+    // isn't accepted, with continuous the match must start at start.
+    bool Search(_In_reads_(length) const wchar_t* data, _In_ size_t length, _In_ size_t start, _In_ bool notNull, _In_ bool continuous, _Out_ Match& match) const;
+
+    // Same result as regex_replace with the backtracking engines
+    std::wstring Replace(_In_ const std::wstring& source, _In_ const Replacement& replacement, _In_ bool allOccurrences) const;
+
+private:
+    struct Program;
+
+    bool _CanMatch(_In_reads_(length) const wchar_t* data, _In_ size_t length) const;
+
+    std::unique_ptr<Program> m_program;
+};
@@ -0,0 +1,231 @@
+#include "pch.h"
+#include "LiteralMatcher.h"
+#include <memory>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#define LITERAL_MATCHER_SSE2
+#endif
+
+namespace
+{
+    const size_t c_codeUnitCount = 0x10000;
+
+    struct FoldTable
+    {
+        std::unique_ptr<wchar_t[]> fold;
+        // True if towlower of ASCII is the plain A-Z to a-z mapping, which is what
+        // the SIMD compare folds.  Otherwise every unit goes through the table.
+        bool simpleAscii = true;
+    };
+
+    const FoldTable& GetFoldTable()
+    {
+        static const FoldTable table = [] {
+            FoldTable t;
+            t.fold = std::make_unique<wchar_t[]>(c_codeUnitCount);
+            for (size_t c = 0; c < c_codeUnitCount; c++)
+            {
+                t.fold[c] = static_cast<wchar_t>(towlower(static_cast<wint_t>(c)));
+            }
+            for (wchar_t c = 0; c < 0x80; c++)
+            {
+                const wchar_t expected = (c >= L'A' && c <= L'Z') ? c + (L'a' - L'A') : c;
+                if (t.fold[c] != expected)
+                {
+                    t.simpleAscii = false;
+                    break;
+                }
+            }
+            return t;
+        }();
+        return table;
+    }
+
+#ifdef LITERAL_MATCHER_SSE2
+    // Lowercases the 8 code units of block if they are all ASCII.
+    // Returns false, leaving folded untouched, if any of them isn't.
+    bool FoldAsciiBlock(_In_ __m128i block, _Out_ __m128i* folded)
+    {
+        const __m128i nonAscii = _mm_and_si128(block, _mm_set1_epi16(static_cast<short>(0xFF80)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(nonAscii, _mm_setzero_si128())) != 0xFFFF)
+        {
+            return false;
+        }
+
+        // Values are below 0x80 so the signed compares are safe
+        const __m128i upper = _mm_and_si128(_mm_cmpgt_epi16(block, _mm_set1_epi16(L'A' - 1)),
+                                            _mm_cmplt_epi16(block, _mm_set1_epi16(L'Z' + 1)));
+        *folded = _mm_or_si128(block, _mm_and_si128(upper, _mm_set1_epi16(0x20)));
+        return true;
+    }
+#endif
+}
+
+CLiteralMatcher::CLiteralMatcher(_In_ const std::wstring& searchTerm, _In_ bool caseInsensitive) :
+    m_searchTerm(searchTerm),
+    m_caseInsensitive(caseInsensitive)
+{
+    if (m_searchTerm.empty())
+    {
+        return;
+    }
+
+    if (!m_caseInsensitive)
+    {
+        m_firstUnits[m_firstUnitCount++] = m_searchTerm[0];
+        return;
+    }
+
+    const wchar_t* fold = GetFoldTable().fold.get();
+    for (auto& c : m_searchTerm)
+    {
+        c = fold[static_cast<unsigned short>(c)];
+    }
+
+    // Every unit folding to the same value as the first one is a candidate,
+    // e.g. 'K', 'k' and the Kelvin sign for "k"
+    for (size_t c = 0; c < c_codeUnitCount; c++)
+    {
+        if (fold[c] == m_searchTerm[0])
+        {
+            if (m_firstUnitCount == c_maxFirstUnits)
+            {
+                m_firstUnitCount = 0;
+                break;
+            }
+            m_firstUnits[m_firstUnitCount++] = static_cast<wchar_t>(c);
+        }
+    }
+}
+
+wchar_t CLiteralMatcher::FoldCase(_In_ wchar_t c)
+{
+    return GetFoldTable().fold[static_cast<unsigned short>(c)];
+}
+
+size_t CLiteralMatcher::Find(_In_reads_(length) const wchar_t* data, _In_ size_t length, _In_ size_t pos) const
+{
+    const size_t searchTermLength = m_searchTerm.length();
+    if (pos > length || length - pos < searchTermLength)
+    {
+        return std::wstring::npos;
+    }
+    if (searchTermLength == 0)
+    {
+        return pos;
+    }
+
+    const size_t lastStart = length - searchTermLength;
+
+#ifdef LITERAL_MATCHER_SSE2
+    if (m_firstUnitCount > 0)
+    {
+        __m128i firstUnits[c_maxFirstUnits];
+        for (size_t i = 0; i < m_firstUnitCount; i++)
+        {
+            firstUnits[i] = _mm_set1_epi16(static_cast<short>(m_firstUnits[i]));
+        }
+
+        // Look for candidate starts 8 units at a time
+        for (; pos + 8 <= length && pos <= lastStart; pos += 8)
+        {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+            __m128i eq = _mm_cmpeq_epi16(block, firstUnits[0]);
+            for (size_t i = 1; i < m_firstUnitCount; i++)
+            {
+                eq = _mm_or_si128(eq, _mm_cmpeq_epi16(block, firstUnits[i]));
+            }
+
+            unsigned long mask = static_cast<unsigned long>(_mm_movemask_epi8(eq));
+            while (mask != 0)
+            {
+                unsigned long bit;
+                _BitScanForward(&bit, mask);
+                const size_t candidate = pos + bit / 2;
+                if (candidate > lastStart)
+                {
+                    return std::wstring::npos;
+                }
+                if (_MatchesAt(data + candidate))
+                {
+                    return candidate;
+                }
+                // Each unit sets two mask bits
+                mask &= ~(3UL << bit);
+            }
+        }
+    }
+#endif
+
+    if (!m_caseInsensitive)
+    {
+        for (; pos <= lastStart; pos++)
+        {
+            if (data[pos] == m_searchTerm[0] && _MatchesAt(data + pos))
+            {
+                return pos;
+            }
+        }
+        return std::wstring::npos;
+    }
+
+    const wchar_t* fold = GetFoldTable().fold.get();
+    for (; pos <= lastStart; pos++)
+    {
+        if (fold[static_cast<unsigned short>(data[pos])] == m_searchTerm[0] && _MatchesAt(data + pos))
+        {
+            return pos;
+        }
+    }
+    return std::wstring::npos;
+}
+
+bool CLiteralMatcher::_MatchesAt(_In_ const wchar_t* data) const
+{
+    const size_t searchTermLength = m_searchTerm.length();
+    const wchar_t* searchTerm = m_searchTerm.c_str();
+    if (!m_caseInsensitive)
+    {
+        return std::char_traits<wchar_t>::compare(data, searchTerm, searchTermLength) == 0;
+    }
+
+    const FoldTable& table = GetFoldTable();
+    size_t i = 0;
+#ifdef LITERAL_MATCHER_SSE2
+    if (table.simpleAscii)
+    {
+        for (; i + 8 <= searchTermLength; i += 8)
+        {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i folded;
+            if (FoldAsciiBlock(block, &folded))
+            {
+                const __m128i expected = _mm_loadu_si128(reinterpret_cast<const __m128i*>(searchTerm + i));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi16(folded, expected)) != 0xFFFF)
+                {
+                    return false;
+                }
+                continue;
+            }
+
+            for (size_t j = i; j < i + 8; j++)
+            {
+                if (table.fold[static_cast<unsigned short>(data[j])] != searchTerm[j])
+                {
+                    return false;
+                }
+            }
+        }
+    }
+#endif
+
+    for (; i < searchTermLength; i++)
+    {
+        if (table.fold[static_cast<unsigned short>(data[i])] != searchTerm[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+
+// Finds the occurrences of a literal search term, optionally ignoring case.
+// Case folding matches towlower applied to each UTF-16 code unit, which is what
+// the simple search and replace has always used.  The search term is prepared
+// once so Find can be called for many names without allocating.
+class CLiteralMatcher
+{
+public:
+    CLiteralMatcher() = default;
+    CLiteralMatcher(_In_ const std::wstring& searchTerm, _In_ bool caseInsensitive);
+
+    // Returns the position of the first occurrence starting at or after pos,
+    // or std::wstring::npos if there is none.
+    size_t Find(_In_reads_(length) const wchar_t* data, _In_ size_t length, _In_ size_t pos) const;
+
+    bool Contains(_In_reads_(length) const wchar_t* data, _In_ size_t length) const
+    {
+        return Find(data, length, 0) != std::wstring::npos;
+    }
+
+    size_t SearchTermLength() const { return m_searchTerm.length(); }
+
+    static wchar_t FoldCase(_In_ wchar_t c);
+
+private:
+    bool _MatchesAt(_In_ const wchar_t* data) const;
+
+    // Code units folding to the first unit of the search term, scanned for with SIMD
+    // compares.  Empty if there are too many of them to be worth it.
+    static const size_t c_maxFirstUnits = 4;
+
+    std::wstring m_searchTerm; // Already folded when case insensitive
+    bool m_caseInsensitive = false;
+    wchar_t m_firstUnits[c_maxFirstUnits] = {};
+    size_t m_firstUnitCount = 0;
+};
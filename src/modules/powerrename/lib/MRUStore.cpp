@@ -0,0 +1,261 @@
+#include "pch.h"
+#include "MRUStore.h"
+#include <cstring>
+#include <fstream>
+#include <random>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const char c_magic[4] = { 'P', 'R', 'M', 'U' };
+    const uint32_t c_version = 1;
+    // Magic, version, generation
+    const size_t c_headerSize = sizeof(c_magic) + sizeof(uint32_t) + sizeof(uint64_t);
+    // Length, checksum
+    const size_t c_recordOverhead = sizeof(uint32_t) + sizeof(uint32_t);
+    // Longer strings are taken for a damaged record
+    const uint32_t c_maxRecordLength = 32768;
+
+    // The log is compacted once it has this many records per string of the list
+    const unsigned int c_compactionRecordsPerItem = 4;
+
+    uint32_t Checksum(_In_ const char* data, _In_ size_t size)
+    {
+        // FNV-1a
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+        }
+        return hash;
+    }
+
+    void WriteUInt(_Inout_ std::string& buffer, _In_ uint64_t value, _In_ size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            buffer += static_cast<char>((value >> (8 * i)) & 0xFF);
+        }
+    }
+
+    uint64_t ReadUInt(_In_ const std::string& buffer, _In_ size_t pos, _In_ size_t size)
+    {
+        uint64_t value = 0;
+        for (size_t i = 0; i < size; i++)
+        {
+            value |= static_cast<uint64_t>(static_cast<unsigned char>(buffer[pos + i])) << (8 * i);
+        }
+        return value;
+    }
+
+    uint64_t NewGeneration()
+    {
+        std::random_device random;
+        uint64_t generation = 0;
+        while (generation == 0)
+        {
+            generation = (static_cast<uint64_t>(random()) << 32) | random();
+        }
+        return generation;
+    }
+}
+
+CMRUStore::CMRUStore(unsigned int size, _In_ const fs::path& logPath) :
+    m_size(size), m_logPath(logPath)
+{
+}
+
+void CMRUStore::Load(_In_ const std::vector<std::wstring>& snapshot)
+{
+    m_items.clear();
+    m_index.clear();
+    for (const std::wstring& item : snapshot)
+    {
+        _Push(item);
+    }
+
+    m_logGeneration = 0;
+    m_logSize = 0;
+    m_logRecordCount = 0;
+    m_logDamaged = false;
+    _ReadLog();
+}
+
+HRESULT CMRUStore::Refresh()
+{
+    return _ReadLog();
+}
+
+bool CMRUStore::Push(_In_ const std::wstring& data)
+{
+    if (!m_items.empty() && m_items.front() == data)
+    {
+        return false;
+    }
+
+    _Push(data);
+    _AppendLog(data);
+    return true;
+}
+
+void CMRUStore::Resize(unsigned int size)
+{
+    m_size = size;
+    _Trim();
+}
+
+std::vector<std::wstring> CMRUStore::GetItems() const
+{
+    return std::vector<std::wstring>(m_items.begin(), m_items.end());
+}
+
+bool CMRUStore::NeedsCompaction() const
+{
+    return m_logDamaged || m_logRecordCount >= c_compactionRecordsPerItem * max(m_size, 1u);
+}
+
+void CMRUStore::TruncateLog()
+{
+    std::error_code error;
+    fs::remove(m_logPath, error);
+    m_logGeneration = 0;
+    m_logSize = 0;
+    m_logRecordCount = 0;
+    m_logDamaged = false;
+}
+
+void CMRUStore::_Push(_In_ const std::wstring& data)
+{
+    const size_t hash = std::hash<std::wstring>()(data);
+    auto range = m_index.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (*it->second == data)
+        {
+            m_items.splice(m_items.begin(), m_items, it->second);
+            return;
+        }
+    }
+
+    m_items.push_front(data);
+    m_index.emplace(hash, m_items.begin());
+    _Trim();
+}
+
+void CMRUStore::_Trim()
+{
+    while (m_items.size() > m_size)
+    {
+        auto range = m_index.equal_range(std::hash<std::wstring>()(m_items.back()));
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second == std::prev(m_items.end()))
+            {
+                m_index.erase(it);
+                break;
+            }
+        }
+        m_items.pop_back();
+    }
+}
+
+HRESULT CMRUStore::_ReadLog()
+{
+    std::string content;
+    {
+        std::ifstream file(m_logPath, std::ios::binary);
+        if (file.is_open())
+        {
+            using isbi = std::istreambuf_iterator<char>;
+            content.assign(isbi{ file }, isbi{});
+        }
+    }
+
+    // A missing log, or one whose header wasn't written completely, has no records
+    if (content.size() < c_headerSize || memcmp(content.data(), c_magic, sizeof(c_magic)) != 0 ||
+        ReadUInt(content, sizeof(c_magic), sizeof(uint32_t)) != c_version)
+    {
+        return (m_logGeneration != 0) ? S_FALSE : S_OK;
+    }
+
+    const uint64_t generation = ReadUInt(content, sizeof(c_magic) + sizeof(uint32_t), sizeof(uint64_t));
+    if (m_logGeneration != 0 && (generation != m_logGeneration || content.size() < m_logSize))
+    {
+        return S_FALSE;
+    }
+    m_logGeneration = generation;
+
+    size_t pos = max(static_cast<size_t>(m_logSize), c_headerSize);
+    while (pos + c_recordOverhead <= content.size())
+    {
+        const uint32_t length = static_cast<uint32_t>(ReadUInt(content, pos, sizeof(uint32_t)));
+        const size_t dataSize = static_cast<size_t>(length) * 2;
+        if (length > c_maxRecordLength)
+        {
+            m_logDamaged = true;
+            break;
+        }
+        if (pos + c_recordOverhead + dataSize > content.size())
+        {
+            // Still being written, or torn by a crash
+            break;
+        }
+        if (ReadUInt(content, pos + sizeof(uint32_t) + dataSize, sizeof(uint32_t)) != Checksum(content.data() + pos, sizeof(uint32_t) + dataSize))
+        {
+            m_logDamaged = true;
+            break;
+        }
+
+        std::wstring data(length, L'\0');
+        for (uint32_t i = 0; i < length; i++)
+        {
+            data[i] = static_cast<wchar_t>(ReadUInt(content, pos + sizeof(uint32_t) + 2 * i, 2));
+        }
+        _Push(data);
+        m_logRecordCount++;
+        pos += c_recordOverhead + dataSize;
+    }
+    m_logSize = pos;
+    return S_OK;
+}
+
+void CMRUStore::_AppendLog(_In_ const std::wstring& data)
+{
+    std::string buffer;
+    std::error_code error;
+    uint64_t fileSize = fs::file_size(m_logPath, error);
+    const bool create = error || m_logGeneration == 0 || fileSize < c_headerSize;
+    if (create)
+    {
+        m_logGeneration = NewGeneration();
+        m_logSize = 0;
+        m_logRecordCount = 0;
+        fileSize = 0;
+        buffer.append(c_magic, sizeof(c_magic));
+        WriteUInt(buffer, c_version, sizeof(uint32_t));
+        WriteUInt(buffer, m_logGeneration, sizeof(uint64_t));
+    }
+
+    const size_t recordStart = buffer.size();
+    WriteUInt(buffer, data.length(), sizeof(uint32_t));
+    for (wchar_t c : data)
+    {
+        WriteUInt(buffer, static_cast<uint16_t>(c), 2);
+    }
+    WriteUInt(buffer, Checksum(buffer.data() + recordStart, buffer.size() - recordStart), sizeof(uint32_t));
+
+    std::ofstream file(m_logPath, std::ios::binary | (create ? std::ios::trunc : std::ios::app));
+    if (!file.is_open() || !file.write(buffer.data(), buffer.size()))
+    {
+        return;
+    }
+
+    // If another process appended since the log was read, its records and this one
+    // are read by the next Refresh
+    if (fileSize == m_logSize)
+    {
+        m_logSize += buffer.size();
+        m_logRecordCount++;
+    }
+}
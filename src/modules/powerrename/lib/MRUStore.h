@@ -0,0 +1,62 @@
+#pragma once
+#include "pch.h"
+#include <filesystem>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Most recently used strings, newest first and without duplicates, looked up by
+// hash.  Each Push is appended to a log file instead of rewriting the list; the
+// owner writes a snapshot of the strings and calls TruncateLog once NeedsCompaction.
+// Replaying a log over a snapshot that already has its strings gives the same
+// list, so the log can be truncated after the snapshot is written.
+// Other processes may append to the same log, Refresh reads what they added.
+// Not thread safe.
+class CMRUStore
+{
+public:
+    CMRUStore(unsigned int size, _In_ const std::filesystem::path& logPath);
+
+    // Replaces the strings by the snapshot, oldest first, then replays the log
+    void Load(_In_ const std::vector<std::wstring>& snapshot);
+
+    // Reads the records appended to the log since it was last read.  Returns S_FALSE
+    // if the log was truncated meanwhile, the snapshot must be loaded again.
+    HRESULT Refresh();
+
+    // Puts data on top and appends it to the log, which must have been read by Load
+    // or Refresh.  Returns false if data already was on top, nothing is written then.
+    bool Push(_In_ const std::wstring& data);
+
+    // Keeps the newest size strings
+    void Resize(unsigned int size);
+
+    // Newest first
+    std::vector<std::wstring> GetItems() const;
+    unsigned int GetSize() const { return m_size; }
+
+    bool NeedsCompaction() const;
+    // Deletes the log, once a snapshot of GetItems was written
+    void TruncateLog();
+
+private:
+    void _Push(_In_ const std::wstring& data);
+    void _Trim();
+    HRESULT _ReadLog();
+    void _AppendLog(_In_ const std::wstring& data);
+
+    unsigned int m_size;
+    // Newest first, indexed by the hash of the strings
+    std::list<std::wstring> m_items;
+    std::unordered_multimap<size_t, std::list<std::wstring>::iterator> m_index;
+
+    const std::filesystem::path m_logPath;
+    // Identifies the log file read, a new one is created after each truncation
+    uint64_t m_logGeneration = 0;
+    // Bytes of the log read or written by this instance
+    uint64_t m_logSize = 0;
+    unsigned int m_logRecordCount = 0;
+    // Set when a record can't be read, the log is compacted then
+    bool m_logDamaged = false;
+};
@@ -0,0 +1,210 @@
+#include "pch.h"
+#include "PowerRenameEngine.h"
+#include "Helpers.h"
+#include "LiteralMatcher.h"
+#include "UniqueNameResolver.h"
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+bool IsExcludedFromRename(bool isFolder, bool isSubFolderContent, DWORD flags)
+{
+    return (isFolder && (flags & PowerRenameFlags::ExcludeFolders)) ||
+           (!isFolder && (flags & PowerRenameFlags::ExcludeFiles)) ||
+           (isSubFolderContent && (flags & PowerRenameFlags::ExcludeSubfolders));
+}
+
+HRESULT GetRenamedFileName(_In_ IPowerRenameRegEx* renameRegEx,
+                           _In_ PCWSTR originalName,
+                           DWORD flags,
+                           _In_opt_ const SYSTEMTIME* fileTime,
+                           _In_opt_ const CLiteralMatcher* literalMatcher,
+                           _Out_opt_ bool* isMatch,
+                           _Out_ std::optional<std::wstring>& newName)
+{
+    newName.reset();
+    if (isMatch)
+    {
+        *isMatch = false;
+    }
+
+    wchar_t sourceName[MAX_PATH] = { 0 };
+    if (flags & NameOnly)
+    {
+        StringCchCopy(sourceName, ARRAYSIZE(sourceName), fs::path(originalName).stem().c_str());
+    }
+    else if (flags & ExtensionOnly)
+    {
+        std::wstring extension = fs::path(originalName).extension().wstring();
+        if (!extension.empty() && extension.front() == '.')
+        {
+            extension = extension.erase(0, 1);
+        }
+        StringCchCopy(sourceName, ARRAYSIZE(sourceName), extension.c_str());
+    }
+    else
+    {
+        StringCchCopy(sourceName, ARRAYSIZE(sourceName), originalName);
+    }
+
+    if (literalMatcher && isMatch)
+    {
+        *isMatch = literalMatcher->Contains(sourceName, wcslen(sourceName));
+    }
+
+    // Failure here means we didn't match anything or had nothing to match
+    PWSTR replaced = nullptr;
+    HRESULT hr = fileTime ? renameRegEx->ReplaceWithFileTime(sourceName, *fileTime, &replaced) :
+                            renameRegEx->Replace(sourceName, &replaced);
+
+    if (FAILED(hr))
+    {
+        CoTaskMemFree(replaced);
+        return hr;
+    }
+
+    // replaced == nullptr likely means we have an empty search string.  The name is
+    // left unchanged, except when a string transformation is selected.
+    if (replaced == nullptr && (flags & Uppercase || flags & Lowercase || flags & Titlecase))
+    {
+        SHStrDup(sourceName, &replaced);
+    }
+
+    wchar_t resultName[MAX_PATH] = { 0 };
+    PWSTR newNameToUse = nullptr;
+    if (replaced != nullptr)
+    {
+        newNameToUse = resultName;
+        if (flags & NameOnly)
+        {
+            StringCchPrintf(resultName, ARRAYSIZE(resultName), L"%s%s", replaced, fs::path(originalName).extension().c_str());
+        }
+        else if (flags & ExtensionOnly)
+        {
+            std::wstring extension = fs::path(originalName).extension().wstring();
+            if (!extension.empty())
+            {
+                StringCchPrintf(resultName, ARRAYSIZE(resultName), L"%s.%s", fs::path(originalName).stem().c_str(), replaced);
+            }
+            else
+            {
+                StringCchCopy(resultName, ARRAYSIZE(resultName), originalName);
+            }
+        }
+        else
+        {
+            StringCchCopy(resultName, ARRAYSIZE(resultName), replaced);
+        }
+    }
+    CoTaskMemFree(replaced);
+
+    wchar_t trimmedName[MAX_PATH] = { 0 };
+    if (newNameToUse != nullptr)
+    {
+        hr = GetTrimmedFileName(trimmedName, ARRAYSIZE(trimmedName), newNameToUse);
+        newNameToUse = trimmedName;
+    }
+
+    wchar_t transformedName[MAX_PATH] = { 0 };
+    if (SUCCEEDED(hr) && newNameToUse != nullptr && (flags & Uppercase || flags & Lowercase || flags & Titlecase))
+    {
+        hr = GetTransformedFileName(transformedName, ARRAYSIZE(transformedName), newNameToUse, flags);
+        newNameToUse = transformedName;
+    }
+
+    // No change from originalName so leave the result empty
+    if (SUCCEEDED(hr) && newNameToUse != nullptr && lstrcmp(originalName, newNameToUse) != 0)
+    {
+        newName = newNameToUse;
+    }
+
+    return hr;
+}
+
+HRESULT GetRenamedFileNames(_In_ IPowerRenameRegEx* renameRegEx,
+                            const std::vector<PowerRenameEngineItem>& items,
+                            _Out_ std::vector<std::optional<std::wstring>>& newNames)
+{
+    newNames.clear();
+    newNames.resize(items.size());
+
+    DWORD flags = 0;
+    PWSTR replaceTerm = nullptr;
+    HRESULT hr = renameRegEx->GetFlags(&flags);
+    if (SUCCEEDED(hr))
+    {
+        hr = renameRegEx->GetReplaceTerm(&replaceTerm);
+    }
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    const bool useFileTime = isFileTimeUsed(replaceTerm);
+    CoTaskMemFree(replaceTerm);
+
+    for (size_t i = 0; i < items.size() && SUCCEEDED(hr); i++)
+    {
+        const PowerRenameEngineItem& item = items[i];
+        if (IsExcludedFromRename(item.isFolder, item.isSubFolderContent, flags))
+        {
+            continue;
+        }
+
+        if (useFileTime && !item.time)
+        {
+            hr = E_INVALIDARG;
+            break;
+        }
+
+        const std::wstring originalName = fs::path(item.path).filename().wstring();
+        hr = GetRenamedFileName(renameRegEx, originalName.c_str(), flags, useFileTime ? &*item.time : nullptr, nullptr, nullptr, newNames[i]);
+    }
+
+    if (FAILED(hr) || !(flags & EnumerateItems))
+    {
+        return hr;
+    }
+
+    // Enumerated names are picked against the contents of each folder and the names
+    // already picked for the other items.  The current names of the items getting a
+    // new name don't count, they are renamed away.
+    CUniqueNameResolver uniqueNames;
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        if (newNames[i])
+        {
+            const fs::path path(items[i].path);
+            uniqueNames.Release(path.parent_path().c_str(), path.filename().c_str());
+        }
+    }
+
+    unsigned long itemEnumIndex = 1;
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        std::optional<std::wstring>& newName = newNames[i];
+        if (!newName)
+        {
+            continue;
+        }
+
+        const fs::path path(items[i].path);
+        std::wstring uniqueName;
+        unsigned long countUsed = 0;
+        if (uniqueNames.GetEnumeratedName(path.parent_path().c_str(), newName->c_str(), itemEnumIndex, uniqueName, &countUsed) == S_OK)
+        {
+            // Numbered as it already was, no change
+            if (uniqueName == path.filename().wstring())
+            {
+                newName.reset();
+            }
+            else
+            {
+                newName = std::move(uniqueName);
+            }
+        }
+        itemEnumIndex++;
+    }
+
+    return hr;
+}
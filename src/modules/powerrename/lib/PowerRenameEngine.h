@@ -0,0 +1,44 @@
+#pragma once
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <lib/PowerRenameInterfaces.h>
+
+class CLiteralMatcher;
+
+// The new name computation of PowerRename, independent of shell items, of the
+// rename manager and of its message window.  It works on plain names so plans can
+// be computed by scripts and benchmarks as well as by the manager.
+
+struct PowerRenameEngineItem
+{
+    // Full path, or only the name of the item
+    std::wstring path;
+    bool isFolder = false;
+    bool isSubFolderContent = false;
+    // Local creation time, only required when the replace term contains dated tokens
+    std::optional<SYSTEMTIME> time;
+};
+
+bool IsExcludedFromRename(bool isFolder, bool isSubFolderContent, DWORD flags);
+
+// Computes the new name of an item, before any enumeration is applied: search and
+// replace on the part of the name selected by flags, then trimming and case
+// transformation.  newName is left empty when the item keeps its original name.
+// fileTime is only required when the replace term has dated tokens.
+// When literalMatcher is set, isMatch receives whether the searched part of the
+// name contains its search term.
+HRESULT GetRenamedFileName(_In_ IPowerRenameRegEx* renameRegEx,
+                           _In_ PCWSTR originalName,
+                           DWORD flags,
+                           _In_opt_ const SYSTEMTIME* fileTime,
+                           _In_opt_ const CLiteralMatcher* literalMatcher,
+                           _Out_opt_ bool* isMatch,
+                           _Out_ std::optional<std::wstring>& newName);
+
+// Computes the new names of items in order, with the exclusions and the enumeration
+// of the rename manager.  newNames receives one entry per item.
+HRESULT GetRenamedFileNames(_In_ IPowerRenameRegEx* renameRegEx,
+                            const std::vector<PowerRenameEngineItem>& items,
+                            _Out_ std::vector<std::optional<std::wstring>>& newNames);
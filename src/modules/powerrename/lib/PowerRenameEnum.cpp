@@ -0,0 +1,474 @@
+#include "pch.h"
+#include "PowerRenameEnum.h"
+#include "Helpers.h"
+#include <ShlGuid.h>
+
+namespace
+{
+    // We shouldn't get this deep since we only enum the contents of
+    // regular folders but limiting it just in case
+    const int c_maxDepth = MAX_PATH / 2;
+
+    // Folders are read from disk, so use a few workers even on small machines
+    const UINT c_minWorkers = 2;
+    const UINT c_maxWorkers = 8;
+
+    // Listing a folder for the creation times of the top level items is only worth
+    // it when this many of them are in that folder, the others are opened if needed
+    const size_t c_minRootItemsToListFolder = 16;
+
+    void ReadFolderTimes(_In_ PCWSTR folderPath, _Inout_ std::unordered_map<std::wstring, FILETIME>& times)
+    {
+        std::wstring pattern = folderPath;
+        if (!pattern.empty() && pattern.back() != L'\\')
+        {
+            pattern += L'\\';
+        }
+        pattern += L'*';
+
+        WIN32_FIND_DATA findData = { 0 };
+        HANDLE findHandle = FindFirstFileEx(pattern.c_str(), FindExInfoBasic, &findData, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+        if (findHandle != INVALID_HANDLE_VALUE)
+        {
+            do
+            {
+                times.emplace(findData.cFileName, findData.ftCreationTime);
+            } while (FindNextFile(findHandle, &findData));
+
+            FindClose(findHandle);
+        }
+    }
+
+    // Local time, as CPowerRenameItem::GetTime gives it
+    bool FindLocalTime(_In_ const std::unordered_map<std::wstring, FILETIME>& times, _In_ PCWSTR name, _Out_ SYSTEMTIME* time)
+    {
+        const auto it = times.find(name);
+        SYSTEMTIME systemTime;
+        return it != times.end() && FileTimeToSystemTime(&it->second, &systemTime) &&
+               SystemTimeToTzSpecificLocalTime(nullptr, &systemTime, time);
+    }
+}
+
+CPowerRenameEnum::Folder::~Folder()
+{
+    for (auto& entry : entries)
+    {
+        CoTaskMemFree(entry.pidl);
+    }
+}
+
+CPowerRenameEnum::~CPowerRenameEnum()
+{
+    Cancel();
+
+    for (auto& queue : m_queues)
+    {
+        for (auto& task : queue->tasks)
+        {
+            CoTaskMemFree(const_cast<PIDLIST_ABSOLUTE>(task.pidl));
+        }
+    }
+}
+
+HRESULT CPowerRenameEnum::Start(_In_ IUnknown* dataSource, _In_ IPowerRenameItemFactory* itemFactory, _In_opt_ HWND hwndNotify, _In_ UINT message)
+{
+    m_itemFactory = itemFactory;
+    m_hwndNotify = hwndNotify;
+    m_message = message;
+
+    const UINT workerCount = min(max(std::thread::hardware_concurrency(), c_minWorkers), c_maxWorkers);
+    for (UINT i = 0; i < workerCount; i++)
+    {
+        m_queues.push_back(std::make_unique<WorkQueue>());
+    }
+
+    CComPtr<IShellItemArray> spsia;
+    HRESULT hr = GetShellItemArrayFromDataObject(dataSource, &spsia);
+    CComPtr<IEnumShellItems> spesi;
+    if (SUCCEEDED(hr))
+    {
+        hr = spsia->EnumItems(&spesi);
+    }
+
+    // The top level items are read here since the array belongs to the caller's apartment
+    while (SUCCEEDED(hr))
+    {
+        IShellItem* shellItems[c_fetchBatchSize] = {};
+        ULONG fetched = 0;
+        hr = spesi->Next(ARRAYSIZE(shellItems), shellItems, &fetched);
+        for (ULONG i = 0; i < fetched; i++)
+        {
+            _AddEntry(shellItems[i], m_root, 0, i % workerCount, nullptr);
+            shellItems[i]->Release();
+        }
+
+        if (hr != S_OK)
+        {
+            hr = SUCCEEDED(hr) ? S_OK : hr;
+            break;
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        _ReadRootTimes();
+    }
+    m_root.done = true;
+
+    if (SUCCEEDED(hr))
+    {
+        m_walk.push_back({ &m_root, 0, 0 });
+        for (UINT i = 0; i < workerCount; i++)
+        {
+            m_workers.emplace_back(&CPowerRenameEnum::_WorkerThread, this, i);
+        }
+    }
+
+    return hr;
+}
+
+void CPowerRenameEnum::Cancel()
+{
+    m_canceled = true;
+    {
+        std::lock_guard<std::mutex> lock(m_stateLock);
+        m_stateVersion++;
+    }
+    m_workChanged.notify_all();
+    m_folderDone.notify_all();
+
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+    m_workers.clear();
+}
+
+HRESULT CPowerRenameEnum::GetItems(_Inout_ std::vector<CComPtr<IPowerRenameItem>>& items, _In_ UINT maxCount, _In_ DWORD timeoutMs)
+{
+    // Workers post a new notification for the folders they finish from now on
+    m_notifyPending = false;
+
+    UINT added = 0;
+    while (!m_walk.empty())
+    {
+        if (m_canceled)
+        {
+            return E_ABORT;
+        }
+
+        WalkPosition& position = m_walk.back();
+        Folder& folder = *position.folder;
+        if (!folder.done)
+        {
+            if (timeoutMs == 0)
+            {
+                return S_OK;
+            }
+
+            std::unique_lock<std::mutex> lock(m_stateLock);
+            auto isDone = [&] { return folder.done || m_canceled; };
+            if (timeoutMs == INFINITE)
+            {
+                m_folderDone.wait(lock, isDone);
+            }
+            else if (!m_folderDone.wait_for(lock, std::chrono::milliseconds(timeoutMs), isDone))
+            {
+                return S_OK;
+            }
+            continue;
+        }
+
+        if (position.index == folder.entries.size())
+        {
+            // The folder and all its subfolders were walked, their entries aren't needed anymore
+            folder.entries = {};
+            m_walk.pop_back();
+            continue;
+        }
+
+        if (added == maxCount)
+        {
+            // More items are ready, let the caller know it should come back
+            _Notify();
+            return S_OK;
+        }
+
+        Entry& entry = folder.entries[position.index++];
+        const int depth = position.depth;
+
+        CComPtr<IShellItem> shellItem;
+        HRESULT hr = SHCreateItemFromIDList(entry.pidl, IID_PPV_ARGS(&shellItem));
+        CoTaskMemFree(entry.pidl);
+        entry.pidl = nullptr;
+
+        CComPtr<IPowerRenameItem> item;
+        if (SUCCEEDED(hr))
+        {
+            hr = m_itemFactory->Create(shellItem, &item);
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            item->PutDepth(depth);
+            if (entry.hasTime)
+            {
+                item->PutTime(entry.time);
+            }
+            items.push_back(item);
+            added++;
+        }
+        else if (SUCCEEDED(m_result))
+        {
+            m_result = hr;
+        }
+
+        if (entry.folder)
+        {
+            // position may be invalidated from here
+            m_walk.push_back({ entry.folder.get(), 0, depth + 1 });
+        }
+    }
+
+    const HRESULT workerResult = m_workerResult;
+    if (FAILED(m_result))
+    {
+        return m_result;
+    }
+    return FAILED(workerResult) ? workerResult : S_FALSE;
+}
+
+void CPowerRenameEnum::_WorkerThread(_In_ size_t workerIndex)
+{
+    const HRESULT hrInit = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+    while (!m_canceled)
+    {
+        ULONGLONG version = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_stateLock);
+            version = m_stateVersion;
+        }
+
+        Task task;
+        if (_PopTask(workerIndex, task))
+        {
+            _ReadFolder(workerIndex, task);
+            CoTaskMemFree(const_cast<PIDLIST_ABSOLUTE>(task.pidl));
+
+            if (--m_pendingTasks == 0)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_stateLock);
+                    m_stateVersion++;
+                }
+                m_workChanged.notify_all();
+            }
+            continue;
+        }
+
+        // Wait for a task to be pushed, or for all of them to be done
+        std::unique_lock<std::mutex> lock(m_stateLock);
+        m_workChanged.wait(lock, [&] { return m_stateVersion != version || m_pendingTasks == 0 || m_canceled; });
+        if (m_pendingTasks == 0)
+        {
+            break;
+        }
+    }
+
+    if (SUCCEEDED(hrInit))
+    {
+        CoUninitialize();
+    }
+}
+
+bool CPowerRenameEnum::_PopTask(_In_ size_t workerIndex, _Out_ Task& task)
+{
+    // Take the most recent task of our own queue, to walk down the tree we are reading
+    {
+        WorkQueue& queue = *m_queues[workerIndex];
+        std::lock_guard<std::mutex> lock(queue.lock);
+        if (!queue.tasks.empty())
+        {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+            return true;
+        }
+    }
+
+    // Otherwise steal the oldest task of another worker, likely the root of a large subtree
+    for (size_t i = 1; i < m_queues.size(); i++)
+    {
+        WorkQueue& queue = *m_queues[(workerIndex + i) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(queue.lock);
+        if (!queue.tasks.empty())
+        {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void CPowerRenameEnum::_PushTask(_In_ size_t workerIndex, _In_ const Task& task)
+{
+    m_pendingTasks++;
+    {
+        WorkQueue& queue = *m_queues[workerIndex];
+        std::lock_guard<std::mutex> lock(queue.lock);
+        queue.tasks.push_back(task);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_stateLock);
+        m_stateVersion++;
+    }
+    m_workChanged.notify_one();
+}
+
+void CPowerRenameEnum::_ReadFolder(_In_ size_t workerIndex, _In_ const Task& task)
+{
+    CComPtr<IShellItem> folderItem;
+    HRESULT hr = SHCreateItemFromIDList(task.pidl, IID_PPV_ARGS(&folderItem));
+
+    // Bind to the IShellItem for the IEnumShellItems interface
+    CComPtr<IEnumShellItems> spesi;
+    if (SUCCEEDED(hr))
+    {
+        hr = folderItem->BindToHandler(nullptr, BHID_EnumItems, IID_PPV_ARGS(&spesi));
+    }
+
+    // One listing of the folder gives the creation times of all its contents
+    FolderTimes times;
+    PWSTR folderPath = nullptr;
+    const bool hasTimes = SUCCEEDED(hr) && SUCCEEDED(folderItem->GetDisplayName(SIGDN_FILESYSPATH, &folderPath));
+    if (hasTimes)
+    {
+        ReadFolderTimes(folderPath, times);
+        CoTaskMemFree(folderPath);
+    }
+
+    while (SUCCEEDED(hr) && !m_canceled)
+    {
+        IShellItem* shellItems[c_fetchBatchSize] = {};
+        ULONG fetched = 0;
+        hr = spesi->Next(ARRAYSIZE(shellItems), shellItems, &fetched);
+        for (ULONG i = 0; i < fetched; i++)
+        {
+            _AddEntry(shellItems[i], *task.folder, task.depth, workerIndex, hasTimes ? &times : nullptr);
+            shellItems[i]->Release();
+        }
+
+        if (hr != S_OK)
+        {
+            break;
+        }
+    }
+
+    if (FAILED(hr))
+    {
+        // Keep the first failure, the other folders are still read
+        HRESULT expected = S_OK;
+        m_workerResult.compare_exchange_strong(expected, hr);
+    }
+
+    _OnFolderDone(*task.folder);
+}
+
+bool CPowerRenameEnum::_AddEntry(_In_ IShellItem* shellItem, _Inout_ Folder& folder, _In_ int depth, _In_ size_t workerIndex, _In_opt_ const FolderTimes* times)
+{
+    Entry entry;
+    if (FAILED(SHGetIDListFromObject(shellItem, &entry.pidl)))
+    {
+        return false;
+    }
+
+    PWSTR name = nullptr;
+    if (times && SUCCEEDED(shellItem->GetDisplayName(SIGDN_PARENTRELATIVEPARSING, &name)))
+    {
+        entry.hasTime = FindLocalTime(*times, name, &entry.time);
+        CoTaskMemFree(name);
+    }
+
+    // Some items can be both folders and streams (ex: zip folders), only the
+    // contents of regular folders are enumerated.  Same test as CPowerRenameItem.
+    SFGAOF att = 0;
+    const bool isFolder = SUCCEEDED(shellItem->GetAttributes(SFGAO_STREAM | SFGAO_FOLDER, &att)) &&
+                          (att & SFGAO_FOLDER) && !(att & SFGAO_STREAM);
+
+    Task task = {};
+    if (isFolder && depth + 1 < c_maxDepth)
+    {
+        // The task gets its own copy since the entry's is freed once the item is created
+        task.pidl = ILCloneFull(entry.pidl);
+        if (task.pidl)
+        {
+            entry.folder = std::make_unique<Folder>();
+            task.folder = entry.folder.get();
+            task.depth = depth + 1;
+        }
+    }
+
+    folder.entries.push_back(std::move(entry));
+
+    if (task.folder)
+    {
+        _PushTask(workerIndex, task);
+    }
+    return true;
+}
+
+void CPowerRenameEnum::_ReadRootTimes()
+{
+    // Entries by parent folder, with their names
+    std::unordered_map<std::wstring, std::vector<std::pair<size_t, std::wstring>>> parents;
+    for (size_t i = 0; i < m_root.entries.size(); i++)
+    {
+        PWSTR path = nullptr;
+        if (SUCCEEDED(SHGetNameFromIDList(m_root.entries[i].pidl, SIGDN_FILESYSPATH, &path)))
+        {
+            PCWSTR name = PathFindFileName(path);
+            if (name != path && *name)
+            {
+                parents[std::wstring(path, name - path)].emplace_back(i, name);
+            }
+            CoTaskMemFree(path);
+        }
+    }
+
+    for (const auto& [parentPath, entries] : parents)
+    {
+        if (entries.size() < c_minRootItemsToListFolder)
+        {
+            continue;
+        }
+
+        FolderTimes times;
+        ReadFolderTimes(parentPath.c_str(), times);
+        for (const auto& [index, name] : entries)
+        {
+            Entry& entry = m_root.entries[index];
+            entry.hasTime = FindLocalTime(times, name.c_str(), &entry.time);
+        }
+    }
+}
+
+void CPowerRenameEnum::_OnFolderDone(_Inout_ Folder& folder)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_stateLock);
+        folder.done = true;
+    }
+    m_folderDone.notify_all();
+    _Notify();
+}
+
+void CPowerRenameEnum::_Notify()
+{
+    if (m_hwndNotify && !m_notifyPending.exchange(true))
+    {
+        PostMessage(m_hwndNotify, m_message, 0, 0);
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <lib/PowerRenameInterfaces.h>
+
+// Enumerates the items of a data object and the contents of its folders, recursively.
+// Folders are read in parallel by a pool of workers sharing a work-stealing queue,
+// while the caller collects the items in chunks, in the order of a depth-first walk,
+// as soon as the folders they belong to are read.
+// The creation times of the items are read with the listings of their folders and
+// given to the items, so dated replace terms don't open each file.
+class CPowerRenameEnum
+{
+public:
+    // Number of shell items fetched per IEnumShellItems::Next call
+    static const ULONG c_fetchBatchSize = 64;
+
+    CPowerRenameEnum() = default;
+    ~CPowerRenameEnum();
+
+    // Reads the top level items of dataSource and starts reading the folders.
+    // If hwndNotify is set, message is posted to it when new items are ready.
+    HRESULT Start(_In_ IUnknown* dataSource, _In_ IPowerRenameItemFactory* itemFactory, _In_opt_ HWND hwndNotify, _In_ UINT message);
+    void Cancel();
+
+    // Creates the next items, at most maxCount, and appends them to items.  Waits up
+    // to timeoutMs for the folders still being read.  Returns S_FALSE once all
+    // the items were returned.
+    HRESULT GetItems(_Inout_ std::vector<CComPtr<IPowerRenameItem>>& items, _In_ UINT maxCount, _In_ DWORD timeoutMs);
+
+private:
+    struct Folder;
+
+    struct Entry
+    {
+        PIDLIST_ABSOLUTE pidl = nullptr;
+        // Set for the folders whose contents are enumerated
+        std::unique_ptr<Folder> folder;
+        // Local creation time, when found in the listing of the parent folder
+        bool hasTime = false;
+        SYSTEMTIME time = {};
+    };
+
+    // Creation times of the contents of a folder, by name
+    using FolderTimes = std::unordered_map<std::wstring, FILETIME>;
+
+    struct Folder
+    {
+        ~Folder();
+
+        std::vector<Entry> entries;
+        // Set by the worker once entries is complete
+        std::atomic<bool> done = false;
+    };
+
+    struct Task
+    {
+        PCIDLIST_ABSOLUTE pidl;
+        Folder* folder;
+        int depth;
+    };
+
+    struct WorkQueue
+    {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    struct WalkPosition
+    {
+        Folder* folder;
+        size_t index;
+        int depth;
+    };
+
+    void _WorkerThread(_In_ size_t workerIndex);
+    bool _PopTask(_In_ size_t workerIndex, _Out_ Task& task);
+    void _PushTask(_In_ size_t workerIndex, _In_ const Task& task);
+    void _ReadFolder(_In_ size_t workerIndex, _In_ const Task& task);
+    bool _AddEntry(_In_ IShellItem* shellItem, _Inout_ Folder& folder, _In_ int depth, _In_ size_t workerIndex, _In_opt_ const FolderTimes* times);
+    void _ReadRootTimes();
+    void _OnFolderDone(_Inout_ Folder& folder);
+    void _Notify();
+
+    CComPtr<IPowerRenameItemFactory> m_itemFactory;
+    HWND m_hwndNotify = nullptr;
+    UINT m_message = 0;
+
+    // Walk state, only used by the caller thread
+    Folder m_root;
+    std::vector<WalkPosition> m_walk;
+    HRESULT m_result = S_OK;
+
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+    // Tasks queued or being run
+    std::atomic<UINT> m_pendingTasks = 0;
+    std::atomic<bool> m_canceled = false;
+    std::atomic<bool> m_notifyPending = false;
+    // First failure to read a folder
+    std::atomic<HRESULT> m_workerResult = S_OK;
+
+    // Guards the waits of the idle workers and of the caller
+    std::mutex m_stateLock;
+    // Incremented when a task is pushed or when no task is left
+    ULONGLONG m_stateVersion = 0;
+    std::condition_variable m_workChanged;
+    std::condition_variable m_folderDone;
+};
@@ -79,6 +79,14 @@ IFACEMETHODIMP CPowerRenameItem::GetTime(_Outptr_ SYSTEMTIME* time)
     return hr;
 }
 
+IFACEMETHODIMP CPowerRenameItem::PutTime(_In_ SYSTEMTIME time)
+{
+    CSRWExclusiveAutoLock lock(&m_lock);
+    m_time = time;
+    m_isTimeParsed = true;
+    return S_OK;
+}
+
 IFACEMETHODIMP CPowerRenameItem::GetShellItem(_Outptr_ IShellItem** ppsi)
 {
     return SHCreateItemFromParsingName(m_path, nullptr, IID_PPV_ARGS(ppsi));
@@ -133,6 +141,13 @@ IFACEMETHODIMP CPowerRenameItem::GetIsSubFolderContent(_Out_ bool* isSubFolderCo
     return S_OK;
 }
 
+IFACEMETHODIMP CPowerRenameItem::GetCanRename(_Out_ bool* canRename)
+{
+    CSRWSharedAutoLock lock(&m_lock);
+    *canRename = m_canRename;
+    return S_OK;
+}
+
 IFACEMETHODIMP CPowerRenameItem::GetSelected(_Out_ bool* selected)
 {
     CSRWSharedAutoLock lock(&m_lock);
@@ -16,12 +16,14 @@ public:
     // IPowerRenameItem
     IFACEMETHODIMP GetPath(_Outptr_ PWSTR* path);
     IFACEMETHODIMP GetTime(_Outptr_ SYSTEMTIME* time);
+    IFACEMETHODIMP PutTime(_In_ SYSTEMTIME time);
     IFACEMETHODIMP GetShellItem(_Outptr_ IShellItem** ppsi);
     IFACEMETHODIMP GetOriginalName(_Outptr_ PWSTR* originalName);
     IFACEMETHODIMP PutNewName(_In_opt_ PCWSTR newName);
     IFACEMETHODIMP GetNewName(_Outptr_ PWSTR* newName);
     IFACEMETHODIMP GetIsFolder(_Out_ bool* isFolder);
     IFACEMETHODIMP GetIsSubFolderContent(_Out_ bool* isSubFolderContent);
+    IFACEMETHODIMP GetCanRename(_Out_ bool* canRename);
     IFACEMETHODIMP GetSelected(_Out_ bool* selected);
     IFACEMETHODIMP PutSelected(_In_ bool selected);
     IFACEMETHODIMP GetId(_Out_ int* id);
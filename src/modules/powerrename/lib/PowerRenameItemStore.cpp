@@ -0,0 +1,305 @@
+#include "pch.h"
+#include "PowerRenameItemStore.h"
+#include "PowerRenameEngine.h"
+#include "RenameJournal.h"
+
+PCWSTR CNamePool::Add(_In_reads_(length) const wchar_t* name, _In_ size_t length)
+{
+    const size_t needed = length + 1;
+    wchar_t* destination = nullptr;
+    if (needed > c_segmentLength)
+    {
+        // Names longer than a segment get their own, the current one keeps being filled
+        m_segments.push_back(std::make_unique<wchar_t[]>(needed));
+        destination = m_segments.back().get();
+    }
+    else
+    {
+        if (!m_current || c_segmentLength - m_currentUsed < needed)
+        {
+            m_segments.push_back(std::make_unique<wchar_t[]>(c_segmentLength));
+            m_current = m_segments.back().get();
+            m_currentUsed = 0;
+        }
+        destination = m_current + m_currentUsed;
+        m_currentUsed += needed;
+    }
+
+    memcpy(destination, name, length * sizeof(wchar_t));
+    destination[length] = L'\0';
+    m_size += needed;
+    return destination;
+}
+
+bool CPowerRenameItemColumns::IsExcluded(_In_ UINT index, _In_ DWORD flags) const
+{
+    return IsExcludedFromRename(IsFolder(index), GetDepth(index) > 0, flags);
+}
+
+bool CPowerRenameItemColumns::ShouldRename(_In_ UINT index, _In_ DWORD flags) const
+{
+    const Block& block = _GetBlock(index);
+    const UINT slot = index % c_blockSize;
+    return block.selected[slot] &&
+           (block.attributes[slot] & c_attributeCanRename) &&
+           block.newNames[slot].load(std::memory_order_relaxed) != nullptr &&
+           !IsExcluded(index, flags);
+}
+
+bool CPowerRenameItemColumns::PutNewName(_In_ UINT index, _In_opt_ PCWSTR newName, _Inout_ CNamePool& pool) const
+{
+    Block& block = _GetBlock(index);
+    const UINT slot = index % c_blockSize;
+    if (newName && wcscmp(newName, block.originalNames[slot]) == 0)
+    {
+        newName = nullptr;
+    }
+
+    PCWSTR currentNewName = block.newNames[slot].load(std::memory_order_relaxed);
+    if (currentNewName == newName || (currentNewName && newName && wcscmp(currentNewName, newName) == 0))
+    {
+        return false;
+    }
+
+    block.newNames[slot].store(newName ? pool.Add(newName, wcslen(newName)) : nullptr, std::memory_order_release);
+    return true;
+}
+
+void CPowerRenameItemColumns::GetRenamePlan(_In_ DWORD flags, _Inout_ std::vector<RenamePlanItem>& plan) const
+{
+    // Count the items of each depth, the new names are only read once the order is known
+    std::vector<UINT> renamed;
+    std::vector<UINT> depthPositions;
+    for (UINT i = 0; i < m_count; i++)
+    {
+        if (ShouldRename(i, flags))
+        {
+            const UINT depth = GetDepth(i);
+            if (depth >= depthPositions.size())
+            {
+                depthPositions.resize(depth + 1);
+            }
+            depthPositions[depth]++;
+            renamed.push_back(i);
+        }
+    }
+
+    // Position of the first item of each depth, from the deepest one
+    UINT position = 0;
+    for (size_t depth = depthPositions.size(); depth-- > 0;)
+    {
+        const UINT count = depthPositions[depth];
+        depthPositions[depth] = position;
+        position += count;
+    }
+
+    std::vector<UINT> order(renamed.size());
+    for (UINT i : renamed)
+    {
+        order[depthPositions[GetDepth(i)]++] = i;
+    }
+
+    plan.reserve(plan.size() + order.size());
+    for (UINT i : order)
+    {
+        // The regex pass may have run since the items were counted
+        PCWSTR newName = GetNewName(i);
+        if (newName)
+        {
+            RenamePlanItem item;
+            item.depth = GetDepth(i);
+            item.parentPath = GetParentPath(i);
+            item.originalName = GetOriginalName(i);
+            item.newName = newName;
+            plan.push_back(std::move(item));
+        }
+    }
+}
+
+CPowerRenameItemStore::~CPowerRenameItemStore()
+{
+    Clear();
+}
+
+UINT CPowerRenameItemStore::FindIndex(_In_ int id) const
+{
+    UINT first = 0;
+    UINT count = m_count;
+    while (count > 0)
+    {
+        const UINT half = count / 2;
+        if (GetId(first + half) < id)
+        {
+            first += half + 1;
+            count -= half + 1;
+        }
+        else
+        {
+            count = half;
+        }
+    }
+    return first;
+}
+
+bool CPowerRenameItemStore::Contains(_In_ int id) const
+{
+    const UINT index = FindIndex(id);
+    return index < m_count && GetId(index) == id;
+}
+
+HRESULT CPowerRenameItemStore::Add(_In_ IPowerRenameItem* item, _Out_ UINT* index)
+{
+    *index = 0;
+
+    int id = 0;
+    UINT depth = 0;
+    bool isFolder = false;
+    bool canRename = false;
+    bool selected = false;
+    PWSTR originalName = nullptr;
+    PWSTR path = nullptr;
+    HRESULT hr = item->GetId(&id);
+    if (SUCCEEDED(hr))
+    {
+        hr = item->GetDepth(&depth);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = item->GetIsFolder(&isFolder);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = item->GetCanRename(&canRename);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = item->GetSelected(&selected);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = item->GetOriginalName(&originalName);
+    }
+    if (FAILED(hr))
+    {
+        CoTaskMemFree(originalName);
+        return hr;
+    }
+
+    // Path up to the last backslash, reusing the previous item's when it's the same
+    // folder.  Items without a path get an empty one.
+    PCWSTR parentPath = L"";
+    size_t parentLength = 0;
+    if (SUCCEEDED(item->GetPath(&path)))
+    {
+        parentPath = path;
+        parentLength = PathFindFileName(path) - path;
+        if (parentLength > 0 && path[parentLength - 1] == L'\\' && !(parentLength == 3 && path[1] == L':'))
+        {
+            parentLength--;
+        }
+    }
+    if (!m_lastParentPath || wcslen(m_lastParentPath) != parentLength || wcsncmp(m_lastParentPath, parentPath, parentLength) != 0)
+    {
+        m_lastParentPath = m_names.Add(parentPath, parentLength);
+    }
+    CoTaskMemFree(path);
+
+    if (m_count % c_blockSize == 0)
+    {
+        m_ownedBlocks.push_back(std::make_unique<Block>());
+        m_blocks.push_back(m_ownedBlocks.back().get());
+    }
+
+    // Move the items with a greater id up by one
+    const UINT position = FindIndex(id);
+    for (UINT u = m_count; u > position; u--)
+    {
+        Block& to = _GetBlock(u);
+        Block& from = _GetBlock(u - 1);
+        const UINT toSlot = u % c_blockSize;
+        const UINT fromSlot = (u - 1) % c_blockSize;
+        to.items[toSlot] = from.items[fromSlot];
+        to.ids[toSlot] = from.ids[fromSlot];
+        to.originalNames[toSlot] = from.originalNames[fromSlot];
+        to.parentPaths[toSlot] = from.parentPaths[fromSlot];
+        to.newNames[toSlot].store(from.newNames[fromSlot].load());
+        to.depths[toSlot] = from.depths[fromSlot];
+        to.attributes[toSlot] = from.attributes[fromSlot];
+        to.selected[toSlot] = from.selected[fromSlot];
+    }
+
+    Block& block = _GetBlock(position);
+    const UINT slot = position % c_blockSize;
+    block.items[slot] = item;
+    item->AddRef();
+    block.ids[slot] = id;
+    block.originalNames[slot] = m_names.Add(originalName, wcslen(originalName));
+    block.parentPaths[slot] = m_lastParentPath;
+    block.newNames[slot].store(nullptr);
+    block.depths[slot] = depth;
+    block.attributes[slot] = (isFolder ? c_attributeFolder : 0) | (canRename ? c_attributeCanRename : 0);
+    block.selected[slot] = selected;
+    CoTaskMemFree(originalName);
+
+    m_count++;
+    *index = position;
+    return S_OK;
+}
+
+void CPowerRenameItemStore::PutSelected(_In_ UINT index, _In_ bool selected)
+{
+    _GetBlock(index).selected[index % c_blockSize] = selected;
+}
+
+void CPowerRenameItemStore::Clear()
+{
+    for (UINT u = 0; u < m_count; u++)
+    {
+        GetItem(u)->Release();
+    }
+
+    m_blocks.clear();
+    m_ownedBlocks.clear();
+    m_count = 0;
+    m_names = CNamePool();
+    m_lastParentPath = nullptr;
+    m_newNamePools.clear();
+    m_compactedNewNamesSize = 0;
+}
+
+CNamePool& CPowerRenameItemStore::AddNewNamePool()
+{
+    m_newNamePools.push_back(std::make_unique<CNamePool>());
+    return *m_newNamePools.back();
+}
+
+void CPowerRenameItemStore::CompactNewNames(_In_ const CPowerRenameItemColumns& snapshot)
+{
+    // Each pass writes the names that changed to new pools, compacting once they doubled
+    // since the last compaction keeps the cost proportional to the names written.
+    size_t size = 0;
+    for (auto& pool : m_newNamePools)
+    {
+        size += pool->Size();
+    }
+    if (size <= 2 * m_compactedNewNamesSize + CNamePool::c_segmentLength)
+    {
+        return;
+    }
+
+    auto compacted = std::make_unique<CNamePool>();
+    for (UINT u = 0; u < snapshot.Count(); u++)
+    {
+        Block& block = snapshot._GetBlock(u);
+        const UINT slot = u % c_blockSize;
+        PCWSTR newName = block.newNames[slot].load(std::memory_order_relaxed);
+        if (newName)
+        {
+            block.newNames[slot].store(compacted->Add(newName, wcslen(newName)), std::memory_order_release);
+        }
+    }
+
+    m_compactedNewNamesSize = compacted->Size();
+    m_newNamePools.clear();
+    m_newNamePools.push_back(std::move(compacted));
+}
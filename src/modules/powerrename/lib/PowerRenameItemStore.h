@@ -0,0 +1,142 @@
+#pragma once
+#include "pch.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <lib/PowerRenameInterfaces.h>
+
+struct RenamePlanItem;
+
+// Append-only storage for names.  A name never moves once added, so it can be read
+// from other threads for as long as the pool lives.  Not thread safe.
+class CNamePool
+{
+public:
+    static const size_t c_segmentLength = 64 * 1024;
+
+    PCWSTR Add(_In_reads_(length) const wchar_t* name, _In_ size_t length);
+
+    // Number of characters stored, null terminators included
+    size_t Size() const { return m_size; }
+
+private:
+    std::vector<std::unique_ptr<wchar_t[]>> m_segments;
+    wchar_t* m_current = nullptr;
+    size_t m_currentUsed = 0;
+    size_t m_size = 0;
+};
+
+// Read access to the columns of the first Count() items of a CPowerRenameItemStore.
+// A copy taken when a regex pass starts stays valid while items are appended to the
+// store, so the workers of the pass can use it without taking the items lock.
+class CPowerRenameItemColumns
+{
+public:
+    static const UINT c_blockSize = 1024;
+
+    UINT Count() const { return m_count; }
+
+    IPowerRenameItem* GetItem(_In_ UINT index) const { return _GetBlock(index).items[index % c_blockSize]; }
+    int GetId(_In_ UINT index) const { return _GetBlock(index).ids[index % c_blockSize]; }
+    PCWSTR GetOriginalName(_In_ UINT index) const { return _GetBlock(index).originalNames[index % c_blockSize]; }
+    // Path of the folder holding the item, without a trailing backslash unless it is a
+    // drive root
+    PCWSTR GetParentPath(_In_ UINT index) const { return _GetBlock(index).parentPaths[index % c_blockSize]; }
+    UINT GetDepth(_In_ UINT index) const { return _GetBlock(index).depths[index % c_blockSize]; }
+    bool IsFolder(_In_ UINT index) const { return (_GetBlock(index).attributes[index % c_blockSize] & c_attributeFolder) != 0; }
+    bool IsSelected(_In_ UINT index) const { return _GetBlock(index).selected[index % c_blockSize]; }
+
+    // Null when the item keeps its original name
+    PCWSTR GetNewName(_In_ UINT index) const
+    {
+        return _GetBlock(index).newNames[index % c_blockSize].load(std::memory_order_acquire);
+    }
+
+    bool IsExcluded(_In_ UINT index, _In_ DWORD flags) const;
+    // Same as IPowerRenameItem::ShouldRenameItem
+    bool ShouldRename(_In_ UINT index, _In_ DWORD flags) const;
+
+    // Copies newName to pool and stores it as the new name of the item.  A new name equal
+    // to the original name is stored as null.  Returns false if the new name didn't change.
+    // Items of different indexes can be updated concurrently.
+    bool PutNewName(_In_ UINT index, _In_opt_ PCWSTR newName, _Inout_ CNamePool& pool) const;
+
+    // Appends the items to rename with flags to plan, deepest first so the content of a
+    // folder is renamed before it, and in index order for a depth.  The depth is bounded
+    // by the nesting of the folders, so the items are placed with a counting sort.
+    void GetRenamePlan(_In_ DWORD flags, _Inout_ std::vector<RenamePlanItem>& plan) const;
+
+protected:
+    friend class CPowerRenameItemStore;
+
+    static const BYTE c_attributeFolder = 0x1;
+    static const BYTE c_attributeCanRename = 0x2;
+
+    struct Block
+    {
+        IPowerRenameItem* items[c_blockSize];
+        int ids[c_blockSize];
+        PCWSTR originalNames[c_blockSize];
+        // Shared by the items of a folder
+        PCWSTR parentPaths[c_blockSize];
+        std::atomic<PCWSTR> newNames[c_blockSize];
+        UINT depths[c_blockSize];
+        BYTE attributes[c_blockSize];
+        // Only updated by the manager thread
+        bool selected[c_blockSize];
+    };
+
+    Block& _GetBlock(_In_ UINT index) const { return *m_blocks[index / c_blockSize]; }
+
+    std::vector<Block*> m_blocks;
+    UINT m_count = 0;
+};
+
+// Stores the items of the manager as columns, in id order.  Items are held in blocks
+// of c_blockSize that never move, and the names and paths are kept in pools instead
+// of being allocated for each item.
+// Adding items and changing the selection happen on the manager thread, under the
+// manager's items lock.  The new names are written by the regex pass.
+class CPowerRenameItemStore :
+    public CPowerRenameItemColumns
+{
+public:
+    CPowerRenameItemStore() = default;
+    ~CPowerRenameItemStore();
+
+    CPowerRenameItemStore(const CPowerRenameItemStore&) = delete;
+    CPowerRenameItemStore& operator=(const CPowerRenameItemStore&) = delete;
+
+    CPowerRenameItemColumns GetSnapshot() const { return *this; }
+
+    // Index of the item with this id, or of the first item with a greater id
+    UINT FindIndex(_In_ int id) const;
+    bool Contains(_In_ int id) const;
+    // Whether an item with this id would be added after all the others
+    bool IsAppend(_In_ int id) const { return m_count == 0 || id > GetId(m_count - 1); }
+
+    // Reads the fields of item and inserts it at its position in id order.  Items
+    // after it move, so no snapshot can be in use unless IsAppend is true.
+    HRESULT Add(_In_ IPowerRenameItem* item, _Out_ UINT* index);
+    void PutSelected(_In_ UINT index, _In_ bool selected);
+    void Clear();
+
+    // Pool the new names of a regex worker are written to.  Only called by the regex
+    // worker thread, or while no regex worker thread runs.
+    CNamePool& AddNewNamePool();
+    // Moves the new names of the items of snapshot to a single pool once the pools hold
+    // mostly names that were replaced since.  Only called by the regex worker thread
+    // once its workers are done, snapshot must hold all the items having a new name.
+    void CompactNewNames(_In_ const CPowerRenameItemColumns& snapshot);
+
+private:
+    std::vector<std::unique_ptr<Block>> m_ownedBlocks;
+    // Original names and parent paths
+    CNamePool m_names;
+    // Parent path of the last item added, the items of a folder are added together
+    PCWSTR m_lastParentPath = nullptr;
+    std::vector<std::unique_ptr<CNamePool>> m_newNamePools;
+    // Size of the new names when they were last compacted
+    size_t m_compactedNewNamesSize = 0;
+};
@@ -1,13 +1,23 @@
 #include "pch.h"
 #include "PowerRenameManager.h"
 #include "PowerRenameRegEx.h" // Default RegEx handler
+#include "LiteralMatcher.h"
+#include "PowerRenameEngine.h"
+#include "UniqueNameResolver.h"
+#include "RenameJournal.h"
+#include "ShellRenameExecutor.h"
 #include <algorithm>
 #include <shlobj.h>
 #include <cstring>
 #include "helpers.h"
 #include <filesystem>
+#include <atomic>
+#include <optional>
+#include <thread>
 #include "trace.h"
 #include <winrt/base.h>
+#include <common/SettingsAPI/settings_helpers.h>
+#include <dll/PowerRenameConstants.h>
 
 namespace fs = std::filesystem;
 
@@ -135,6 +145,8 @@ IFACEMETHODIMP CPowerRenameManager::Reset()
 
 IFACEMETHODIMP CPowerRenameManager::Shutdown()
 {
+    // The regex pass reads the items without holding a reference to them
+    _CancelRegExWorkerThread();
     _ClearRegEx();
     _Cleanup();
     return S_OK;
@@ -142,19 +154,37 @@ IFACEMETHODIMP CPowerRenameManager::Shutdown()
 
 IFACEMETHODIMP CPowerRenameManager::AddItem(_In_ IPowerRenameItem* pItem)
 {
+    int id = 0;
+    pItem->GetId(&id);
+
+    // Items are kept in id order and are usually added in that order.  Inserting one
+    // before the end moves the items after it, so the regex pass reading them stops first.
+    bool isAppend = false;
+    {
+        CSRWSharedAutoLock lock(&m_lockItems);
+        isAppend = m_renameItems.IsAppend(id);
+    }
+    if (!isAppend)
+    {
+        _CancelRegExWorkerThread();
+        m_regExMatchState.valid = false;
+    }
+
     HRESULT hr = E_FAIL;
     // Scope lock
     {
         CSRWExclusiveAutoLock lock(&m_lockItems);
-        int id = 0;
-        pItem->GetId(&id);
         // Verify the item isn't already added
-        if (m_renameItems.find(id) == m_renameItems.end())
+        if (!m_renameItems.Contains(id))
         {
-            m_renameItems[id] = pItem;
-            m_isVisible.push_back(true);
-            pItem->AddRef();
-            hr = S_OK;
+            UINT index = 0;
+            hr = m_renameItems.Add(pItem, &index);
+            if (SUCCEEDED(hr))
+            {
+                m_visibleItems.Insert(index, true);
+                m_visibleItemsDirty = true;
+                m_extensions.Add(m_renameItems.GetOriginalName(index));
+            }
         }
     }
 
@@ -171,11 +201,9 @@ IFACEMETHODIMP CPowerRenameManager::GetItemByIndex(_In_ UINT index, _COM_Outptr_
     *ppItem = nullptr;
     CSRWSharedAutoLock lock(&m_lockItems);
     HRESULT hr = E_FAIL;
-    if (index < m_renameItems.size())
+    if (index < m_renameItems.Count())
     {
-        std::map<int, IPowerRenameItem*>::iterator it = m_renameItems.begin();
-        std::advance(it, index);
-        *ppItem = it->second;
+        *ppItem = m_renameItems.GetItem(index);
         (*ppItem)->AddRef();
         hr = S_OK;
     }
@@ -196,20 +224,7 @@ IFACEMETHODIMP CPowerRenameManager::GetVisibleItemByIndex(_In_ UINT index, _COM_
     }
     else if (SUCCEEDED(GetVisibleItemCount(&count)) && index < count)
     {
-        UINT realIndex = 0, visibleIndex = 0;
-        for (size_t i = 0; i < m_isVisible.size(); i++)
-        {
-            if (m_isVisible[i] && visibleIndex == index)
-            {
-                realIndex = static_cast<UINT>(i);
-                break;
-            }
-            if (m_isVisible[i])
-            {
-                visibleIndex++;
-            }
-        }
-        hr = GetItemByIndex(realIndex, ppItem);
+        hr = GetItemByIndex(m_visibleItems.Select(index), ppItem);
     }
 
     return hr;
@@ -221,11 +236,10 @@ IFACEMETHODIMP CPowerRenameManager::GetItemById(_In_ int id, _COM_Outptr_ IPower
 
     CSRWSharedAutoLock lock(&m_lockItems);
     HRESULT hr = E_FAIL;
-    std::map<int, IPowerRenameItem*>::iterator it;
-    it = m_renameItems.find(id);
-    if (it != m_renameItems.end())
+    const UINT index = m_renameItems.FindIndex(id);
+    if (index < m_renameItems.Count() && m_renameItems.GetId(index) == id)
     {
-        *ppItem = m_renameItems[id];
+        *ppItem = m_renameItems.GetItem(index);
         (*ppItem)->AddRef();
         hr = S_OK;
     }
@@ -236,32 +250,63 @@ IFACEMETHODIMP CPowerRenameManager::GetItemById(_In_ int id, _COM_Outptr_ IPower
 IFACEMETHODIMP CPowerRenameManager::GetItemCount(_Out_ UINT* count)
 {
     CSRWSharedAutoLock lock(&m_lockItems);
-    *count = static_cast<UINT>(m_renameItems.size());
+    *count = m_renameItems.Count();
     return S_OK;
 }
 
+IFACEMETHODIMP CPowerRenameManager::PutItemSelected(_In_ int id, _In_ bool selected)
+{
+    CSRWExclusiveAutoLock lock(&m_lockItems);
+    HRESULT hr = E_FAIL;
+    const UINT index = m_renameItems.FindIndex(id);
+    if (index < m_renameItems.Count() && m_renameItems.GetId(index) == id)
+    {
+        // The item keeps its own copy for the listeners reading it
+        m_renameItems.PutSelected(index, selected);
+        m_visibleItemsDirty = true;
+        hr = m_renameItems.GetItem(index)->PutSelected(selected);
+    }
+
+    return hr;
+}
+
 IFACEMETHODIMP CPowerRenameManager::SetVisible()
 {
     CSRWSharedAutoLock lock(&m_lockItems);
     HRESULT hr = E_FAIL;
+    // Cleared first so changes made while we run aren't lost
+    m_visibleItemsDirty = false;
+
+    // Every item is shown by the rename filter until there is a search term
+    bool showAll = false;
+    if (m_filter == PowerRenameFilters::ShouldRename)
+    {
+        PWSTR searchTerm = nullptr;
+        showAll = FAILED(m_spRegEx->GetSearchTerm(&searchTerm)) || (searchTerm && searchTerm[0] == L'\0');
+        CoTaskMemFree(searchTerm);
+    }
+
     UINT lastVisibleDepth = 0;
-    size_t i = m_isVisible.size() - 1;
-    PWSTR searchTerm = nullptr;
-    for (auto rit = m_renameItems.rbegin(); rit != m_renameItems.rend(); ++rit, --i)
+    for (UINT i = m_renameItems.Count(); i-- > 0;)
     {
-        bool isVisible = false;
-        if (m_filter == PowerRenameFilters::ShouldRename &&
-            (FAILED(m_spRegEx->GetSearchTerm(&searchTerm)) || searchTerm && wcslen(searchTerm) == 0))
-        {
-            isVisible = true;
-        }
-        else
+        bool isVisible = true;
+        if (!showAll)
         {
-            rit->second->IsItemVisible(m_filter, m_flags, &isVisible);
+            switch (m_filter)
+            {
+            case PowerRenameFilters::Selected:
+                isVisible = m_renameItems.IsSelected(i);
+                break;
+            case PowerRenameFilters::FlagsApplicable:
+                isVisible = !m_renameItems.IsExcluded(i, m_flags);
+                break;
+            case PowerRenameFilters::ShouldRename:
+                isVisible = m_renameItems.ShouldRename(i, m_flags);
+                break;
+            }
         }
 
-        UINT itemDepth = 0;
-        rit->second->GetDepth(&itemDepth);
+        const UINT itemDepth = m_renameItems.GetDepth(i);
 
         //Make an item visible if it has a least one visible subitem
         if (isVisible)
@@ -274,10 +319,13 @@ IFACEMETHODIMP CPowerRenameManager::SetVisible()
             lastVisibleDepth = itemDepth;
         }
 
-        m_isVisible[i] = isVisible;
+        m_visibleItems.Set(i, isVisible);
         hr = S_OK;
     }
 
+    // Only the blocks of the items that changed are counted again
+    m_visibleItems.Update();
+
     return hr;
 }
 
@@ -288,15 +336,14 @@ IFACEMETHODIMP CPowerRenameManager::GetVisibleItemCount(_Out_ UINT* count)
 
     if (m_filter != PowerRenameFilters::None)
     {
-        SetVisible();
-
-        for (size_t i = 0; i < m_isVisible.size(); i++)
+        // The list view asks for the count for every row it paints, the visibility
+        // is only evaluated again after something it depends on changed
+        if (m_visibleItemsDirty)
         {
-            if (m_isVisible[i])
-            {
-                (*count)++;
-            }
+            SetVisible();
         }
+
+        *count = m_visibleItems.Count();
     }
     else
     {
@@ -311,11 +358,9 @@ IFACEMETHODIMP CPowerRenameManager::GetSelectedItemCount(_Out_ UINT* count)
     *count = 0;
     CSRWSharedAutoLock lock(&m_lockItems);
 
-    for (auto it : m_renameItems)
+    for (UINT u = 0; u < m_renameItems.Count(); u++)
     {
-        IPowerRenameItem* pItem = it.second;
-        bool selected = false;
-        if (SUCCEEDED(pItem->GetSelected(&selected)) && selected)
+        if (m_renameItems.IsSelected(u))
         {
             (*count)++;
         }
@@ -329,11 +374,9 @@ IFACEMETHODIMP CPowerRenameManager::GetRenameItemCount(_Out_ UINT* count)
     *count = 0;
     CSRWSharedAutoLock lock(&m_lockItems);
 
-    for (auto it : m_renameItems)
+    for (UINT u = 0; u < m_renameItems.Count(); u++)
     {
-        IPowerRenameItem* pItem = it.second;
-        bool shouldRename = false;
-        if (SUCCEEDED(pItem->ShouldRenameItem(m_flags, &shouldRename)) && shouldRename)
+        if (m_renameItems.ShouldRename(u, m_flags))
         {
             (*count)++;
         }
@@ -342,6 +385,34 @@ IFACEMETHODIMP CPowerRenameManager::GetRenameItemCount(_Out_ UINT* count)
     return S_OK;
 }
 
+IFACEMETHODIMP CPowerRenameManager::PutViewport(_In_ UINT firstVisibleIndex, _In_ UINT lastVisibleIndex)
+{
+    m_viewportFirst = firstVisibleIndex;
+    m_viewportLast = lastVisibleIndex;
+    return S_OK;
+}
+
+// Converts the viewport from list view indexes to item indexes
+void CPowerRenameManager::_GetViewport(_Out_ UINT* firstIndex, _Out_ UINT* lastIndex)
+{
+    *firstIndex = m_viewportFirst;
+    *lastIndex = m_viewportLast;
+
+    if (m_filter != PowerRenameFilters::None)
+    {
+        CSRWSharedAutoLock lock(&m_lockItems);
+        const UINT visibleCount = m_visibleItems.Count();
+        if (m_viewportFirst < visibleCount)
+        {
+            *firstIndex = m_visibleItems.Select(m_viewportFirst);
+        }
+        if (m_viewportLast < visibleCount)
+        {
+            *lastIndex = m_visibleItems.Select(m_viewportLast);
+        }
+    }
+}
+
 IFACEMETHODIMP CPowerRenameManager::GetFlags(_Out_ DWORD* flags)
 {
     _EnsureRegEx();
@@ -354,6 +425,7 @@ IFACEMETHODIMP CPowerRenameManager::PutFlags(_In_ DWORD flags)
     if (flags != m_flags)
     {
         m_flags = flags;
+        m_visibleItemsDirty = true;
         _EnsureRegEx();
         m_spRegEx->PutFlags(flags);
     }
@@ -384,6 +456,8 @@ IFACEMETHODIMP CPowerRenameManager::SwitchFilter(_In_ int columnNumber)
         break;
     }
 
+    m_visibleItemsDirty = true;
+
     return S_OK;
 }
 
@@ -425,8 +499,16 @@ IFACEMETHODIMP CPowerRenameManager::PutRenameItemFactory(_In_ IPowerRenameItemFa
     return S_OK;
 }
 
+IFACEMETHODIMP CPowerRenameManager::UpdateNewNames()
+{
+    // Items were added since the last preview, ex: while enumerating
+    return _PerformRegExRename();
+}
+
 IFACEMETHODIMP CPowerRenameManager::OnSearchTermChanged(_In_ PCWSTR /*searchTerm*/)
 {
+    // The rename filter shows every item while the search term is empty
+    m_visibleItemsDirty = true;
     _PerformRegExRename();
     return S_OK;
 }
@@ -441,6 +523,7 @@ IFACEMETHODIMP CPowerRenameManager::OnFlagsChanged(_In_ DWORD flags)
 {
     // Flags were updated in the rename regex.  Update our preview.
     m_flags = flags;
+    m_visibleItemsDirty = true;
     _PerformRegExRename();
     return S_OK;
 }
@@ -494,7 +577,7 @@ HRESULT CPowerRenameManager::_Init()
 // Custom messages for worker threads
 enum
 {
-    SRM_REGEX_ITEM_UPDATED = (WM_APP + 1), // Single rename item processed by regex worker thread
+    SRM_REGEX_ITEMS_UPDATED = (WM_APP + 1), // Rename items processed by regex worker thread, see CDirtyItemTracker
     SRM_REGEX_STARTED, // RegEx operation was started
     SRM_REGEX_CANCELED, // Regex operation was canceled
     SRM_REGEX_COMPLETE, // Regex worker thread completed
@@ -508,6 +591,14 @@ struct WorkerThreadData
     HANDLE cancelEvent = nullptr;
     HWND hwndParent = nullptr;
     CComPtr<IPowerRenameManager> spsrm;
+    CPowerRenameItemColumns items;
+    // Regex worker only
+    CPowerRenameItemStore* itemStore = nullptr;
+    CDirtyItemTracker* updatedItems = nullptr;
+    CPowerRenameManager::RegExMatchState* matchState = nullptr;
+    // Range of item indexes shown in the list view, processed first
+    UINT viewportFirst = 0;
+    UINT viewportLast = 0;
 };
 
 // Msg-only worker window proc for communication from our worker threads
@@ -541,25 +632,21 @@ LRESULT CPowerRenameManager::_WndProc(_In_ HWND hwnd, _In_ UINT msg, _In_ WPARAM
 
     switch (msg)
     {
-    case SRM_REGEX_ITEM_UPDATED:
-    {
-        int id = static_cast<int>(lParam);
-        CComPtr<IPowerRenameItem> spItem;
-        if (SUCCEEDED(GetItemById(id, &spItem)))
-        {
-            _OnUpdate(spItem);
-        }
+    case SRM_REGEX_ITEMS_UPDATED:
+        _FlushUpdatedItems();
         break;
-    }
+
     case SRM_REGEX_STARTED:
         _OnRegExStarted(static_cast<DWORD>(wParam));
         break;
 
     case SRM_REGEX_CANCELED:
+        _FlushUpdatedItems();
         _OnRegExCanceled(static_cast<DWORD>(wParam));
         break;
 
     case SRM_REGEX_COMPLETE:
+        _FlushUpdatedItems();
         _OnRegExCompleted(static_cast<DWORD>(wParam));
         break;
 
@@ -585,39 +672,11 @@ void CPowerRenameManager::_LogOperationTelemetry()
     GetRenameItemCount(&renameItemCount);
     GetFlags(&flags);
 
-    // Enumerate extensions used into a map
-    std::map<std::wstring, int> extensionsMap;
-    for (UINT i = 0; i < totalItemCount; i++)
-    {
-        CComPtr<IPowerRenameItem> spItem;
-        if (SUCCEEDED(GetItemByIndex(i, &spItem)))
-        {
-            PWSTR originalName;
-            if (SUCCEEDED(spItem->GetOriginalName(&originalName)))
-            {
-                std::wstring extension = fs::path(originalName).extension().wstring();
-                std::map<std::wstring, int>::iterator it = extensionsMap.find(extension);
-                if (it == extensionsMap.end())
-                {
-                    extensionsMap.insert({ extension, 1 });
-                }
-                else
-                {
-                    it->second++;
-                }
-
-                CoTaskMemFree(originalName);
-            }
-        }
-    }
-
-    std::wstring extensionList = L"";
-    for (auto elem : extensionsMap)
+    // The extensions are counted as the items are added
+    std::wstring extensionList;
     {
-        extensionList.append(elem.first);
-        extensionList.append(L":");
-        extensionList.append(std::to_wstring(elem.second));
-        extensionList.append(L",");
+        CSRWSharedAutoLock lock(&m_lockItems);
+        extensionList = m_extensions.GetTopList();
     }
 
     Trace::RenameOperation(totalItemCount, selectedItemCount, renameItemCount, flags, extensionList.c_str());
@@ -687,6 +746,10 @@ HRESULT CPowerRenameManager::_CreateFileOpWorkerThread()
         pwtd->startEvent = m_startRegExWorkerEvent;
         pwtd->cancelEvent = nullptr;
         pwtd->spsrm = this;
+        {
+            CSRWSharedAutoLock lock(&m_lockItems);
+            pwtd->items = m_renameItems.GetSnapshot();
+        }
         m_fileOpWorkerThreadHandle = CreateThread(nullptr, 0, s_fileOpWorkerThread, pwtd, 0, nullptr);
         hr = E_FAIL;
         if (m_fileOpWorkerThreadHandle)
@@ -702,6 +765,116 @@ HRESULT CPowerRenameManager::_CreateFileOpWorkerThread()
     return hr;
 }
 
+namespace
+{
+    const wchar_t c_renameJournalPrefix[] = L"rename-journal-";
+
+    // Journal of the rename operation running in this process.  It is deleted once the
+    // operation is over, so one left behind belongs to an operation that was interrupted.
+    fs::path GetRenameJournalPath()
+    {
+        std::wstring path = PTSettingsHelper::get_module_save_folder_location(PowerRenameConstants::ModuleKey);
+        path += L"\\" + std::wstring(c_renameJournalPrefix) + std::to_wstring(GetCurrentProcessId()) + L"-" + std::to_wstring(GetTickCount64()) + L".bin";
+        return path;
+    }
+
+    bool HasProcessExited(_In_ DWORD pid)
+    {
+        HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, pid);
+        if (!process)
+        {
+            // Access is denied to a process that is running
+            return GetLastError() == ERROR_INVALID_PARAMETER;
+        }
+        const bool exited = WaitForSingleObject(process, 0) == WAIT_OBJECT_0;
+        CloseHandle(process);
+        return exited;
+    }
+}
+
+std::vector<CPowerRenameManager::InterruptedRename> CPowerRenameManager::s_GetInterruptedRenames()
+{
+    const fs::path folder = PTSettingsHelper::get_module_save_folder_location(PowerRenameConstants::ModuleKey);
+    std::vector<fs::path> journalPaths;
+    std::error_code error;
+    for (fs::directory_iterator it(folder, error), end; !error && it != end; it.increment(error))
+    {
+        const std::wstring name = it->path().filename().wstring();
+        if (name.rfind(c_renameJournalPrefix, 0) != 0 || it->path().extension() != L".bin")
+        {
+            continue;
+        }
+
+        // The operations of running processes aren't interrupted
+        const DWORD pid = wcstoul(name.c_str() + ARRAYSIZE(c_renameJournalPrefix) - 1, nullptr, 10);
+        if (pid != GetCurrentProcessId() && HasProcessExited(pid))
+        {
+            journalPaths.push_back(it->path());
+        }
+    }
+
+    std::vector<InterruptedRename> renames;
+    for (const auto& path : journalPaths)
+    {
+        std::unique_ptr<CRenameJournal> journal;
+        const HRESULT hr = CRenameJournal::s_Open(path, journal);
+        if (hr == S_OK && !journal->IsFinished())
+        {
+            renames.push_back({ path, journal->GetProgress().total, journal->GetProgress().done });
+        }
+        else if (SUCCEEDED(hr) || hr == HRESULT_FROM_WIN32(ERROR_INVALID_DATA))
+        {
+            // Nothing was renamed, the operation was over, or the journal can't be read
+            journal.reset();
+            fs::remove(path, error);
+        }
+    }
+    return renames;
+}
+
+HRESULT CPowerRenameManager::s_RecoverInterruptedRename(_In_ const InterruptedRename& rename, _In_ bool rollBack, _In_opt_ HWND hwndParent)
+{
+    std::unique_ptr<CRenameJournal> journal;
+    HRESULT hr = CRenameJournal::s_Open(rename.journalPath, journal);
+    if (hr == S_OK && !journal->IsFinished())
+    {
+        // As few operations as the journal allows, like the rename itself.  A roll back
+        // runs one operation per folder depth.
+        CShellRenameExecutor executor(hwndParent, FOF_DEFAULTFLAGS);
+        hr = rollBack ? journal->RollBack(executor, journal->GetEntryCount(), nullptr) : journal->Execute(executor, journal->GetEntryCount(), nullptr);
+    }
+
+    // Kept to be offered again if the user canceled
+    if (SUCCEEDED(hr) && journal)
+    {
+        hr = journal->Finish();
+    }
+    return hr;
+}
+
+HRESULT CPowerRenameManager::GetRenamePlan(_Out_ std::vector<RenamePlanItem>& plan)
+{
+    plan.clear();
+    _WaitForRegExWorkerThread();
+
+    CPowerRenameItemColumns items;
+    {
+        CSRWSharedAutoLock lock(&m_lockItems);
+        items = m_renameItems.GetSnapshot();
+    }
+    s_GetRenamePlan(items, m_flags, plan);
+    return S_OK;
+}
+
+void CPowerRenameManager::s_GetRenamePlan(_In_ const CPowerRenameItemColumns& items, _In_ DWORD flags, _Out_ std::vector<RenamePlanItem>& plan)
+{
+    // The items in the order they are renamed, deepest first so child items are
+    // renamed before parent items, read from the columns of the items.  The names
+    // the batch takes twice in a folder were numbered by the regex pass.
+    plan.clear();
+    items.GetRenamePlan(flags, plan);
+}
+
 DWORD WINAPI CPowerRenameManager::s_fileOpWorkerThread(_In_ void* pv)
 {
     if (SUCCEEDED(CoInitializeEx(NULL, 0)))
@@ -715,74 +888,31 @@ DWORD WINAPI CPowerRenameManager::s_fileOpWorkerThread(_In_ void* pv)
                 CComPtr<IPowerRenameRegEx> spRenameRegEx;
                 if (SUCCEEDED(pwtd->spsrm->GetRenameRegEx(&spRenameRegEx)))
                 {
-                    // Create IFileOperation interface
-                    CComPtr<IFileOperation> spFileOp;
-                    if (SUCCEEDED(CoCreateInstance(CLSID_FileOperation, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&spFileOp))))
-                    {
-                        DWORD flags = 0;
-                        spRenameRegEx->GetFlags(&flags);
-
-                        UINT itemCount = 0;
-                        pwtd->spsrm->GetItemCount(&itemCount);
-
-                        // We add the items to the operation in depth-first order.  This allows child items to be
-                        // renamed before parent items.
+                    DWORD flags = 0;
+                    spRenameRegEx->GetFlags(&flags);
 
-                        // Creating a vector of vectors of items of the same depth
-                        std::vector<std::vector<UINT>> matrix(itemCount);
-
-                        for (UINT u = 0; u < itemCount; u++)
-                        {
-                            CComPtr<IPowerRenameItem> spItem;
-                            if (SUCCEEDED(pwtd->spsrm->GetItemByIndex(u, &spItem)))
-                            {
-                                UINT depth = 0;
-                                spItem->GetDepth(&depth);
-                                matrix[depth].push_back(u);
-                            }
-                        }
-
-                        // From the greatest depth first, add all items of that depth to the operation
-                        for (LONG v = itemCount - 1; v >= 0; v--)
-                        {
-                            for (auto it : matrix[v])
-                            {
-                                CComPtr<IPowerRenameItem> spItem;
-                                if (SUCCEEDED(pwtd->spsrm->GetItemByIndex(it, &spItem)))
-                                {
-                                    bool shouldRename = false;
-                                    if (SUCCEEDED(spItem->ShouldRenameItem(flags, &shouldRename)) && shouldRename)
-                                    {
-                                        PWSTR newName = nullptr;
-                                        if (SUCCEEDED(spItem->GetNewName(&newName)))
-                                        {
-                                            CComPtr<IShellItem> spShellItem;
-                                            if (SUCCEEDED(spItem->GetShellItem(&spShellItem)))
-                                            {
-                                                spFileOp->RenameItem(spShellItem, newName, nullptr);
-                                            }
-                                            CoTaskMemFree(newName);
-                                        }
-                                    }
-                                }
-                            }
-                        }
+                    std::vector<RenamePlanItem> plan;
+                    s_GetRenamePlan(pwtd->items, flags, plan);
 
-                        // Set the operation flags
-                        if (SUCCEEDED(spFileOp->SetOperationFlags(FOF_DEFAULTFLAGS)))
-                        {
-                            // Set the parent window
-                            if (pwtd->hwndParent)
-                            {
-                                spFileOp->SetOwnerWindow(pwtd->hwndParent);
-                            }
+                    // The journal lets an interrupted operation be finished or rolled back, see
+                    // s_GetInterruptedRenames.  Without a journal file, the operation still runs
+                    // with the journal in memory.
+                    std::unique_ptr<CRenameJournal> journal;
+                    if (FAILED(CRenameJournal::s_Create(GetRenameJournalPath(), plan, journal)))
+                    {
+                        CRenameJournal::s_Create(fs::path(), plan, journal);
+                    }
 
-                            // Perform the operation
-                            // We don't care about the return code here. We would rather
-                            // return control back to explorer so the user can cleanly
-                            // undo the operation if it failed halfway through.
-                            spFileOp->PerformOperations();
-                        }
+                    if (journal)
+                    {
+                        // We don't care about the return code here. We would rather
+                        // return control back to explorer so the user can cleanly
+                        // undo the operation if it failed halfway through.  All the items
+                        // are renamed in one batch, one IFileOperation, so Explorer shows
+                        // one progress dialog and undoes the rename in one step.
+                        CShellRenameExecutor executor(pwtd->hwndParent, FOF_DEFAULTFLAGS);
+                        journal->Execute(executor, journal->GetEntryCount(), nullptr);
+                        journal->Finish();
                     }
                 }
             }
@@ -838,6 +968,17 @@ HRESULT CPowerRenameManager::_CreateRegExWorkerThread()
         pwtd->cancelEvent = m_cancelRegExWorkerEvent;
         pwtd->hwndParent = m_hwndParent;
         pwtd->spsrm = this;
+        {
+            CSRWSharedAutoLock lock(&m_lockItems);
+            pwtd->items = m_renameItems.GetSnapshot();
+        }
+        pwtd->itemStore = &m_renameItems;
+        // The canceled pass may have updated items it didn't report yet
+        _FlushUpdatedItems();
+        m_updatedItems.Reset(pwtd->items.Count());
+        pwtd->updatedItems = &m_updatedItems;
+        pwtd->matchState = &m_regExMatchState;
+        _GetViewport(&pwtd->viewportFirst, &pwtd->viewportLast);
         m_regExWorkerThreadHandle = CreateThread(nullptr, 0, s_regexWorkerThread, pwtd, 0, nullptr);
         hr = E_FAIL;
         if (m_regExWorkerThreadHandle)
@@ -853,6 +994,49 @@ HRESULT CPowerRenameManager::_CreateRegExWorkerThread()
     return hr;
 }
 
+namespace
+{
+    // Number of items a regex worker claims at a time.  Small enough to keep every
+    // worker busy until the end of the pass and to react quickly to cancellation.
+    const UINT c_regExChunkSize = 256;
+
+    // Computes the new name of an item, before any enumeration is applied.  Returns an
+    // empty optional when the item keeps its original name.  Items of different indexes
+    // can be processed concurrently.
+    // When literalMatcher is set, isMatch receives whether the source contains its search
+    // term.  Since each character is folded on its own, a source that doesn't contain a
+    // search term can't contain any search term starting with it either.
+    std::optional<std::wstring> GetRegExNewName(_In_ IPowerRenameRegEx* renameRegEx, _In_ const CPowerRenameItemColumns& items, _In_ UINT index, DWORD flags, bool useFileTime, _In_opt_ const CLiteralMatcher* literalMatcher, _Out_opt_ bool* isMatch)
+    {
+        SYSTEMTIME fileTime = { 0 };
+        if (useFileTime)
+        {
+            winrt::check_hresult(items.GetItem(index)->GetTime(&fileTime));
+        }
+
+        std::optional<std::wstring> newName;
+        winrt::check_hresult(GetRenamedFileName(renameRegEx, items.GetOriginalName(index), flags, useFileTime ? &fileTime : nullptr, literalMatcher, isMatch, newName));
+
+        return newName;
+    }
+
+    // Stores the new name of an item and lets the manager thread know if it changed
+    void CommitNewName(_In_ const CPowerRenameItemColumns& items, _In_ UINT index, _In_opt_ PCWSTR newName, _Inout_ CNamePool& namePool, _In_ WorkerThreadData* pwtd)
+    {
+        // Was there a change?  Only then the item gets a copy of the new name for the
+        // listeners reading it.  The updates are coalesced and the manager thread is
+        // only messaged when a batch of them is ready.
+        if (items.PutNewName(index, newName, namePool))
+        {
+            winrt::check_hresult(items.GetItem(index)->PutNewName(newName));
+            if (pwtd->updatedItems->MarkDirty(index))
+            {
+                PostMessage(pwtd->hwndManager, SRM_REGEX_ITEMS_UPDATED, GetCurrentThreadId(), 0);
+            }
+        }
+    }
+}
+
 DWORD WINAPI CPowerRenameManager::s_regexWorkerThread(_In_ void* pv)
 {
     try
@@ -874,180 +1058,244 @@ DWORD WINAPI CPowerRenameManager::s_regexWorkerThread(_In_ void* pv)
                 winrt::check_hresult(spRenameRegEx->GetFlags(&flags));
 
                 PWSTR replaceTerm = nullptr;
+                PWSTR searchTerm = nullptr;
                 bool useFileTime = false;
 
                 winrt::check_hresult(spRenameRegEx->GetReplaceTerm(&replaceTerm));
+                winrt::check_hresult(spRenameRegEx->GetSearchTerm(&searchTerm));
 
                 if (isFileTimeUsed(replaceTerm))
                 {
                     useFileTime = true;
                 }
 
-                UINT itemCount = 0;
-                unsigned long itemEnumIndex = 1;
-                winrt::check_hresult(pwtd->spsrm->GetItemCount(&itemCount));
-                for (UINT u = 0; u < itemCount; u++)
+                const CPowerRenameItemColumns& items = pwtd->items;
+                const UINT itemCount = items.Count();
+
+                // The enumeration number of an item depends on all items before it, so when
+                // enumerating the new names are only committed by the sequential pass below.
+                const bool enumerate = (flags & EnumerateItems) != 0;
+                std::vector<std::optional<std::wstring>> pendingNames(enumerate ? itemCount : 0);
+
+                // When the literal search term of the last completed pass was extended, only
+                // the items that matched it can have a different new name.
+                RegExMatchState& matchState = *pwtd->matchState;
+                const bool literal = !(flags & UseRegularExpressions);
+                const std::wstring currentSearchTerm(searchTerm ? searchTerm : L"");
+                const std::wstring currentReplaceTerm(replaceTerm ? replaceTerm : L"");
+                const bool incremental = literal && !enumerate && matchState.valid &&
+                                         matchState.flags == flags &&
+                                         matchState.replaceTerm == currentReplaceTerm &&
+                                         matchState.isMatch.size() == itemCount &&
+                                         !matchState.searchTerm.empty() &&
+                                         currentSearchTerm.compare(0, matchState.searchTerm.length(), matchState.searchTerm) == 0;
+                matchState.valid = false;
+                std::optional<CLiteralMatcher> literalMatcher;
+                if (literal)
+                {
+                    literalMatcher.emplace(currentSearchTerm, !(flags & CaseSensitive));
+                }
+                if (!incremental)
+                {
+                    matchState.isMatch.assign(literal ? itemCount : 0, FALSE);
+                }
+                CoTaskMemFree(replaceTerm);
+                CoTaskMemFree(searchTerm);
+
+                // Process the chunks shown in the list view first
+                const UINT chunkCount = (itemCount + c_regExChunkSize - 1) / c_regExChunkSize;
+                std::vector<UINT> chunkOrder;
+                chunkOrder.reserve(chunkCount);
+                UINT firstViewportChunk = pwtd->viewportFirst / c_regExChunkSize;
+                UINT lastViewportChunk = min(pwtd->viewportLast / c_regExChunkSize, chunkCount - 1);
+                for (UINT chunk = firstViewportChunk; chunk < chunkCount && chunk <= lastViewportChunk; chunk++)
+                {
+                    chunkOrder.push_back(chunk);
+                }
+                for (UINT chunk = 0; chunk < chunkCount; chunk++)
                 {
-                    // Check if cancel event is signaled
-                    if (WaitForSingleObject(pwtd->cancelEvent, 0) == WAIT_OBJECT_0)
+                    if (chunk < firstViewportChunk || chunk > lastViewportChunk)
                     {
-                        // Canceled from manager
-                        // Send the manager thread the canceled message
-                        PostMessage(pwtd->hwndManager, SRM_REGEX_CANCELED, GetCurrentThreadId(), 0);
-                        break;
+                        chunkOrder.push_back(chunk);
                     }
+                }
 
-                    CComPtr<IPowerRenameItem> spItem;
-                    winrt::check_hresult(pwtd->spsrm->GetItemByIndex(u, &spItem));
-
-                    int id = -1;
-                    winrt::check_hresult(spItem->GetId(&id));
+                std::atomic<UINT> nextChunk = 0;
+                std::atomic<bool> stop = false;
+                std::atomic<bool> canceled = false;
+                std::atomic<HRESULT> workerResult = S_OK;
 
-                    bool isFolder = false;
-                    bool isSubFolderContent = false;
-                    winrt::check_hresult(spItem->GetIsFolder(&isFolder));
-                    winrt::check_hresult(spItem->GetIsSubFolderContent(&isSubFolderContent));
-                    if ((isFolder && (flags & PowerRenameFlags::ExcludeFolders)) ||
-                        (!isFolder && (flags & PowerRenameFlags::ExcludeFiles)) ||
-                        (isSubFolderContent && (flags & PowerRenameFlags::ExcludeSubfolders)))
+                auto regExWorker = [&](CNamePool& namePool) {
+                    try
                     {
-                        // Exclude this item from renaming.  Ensure new name is cleared.
-                        winrt::check_hresult(spItem->PutNewName(nullptr));
-
-                        // Send the manager thread the item processed message
-                        PostMessage(pwtd->hwndManager, SRM_REGEX_ITEM_UPDATED, GetCurrentThreadId(), id);
-
-                        continue;
-                    }
+                        while (!stop)
+                        {
+                            const UINT chunkIndex = nextChunk++;
+                            if (chunkIndex >= chunkCount)
+                            {
+                                break;
+                            }
+                            const UINT chunk = chunkOrder[chunkIndex];
 
-                    PWSTR originalName = nullptr;
-                    winrt::check_hresult(spItem->GetOriginalName(&originalName));
+                            // Check if cancel event is signaled
+                            if (WaitForSingleObject(pwtd->cancelEvent, 0) == WAIT_OBJECT_0)
+                            {
+                                canceled = true;
+                                stop = true;
+                                break;
+                            }
 
+                            const UINT last = min(itemCount, (chunk + 1) * c_regExChunkSize);
+                            for (UINT u = chunk * c_regExChunkSize; u < last; u++)
+                            {
+                                if (incremental && !matchState.isMatch[u])
+                                {
+                                    // Proven not to match by the previous pass
+                                    continue;
+                                }
 
-                    PWSTR currentNewName = nullptr;
-                    winrt::check_hresult(spItem->GetNewName(&currentNewName));
+                                if (items.IsExcluded(u, flags))
+                                {
+                                    // Exclude this item from renaming.  Ensure new name is cleared.
+                                    CommitNewName(items, u, nullptr, namePool, pwtd);
+                                    continue;
+                                }
 
-                    wchar_t sourceName[MAX_PATH] = { 0 };
-                    if (flags & NameOnly)
-                    {
-                        StringCchCopy(sourceName, ARRAYSIZE(sourceName), fs::path(originalName).stem().c_str());
-                    }
-                    else if (flags & ExtensionOnly)
-                    {
-                        std::wstring extension = fs::path(originalName).extension().wstring();
-                        if (!extension.empty() && extension.front() == '.')
-                        {
-                            extension = extension.erase(0, 1);
+                                bool isMatch = false;
+                                std::optional<std::wstring> newName = GetRegExNewName(spRenameRegEx, items, u, flags, useFileTime, literalMatcher ? &*literalMatcher : nullptr, &isMatch);
+                                if (literal)
+                                {
+                                    matchState.isMatch[u] = isMatch;
+                                }
+                                if (enumerate && newName)
+                                {
+                                    pendingNames[u] = std::move(newName);
+                                }
+                                else
+                                {
+                                    CommitNewName(items, u, newName ? newName->c_str() : nullptr, namePool, pwtd);
+                                }
+                            }
                         }
-                        StringCchCopy(sourceName, ARRAYSIZE(sourceName), extension.c_str());
                     }
-                    else
+                    catch (winrt::hresult_error const& e)
                     {
-                        StringCchCopy(sourceName, ARRAYSIZE(sourceName), originalName);
+                        workerResult = e.code();
+                        stop = true;
                     }
-
-                    SYSTEMTIME fileTime = { 0 };
-
-                    if (useFileTime)
+                    catch (...)
                     {
-                        winrt::check_hresult(spItem->GetTime(&fileTime));
-                        winrt::check_hresult(spRenameRegEx->PutFileTime(fileTime));
+                        workerResult = E_FAIL;
+                        stop = true;
                     }
+                };
 
-                    PWSTR newName = nullptr;
-
-                    // Failure here means we didn't match anything or had nothing to match
-                    // Call put_newName with null in that case to reset it
-                    winrt::check_hresult(spRenameRegEx->Replace(sourceName, &newName));
-
-                    if (useFileTime)
-                    {
-                        winrt::check_hresult(spRenameRegEx->ResetFileTime());
-                    }
+                UINT workerCount = min(max(std::thread::hardware_concurrency(), 1u), max(chunkCount, 1u));
 
-                    wchar_t resultName[MAX_PATH] = { 0 };
+                // Each worker writes the new names to its own pool
+                std::vector<CNamePool*> namePools;
+                for (UINT i = 0; i < workerCount; i++)
+                {
+                    namePools.push_back(&pwtd->itemStore->AddNewNamePool());
+                }
 
-                    PWSTR newNameToUse = nullptr;
+                std::vector<std::thread> workers;
+                for (UINT i = 1; i < workerCount; i++)
+                {
+                    workers.emplace_back(regExWorker, std::ref(*namePools[i]));
+                }
+                regExWorker(*namePools[0]);
+                for (auto& worker : workers)
+                {
+                    worker.join();
+                }
 
-                    // newName == nullptr likely means we have an empty search string.  We should leave newNameToUse
-                    // as nullptr so we clear the renamed column
-                    // Except string transformation is selected.
+                winrt::check_hresult(workerResult.load());
 
-                    if (newName == nullptr && (flags & Uppercase || flags & Lowercase || flags & Titlecase))
+                if (!canceled && enumerate)
+                {
+                    // Sequential pass assigning the enumeration numbers in item order.  The
+                    // names are picked against the contents of each folder, read once, and
+                    // the names already picked for the other items.  The current names of the
+                    // items getting a new name don't count, they are renamed away.
+                    CUniqueNameResolver uniqueNames;
+                    for (UINT u = 0; u < itemCount; u++)
                     {
-                        SHStrDup(sourceName, &newName);
+                        if (pendingNames[u])
+                        {
+                            uniqueNames.Release(items.GetParentPath(u), items.GetOriginalName(u));
+                        }
                     }
 
-                    if (newName != nullptr)
+                    unsigned long itemEnumIndex = 1;
+                    for (UINT u = 0; u < itemCount; u++)
                     {
-                        newNameToUse = resultName;
-                        if (flags & NameOnly)
+                        if (u % c_regExChunkSize == 0 && WaitForSingleObject(pwtd->cancelEvent, 0) == WAIT_OBJECT_0)
                         {
-                            StringCchPrintf(resultName, ARRAYSIZE(resultName), L"%s%s", newName, fs::path(originalName).extension().c_str());
+                            canceled = true;
+                            break;
                         }
-                        else if (flags & ExtensionOnly)
+
+                        if (!pendingNames[u])
                         {
-                            std::wstring extension = fs::path(originalName).extension().wstring();
-                            if (!extension.empty())
-                            {
-                                StringCchPrintf(resultName, ARRAYSIZE(resultName), L"%s.%s", fs::path(originalName).stem().c_str(), newName);
-                            }
-                            else
-                            {
-                                StringCchCopy(resultName, ARRAYSIZE(resultName), originalName);
-                            }
+                            continue;
                         }
-                        else
+
+                        PCWSTR newNameToUse = pendingNames[u]->c_str();
+                        std::wstring uniqueName;
+                        unsigned long countUsed = 0;
+                        if (uniqueNames.GetEnumeratedName(items.GetParentPath(u), newNameToUse, itemEnumIndex, uniqueName, &countUsed) == S_OK)
                         {
-                            StringCchCopy(resultName, ARRAYSIZE(resultName), newName);
+                            newNameToUse = uniqueName.c_str();
                         }
-                    }
-
-                    wchar_t trimmedName[MAX_PATH] = { 0 };
-                    if (newNameToUse != nullptr)
-                    {
-                        winrt::check_hresult(GetTrimmedFileName(trimmedName, ARRAYSIZE(trimmedName), newNameToUse));
-                        newNameToUse = trimmedName;
-                    }
+                        itemEnumIndex++;
 
-                    wchar_t transformedName[MAX_PATH] = { 0 };
-                    if (newNameToUse != nullptr && (flags & Uppercase || flags & Lowercase || flags & Titlecase))
-                    {
-                        winrt::check_hresult(GetTransformedFileName(transformedName, ARRAYSIZE(transformedName), newNameToUse, flags));
-                        newNameToUse = transformedName;
+                        CommitNewName(items, u, newNameToUse, *namePools[0], pwtd);
                     }
-
-                    // No change from originalName so set newName to
-                    // null so we clear it from our UI as well.
-                    if (lstrcmp(originalName, newNameToUse) == 0)
+                }
+                else if (!canceled)
+                {
+                    // Sequential pass finding the items renamed to the same name in the same
+                    // folder.  The later ones get the next free number, like the shell would
+                    // give them, so the preview shows the names the rename gives.  The folder
+                    // is only read when a collision is found in it.
+                    CUniqueNameResolver batchNames;
+                    for (UINT u = 0; u < itemCount; u++)
                     {
-                        newNameToUse = nullptr;
-                    }
+                        if (u % c_regExChunkSize == 0 && WaitForSingleObject(pwtd->cancelEvent, 0) == WAIT_OBJECT_0)
+                        {
+                            canceled = true;
+                            break;
+                        }
 
-                    wchar_t uniqueName[MAX_PATH] = { 0 };
-                    if (newNameToUse != nullptr && (flags & EnumerateItems))
-                    {
+                        PCWSTR newName = items.GetNewName(u);
+                        std::wstring uniqueName;
                         unsigned long countUsed = 0;
-                        if (GetEnumeratedFileName(uniqueName, ARRAYSIZE(uniqueName), newNameToUse, nullptr, itemEnumIndex, &countUsed))
+                        if (newName && !batchNames.Claim(items.GetParentPath(u), newName) &&
+                            batchNames.GetEnumeratedName(items.GetParentPath(u), newName, 2, uniqueName, &countUsed) == S_OK)
                         {
-                            newNameToUse = uniqueName;
+                            CommitNewName(items, u, uniqueName.c_str(), *namePools[0], pwtd);
                         }
-                        itemEnumIndex++;
                     }
+                }
 
-                    winrt::check_hresult(spItem->PutNewName(newNameToUse));
+                pwtd->itemStore->CompactNewNames(items);
 
-                    // Was there a change?
-                    if (lstrcmp(currentNewName, newNameToUse) != 0)
-                    {
-                        // Send the manager thread the item processed message
-                        PostMessage(pwtd->hwndManager, SRM_REGEX_ITEM_UPDATED, GetCurrentThreadId(), id);
-                    }
-                    CoTaskMemFree(newName);
-                    CoTaskMemFree(currentNewName);
-                    CoTaskMemFree(originalName);
+                if (!canceled && literal)
+                {
+                    matchState.flags = flags;
+                    matchState.searchTerm = currentSearchTerm;
+                    matchState.replaceTerm = currentReplaceTerm;
+                    matchState.incremental = incremental;
+                    matchState.valid = true;
+                }
+
+                if (canceled)
+                {
+                    // Canceled from manager
+                    // Send the manager thread the canceled message
+                    PostMessage(pwtd->hwndManager, SRM_REGEX_CANCELED, GetCurrentThreadId(), 0);
                 }
-                CoTaskMemFree(replaceTerm);
             }
 
             // Send the manager thread the completion message
@@ -1152,7 +1400,7 @@ void CPowerRenameManager::_OnItemAdded(_In_ IPowerRenameItem* renameItem)
     }
 }
 
-void CPowerRenameManager::_OnUpdate(_In_ IPowerRenameItem* renameItem)
+void CPowerRenameManager::_OnItemsUpdated(_In_ UINT firstIndex, _In_ UINT lastIndex)
 {
     CSRWSharedAutoLock lock(&m_lockEvents);
 
@@ -1160,11 +1408,23 @@ void CPowerRenameManager::_OnUpdate(_In_ IPowerRenameItem* renameItem)
     {
         if (it.pEvents)
         {
-            it.pEvents->OnUpdate(renameItem);
+            it.pEvents->OnItemsUpdated(firstIndex, lastIndex);
         }
     }
 }
 
+void CPowerRenameManager::_FlushUpdatedItems()
+{
+    UINT firstIndex = 0;
+    UINT lastIndex = 0;
+    if (m_updatedItems.Flush(&firstIndex, &lastIndex))
+    {
+        // New names change what the rename filter shows
+        m_visibleItemsDirty = true;
+        _OnItemsUpdated(firstIndex, lastIndex);
+    }
+}
+
 void CPowerRenameManager::_OnError(_In_ IPowerRenameItem* renameItem)
 {
     CSRWSharedAutoLock lock(&m_lockEvents);
@@ -1266,17 +1526,10 @@ void CPowerRenameManager::_ClearPowerRenameItems()
     CSRWExclusiveAutoLock lock(&m_lockItems);
 
     // Cleanup rename items
-    for (std::map<int, IPowerRenameItem*>::iterator it = m_renameItems.begin(); it != m_renameItems.end(); ++it)
-    {
-        IPowerRenameItem* pItem = it->second;
-        if (pItem)
-        {
-            pItem->Release();
-            it->second = nullptr;
-        }
-    }
-
-    m_renameItems.clear();
+    m_renameItems.Clear();
+    m_visibleItems.Clear();
+    m_extensions.Clear();
+    m_visibleItemsDirty = true;
 }
 
 void CPowerRenameManager::_Cleanup()
@@ -1,7 +1,13 @@
 #pragma once
+#include <atomic>
 #include <vector>
-#include <map>
+#include <string>
 #include "srwlock.h"
+#include "DirtyItemTracker.h"
+#include "PowerRenameItemStore.h"
+#include "VisibleItemIndex.h"
+#include "ExtensionHistogram.h"
+#include "RenameJournal.h"
 
 #include <lib/PowerRenameManager.h>
 #include <lib/PowerRenameInterfaces.h>
@@ -33,6 +39,7 @@ public:
     IFACEMETHODIMP GetVisibleItemCount(_Out_ UINT* count);
     IFACEMETHODIMP GetSelectedItemCount(_Out_ UINT* count);
     IFACEMETHODIMP GetRenameItemCount(_Out_ UINT* count);
+    IFACEMETHODIMP PutViewport(_In_ UINT firstVisibleIndex, _In_ UINT lastVisibleIndex);
     IFACEMETHODIMP GetFlags(_Out_ DWORD* flags);
     IFACEMETHODIMP PutFlags(_In_ DWORD flags);
     IFACEMETHODIMP GetFilter(_Out_ DWORD* filter);
@@ -41,6 +48,8 @@ public:
     IFACEMETHODIMP PutRenameRegEx(_In_ IPowerRenameRegEx* pRegEx);
     IFACEMETHODIMP GetRenameItemFactory(_COM_Outptr_ IPowerRenameItemFactory** ppItemFactory);
     IFACEMETHODIMP PutRenameItemFactory(_In_ IPowerRenameItemFactory* pItemFactory);
+    IFACEMETHODIMP UpdateNewNames();
+    IFACEMETHODIMP PutItemSelected(_In_ int id, _In_ bool selected);
 
     // IPowerRenameRegExEvents
     IFACEMETHODIMP OnSearchTermChanged(_In_ PCWSTR searchTerm);
@@ -50,7 +59,48 @@ public:
 
     static HRESULT s_CreateInstance(_Outptr_ IPowerRenameManager** ppsrm);
 
+    // Plan Rename would run: the items to rename, deepest first, with the names the
+    // batch takes twice in a folder enumerated.  Waits for the regex pass running.
+    HRESULT GetRenamePlan(_Out_ std::vector<RenamePlanItem>& plan);
+
+    // Rename operation of a PowerRename process that exited before it was over
+    struct InterruptedRename
+    {
+        std::filesystem::path journalPath;
+        size_t itemCount = 0;
+        size_t renamedCount = 0;
+    };
+
+    // Operations interrupted by a crash, from the journals in the module settings
+    // folder.  Journals of running processes are skipped, those holding nothing to
+    // recover are deleted.
+    static std::vector<InterruptedRename> s_GetInterruptedRenames();
+
+    // Renames the remaining items of the interrupted operation, or gives the items it
+    // renamed their original name, through IFileOperation, then deletes its journal.
+    // The journal is kept if the operation fails or is canceled.
+    static HRESULT s_RecoverInterruptedRename(_In_ const InterruptedRename& rename, _In_ bool rollBack, _In_opt_ HWND hwndParent);
+
+    // Literal search state of the last completed regex pass.  When the search term is
+    // extended, only the items that matched it need to be evaluated again.
+    // Only accessed by the regex worker thread, or while no regex worker thread runs.
+    struct RegExMatchState
+    {
+        bool valid = false;
+        DWORD flags = 0;
+        std::wstring searchTerm;
+        std::wstring replaceTerm;
+        // Whether the pass only evaluated the items that matched the previous search term
+        bool incremental = false;
+        // One entry per item, not a std::vector<bool> so workers can update
+        // different items concurrently
+        std::vector<BYTE> isMatch;
+    };
+
 protected:
+    // Reads the state of the regex passes in the unit tests
+    friend class CPowerRenameManagerTestAccess;
+
     CPowerRenameManager();
     virtual ~CPowerRenameManager();
 
@@ -60,7 +110,7 @@ protected:
     void _Cancel();
 
     void _OnItemAdded(_In_ IPowerRenameItem* renameItem);
-    void _OnUpdate(_In_ IPowerRenameItem* renameItem);
+    void _OnItemsUpdated(_In_ UINT firstIndex, _In_ UINT lastIndex);
     void _OnError(_In_ IPowerRenameItem* renameItem);
     void _OnRegExStarted(_In_ DWORD threadId);
     void _OnRegExCanceled(_In_ DWORD threadId);
@@ -68,6 +118,9 @@ protected:
     void _OnRenameStarted();
     void _OnRenameCompleted();
 
+    void _FlushUpdatedItems();
+    void _GetViewport(_Out_ UINT* firstIndex, _Out_ UINT* lastIndex);
+
     void _ClearEventHandlers();
     void _ClearPowerRenameItems();
 
@@ -83,10 +136,12 @@ protected:
     HRESULT _InitRegEx();
     void _ClearRegEx();
 
-    // Thread proc for performing the regex rename of each item
+    // Thread proc for performing the regex rename of each item.  The items are split
+    // in chunks processed in parallel by a pool of workers.
     static DWORD WINAPI s_regexWorkerThread(_In_ void* pv);
     // Thread proc for performing the actual file operation that does the file rename
     static DWORD WINAPI s_fileOpWorkerThread(_In_ void* pv);
+    static void s_GetRenamePlan(_In_ const CPowerRenameItemColumns& items, _In_ DWORD flags, _Out_ std::vector<RenamePlanItem>& plan);
 
     static LRESULT CALLBACK s_msgWndProc(_In_ HWND hwnd, _In_ UINT uMsg, _In_ WPARAM wParam, _In_ LPARAM lParam);
     LRESULT _WndProc(_In_ HWND hwnd, _In_ UINT msg, _In_ WPARAM wParam, _In_ LPARAM lParam);
@@ -97,6 +152,15 @@ protected:
     HANDLE m_startRegExWorkerEvent = nullptr;
     HANDLE m_cancelRegExWorkerEvent = nullptr;
 
+    // Items updated by the regex worker that listeners haven't been notified of yet
+    CDirtyItemTracker m_updatedItems;
+
+    RegExMatchState m_regExMatchState;
+
+    // Range of list view indexes currently displayed
+    UINT m_viewportFirst = 0;
+    UINT m_viewportLast = 0;
+
     HANDLE m_fileOpWorkerThreadHandle = nullptr;
     HANDLE m_startFileOpWorkerEvent = nullptr;
 
@@ -120,8 +184,14 @@ protected:
     CComPtr<IPowerRenameRegEx> m_spRegEx;
 
     _Guarded_by_(m_lockEvents) std::vector<RENAME_MGR_EVENT> m_powerRenameManagerEvents;
-    _Guarded_by_(m_lockItems) std::map<int, IPowerRenameItem*> m_renameItems;
-    _Guarded_by_(m_lockItems) std::vector<bool> m_isVisible;
+    // Regex passes read and update a snapshot of it without the lock
+    _Guarded_by_(m_lockItems) CPowerRenameItemStore m_renameItems;
+    _Guarded_by_(m_lockItems) CVisibleItemIndex m_visibleItems;
+    // Extensions of the original names, reported with the rename operation
+    _Guarded_by_(m_lockItems) CExtensionHistogram m_extensions;
+    // Set when the filter, the flags, the selection or the new names changed since
+    // the visibility was last evaluated
+    std::atomic<bool> m_visibleItemsDirty = true;
 
     // Parent HWND used by IFileOperation
     HWND m_hwndParent = nullptr;
@@ -1,15 +1,62 @@
 #include "pch.h"
 #include "PowerRenameRegEx.h"
 #include "Settings.h"
+#include "LiteralMatcher.h"
+#include "LinearRegEx.h"
+#include "DatedReplaceTerm.h"
 #include <regex>
 #include <string>
 #include <algorithm>
+#include <optional>
 #include <boost/regex.hpp>
 #include <helpers.h>
 
 using namespace std;
 using std::regex_error;
 
+struct CPowerRenameRegEx::CompiledPattern
+{
+    HRESULT hr = S_OK;
+    DWORD flags = 0;
+    wstring searchTerm;
+    // Replace term already rewritten into the $0/$1 format expected by regex_replace
+    wstring replaceTerm;
+    optional<std::wregex> stdPattern;
+    optional<boost::wregex> boostPattern;
+    // Used instead of stdPattern or boostPattern when the search term is supported by
+    // the linear time engine.  They are still compiled for the replace terms it can't
+    // format, and for the syntax errors.
+    optional<CLinearRegEx> linearPattern;
+    // Unset when the replace term needs the formatting of the backtracking engine
+    optional<CLinearRegEx::Replacement> linearReplacement;
+    // Used instead of the patterns for simple search and replace
+    CLiteralMatcher literalMatcher;
+    // Set when the replace term has date or time tokens, formatted for each item
+    optional<CDatedReplaceTerm> datedReplaceTerm;
+};
+
+// Rewrite the $0..$9 back references of the replace term into the format
+// understood by regex_replace.  An escaped $$ is left untouched.
+static wstring RewriteReplaceTerm(const wstring& replaceTerm)
+{
+    static const std::wregex zeroGroupRegex(L"(([^\\$]|^)(\\$\\$)*)\\$[0]");
+    static const std::wregex otherGroupRegex(L"(([^\\$]|^)(\\$\\$)*)\\$([1-9])");
+
+    wstring result = regex_replace(replaceTerm, zeroGroupRegex, L"$1$$$0");
+    return regex_replace(result, otherGroupRegex, L"$1$0$4");
+}
+
+// Parse the replace term for the linear engine when it gives the same result as the
+// backtracking one.  Boost formats the \ escapes of the term, the linear engine doesn't.
+static bool PrepareLinearReplacement(const CLinearRegEx& linearPattern, const wstring& replaceTerm, bool useBoostLib, CLinearRegEx::Replacement& replacement)
+{
+    if (useBoostLib && replaceTerm.find(L'\\') != wstring::npos)
+    {
+        return false;
+    }
+    return linearPattern.PrepareReplacement(replaceTerm, replacement);
+}
+
 IFACEMETHODIMP_(ULONG) CPowerRenameRegEx::AddRef()
 {
     return InterlockedIncrement(&m_refCount);
@@ -97,6 +144,7 @@ IFACEMETHODIMP CPowerRenameRegEx::PutSearchTerm(_In_ PCWSTR searchTerm)
             changed = true;
             CoTaskMemFree(m_searchTerm);
             hr = SHStrDup(searchTerm, &m_searchTerm);
+            _InvalidateCompiledPattern();
         }
     }
 
@@ -132,6 +180,7 @@ IFACEMETHODIMP CPowerRenameRegEx::PutReplaceTerm(_In_ PCWSTR replaceTerm)
             changed = true;
             CoTaskMemFree(m_replaceTerm);
             hr = SHStrDup(replaceTerm, &m_replaceTerm);
+            _InvalidateCompiledPattern();
         }
     }
 
@@ -151,9 +200,19 @@ IFACEMETHODIMP CPowerRenameRegEx::GetFlags(_Out_ DWORD* flags)
 
 IFACEMETHODIMP CPowerRenameRegEx::PutFlags(_In_ DWORD flags)
 {
-    if (m_flags != flags)
+    bool changed = false;
+    {
+        CSRWExclusiveAutoLock lock(&m_lock);
+        if (m_flags != flags)
+        {
+            changed = true;
+            m_flags = flags;
+            _InvalidateCompiledPattern();
+        }
+    }
+
+    if (changed)
     {
-        m_flags = flags;
         _OnFlagsChanged();
     }
     return S_OK;
@@ -213,6 +272,7 @@ CPowerRenameRegEx::CPowerRenameRegEx() :
     SHStrDup(L"", &m_replaceTerm);
 
     _useBoostLib = CSettingsInstance().GetUseBoostLib();
+    _useLinearRegEx = CSettingsInstance().GetUseLinearRegEx();
 }
 
 CPowerRenameRegEx::~CPowerRenameRegEx()
@@ -221,88 +281,112 @@ CPowerRenameRegEx::~CPowerRenameRegEx()
     CoTaskMemFree(m_replaceTerm);
 }
 
-HRESULT CPowerRenameRegEx::Replace(_In_ PCWSTR source, _Outptr_ PWSTR* result)
+IFACEMETHODIMP CPowerRenameRegEx::Replace(_In_ PCWSTR source, _Outptr_ PWSTR* result)
+{
+    SYSTEMTIME fileTime = { 0 };
+    bool useFileTime = false;
+    {
+        CSRWSharedAutoLock lock(&m_lock);
+        fileTime = m_fileTime;
+        useFileTime = m_useFileTime;
+    }
+    return _Replace(source, useFileTime ? &fileTime : nullptr, result);
+}
+
+IFACEMETHODIMP CPowerRenameRegEx::ReplaceWithFileTime(_In_ PCWSTR source, _In_ SYSTEMTIME fileTime, _Outptr_ PWSTR* result)
+{
+    return _Replace(source, &fileTime, result);
+}
+
+HRESULT CPowerRenameRegEx::_Replace(_In_ PCWSTR source, _In_opt_ const SYSTEMTIME* fileTime, _Outptr_ PWSTR* result)
 {
     *result = nullptr;
 
-    CSRWSharedAutoLock lock(&m_lock);
-    HRESULT hr = S_OK;
-    if (!(m_searchTerm && wcslen(m_searchTerm) > 0 && source && wcslen(source) > 0))
+    std::shared_ptr<const CompiledPattern> compiled;
+    HRESULT hr = _GetCompiledPattern(compiled);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    if (!(compiled->searchTerm.length() > 0 && source && wcslen(source) > 0))
     {
         return hr;
     }
     wstring res = source;
     try
     {
-        // TODO: creating the regex could be costly.  May want to cache this.
-        wchar_t newReplaceTerm[MAX_PATH] = { 0 };
-        bool fileTimeErrorOccurred = false;
-        if (m_useFileTime)
+        const wstring& searchTerm = compiled->searchTerm;
+        wstring replaceTerm = compiled->replaceTerm;
+        const CLinearRegEx::Replacement* linearReplacement = compiled->linearReplacement ? &*compiled->linearReplacement : nullptr;
+
+        // The tokens of the dated replace term are compiled with the pattern, only
+        // their values depend on the time of the item.
+        CLinearRegEx::Replacement datedLinearReplacement;
+        if (fileTime && compiled->datedReplaceTerm)
         {
-            if (FAILED(GetDatedFileName(newReplaceTerm, ARRAYSIZE(newReplaceTerm), m_replaceTerm, m_fileTime)))
-                fileTimeErrorOccurred = true;
-        }
-
-        std::wstring sourceToUse(source);
-        std::wstring searchTerm(m_searchTerm);
-        std::wstring replaceTerm(L"");
-        if (m_useFileTime && !fileTimeErrorOccurred)
-        {
-            replaceTerm = wstring(newReplaceTerm);
-        }
-        else if (m_replaceTerm)
-        {
-            replaceTerm = wstring(m_replaceTerm);
+            const wstring newReplaceTerm = compiled->datedReplaceTerm->Format(*fileTime);
+            replaceTerm = RewriteReplaceTerm(newReplaceTerm);
+            linearReplacement = nullptr;
+            if (compiled->linearPattern && PrepareLinearReplacement(*compiled->linearPattern, newReplaceTerm, compiled->boostPattern.has_value(), datedLinearReplacement))
+            {
+                linearReplacement = &datedLinearReplacement;
+            }
         }
 
-        replaceTerm = regex_replace(replaceTerm, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$[0]"), L"$1$$$0");
-        replaceTerm = regex_replace(replaceTerm, std::wregex(L"(([^\\$]|^)(\\$\\$)*)\\$([1-9])"), L"$1$0$4");
-
-        if (m_flags & UseRegularExpressions)
+        if (compiled->flags & UseRegularExpressions)
         {
-            if (_useBoostLib)
+            if (compiled->linearPattern && linearReplacement)
+            {
+                res = compiled->linearPattern->Replace(source, *linearReplacement, (compiled->flags & MatchAllOccurences) != 0);
+            }
+            else if (compiled->boostPattern)
             {
-                boost::wregex pattern(m_searchTerm, (!(m_flags & CaseSensitive)) ? boost::regex::icase | boost::regex::ECMAScript : boost::regex::ECMAScript);
-                if (m_flags & MatchAllOccurences)
+                if (compiled->flags & MatchAllOccurences)
                 {
-                    res = boost::regex_replace(wstring(source), pattern, replaceTerm);
+                    res = boost::regex_replace(wstring(source), *compiled->boostPattern, replaceTerm);
                 }
                 else
                 {
-                    res = boost::regex_replace(wstring(source), pattern, replaceTerm, boost::regex_constants::format_first_only);
+                    res = boost::regex_replace(wstring(source), *compiled->boostPattern, replaceTerm, boost::regex_constants::format_first_only);
                 }
             }
             else
             {
-                std::wregex pattern(m_searchTerm, (!(m_flags & CaseSensitive)) ? regex_constants::icase | regex_constants::ECMAScript : regex_constants::ECMAScript);
-                if (m_flags & MatchAllOccurences)
+                if (compiled->flags & MatchAllOccurences)
                 {
-                    res = regex_replace(wstring(source), pattern, replaceTerm);
+                    res = regex_replace(wstring(source), *compiled->stdPattern, replaceTerm);
                 }
                 else
                 {
-                    res = regex_replace(wstring(source), pattern, replaceTerm, regex_constants::format_first_only);
+                    res = regex_replace(wstring(source), *compiled->stdPattern, replaceTerm, regex_constants::format_first_only);
                 }
             }
         }
         else
         {
-            // Simple search and replace
-            size_t pos = 0;
-            do
+            // Simple search and replace, in a single pass over the source
+            const CLiteralMatcher& matcher = compiled->literalMatcher;
+            const size_t sourceLength = wcslen(source);
+            size_t pos = matcher.Find(source, sourceLength, 0);
+            if (pos != wstring::npos)
             {
-                pos = _Find(sourceToUse, searchTerm, (!(m_flags & CaseSensitive)), pos);
-                if (pos != std::string::npos)
+                res.clear();
+                size_t copied = 0;
+                do
                 {
-                    res = sourceToUse.replace(pos, searchTerm.length(), replaceTerm);
-                    pos += replaceTerm.length();
-                }
-
-                if (!(m_flags & MatchAllOccurences))
-                {
-                    break;
-                }
-            } while (pos != std::string::npos);
+                    res.append(source + copied, pos - copied);
+                    res.append(replaceTerm);
+                    copied = pos + searchTerm.length();
+
+                    if (!(compiled->flags & MatchAllOccurences))
+                    {
+                        break;
+                    }
+                    pos = matcher.Find(source, sourceLength, copied);
+                } while (pos != wstring::npos);
+                res.append(source + copied, sourceLength - copied);
+            }
         }
 
         hr = SHStrDup(res.c_str(), result);
@@ -314,17 +398,86 @@ HRESULT CPowerRenameRegEx::Replace(_In_ PCWSTR source, _Outptr_ PWSTR* result)
     return hr;
 }
 
-size_t CPowerRenameRegEx::_Find(std::wstring data, std::wstring toSearch, bool caseInsensitive, size_t pos)
+HRESULT CPowerRenameRegEx::_GetCompiledPattern(_Out_ std::shared_ptr<const CompiledPattern>& compiled)
 {
-    if (caseInsensitive)
     {
-        // Convert to lower
-        std::transform(data.begin(), data.end(), data.begin(), ::towlower);
-        std::transform(toSearch.begin(), toSearch.end(), toSearch.begin(), ::towlower);
+        CSRWSharedAutoLock lock(&m_lock);
+        compiled = m_compiledPattern;
+    }
+
+    if (!compiled)
+    {
+        CSRWExclusiveAutoLock lock(&m_lock);
+        // Another thread may have compiled it while we were waiting for the lock
+        if (!m_compiledPattern)
+        {
+            m_compiledPattern = _CompilePattern();
+        }
+        compiled = m_compiledPattern;
     }
 
-    // Find sub string position in given string starting at position pos
-    return data.find(toSearch, pos);
+    return compiled->hr;
+}
+
+// Must be called with m_lock held exclusively
+std::shared_ptr<const CPowerRenameRegEx::CompiledPattern> CPowerRenameRegEx::_CompilePattern()
+{
+    auto compiled = std::make_shared<CompiledPattern>();
+    compiled->flags = m_flags;
+    compiled->searchTerm = m_searchTerm ? m_searchTerm : L"";
+
+    try
+    {
+        compiled->replaceTerm = RewriteReplaceTerm(m_replaceTerm ? m_replaceTerm : L"");
+        CDatedReplaceTerm datedReplaceTerm(m_replaceTerm);
+        if (datedReplaceTerm.IsDated())
+        {
+            compiled->datedReplaceTerm = std::move(datedReplaceTerm);
+        }
+
+        if ((m_flags & UseRegularExpressions) && compiled->searchTerm.length() > 0)
+        {
+            if (_useBoostLib)
+            {
+                compiled->boostPattern.emplace(compiled->searchTerm, (!(m_flags & CaseSensitive)) ? boost::regex::icase | boost::regex::ECMAScript : boost::regex::ECMAScript);
+            }
+            else
+            {
+                compiled->stdPattern.emplace(compiled->searchTerm, (!(m_flags & CaseSensitive)) ? regex_constants::icase | regex_constants::ECMAScript : regex_constants::ECMAScript);
+            }
+
+            CLinearRegEx linearPattern;
+            if (_useLinearRegEx && linearPattern.Compile(compiled->searchTerm, !(m_flags & CaseSensitive)))
+            {
+                CLinearRegEx::Replacement replacement;
+                if (PrepareLinearReplacement(linearPattern, m_replaceTerm ? m_replaceTerm : L"", _useBoostLib, replacement))
+                {
+                    compiled->linearReplacement = std::move(replacement);
+                }
+                compiled->linearPattern = std::move(linearPattern);
+            }
+        }
+        else
+        {
+            compiled->literalMatcher = CLiteralMatcher(compiled->searchTerm, !(m_flags & CaseSensitive));
+        }
+    }
+    catch (regex_error e)
+    {
+        compiled->hr = E_FAIL;
+    }
+    catch (boost::regex_error e)
+    {
+        compiled->hr = E_FAIL;
+    }
+
+    return compiled;
+}
+
+// Must be called with m_lock held exclusively
+void CPowerRenameRegEx::_InvalidateCompiledPattern()
+{
+    m_compiledPattern = nullptr;
 }
 
 void CPowerRenameRegEx::_OnSearchTermChanged()
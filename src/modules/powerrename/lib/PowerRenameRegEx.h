@@ -2,6 +2,7 @@
 #include "pch.h"
 #include <vector>
 #include <string>
+#include <memory>
 #include "srwlock.h"
 
 #include "PowerRenameInterfaces.h"
@@ -28,6 +29,9 @@ public:
     IFACEMETHODIMP PutFileTime(_In_ SYSTEMTIME fileTime);
     IFACEMETHODIMP ResetFileTime();
     IFACEMETHODIMP Replace(_In_ PCWSTR source, _Outptr_ PWSTR* result);
+    // Replaces with the dated tokens of the replace term formatted for fileTime,
+    // without storing it, so items with different times can be processed concurrently
+    IFACEMETHODIMP ReplaceWithFileTime(_In_ PCWSTR source, _In_ SYSTEMTIME fileTime, _Outptr_ PWSTR* result);
 
     static HRESULT s_CreateInstance(_Outptr_ IPowerRenameRegEx **renameRegEx);
 
@@ -40,9 +44,17 @@ protected:
     void _OnFlagsChanged();
     void _OnFileTimeChanged();
 
-    size_t _Find(std::wstring data, std::wstring toSearch, bool caseInsensitive, size_t pos);
+    // Compiled form of the current search term, replace term and flags.  Defined in
+    // PowerRenameRegEx.cpp so the regex engine headers stay out of this header.
+    struct CompiledPattern;
+
+    HRESULT _GetCompiledPattern(_Out_ std::shared_ptr<const CompiledPattern>& compiled);
+    std::shared_ptr<const CompiledPattern> _CompilePattern();
+    void _InvalidateCompiledPattern();
+    HRESULT _Replace(_In_ PCWSTR source, _In_opt_ const SYSTEMTIME* fileTime, _Outptr_ PWSTR* result);
 
     bool _useBoostLib = false;
+    bool _useLinearRegEx = true;
     DWORD m_flags = DEFAULT_FLAGS;
     PWSTR m_searchTerm = nullptr;
     PWSTR m_replaceTerm = nullptr;
@@ -53,6 +65,10 @@ protected:
     CSRWLock m_lock;
     CSRWLock m_lockEvents;
 
+    // Built lazily by the first Replace call after a search term, replace term or
+    // flags change and then shared by every thread calling Replace.
+    _Guarded_by_(m_lock) std::shared_ptr<const CompiledPattern> m_compiledPattern;
+
     DWORD m_cookie = 0;
 
     struct RENAME_REGEX_EVENT
@@ -0,0 +1,41 @@
+#include "pch.h"
+#include "RenameExecutor.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    HRESULT HResultFromErrorCode(_In_ const std::error_code& error)
+    {
+        return error ? HRESULT_FROM_WIN32(static_cast<unsigned long>(error.value())) : S_OK;
+    }
+}
+
+HRESULT CFileSystemRenameExecutor::RenameBatch(_In_reads_(count) const RenameRequest* requests, _In_ size_t count, _Out_writes_(count) RenameResult* results)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const fs::path newPath = requests[i].path.parent_path() / requests[i].newName;
+        std::error_code error;
+
+        // std::filesystem::rename replaces an existing file, a rename never should.  A
+        // change of case only is the same file on a case insensitive file system.
+        if (fs::exists(newPath, error) && !fs::equivalent(requests[i].path, newPath, error))
+        {
+            results[i].hr = HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS);
+            continue;
+        }
+
+        error.clear();
+        fs::rename(requests[i].path, newPath, error);
+        results[i].hr = HResultFromErrorCode(error);
+        results[i].finalName.clear();
+    }
+    return S_OK;
+}
+
+bool CFileSystemRenameExecutor::Exists(_In_ const fs::path& path)
+{
+    std::error_code error;
+    return fs::exists(path, error);
+}
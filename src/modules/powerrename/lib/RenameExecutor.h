@@ -0,0 +1,44 @@
+#pragma once
+#include <filesystem>
+#include <string>
+
+// One rename of a batch: the item at path gets newName, in the same folder
+struct RenameRequest
+{
+    std::filesystem::path path;
+    std::wstring newName;
+};
+
+struct RenameResult
+{
+    HRESULT hr = E_ABORT;
+    // Name the item ended up with when it differs from the requested one, for instance
+    // after the shell resolved a collision
+    std::wstring finalName;
+};
+
+// Performs the renames planned by a CRenameJournal, one batch at a time
+class IRenameExecutor
+{
+public:
+    virtual ~IRenameExecutor() = default;
+
+    // Renames the items of requests in order and fills one result per request.  A
+    // failure of one rename doesn't stop the others.  Returns a failure when the batch
+    // was stopped, for instance canceled by the user, the requests not attempted keep
+    // E_ABORT then.
+    virtual HRESULT RenameBatch(_In_reads_(count) const RenameRequest* requests, _In_ size_t count, _Out_writes_(count) RenameResult* results) = 0;
+
+    // Used to find out which renames of an interrupted batch were done
+    virtual bool Exists(_In_ const std::filesystem::path& path) = 0;
+};
+
+// Renames directly on the file system with std::filesystem, without undo or UI.  Only
+// depends on the standard library so journals can be tested on any directory tree.
+class CFileSystemRenameExecutor :
+    public IRenameExecutor
+{
+public:
+    HRESULT RenameBatch(_In_reads_(count) const RenameRequest* requests, _In_ size_t count, _Out_writes_(count) RenameResult* results) override;
+    bool Exists(_In_ const std::filesystem::path& path) override;
+};
@@ -0,0 +1,643 @@
+#include "pch.h"
+#include "RenameJournal.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const char c_magic[4] = { 'P', 'R', 'N', 'J' };
+    const uint32_t c_version = 1;
+
+    // Record types
+    const char c_recordFolder = 'F';
+    const char c_recordPlan = 'P';
+    const char c_recordSealed = 'S';
+    const char c_recordBatch = 'B';
+    const char c_recordDone = 'D';
+    const char c_recordFailed = 'X';
+    const char c_recordRolledBack = 'R';
+    const char c_recordFinished = 'C';
+
+    // Type, payload length, payload, checksum
+    const size_t c_recordOverhead = 1 + sizeof(uint32_t) + sizeof(uint32_t);
+
+    uint32_t Checksum(_In_ char type, _In_ const std::string& payload)
+    {
+        // FNV-1a
+        uint32_t hash = 2166136261u;
+        hash = (hash ^ static_cast<unsigned char>(type)) * 16777619u;
+        for (char c : payload)
+        {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+        }
+        return hash;
+    }
+
+    void WriteUInt32(_Inout_ std::string& buffer, _In_ uint32_t value)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            buffer += static_cast<char>((value >> (8 * i)) & 0xFF);
+        }
+    }
+
+    void WriteString(_Inout_ std::string& buffer, _In_ const std::wstring& value)
+    {
+        WriteUInt32(buffer, static_cast<uint32_t>(value.length()));
+        for (wchar_t c : value)
+        {
+            buffer += static_cast<char>(c & 0xFF);
+            buffer += static_cast<char>((c >> 8) & 0xFF);
+        }
+    }
+
+    // Reads the fields of a payload, fails once past its end
+    class CPayloadReader
+    {
+    public:
+        CPayloadReader(_In_ const std::string& payload) :
+            m_payload(payload)
+        {
+        }
+
+        bool ReadUInt32(_Out_ uint32_t& value)
+        {
+            value = 0;
+            if (m_payload.length() - m_pos < 4)
+            {
+                return false;
+            }
+            for (int i = 0; i < 4; i++)
+            {
+                value |= static_cast<uint32_t>(static_cast<unsigned char>(m_payload[m_pos++])) << (8 * i);
+            }
+            return true;
+        }
+
+        bool ReadString(_Out_ std::wstring& value)
+        {
+            value.clear();
+            uint32_t length = 0;
+            if (!ReadUInt32(length) || (m_payload.length() - m_pos) / 2 < length)
+            {
+                return false;
+            }
+            value.resize(length);
+            for (uint32_t u = 0; u < length; u++)
+            {
+                value[u] = static_cast<wchar_t>(static_cast<unsigned char>(m_payload[m_pos]) | (static_cast<unsigned char>(m_payload[m_pos + 1]) << 8));
+                m_pos += 2;
+            }
+            return true;
+        }
+
+    private:
+        const std::string& m_payload;
+        size_t m_pos = 0;
+    };
+}
+
+HRESULT CRenameJournal::s_Create(_In_ const fs::path& path, _In_ const std::vector<RenamePlanItem>& items, _Out_ std::unique_ptr<CRenameJournal>& journal)
+{
+    journal.reset();
+    std::unique_ptr<CRenameJournal> newJournal(new CRenameJournal());
+    newJournal->m_path = path;
+
+    HRESULT hr = newJournal->_OpenFile(true);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    std::vector<size_t> order(items.size());
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    // Plans are usually built in this order already
+    const auto deeper = [&](size_t a, size_t b) { return items[a].depth > items[b].depth; };
+    if (!std::is_sorted(order.begin(), order.end(), deeper))
+    {
+        std::stable_sort(order.begin(), order.end(), deeper);
+    }
+
+    // The items of a folder are usually together, the last folder is checked first
+    std::unordered_map<std::wstring, UINT> folderIndexes;
+    newJournal->m_entries.reserve(items.size());
+    for (size_t i : order)
+    {
+        const RenamePlanItem& item = items[i];
+        UINT folder = 0;
+        if (!newJournal->m_folders.empty() && newJournal->m_folders.back() == item.parentPath)
+        {
+            folder = static_cast<UINT>(newJournal->m_folders.size() - 1);
+        }
+        else
+        {
+            auto it = folderIndexes.find(item.parentPath);
+            if (it != folderIndexes.end())
+            {
+                folder = it->second;
+            }
+            else
+            {
+                folder = static_cast<UINT>(newJournal->m_folders.size());
+                folderIndexes.emplace(item.parentPath, folder);
+                newJournal->m_folders.push_back(item.parentPath);
+
+                std::string payload;
+                WriteString(payload, item.parentPath);
+                newJournal->_AppendRecord(c_recordFolder, payload);
+            }
+        }
+
+        RenameJournalEntry entry;
+        entry.depth = item.depth;
+        entry.folder = folder;
+        entry.originalName = item.originalName;
+        entry.newName = item.newName;
+
+        std::string payload;
+        WriteUInt32(payload, entry.folder);
+        WriteUInt32(payload, entry.depth);
+        WriteString(payload, entry.originalName);
+        WriteString(payload, entry.newName);
+        newJournal->_AppendRecord(c_recordPlan, payload);
+        newJournal->m_entries.push_back(std::move(entry));
+    }
+
+    // Nothing is renamed before the whole plan is on disk
+    std::string payload;
+    WriteUInt32(payload, static_cast<uint32_t>(newJournal->m_entries.size()));
+    newJournal->_AppendRecord(c_recordSealed, payload);
+    newJournal->m_sealed = true;
+    hr = newJournal->_FlushRecords();
+    if (SUCCEEDED(hr))
+    {
+        newJournal->m_progress.total = newJournal->m_entries.size();
+        journal = std::move(newJournal);
+    }
+    return hr;
+}
+
+HRESULT CRenameJournal::s_Open(_In_ const fs::path& path, _Out_ std::unique_ptr<CRenameJournal>& journal)
+{
+    journal.reset();
+    std::string contents;
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+        }
+        contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    if (contents.length() < sizeof(c_magic) + sizeof(uint32_t) || memcmp(contents.data(), c_magic, sizeof(c_magic)) != 0)
+    {
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+    uint32_t version = 0;
+    if (!CPayloadReader(contents.substr(sizeof(c_magic), sizeof(uint32_t))).ReadUInt32(version) || version != c_version)
+    {
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    std::unique_ptr<CRenameJournal> newJournal(new CRenameJournal());
+    newJournal->m_path = path;
+
+    // Replay the records up to the first incomplete or damaged one
+    size_t pos = sizeof(c_magic) + sizeof(uint32_t);
+    std::string payload;
+    while (contents.length() - pos >= c_recordOverhead)
+    {
+        const char type = contents[pos];
+        uint32_t length = 0;
+        CPayloadReader(contents.substr(pos + 1, sizeof(uint32_t))).ReadUInt32(length);
+        if (contents.length() - pos - c_recordOverhead < length)
+        {
+            break;
+        }
+
+        payload.assign(contents, pos + 1 + sizeof(uint32_t), length);
+        uint32_t checksum = 0;
+        CPayloadReader(contents.substr(pos + 1 + sizeof(uint32_t) + length, sizeof(uint32_t))).ReadUInt32(checksum);
+        if (checksum != Checksum(type, payload))
+        {
+            break;
+        }
+
+        newJournal->_Replay(type, payload);
+        pos += c_recordOverhead + length;
+    }
+
+    // Appending after a torn record would hide the new records from the next read
+    if (pos < contents.length())
+    {
+        std::error_code error;
+        fs::resize_file(path, pos, error);
+        if (error)
+        {
+            return HRESULT_FROM_WIN32(static_cast<unsigned long>(error.value()));
+        }
+    }
+
+    if (!newJournal->m_sealed)
+    {
+        newJournal->m_folders.clear();
+        newJournal->m_entries.clear();
+    }
+
+    HRESULT hr = newJournal->_OpenFile(false);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    RenameProgress& progress = newJournal->m_progress;
+    progress.total = newJournal->m_entries.size();
+    for (auto& entry : newJournal->m_entries)
+    {
+        progress.done += entry.state == RenameJournalState::Done ? 1 : 0;
+        progress.failed += entry.state == RenameJournalState::Failed ? 1 : 0;
+        progress.rolledBack += entry.state == RenameJournalState::RolledBack ? 1 : 0;
+    }
+
+    const bool sealed = newJournal->m_sealed;
+    journal = std::move(newJournal);
+    return sealed ? S_OK : S_FALSE;
+}
+
+fs::path CRenameJournal::GetOriginalPath(_In_ size_t index) const
+{
+    return fs::path(GetParentPath(index)) / m_entries[index].originalName;
+}
+
+fs::path CRenameJournal::GetNewPath(_In_ size_t index) const
+{
+    return fs::path(GetParentPath(index)) / m_entries[index].newName;
+}
+
+HRESULT CRenameJournal::Execute(_In_ IRenameExecutor& executor, _In_ size_t batchSize, _In_opt_ const ProgressCallback& progress)
+{
+    HRESULT hr = _ReconcileStartedBatch(executor);
+    const auto start = std::chrono::steady_clock::now();
+    m_progress.batches = 0;
+    m_progress.processed = 0;
+
+    std::vector<size_t> batch;
+    for (size_t next = 0; SUCCEEDED(hr) && next < m_entries.size();)
+    {
+        batch.clear();
+        for (; next < m_entries.size() && batch.size() < std::max<size_t>(batchSize, 1); next++)
+        {
+            if (m_entries[next].state == RenameJournalState::Pending)
+            {
+                batch.push_back(next);
+            }
+        }
+        if (batch.empty())
+        {
+            break;
+        }
+
+        hr = _RunBatch(executor, BatchKind::Execute, batch);
+        _UpdateProgress(start);
+        if (SUCCEEDED(hr) && progress && !progress(m_progress))
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_CANCELLED);
+        }
+    }
+    return hr;
+}
+
+HRESULT CRenameJournal::RollBack(_In_ IRenameExecutor& executor, _In_ size_t batchSize, _In_opt_ const ProgressCallback& progress)
+{
+    HRESULT hr = _ReconcileStartedBatch(executor);
+    const auto start = std::chrono::steady_clock::now();
+    m_progress.batches = 0;
+    m_progress.processed = 0;
+
+    // From the last item renamed, so folders get their name back before their content.
+    // The paths of the content are only valid once its folder is back.
+    std::vector<size_t> batch;
+    for (size_t next = m_entries.size(); SUCCEEDED(hr) && next > 0;)
+    {
+        batch.clear();
+        for (; next > 0 && batch.size() < std::max<size_t>(batchSize, 1); next--)
+        {
+            const RenameJournalEntry& entry = m_entries[next - 1];
+            if (entry.state != RenameJournalState::Done)
+            {
+                continue;
+            }
+            if (!batch.empty() && entry.depth != m_entries[batch.front()].depth)
+            {
+                break;
+            }
+            batch.push_back(next - 1);
+        }
+        if (batch.empty())
+        {
+            break;
+        }
+
+        hr = _RunBatch(executor, BatchKind::RollBack, batch);
+        _UpdateProgress(start);
+        if (SUCCEEDED(hr) && progress && !progress(m_progress))
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_CANCELLED);
+        }
+    }
+    return hr;
+}
+
+HRESULT CRenameJournal::Finish()
+{
+    _AppendRecord(c_recordFinished, std::string());
+    HRESULT hr = _FlushRecords();
+    m_finished = true;
+    if (m_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+        std::error_code error;
+        fs::remove(m_path, error);
+    }
+    return hr;
+}
+
+CRenameJournal::~CRenameJournal()
+{
+    if (m_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_file);
+    }
+}
+
+HRESULT CRenameJournal::_OpenFile(_In_ bool truncate)
+{
+    if (m_path.empty())
+    {
+        return S_OK;
+    }
+
+    // A Win32 handle, so the records can be flushed through the system cache
+    m_file = CreateFileW(m_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, truncate ? CREATE_ALWAYS : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        return HRESULT_FROM_WIN32(ERROR_OPEN_FAILED);
+    }
+
+    LARGE_INTEGER distance{};
+    if (!SetFilePointerEx(m_file, distance, nullptr, FILE_END))
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    if (truncate)
+    {
+        std::string header(c_magic, sizeof(c_magic));
+        WriteUInt32(header, c_version);
+        m_pendingRecords = header + m_pendingRecords;
+    }
+    return S_OK;
+}
+
+void CRenameJournal::_Replay(_In_ char type, _In_ const std::string& payload)
+{
+    CPayloadReader reader(payload);
+    uint32_t index = 0;
+    switch (type)
+    {
+    case c_recordFolder:
+    {
+        std::wstring folder;
+        if (reader.ReadString(folder))
+        {
+            m_folders.push_back(std::move(folder));
+        }
+        break;
+    }
+    case c_recordPlan:
+    {
+        RenameJournalEntry entry;
+        uint32_t folder = 0;
+        if (!m_sealed && reader.ReadUInt32(folder) && folder < m_folders.size() && reader.ReadUInt32(entry.depth) &&
+            reader.ReadString(entry.originalName) && reader.ReadString(entry.newName))
+        {
+            entry.folder = folder;
+            m_entries.push_back(std::move(entry));
+        }
+        break;
+    }
+    case c_recordSealed:
+        m_sealed = reader.ReadUInt32(index) && index == m_entries.size();
+        break;
+    case c_recordBatch:
+    {
+        uint32_t kind = 0;
+        uint32_t last = 0;
+        if (reader.ReadUInt32(kind) && reader.ReadUInt32(index) && reader.ReadUInt32(last) && index <= last && last < m_entries.size())
+        {
+            m_startedBatchKind = static_cast<BatchKind>(kind);
+            m_startedBatchFirst = index;
+            m_startedBatchLast = last;
+        }
+        break;
+    }
+    case c_recordDone:
+    {
+        std::wstring finalName;
+        if (reader.ReadUInt32(index) && index < m_entries.size() && reader.ReadString(finalName))
+        {
+            m_entries[index].state = RenameJournalState::Done;
+            if (!finalName.empty())
+            {
+                m_entries[index].newName = std::move(finalName);
+            }
+        }
+        break;
+    }
+    case c_recordFailed:
+    {
+        uint32_t result = 0;
+        if (reader.ReadUInt32(index) && index < m_entries.size() && reader.ReadUInt32(result))
+        {
+            m_entries[index].state = RenameJournalState::Failed;
+            m_entries[index].result = static_cast<HRESULT>(result);
+        }
+        break;
+    }
+    case c_recordRolledBack:
+        if (reader.ReadUInt32(index) && index < m_entries.size())
+        {
+            m_entries[index].state = RenameJournalState::RolledBack;
+        }
+        break;
+    case c_recordFinished:
+        m_finished = true;
+        break;
+    }
+}
+
+HRESULT CRenameJournal::_ReconcileStartedBatch(_In_ IRenameExecutor& executor)
+{
+    if (m_startedBatchKind == BatchKind::None)
+    {
+        return S_OK;
+    }
+
+    for (size_t i = m_startedBatchFirst; i <= m_startedBatchLast; i++)
+    {
+        RenameJournalEntry& entry = m_entries[i];
+        if (m_startedBatchKind == BatchKind::Execute && entry.state == RenameJournalState::Pending &&
+            !executor.Exists(GetOriginalPath(i)) && executor.Exists(GetNewPath(i)))
+        {
+            entry.state = RenameJournalState::Done;
+            m_progress.done++;
+
+            std::string payload;
+            WriteUInt32(payload, static_cast<uint32_t>(i));
+            WriteString(payload, std::wstring());
+            _AppendRecord(c_recordDone, payload);
+        }
+        else if (m_startedBatchKind == BatchKind::RollBack && entry.state == RenameJournalState::Done &&
+                 !executor.Exists(GetNewPath(i)) && executor.Exists(GetOriginalPath(i)))
+        {
+            entry.state = RenameJournalState::RolledBack;
+            m_progress.done--;
+            m_progress.rolledBack++;
+
+            std::string payload;
+            WriteUInt32(payload, static_cast<uint32_t>(i));
+            _AppendRecord(c_recordRolledBack, payload);
+        }
+    }
+
+    m_startedBatchKind = BatchKind::None;
+    return _FlushRecords();
+}
+
+HRESULT CRenameJournal::_RunBatch(_In_ IRenameExecutor& executor, _In_ BatchKind kind, _In_ const std::vector<size_t>& batch)
+{
+    const auto range = std::minmax_element(batch.begin(), batch.end());
+    std::string payload;
+    WriteUInt32(payload, static_cast<uint32_t>(kind));
+    WriteUInt32(payload, static_cast<uint32_t>(*range.first));
+    WriteUInt32(payload, static_cast<uint32_t>(*range.second));
+    _AppendRecord(c_recordBatch, payload);
+    HRESULT hr = _FlushRecords();
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    std::vector<RenameRequest> requests(batch.size());
+    for (size_t u = 0; u < batch.size(); u++)
+    {
+        const size_t i = batch[u];
+        if (kind == BatchKind::Execute)
+        {
+            requests[u].path = GetOriginalPath(i);
+            requests[u].newName = m_entries[i].newName;
+        }
+        else
+        {
+            requests[u].path = GetNewPath(i);
+            requests[u].newName = m_entries[i].originalName;
+        }
+    }
+
+    std::vector<RenameResult> results(batch.size());
+    HRESULT hrBatch = executor.RenameBatch(requests.data(), requests.size(), results.data());
+
+    for (size_t u = 0; u < batch.size(); u++)
+    {
+        const size_t i = batch[u];
+        RenameJournalEntry& entry = m_entries[i];
+        const RenameResult& result = results[u];
+        payload.clear();
+        WriteUInt32(payload, static_cast<uint32_t>(i));
+        if (kind == BatchKind::Execute)
+        {
+            if (SUCCEEDED(result.hr))
+            {
+                entry.state = RenameJournalState::Done;
+                m_progress.done++;
+                if (!result.finalName.empty())
+                {
+                    entry.newName = result.finalName;
+                }
+                WriteString(payload, result.finalName);
+                _AppendRecord(c_recordDone, payload);
+            }
+            else if (result.hr != E_ABORT)
+            {
+                entry.state = RenameJournalState::Failed;
+                entry.result = result.hr;
+                m_progress.failed++;
+                WriteUInt32(payload, static_cast<uint32_t>(result.hr));
+                _AppendRecord(c_recordFailed, payload);
+            }
+        }
+        else if (SUCCEEDED(result.hr))
+        {
+            entry.state = RenameJournalState::RolledBack;
+            m_progress.done--;
+            m_progress.rolledBack++;
+            _AppendRecord(c_recordRolledBack, payload);
+        }
+        else
+        {
+            // Stays renamed, a later RollBack tries again
+            entry.result = result.hr;
+            m_progress.failed++;
+        }
+    }
+
+    m_startedBatchKind = BatchKind::None;
+    m_progress.batches++;
+    m_progress.processed += batch.size();
+    hr = _FlushRecords();
+    return FAILED(hrBatch) ? hrBatch : hr;
+}
+
+void CRenameJournal::_UpdateProgress(_In_ std::chrono::steady_clock::time_point start)
+{
+    m_progress.elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    m_progress.itemsPerSecond = m_progress.elapsedSeconds > 0 ? m_progress.processed / m_progress.elapsedSeconds : 0;
+}
+
+void CRenameJournal::_AppendRecord(_In_ char type, _In_ const std::string& payload)
+{
+    if (m_path.empty())
+    {
+        return;
+    }
+
+    m_pendingRecords += type;
+    WriteUInt32(m_pendingRecords, static_cast<uint32_t>(payload.length()));
+    m_pendingRecords += payload;
+    WriteUInt32(m_pendingRecords, Checksum(type, payload));
+}
+
+HRESULT CRenameJournal::_FlushRecords()
+{
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        m_pendingRecords.clear();
+        return S_OK;
+    }
+
+    // Called a few times per batch only, the flush to the disk is affordable
+    DWORD written = 0;
+    const bool succeeded = WriteFile(m_file, m_pendingRecords.data(), static_cast<DWORD>(m_pendingRecords.size()), &written, nullptr) &&
+                           written == m_pendingRecords.size() &&
+                           FlushFileBuffers(m_file);
+    m_pendingRecords.clear();
+    return succeeded ? S_OK : HRESULT_FROM_WIN32(ERROR_WRITE_FAULT);
+}
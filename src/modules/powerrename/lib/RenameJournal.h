@@ -0,0 +1,147 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "RenameExecutor.h"
+
+// Rename planned for an item
+struct RenamePlanItem
+{
+    UINT depth = 0;
+    // Folder holding the item, before anything is renamed
+    std::wstring parentPath;
+    std::wstring originalName;
+    std::wstring newName;
+};
+
+enum class RenameJournalState : BYTE
+{
+    Pending,
+    Done,
+    Failed,
+    RolledBack,
+};
+
+struct RenameJournalEntry
+{
+    UINT depth = 0;
+    // Index in the folders of the journal
+    UINT folder = 0;
+    std::wstring originalName;
+    // Name the item has once renamed
+    std::wstring newName;
+    RenameJournalState state = RenameJournalState::Pending;
+    HRESULT result = S_OK;
+};
+
+struct RenameProgress
+{
+    size_t total = 0;
+    size_t done = 0;
+    size_t failed = 0;
+    size_t rolledBack = 0;
+    // Batches run and items processed by the current Execute or RollBack call
+    size_t batches = 0;
+    size_t processed = 0;
+    double elapsedSeconds = 0;
+    double itemsPerSecond = 0;
+};
+
+// Plan of a rename operation, and record of what it did so far.
+// The plan is written before anything is renamed, deepest items first like the
+// shell needs them.  The renames then run in batches: a record marks a batch as
+// started, and the outcome of each of its items is recorded once it ran.  After a
+// crash, s_Open reads the journal back, and Execute finishes the plan or RollBack
+// gives the items renamed so far their original name.  Only the items of the batch
+// that was running need to be checked on disk.
+// The file is append-only, folders are stored once and every record carries a
+// checksum, so a record torn by a crash is dropped when the journal is read back.
+// Records are flushed to the disk when a batch starts and once it ran, so they
+// survive the process crashing and a power loss.  Not thread safe.
+class CRenameJournal
+{
+public:
+    // Return false to stop after the current batch
+    typedef std::function<bool(const RenameProgress&)> ProgressCallback;
+
+    static const size_t c_defaultBatchSize = 1024;
+
+    // Writes the plan of items to a new journal file at path, an empty path keeps the
+    // journal in memory only.  Items are ordered by decreasing depth, items of the
+    // same depth keep their order.
+    static HRESULT s_Create(_In_ const std::filesystem::path& path, _In_ const std::vector<RenamePlanItem>& items, _Out_ std::unique_ptr<CRenameJournal>& journal);
+
+    // Reads the journal left by an interrupted operation.  Returns S_FALSE if the plan
+    // wasn't completely written, nothing was renamed then and the journal is empty.
+    static HRESULT s_Open(_In_ const std::filesystem::path& path, _Out_ std::unique_ptr<CRenameJournal>& journal);
+
+    size_t GetEntryCount() const { return m_entries.size(); }
+    const RenameJournalEntry& GetEntry(_In_ size_t index) const { return m_entries[index]; }
+    const std::wstring& GetParentPath(_In_ size_t index) const { return m_folders[m_entries[index].folder]; }
+    std::filesystem::path GetOriginalPath(_In_ size_t index) const;
+    std::filesystem::path GetNewPath(_In_ size_t index) const;
+
+    const RenameProgress& GetProgress() const { return m_progress; }
+    // Whether Finish was called, the operation needs nothing more
+    bool IsFinished() const { return m_finished; }
+
+    // Renames the pending items in batches of batchSize.  progress is called after
+    // each batch.  Returns a failure if the executor or the journal file failed, or
+    // HRESULT_FROM_WIN32(ERROR_CANCELLED) if progress stopped it.  The renames that
+    // failed are recorded and don't fail the call.
+    HRESULT Execute(_In_ IRenameExecutor& executor, _In_ size_t batchSize, _In_opt_ const ProgressCallback& progress);
+
+    // Gives the renamed items their original name, in the reverse order, with the
+    // same results as Execute.  A batch never holds an item and its parent folder.
+    HRESULT RollBack(_In_ IRenameExecutor& executor, _In_ size_t batchSize, _In_opt_ const ProgressCallback& progress);
+
+    // Records that the operation is over and deletes the journal file
+    HRESULT Finish();
+
+    ~CRenameJournal();
+
+private:
+    enum class BatchKind : BYTE
+    {
+        None,
+        Execute,
+        RollBack,
+    };
+
+    CRenameJournal() = default;
+    CRenameJournal(const CRenameJournal&) = delete;
+    CRenameJournal& operator=(const CRenameJournal&) = delete;
+
+    HRESULT _OpenFile(_In_ bool truncate);
+    void _Replay(_In_ char type, _In_ const std::string& payload);
+    // Settles the items of the batch that was running when the journal was written,
+    // from what is on disk
+    HRESULT _ReconcileStartedBatch(_In_ IRenameExecutor& executor);
+    HRESULT _RunBatch(_In_ IRenameExecutor& executor, _In_ BatchKind kind, _In_ const std::vector<size_t>& batch);
+    void _UpdateProgress(_In_ std::chrono::steady_clock::time_point start);
+
+    void _AppendRecord(_In_ char type, _In_ const std::string& payload);
+    HRESULT _FlushRecords();
+
+    std::filesystem::path m_path;
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    // Records not written to the file yet
+    std::string m_pendingRecords;
+
+    std::vector<std::wstring> m_folders;
+    std::vector<RenameJournalEntry> m_entries;
+    bool m_sealed = false;
+    bool m_finished = false;
+
+    // Last batch started, unsettled until its items are checked
+    BatchKind m_startedBatchKind = BatchKind::None;
+    size_t m_startedBatchFirst = 0;
+    size_t m_startedBatchLast = 0;
+
+    RenameProgress m_progress;
+};
@@ -1,6 +1,8 @@
 #include "pch.h"
 #include "Settings.h"
 #include "PowerRenameInterfaces.h"
+#include "MRUStore.h"
+#include "srwlock.h"
 #include <common/SettingsAPI/settings_helpers.h>
 
 #include <filesystem>
@@ -15,6 +17,7 @@ namespace
     const wchar_t c_powerRenameUIFlagsFilePath[] = L"\\power-rename-ui-flags";
     const wchar_t c_searchMRUListFilePath[] = L"\\search-mru.json";
     const wchar_t c_replaceMRUListFilePath[] = L"\\replace-mru.json";
+    const wchar_t c_mruLogExtension[] = L".log";
 
     const wchar_t c_rootRegPath[] = L"Software\\Microsoft\\PowerRename";
     const wchar_t c_mruSearchRegPath[] = L"\\SearchMRU";
@@ -32,6 +35,7 @@ namespace
     const wchar_t c_mruList[] = L"MRUList";
     const wchar_t c_insertionIdx[] = L"InsertionIdx";
     const wchar_t c_useBoostLib[] = L"UseBoostLib";
+    const wchar_t c_useLinearRegEx[] = L"UseLinearRegEx";
 
     unsigned int GetRegNumber(const std::wstring& valueName, unsigned int defaultValue)
     {
@@ -87,180 +91,171 @@ namespace
     }
 }
 
+// The MRU list of the process, shared by its dialogs.  The JSON file is the snapshot
+// of the list, read once per process.  The strings pushed since it was written are
+// appended to the log of the store, next to it, and the snapshot is written again
+// once the log got long.
 class MRUListHandler
 {
 public:
-    MRUListHandler(unsigned int size, const std::wstring& filePath, const std::wstring& regPath) :
-        pushIdx(0),
-        nextIdx(1),
-        size(size),
+    MRUListHandler(const std::wstring& filePath, const std::wstring& regPath) :
         jsonFilePath(PTSettingsHelper::get_module_save_folder_location(PowerRenameConstants::ModuleKey) + filePath),
-        registryFilePath(regPath)
+        registryFilePath(regPath),
+        store(0, std::filesystem::path(jsonFilePath).replace_extension(c_mruLogExtension))
     {
-        items.resize(size);
-        Load();
     }
 
+    // Loads the list the first time, or when its size changed, and otherwise reads
+    // the strings pushed by other processes
+    void Open(unsigned int size);
     void Push(const std::wstring& data);
-    bool Next(std::wstring& data);
-
-    void Reset();
+    // Newest first
+    std::vector<std::wstring> GetItems();
 
 private:
     void Load();
-    void Save();
-    void MigrateFromRegistry();
-    json::JsonArray Serialize();
-    void ParseJson();
+    void Compact();
+    std::vector<std::wstring> MigrateFromRegistry();
+    std::vector<std::wstring> ParseJson(unsigned int& snapshotSize);
 
-    bool Exists(const std::wstring& data);
-
-    std::vector<std::wstring> items;
-    unsigned int pushIdx;
-    unsigned int nextIdx;
-    unsigned int size;
+    CSRWLock mruLock;
+    bool loaded = false;
     const std::wstring jsonFilePath;
     const std::wstring registryFilePath;
+    CMRUStore store;
 };
 
-void MRUListHandler::Push(const std::wstring& data)
+void MRUListHandler::Open(unsigned int size)
 {
-    if (Exists(data))
+    CSRWExclusiveAutoLock lock(&mruLock);
+    if (!loaded || store.GetSize() != size)
     {
-        // TODO: Already existing item should be put on top of MRU list.
-        return;
+        store.Resize(size);
+        Load();
+        loaded = true;
+    }
+    else if (store.Refresh() == S_FALSE)
+    {
+        Load();
     }
-    items[pushIdx] = data;
-    pushIdx = (pushIdx + 1) % size;
-    Save();
 }
 
-bool MRUListHandler::Next(std::wstring& data)
+void MRUListHandler::Push(const std::wstring& data)
 {
-    if (nextIdx == size + 1)
+    CSRWExclusiveAutoLock lock(&mruLock);
+    if (store.Refresh() == S_FALSE)
     {
-        Reset();
-        return false;
+        Load();
     }
-    // Go backwards to consume latest items first.
-    unsigned int idx = (pushIdx + size - nextIdx) % size;
-    if (items[idx].empty())
+
+    // An existing string is moved on top
+    store.Push(data);
+    if (store.NeedsCompaction())
     {
-        Reset();
-        return false;
+        Compact();
     }
-    data = items[idx];
-    ++nextIdx;
-    return true;
 }
 
-void MRUListHandler::Reset()
+std::vector<std::wstring> MRUListHandler::GetItems()
 {
-    nextIdx = 1;
+    CSRWSharedAutoLock lock(&mruLock);
+    return store.GetItems();
 }
 
 void MRUListHandler::Load()
 {
     if (!std::filesystem::exists(jsonFilePath))
     {
-        MigrateFromRegistry();
-
-        Save();
+        store.Load(MigrateFromRegistry());
+        Compact();
     }
     else
     {
-        ParseJson();
+        unsigned int snapshotSize = store.GetSize();
+        store.Load(ParseJson(snapshotSize));
+        if (snapshotSize != store.GetSize() || store.NeedsCompaction())
+        {
+            Compact();
+        }
     }
 }
 
-void MRUListHandler::Save()
+void MRUListHandler::Compact()
 {
-    json::JsonObject jsonData;
+    // Written as the ring the list used to be kept in, oldest first from the first
+    // slot, so the file stays readable by older versions
+    const std::vector<std::wstring> items = store.GetItems();
+    const unsigned int size = store.GetSize();
+    json::JsonArray mruList{};
+    for (size_t i = items.size(); i-- > 0;)
+    {
+        mruList.Append(json::value(items[i]));
+    }
+    for (size_t i = items.size(); i < size; i++)
+    {
+        mruList.Append(json::value(std::wstring{}));
+    }
 
+    json::JsonObject jsonData;
     jsonData.SetNamedValue(c_maxMRUSize, json::value(size));
-    jsonData.SetNamedValue(c_insertionIdx, json::value(pushIdx));
-    jsonData.SetNamedValue(c_mruList, Serialize());
+    jsonData.SetNamedValue(c_insertionIdx, json::value(size ? static_cast<unsigned int>(items.size() % size) : 0u));
+    jsonData.SetNamedValue(c_mruList, mruList);
 
     json::to_file(jsonFilePath, jsonData);
+    store.TruncateLog();
 }
 
-json::JsonArray MRUListHandler::Serialize()
-{
-    json::JsonArray searchMRU{};
-
-    std::wstring data{};
-    for (const std::wstring& item : items)
-    {
-        searchMRU.Append(json::value(item));
-    }
-
-    return searchMRU;
-}
-
-void MRUListHandler::MigrateFromRegistry()
+std::vector<std::wstring> MRUListHandler::MigrateFromRegistry()
 {
+    std::vector<std::wstring> items;
     std::wstring searchListKeys = GetRegString(c_mruList, registryFilePath);
     std::sort(std::begin(searchListKeys), std::end(searchListKeys));
     for (const wchar_t& key : searchListKeys)
     {
-        Push(GetRegString(std::wstring(1, key), registryFilePath));
+        std::wstring item = GetRegString(std::wstring(1, key), registryFilePath);
+        if (!item.empty())
+        {
+            items.push_back(std::move(item));
+        }
     }
+    return items;
 }
 
-void MRUListHandler::ParseJson()
+std::vector<std::wstring> MRUListHandler::ParseJson(unsigned int& snapshotSize)
 {
+    std::vector<std::wstring> items;
     auto json = json::from_file(jsonFilePath);
     if (json)
     {
         const json::JsonObject& jsonObject = json.value();
         try
         {
-            unsigned int oldSize{ size };
             if (json::has(jsonObject, c_maxMRUSize, json::JsonValueType::Number))
             {
-                oldSize = (unsigned int)jsonObject.GetNamedNumber(c_maxMRUSize);
-            }
-            unsigned int oldPushIdx{ 0 };
-            if (json::has(jsonObject, c_insertionIdx, json::JsonValueType::Number))
-            {
-                oldPushIdx = (unsigned int)jsonObject.GetNamedNumber(c_insertionIdx);
-                if (oldPushIdx < 0 || oldPushIdx >= oldSize)
-                {
-                    oldPushIdx = 0;
-                }
+                snapshotSize = (unsigned int)jsonObject.GetNamedNumber(c_maxMRUSize);
             }
             if (json::has(jsonObject, c_mruList, json::JsonValueType::Array))
             {
                 auto jsonArray = jsonObject.GetNamedArray(c_mruList);
-                if (oldSize == size)
+                const unsigned int count = jsonArray.Size();
+                unsigned int oldPushIdx{ 0 };
+                if (json::has(jsonObject, c_insertionIdx, json::JsonValueType::Number))
                 {
-                    for (uint32_t i = 0; i < jsonArray.Size(); ++i)
+                    oldPushIdx = (unsigned int)jsonObject.GetNamedNumber(c_insertionIdx);
+                    if (oldPushIdx >= count)
                     {
-                        items[i] = std::wstring(jsonArray.GetStringAt(i));
+                        oldPushIdx = 0;
                     }
-                    pushIdx = oldPushIdx;
                 }
-                else
+
+                // The oldest string is at the insertion index of the ring
+                for (unsigned int i = 0; i < count; ++i)
                 {
-                    std::vector<std::wstring> temp;
-                    for (unsigned int i = 0; i < min(jsonArray.Size(), size); ++i)
-                    {
-                        int idx = (oldPushIdx + oldSize - (i + 1)) % oldSize;
-                        temp.push_back(std::wstring(jsonArray.GetStringAt(idx)));
-                    }
-                    if (size > oldSize)
-                    {
-                        std::reverse(std::begin(temp), std::end(temp));
-                        pushIdx = (unsigned int)temp.size();
-                        temp.resize(size);
-                    }
-                    else
+                    std::wstring item{ jsonArray.GetStringAt((oldPushIdx + i) % count) };
+                    if (!item.empty())
                     {
-                        temp.resize(size);
-                        std::reverse(std::begin(temp), std::end(temp));
+                        items.push_back(std::move(item));
                     }
-                    items = std::move(temp);
-                    Save();
                 }
             }
         }
@@ -268,11 +263,7 @@ void MRUListHandler::ParseJson()
         {
         }
     }
-}
-
-bool MRUListHandler::Exists(const std::wstring& data)
-{
-    return std::find(std::begin(items), std::end(items), data) != std::end(items);
+    return items;
 }
 
 class CRenameMRU :
@@ -300,29 +291,34 @@ public:
     // IPowerRenameMRU
     IFACEMETHODIMP AddMRUString(_In_ PCWSTR entry);
 
-    static HRESULT CreateInstance(_In_ const std::wstring& filePath, _In_ const std::wstring& regPath, _Outptr_ IUnknown** ppUnk);
+    static HRESULT CreateInstance(_In_ MRUListHandler& list, _Outptr_ IUnknown** ppUnk);
 
 private:
-    CRenameMRU(int size, const std::wstring& filePath, const std::wstring& regPath);
+    CRenameMRU(MRUListHandler& list);
 
-    std::unique_ptr<MRUListHandler> mruList;
+    MRUListHandler& mruList;
+    // Strings enumerated, newest first, taken again by Reset
+    std::vector<std::wstring> items;
+    size_t nextIdx = 0;
     unsigned int refCount = 0;
 };
 
-CRenameMRU::CRenameMRU(int size, const std::wstring& filePath, const std::wstring& regPath) :
+CRenameMRU::CRenameMRU(MRUListHandler& list) :
+    mruList(list),
+    items(list.GetItems()),
     refCount(1)
 {
-    mruList = std::make_unique<MRUListHandler>(size, filePath, regPath);
 }
 
-HRESULT CRenameMRU::CreateInstance(_In_ const std::wstring& filePath, _In_ const std::wstring& regPath, _Outptr_ IUnknown** ppUnk)
+HRESULT CRenameMRU::CreateInstance(_In_ MRUListHandler& list, _Outptr_ IUnknown** ppUnk)
 {
     *ppUnk = nullptr;
     unsigned int maxMRUSize = CSettingsInstance().GetMaxMRUSize();
     HRESULT hr = E_FAIL;
     if (maxMRUSize > 0)
     {
-        CRenameMRU* renameMRU = new CRenameMRU(maxMRUSize, filePath, regPath);
+        list.Open(maxMRUSize);
+        CRenameMRU* renameMRU = new CRenameMRU(list);
         hr = E_OUTOFMEMORY;
         if (renameMRU)
         {
@@ -380,11 +376,17 @@ IFACEMETHODIMP CRenameMRU::Next(__in ULONG celt, __out_ecount_part(celt, *pceltF
         return S_FALSE;
     }
 
-    HRESULT hr = S_FALSE;
-    if (std::wstring data{}; mruList->Next(data))
+    if (nextIdx == items.size())
     {
-        hr = SHStrDup(data.c_str(), rgelt);
-        if (SUCCEEDED(hr) && pceltFetched != nullptr)
+        nextIdx = 0;
+        return S_FALSE;
+    }
+
+    HRESULT hr = SHStrDup(items[nextIdx].c_str(), rgelt);
+    if (SUCCEEDED(hr))
+    {
+        ++nextIdx;
+        if (pceltFetched != nullptr)
         {
             *pceltFetched = 1;
         }
@@ -395,13 +397,14 @@ IFACEMETHODIMP CRenameMRU::Next(__in ULONG celt, __out_ecount_part(celt, *pceltF
 
 IFACEMETHODIMP CRenameMRU::Reset()
 {
-    mruList->Reset();
+    items = mruList.GetItems();
+    nextIdx = 0;
     return S_OK;
 }
 
 IFACEMETHODIMP CRenameMRU::AddMRUString(_In_ PCWSTR entry)
 {
-    mruList->Push(entry);
+    mruList.Push(entry);
     return S_OK;
 }
 
@@ -426,6 +429,7 @@ void CSettings::Save()
     jsonData.SetNamedValue(c_searchText, json::value(settings.searchText));
     jsonData.SetNamedValue(c_replaceText, json::value(settings.replaceText));
     jsonData.SetNamedValue(c_useBoostLib, json::value(settings.useBoostLib));
+    jsonData.SetNamedValue(c_useLinearRegEx, json::value(settings.useLinearRegEx));
 
     json::to_file(jsonFilePath, jsonData);
     GetSystemTimeAsFileTime(&lastLoadedTime);
@@ -456,6 +460,11 @@ void CSettings::Reload()
     {
         Load();
     }
+    else
+    {
+        // The flags have their own file, which is written without the settings file
+        ReadFlags();
+    }
 }
 
 void CSettings::MigrateFromRegistry()
@@ -470,6 +479,7 @@ void CSettings::MigrateFromRegistry()
     settings.searchText = GetRegString(c_searchText, L"");
     settings.replaceText = GetRegString(c_replaceText, L"");
     settings.useBoostLib = false; // Never existed in registry, disabled by default.
+    settings.useLinearRegEx = true; // Never existed in registry, enabled by default.
 }
 
 void CSettings::ParseJson()
@@ -516,6 +526,10 @@ void CSettings::ParseJson()
             {
                 settings.useBoostLib = jsonSettings.GetNamedBoolean(c_useBoostLib);
             }
+            if (json::has(jsonSettings, c_useLinearRegEx, json::JsonValueType::Boolean))
+            {
+                settings.useLinearRegEx = jsonSettings.GetNamedBoolean(c_useLinearRegEx);
+            }
         }
         catch (const winrt::hresult_error&)
         {
@@ -550,10 +564,12 @@ CSettings& CSettingsInstance()
 
 HRESULT CRenameMRUSearch_CreateInstance(_Outptr_ IUnknown** ppUnk)
 {
-    return CRenameMRU::CreateInstance(c_searchMRUListFilePath, c_mruSearchRegPath, ppUnk);
+    static MRUListHandler searchMRUList(c_searchMRUListFilePath, c_mruSearchRegPath);
+    return CRenameMRU::CreateInstance(searchMRUList, ppUnk);
 }
 
 HRESULT CRenameMRUReplace_CreateInstance(_Outptr_ IUnknown** ppUnk)
 {
-    return CRenameMRU::CreateInstance(c_replaceMRUListFilePath, c_mruReplaceRegPath, ppUnk);
+    static MRUListHandler replaceMRUList(c_replaceMRUListFilePath, c_mruReplaceRegPath);
+    return CRenameMRU::CreateInstance(replaceMRUList, ppUnk);
 }
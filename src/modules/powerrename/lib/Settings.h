@@ -61,6 +61,16 @@ public:
         settings.useBoostLib = useBoostLib;
     }
 
+    inline bool GetUseLinearRegEx() const
+    {
+        return settings.useLinearRegEx;
+    }
+
+    inline void SetUseLinearRegEx(bool useLinearRegEx)
+    {
+        settings.useLinearRegEx = useLinearRegEx;
+    }
+
     inline bool GetMRUEnabled() const
     {
         return settings.MRUEnabled;
@@ -116,6 +126,9 @@ public:
 
     void Save();
     void Load();
+    // Loads the settings again if their file was written since they were loaded, and
+    // reads the flags again
+    void Reload();
 
 private:
     struct Settings
@@ -125,6 +138,7 @@ private:
         bool extendedContextMenuOnly{ false }; // Disabled by default.
         bool persistState{ true };
         bool useBoostLib{ false }; // Disabled by default.
+        bool useLinearRegEx{ true };
         bool MRUEnabled{ true };
         unsigned int maxMRUSize{ 10 };
         unsigned int flags{ 0 };
@@ -132,7 +146,6 @@ private:
         std::wstring replaceText{};
     };
 
-    void Reload();
     void MigrateFromRegistry();
     void ParseJson();
 
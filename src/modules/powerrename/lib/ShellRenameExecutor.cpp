@@ -0,0 +1,135 @@
+#include "pch.h"
+#include "ShellRenameExecutor.h"
+
+namespace
+{
+    // Receives the outcome of a single rename of the operation
+    class CRenameItemSink :
+        public IFileOperationProgressSink
+    {
+    public:
+        CRenameItemSink(_Inout_ RenameResult* result) :
+            m_refCount(1), m_result(result)
+        {
+        }
+
+        // IUnknown
+        IFACEMETHODIMP QueryInterface(_In_ REFIID riid, _Outptr_ void** ppv)
+        {
+            static const QITAB qit[] = {
+                QITABENT(CRenameItemSink, IFileOperationProgressSink),
+                { 0 }
+            };
+            return QISearch(this, qit, riid, ppv);
+        }
+
+        IFACEMETHODIMP_(ULONG) AddRef()
+        {
+            return InterlockedIncrement(&m_refCount);
+        }
+
+        IFACEMETHODIMP_(ULONG) Release()
+        {
+            long refCount = InterlockedDecrement(&m_refCount);
+            if (refCount == 0)
+            {
+                delete this;
+            }
+            return refCount;
+        }
+
+        // IFileOperationProgressSink
+        IFACEMETHODIMP PostRenameItem(DWORD, _In_ IShellItem*, _In_ PCWSTR newName, HRESULT hrRename, _In_opt_ IShellItem* newItem)
+        {
+            // Skipped items report a success code without a new item
+            m_result->hr = (SUCCEEDED(hrRename) && !newItem) ? HRESULT_FROM_WIN32(ERROR_CANCELLED) : hrRename;
+            m_result->finalName.clear();
+
+            PWSTR finalName = nullptr;
+            if (SUCCEEDED(m_result->hr) && SUCCEEDED(newItem->GetDisplayName(SIGDN_PARENTRELATIVEPARSING, &finalName)))
+            {
+                if (wcscmp(finalName, newName) != 0)
+                {
+                    m_result->finalName = finalName;
+                }
+                CoTaskMemFree(finalName);
+            }
+            return S_OK;
+        }
+
+        IFACEMETHODIMP StartOperations() { return S_OK; }
+        IFACEMETHODIMP FinishOperations(HRESULT) { return S_OK; }
+        IFACEMETHODIMP PreRenameItem(DWORD, _In_ IShellItem*, _In_opt_ PCWSTR) { return S_OK; }
+        IFACEMETHODIMP PreMoveItem(DWORD, _In_ IShellItem*, _In_ IShellItem*, _In_opt_ PCWSTR) { return S_OK; }
+        IFACEMETHODIMP PostMoveItem(DWORD, _In_ IShellItem*, _In_ IShellItem*, _In_opt_ PCWSTR, HRESULT, _In_opt_ IShellItem*) { return S_OK; }
+        IFACEMETHODIMP PreCopyItem(DWORD, _In_ IShellItem*, _In_ IShellItem*, _In_opt_ PCWSTR) { return S_OK; }
+        IFACEMETHODIMP PostCopyItem(DWORD, _In_ IShellItem*, _In_ IShellItem*, _In_opt_ PCWSTR, HRESULT, _In_opt_ IShellItem*) { return S_OK; }
+        IFACEMETHODIMP PreDeleteItem(DWORD, _In_ IShellItem*) { return S_OK; }
+        IFACEMETHODIMP PostDeleteItem(DWORD, _In_ IShellItem*, HRESULT, _In_opt_ IShellItem*) { return S_OK; }
+        IFACEMETHODIMP PreNewItem(DWORD, _In_ IShellItem*, _In_opt_ PCWSTR) { return S_OK; }
+        IFACEMETHODIMP PostNewItem(DWORD, _In_ IShellItem*, _In_opt_ PCWSTR, _In_opt_ PCWSTR, DWORD, HRESULT, _In_opt_ IShellItem*) { return S_OK; }
+        IFACEMETHODIMP UpdateProgress(UINT, UINT) { return S_OK; }
+        IFACEMETHODIMP ResetTimer() { return S_OK; }
+        IFACEMETHODIMP PauseTimer() { return S_OK; }
+        IFACEMETHODIMP ResumeTimer() { return S_OK; }
+
+    private:
+        ~CRenameItemSink() = default;
+
+        long m_refCount;
+        RenameResult* m_result;
+    };
+}
+
+HRESULT CShellRenameExecutor::RenameBatch(_In_reads_(count) const RenameRequest* requests, _In_ size_t count, _Out_writes_(count) RenameResult* results)
+{
+    CComPtr<IFileOperation> spFileOp;
+    HRESULT hr = CoCreateInstance(CLSID_FileOperation, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&spFileOp));
+    if (SUCCEEDED(hr))
+    {
+        hr = spFileOp->SetOperationFlags(m_operationFlags);
+    }
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    if (m_hwndOwner)
+    {
+        spFileOp->SetOwnerWindow(m_hwndOwner);
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        CComPtr<IShellItem> spShellItem;
+        results[i].hr = SHCreateItemFromParsingName(requests[i].path.c_str(), nullptr, IID_PPV_ARGS(&spShellItem));
+        if (FAILED(results[i].hr))
+        {
+            continue;
+        }
+
+        // Stays E_ABORT unless the sink is told the outcome
+        results[i].hr = E_ABORT;
+        CRenameItemSink* sink = new CRenameItemSink(&results[i]);
+        if (FAILED(spFileOp->RenameItem(spShellItem, requests[i].newName.c_str(), sink)))
+        {
+            results[i].hr = E_FAIL;
+        }
+        sink->Release();
+    }
+
+    // The outcome of each rename comes from the sinks.  Only a cancellation by the user
+    // stops the following batches.
+    spFileOp->PerformOperations();
+    BOOL aborted = FALSE;
+    if (SUCCEEDED(spFileOp->GetAnyOperationsAborted(&aborted)) && aborted)
+    {
+        return HRESULT_FROM_WIN32(ERROR_CANCELLED);
+    }
+    return S_OK;
+}
+
+bool CShellRenameExecutor::Exists(_In_ const std::filesystem::path& path)
+{
+    return GetFileAttributes(path.c_str()) != INVALID_FILE_ATTRIBUTES;
+}
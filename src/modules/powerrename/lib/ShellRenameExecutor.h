@@ -0,0 +1,22 @@
+#pragma once
+#include "RenameExecutor.h"
+
+// Renames through IFileOperation, one operation per batch, so the renames can be
+// undone from Explorer and the shell shows its progress and conflict UI.  Must be
+// used on a thread where COM is initialized.
+class CShellRenameExecutor :
+    public IRenameExecutor
+{
+public:
+    CShellRenameExecutor(_In_opt_ HWND hwndOwner, DWORD operationFlags) :
+        m_hwndOwner(hwndOwner), m_operationFlags(operationFlags)
+    {
+    }
+
+    HRESULT RenameBatch(_In_reads_(count) const RenameRequest* requests, _In_ size_t count, _Out_writes_(count) RenameResult* results) override;
+    bool Exists(_In_ const std::filesystem::path& path) override;
+
+private:
+    HWND m_hwndOwner = nullptr;
+    DWORD m_operationFlags = 0;
+};
@@ -0,0 +1,203 @@
+#include "pch.h"
+#include "UniqueNameResolver.h"
+
+namespace
+{
+    // Folded form of a name used as a key, the file system ignores case
+    std::wstring FoldName(_In_reads_(length) PCWSTR name, _In_ size_t length)
+    {
+        std::wstring folded(name, length);
+        if (!folded.empty())
+        {
+            CharUpperBuffW(folded.data(), static_cast<DWORD>(folded.length()));
+        }
+        return folded;
+    }
+
+    std::wstring FoldName(_In_ const std::wstring& name)
+    {
+        return FoldName(name.c_str(), name.length());
+    }
+
+    // Largest number whose name still fits in MAX_PATH, same limits as GetEnumeratedFileName.
+    // Only the name is measured, as it was for the callers passing no directory, so the
+    // numbers available don't depend on how deep the folder is.
+    unsigned long GetMaxNumber(_In_ size_t stemLength, _In_ size_t decorationLength, unsigned long minNumber)
+    {
+        const long long available = static_cast<long long>(MAX_PATH) - stemLength - decorationLength;
+        switch (available)
+        {
+        case 1:
+            return 10;
+        case 2:
+            return 100;
+        case 3:
+            return 1000;
+        case 4:
+            return 10000;
+        case 5:
+            return 100000;
+        default:
+            return available <= 0 ? minNumber : 1000000;
+        }
+    }
+}
+
+HRESULT CUniqueNameResolver::GetEnumeratedName(_In_ PCWSTR directory, _In_ PCWSTR nameTemplate, unsigned long minNumber, _Out_ std::wstring& uniqueName, _Out_ unsigned long* numberUsed)
+{
+    uniqueName.clear();
+    *numberUsed = 0;
+
+    // Look for a "(digits)" to put the number in
+    PCWSTR rest = wcschr(nameTemplate, L'(');
+    while (rest)
+    {
+        PCWSTR endDigits = rest + 1;
+        while (*endDigits >= L'0' && *endDigits <= L'9')
+        {
+            endDigits++;
+        }
+
+        if (*endDigits == L')')
+        {
+            break;
+        }
+
+        rest = wcschr(rest + 1, L'(');
+    }
+
+    PCWSTR prefix = L"";
+    PCWSTR suffix = L"";
+    size_t stemLength = 0;
+    if (!rest)
+    {
+        rest = PathFindExtension(nameTemplate);
+        stemLength = rest - nameTemplate;
+        prefix = L" (";
+        suffix = L")";
+    }
+    else
+    {
+        rest++;
+        stemLength = rest - nameTemplate;
+        while (*rest >= L'0' && *rest <= L'9')
+        {
+            rest++;
+        }
+    }
+
+    const size_t prefixLength = wcslen(prefix);
+    const size_t suffixLength = wcslen(suffix);
+    const unsigned long maxNumber = GetMaxNumber(stemLength, prefixLength + suffixLength, minNumber);
+
+    Directory& names = _GetDirectory(directory);
+    if (!names.read)
+    {
+        _ReadDirectory(directory, names);
+    }
+
+    // Skip the numbers already known to be taken for this template
+    std::wstring templateKey = FoldName(nameTemplate, stemLength);
+    templateKey += prefix;
+    templateKey += L'\0';
+    templateKey += FoldName(rest, wcslen(rest));
+    TakenRange& taken = names.takenRanges[templateKey];
+    unsigned long number = minNumber;
+    if (taken.first <= number && number < taken.end)
+    {
+        number = taken.end;
+    }
+
+    std::wstring candidate(nameTemplate, stemLength);
+    candidate += prefix;
+    const size_t digitsPosition = candidate.length();
+    for (; number < maxNumber; number++)
+    {
+        candidate.resize(digitsPosition);
+        candidate += std::to_wstring(number);
+        candidate += suffix;
+        candidate += rest;
+
+        std::wstring folded = FoldName(candidate);
+        if (names.existingNames.find(folded) == names.existingNames.end() &&
+            names.claimedNames.insert(std::move(folded)).second)
+        {
+            break;
+        }
+    }
+
+    if (number >= maxNumber)
+    {
+        return S_FALSE;
+    }
+
+    // Every number from minNumber up to this one is taken now
+    if (taken.first <= minNumber && minNumber <= taken.end)
+    {
+        taken.end = number + 1;
+    }
+    else
+    {
+        taken = { minNumber, number + 1 };
+    }
+
+    uniqueName = std::move(candidate);
+    *numberUsed = number;
+    return S_OK;
+}
+
+void CUniqueNameResolver::Release(_In_ PCWSTR directory, _In_ PCWSTR name)
+{
+    Directory& names = _GetDirectory(directory);
+    std::wstring folded = FoldName(name, wcslen(name));
+    names.existingNames.erase(folded);
+    names.releasedNames.insert(std::move(folded));
+
+    // The numbers found taken may be free now
+    names.takenRanges.clear();
+}
+
+bool CUniqueNameResolver::Claim(_In_ PCWSTR directory, _In_ PCWSTR name)
+{
+    if (_GetDirectory(directory).claimedNames.insert(FoldName(name, wcslen(name))).second)
+    {
+        return true;
+    }
+
+    m_collisionCount++;
+    return false;
+}
+
+CUniqueNameResolver::Directory& CUniqueNameResolver::_GetDirectory(_In_ PCWSTR directory)
+{
+    return m_directories[FoldName(directory, wcslen(directory))];
+}
+
+void CUniqueNameResolver::_ReadDirectory(_In_ PCWSTR directory, _Inout_ Directory& names)
+{
+    names.read = true;
+
+    // An empty directory is the current one, as for a relative path
+    std::wstring pattern = directory;
+    if (!pattern.empty() && pattern.back() != L'\\')
+    {
+        pattern += L'\\';
+    }
+    pattern += L'*';
+
+    WIN32_FIND_DATA findData = { 0 };
+    HANDLE findHandle = FindFirstFileEx(pattern.c_str(), FindExInfoBasic, &findData, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+    if (findHandle != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            std::wstring folded = FoldName(findData.cFileName, wcslen(findData.cFileName));
+            if (names.releasedNames.find(folded) == names.releasedNames.end())
+            {
+                names.existingNames.insert(std::move(folded));
+            }
+        } while (FindNextFile(findHandle, &findData));
+
+        FindClose(findHandle);
+    }
+}
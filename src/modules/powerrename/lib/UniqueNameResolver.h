@@ -0,0 +1,57 @@
+#pragma once
+#include "pch.h"
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// Picks the enumerated names of a rename batch without probing the file system for
+// each candidate.  The names of a directory are read once, the first time a name is
+// picked in it, and the names claimed by the batch are tracked along with them.
+// The numbers found taken for a name template are remembered, so numbering many
+// items with the same template is O(1) amortized.
+// Names are compared case insensitively, like the file system does.  Not thread safe.
+class CUniqueNameResolver
+{
+public:
+    // Same rules as GetEnumeratedFileName: the number replaces the digits of the first
+    // "(digits)" of nameTemplate, or is added as " (number)" before the extension.
+    // Claims the name with the smallest number from minNumber that is neither in the
+    // directory nor claimed.  Returns S_FALSE if all the numbers are taken.
+    HRESULT GetEnumeratedName(_In_ PCWSTR directory, _In_ PCWSTR nameTemplate, unsigned long minNumber, _Out_ std::wstring& uniqueName, _Out_ unsigned long* numberUsed);
+
+    // The item named name in directory is renamed by the batch, so its name is free
+    // for the other items.  Call it for every renamed item before picking names, so
+    // running the same rename again on numbered items gives them the same numbers.
+    void Release(_In_ PCWSTR directory, _In_ PCWSTR name);
+
+    // Claims name in directory for the batch.  Returns false if another item of the
+    // batch already claimed it.  Doesn't read the directory.
+    bool Claim(_In_ PCWSTR directory, _In_ PCWSTR name);
+
+    // Number of Claim calls that found the name already claimed by the batch
+    UINT GetCollisionCount() const { return m_collisionCount; }
+
+private:
+    // Numbers known to be taken for a template, from first to end (excluded)
+    struct TakenRange
+    {
+        unsigned long first = 0;
+        unsigned long end = 0;
+    };
+
+    struct Directory
+    {
+        bool read = false;
+        std::unordered_set<std::wstring> existingNames;
+        // Names of the items the batch renames, not taken once the directory is read
+        std::unordered_set<std::wstring> releasedNames;
+        std::unordered_set<std::wstring> claimedNames;
+        std::unordered_map<std::wstring, TakenRange> takenRanges;
+    };
+
+    Directory& _GetDirectory(_In_ PCWSTR directory);
+    void _ReadDirectory(_In_ PCWSTR directory, _Inout_ Directory& names);
+
+    std::unordered_map<std::wstring, Directory> m_directories;
+    UINT m_collisionCount = 0;
+};
@@ -0,0 +1,156 @@
+#include "pch.h"
+#include "VisibleItemIndex.h"
+#include <intrin.h>
+
+namespace
+{
+    UINT PopCount(_In_ ULONGLONG word)
+    {
+        return static_cast<UINT>(__popcnt64(word));
+    }
+
+    // Position of the rank-th set bit of word, which must have more than rank bits set
+    UINT SelectInWord(_In_ ULONGLONG word, _In_ UINT rank)
+    {
+        for (UINT i = 0; i < rank; i++)
+        {
+            word &= word - 1;
+        }
+
+        unsigned long bit = 0;
+        _BitScanForward64(&bit, word);
+        return bit;
+    }
+}
+
+void CVisibleItemIndex::Insert(_In_ UINT index, _In_ bool visible)
+{
+    if (m_size % 64 == 0)
+    {
+        m_words.push_back(0);
+    }
+
+    // Move the bits from index up by one, carrying the top bit of each word
+    const UINT firstWord = index / 64;
+    for (size_t word = m_words.size() - 1; word > firstWord; word--)
+    {
+        m_words[word] = (m_words[word] << 1) | (m_words[word - 1] >> 63);
+    }
+    const ULONGLONG lowMask = (1ULL << (index % 64)) - 1;
+    const ULONGLONG current = m_words[firstWord];
+    m_words[firstWord] = (current & lowMask) | ((current & ~lowMask) << 1);
+
+    m_size++;
+    m_firstStaleBlock = min(m_firstStaleBlock, index / c_blockBits);
+    Set(index, visible);
+    Update();
+}
+
+void CVisibleItemIndex::Set(_In_ UINT index, _In_ bool visible)
+{
+    const ULONGLONG bit = 1ULL << (index % 64);
+    ULONGLONG& word = m_words[index / 64];
+    if (((word & bit) != 0) != visible)
+    {
+        word ^= bit;
+        m_firstStaleBlock = min(m_firstStaleBlock, index / c_blockBits);
+    }
+}
+
+void CVisibleItemIndex::Update()
+{
+    const UINT blockCount = _BlockCount();
+    if (m_firstStaleBlock >= blockCount && m_blockRanks.size() == blockCount + 1)
+    {
+        return;
+    }
+
+    const UINT firstBlock = min(m_firstStaleBlock, blockCount);
+    UINT rank = firstBlock == 0 ? 0 : m_blockRanks[firstBlock - 1] + _BlockPopCount(firstBlock - 1);
+
+    // The samples before the first changed block are still right
+    while (!m_selectSamples.empty() && m_selectSamples.back() >= firstBlock)
+    {
+        m_selectSamples.pop_back();
+    }
+
+    m_blockRanks.resize(blockCount + 1);
+    for (UINT block = firstBlock; block < blockCount; block++)
+    {
+        m_blockRanks[block] = rank;
+        rank += _BlockPopCount(block);
+        while (m_selectSamples.size() * c_selectSampleRate < rank)
+        {
+            m_selectSamples.push_back(block);
+        }
+    }
+    m_blockRanks[blockCount] = rank;
+    m_firstStaleBlock = blockCount;
+}
+
+void CVisibleItemIndex::Clear()
+{
+    m_words.clear();
+    m_blockRanks.clear();
+    m_selectSamples.clear();
+    m_size = 0;
+    m_firstStaleBlock = 0;
+}
+
+UINT CVisibleItemIndex::Rank(_In_ UINT index) const
+{
+    const UINT block = index / c_blockBits;
+    UINT rank = m_blockRanks[block];
+    for (UINT word = block * c_wordsPerBlock; word < index / 64; word++)
+    {
+        rank += PopCount(m_words[word]);
+    }
+    if (index % 64)
+    {
+        rank += PopCount(m_words[index / 64] & ((1ULL << (index % 64)) - 1));
+    }
+    return rank;
+}
+
+UINT CVisibleItemIndex::Select(_In_ UINT visibleIndex) const
+{
+    // The block is between the samples around visibleIndex, find the last one
+    // starting at or before it
+    const size_t sample = visibleIndex / c_selectSampleRate;
+    UINT first = m_selectSamples[sample];
+    UINT last = sample + 1 < m_selectSamples.size() ? m_selectSamples[sample + 1] : _BlockCount() - 1;
+    while (first < last)
+    {
+        const UINT middle = first + (last - first + 1) / 2;
+        if (m_blockRanks[middle] <= visibleIndex)
+        {
+            first = middle;
+        }
+        else
+        {
+            last = middle - 1;
+        }
+    }
+
+    UINT rank = visibleIndex - m_blockRanks[first];
+    for (UINT word = first * c_wordsPerBlock;; word++)
+    {
+        const UINT count = PopCount(m_words[word]);
+        if (rank < count)
+        {
+            return word * 64 + SelectInWord(m_words[word], rank);
+        }
+        rank -= count;
+    }
+}
+
+UINT CVisibleItemIndex::_BlockPopCount(_In_ UINT block) const
+{
+    UINT count = 0;
+    const size_t lastWord = min(static_cast<size_t>(block + 1) * c_wordsPerBlock, m_words.size());
+    for (size_t word = static_cast<size_t>(block) * c_wordsPerBlock; word < lastWord; word++)
+    {
+        count += PopCount(m_words[word]);
+    }
+    return count;
+}
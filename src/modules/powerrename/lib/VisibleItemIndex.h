@@ -0,0 +1,51 @@
+#pragma once
+#include "pch.h"
+#include <vector>
+
+// Visibility of the items of the manager as a bitmap, with the counts needed to map
+// list view indexes to item indexes without scanning it.
+// The number of visible items before each block of c_blockBits items is kept, along
+// with the block holding every c_selectSampleRate-th visible item, so Select only
+// searches the few blocks between two samples.
+// Not thread safe, the manager guards it with its items lock.
+class CVisibleItemIndex
+{
+public:
+    static const UINT c_blockBits = 512;
+    static const UINT c_selectSampleRate = 512;
+
+    UINT Size() const { return m_size; }
+    bool IsVisible(_In_ UINT index) const { return (m_words[index / 64] >> (index % 64)) & 1; }
+
+    // Inserts an item at index, the items after it move up by one.  The counts are
+    // updated from the block of index, so appending is O(1).
+    void Insert(_In_ UINT index, _In_ bool visible);
+    // Changes the visibility of an item.  Update must be called once done changing
+    // items and before Count, Rank or Select are used again.
+    void Set(_In_ UINT index, _In_ bool visible);
+    // Updates the counts of the blocks changed by Set since the last call
+    void Update();
+    void Clear();
+
+    // Number of visible items
+    UINT Count() const { return m_blockRanks.empty() ? 0 : m_blockRanks.back(); }
+    // Number of visible items before index
+    UINT Rank(_In_ UINT index) const;
+    // Index of the item displayed at visibleIndex, which must be less than Count
+    UINT Select(_In_ UINT visibleIndex) const;
+
+private:
+    static const UINT c_wordsPerBlock = c_blockBits / 64;
+
+    UINT _BlockCount() const { return (m_size + c_blockBits - 1) / c_blockBits; }
+    UINT _BlockPopCount(_In_ UINT block) const;
+
+    std::vector<ULONGLONG> m_words;
+    // Visible items before each block, followed by the number of visible items
+    std::vector<UINT> m_blockRanks;
+    // Block holding the visible item k * c_selectSampleRate at index k
+    std::vector<UINT> m_selectSamples;
+    UINT m_size = 0;
+    // First block whose count is out of date
+    UINT m_firstStaleBlock = 0;
+};
@@ -86,5 +86,6 @@ void Trace::SettingsChanged() noexcept
         TraceLoggingBoolean(CSettingsInstance().GetMRUEnabled(), "IsMRUEnabled"),
         TraceLoggingUInt64(CSettingsInstance().GetMaxMRUSize(), "MaxMRUSize"),
         TraceLoggingBoolean(CSettingsInstance().GetUseBoostLib(), "UseBoostLib"),
+        TraceLoggingBoolean(CSettingsInstance().GetUseLinearRegEx(), "UseLinearRegEx"),
         TraceLoggingUInt64(CSettingsInstance().GetFlags(), "Flags"));
 }
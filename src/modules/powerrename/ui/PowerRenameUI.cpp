@@ -7,12 +7,19 @@
 #include <commctrl.h>
 #include <Shlobj.h>
 #include <helpers.h>
+#include <PowerRenameManager.h>
 #include <windowsx.h>
 #include <thread>
 #include <trace.h>
 
 extern HINSTANCE g_hInst;
 
+// Posted by the enumerator when new items are ready
+enum
+{
+    WM_POWERRENAME_ITEMSREADY = (WM_APP + 1)
+};
+
 enum
 {
     MATCHMODE_FULLNAME = 0,
@@ -82,7 +89,7 @@ inline int RECT_HEIGHT(RECT& r)
 CPowerRenameUI::CPowerRenameUI() :
     m_refCount(1)
 {
-    CSettingsInstance().Load();
+    CSettingsInstance().Reload();
     (void)OleInitialize(nullptr);
     ModuleAddRef();
 }
@@ -170,15 +177,27 @@ IFACEMETHODIMP CPowerRenameUI::OnItemAdded(_In_ IPowerRenameItem*)
     return S_OK;
 }
 
-IFACEMETHODIMP CPowerRenameUI::OnUpdate(_In_ IPowerRenameItem*)
+IFACEMETHODIMP CPowerRenameUI::OnItemsUpdated(_In_ UINT firstIndex, _In_ UINT lastIndex)
 {
     UINT visibleItemCount = 0;
+    DWORD filter = PowerRenameFilters::None;
     if (m_spsrm)
     {
         m_spsrm->GetVisibleItemCount(&visibleItemCount);
+        m_spsrm->GetFilter(&filter);
     }
     m_listview.SetItemCount(visibleItemCount);
-    m_listview.RedrawItems(0, visibleItemCount);
+
+    // The updated range is made of item indexes which only match the list view
+    // indexes when no filter is applied.
+    if (filter == PowerRenameFilters::None)
+    {
+        m_listview.RedrawVisibleItems(firstIndex, lastIndex);
+    }
+    else
+    {
+        m_listview.RedrawVisibleItems(0, visibleItemCount);
+    }
     _UpdateCounts();
     return S_OK;
 }
@@ -276,7 +295,6 @@ IFACEMETHODIMP CPowerRenameUI::Drop(_In_ IDataObject* pdtobj, DWORD, POINTL pt,
         m_spdth->Drop(pdtobj, &ptT, *pdwEffect);
     }
 
-    EnableWindow(GetDlgItem(m_hwnd, ID_RENAME), TRUE);
     EnableWindow(m_hwndLV, TRUE);
 
     // Populate the manager from the data object
@@ -355,6 +373,9 @@ HRESULT CPowerRenameUI::_InitAutoComplete()
 
 void CPowerRenameUI::_Cleanup()
 {
+    // Stop the enumeration before releasing the manager it adds items to
+    m_enumerator = nullptr;
+
     if (m_spsrm && m_cookie != 0)
     {
         m_spsrm->UnAdvise(m_cookie);
@@ -375,21 +396,80 @@ void CPowerRenameUI::_Cleanup()
 
 void CPowerRenameUI::_EnumerateItems(_In_ IUnknown* pdtobj)
 {
-    // Enumerate the data object and populate the manager
+    // Enumerate the data object and populate the manager.  Subfolders are read
+    // in the background and their items are added as they arrive.
     if (m_spsrm)
     {
-        m_disableCountUpdate = true;
-        EnumerateDataObject(pdtobj, m_spsrm);
-        m_disableCountUpdate = false;
+        // Items of a previous drop go first
+        if (m_enumerator)
+        {
+            _AddEnumeratedItems(INFINITE);
+        }
 
-        UINT itemCount = 0;
-        m_spsrm->GetVisibleItemCount(&itemCount);
-        m_listview.SetItemCount(itemCount);
+        CComPtr<IPowerRenameItemFactory> spsrif;
+        HRESULT hr = m_spsrm->GetRenameItemFactory(&spsrif);
+        if (SUCCEEDED(hr))
+        {
+            m_enumerator = std::make_unique<CPowerRenameEnum>();
+            m_newNamesItemCount = 0;
+            hr = m_enumerator->Start(pdtobj, spsrif, m_hwnd, WM_POWERRENAME_ITEMSREADY);
+        }
 
-        _UpdateCounts();
+        if (SUCCEEDED(hr))
+        {
+            // Show the top level items right away
+            _AddEnumeratedItems(0);
+        }
+        else
+        {
+            m_enumerator = nullptr;
+        }
     }
 }
 
+void CPowerRenameUI::_AddEnumeratedItems(_In_ DWORD timeoutMs)
+{
+    if (!m_enumerator || !m_spsrm)
+    {
+        return;
+    }
+
+    // Add a chunk at a time and let the enumerator post another message for the
+    // next one, so the dialog stays responsive while large folders are read
+    HRESULT hr = S_OK;
+    std::vector<CComPtr<IPowerRenameItem>> items;
+    do
+    {
+        items.clear();
+        hr = m_enumerator->GetItems(items, c_enumChunkSize, timeoutMs);
+        for (auto& item : items)
+        {
+            m_spsrm->AddItem(item);
+        }
+    } while (hr == S_OK && timeoutMs == INFINITE);
+
+    const bool done = (hr != S_OK);
+    if (done)
+    {
+        m_enumerator = nullptr;
+    }
+
+    // Update the preview each time the item count doubles rather than for every chunk
+    UINT itemCount = 0;
+    m_spsrm->GetItemCount(&itemCount);
+    if (itemCount > 0 && (done || itemCount >= 2 * m_newNamesItemCount))
+    {
+        m_newNamesItemCount = itemCount;
+        m_spsrm->UpdateNewNames();
+    }
+
+    UINT visibleItemCount = 0;
+    m_spsrm->GetVisibleItemCount(&visibleItemCount);
+    m_listview.SetItemCount(visibleItemCount);
+
+    _UpdateCounts();
+}
+
 HRESULT CPowerRenameUI::_ReadSettings()
 {
     // Check if we should read flags from settings
@@ -589,6 +669,10 @@ INT_PTR CPowerRenameUI::_DlgProc(UINT uMsg, WPARAM wParam, LPARAM lParam)
         _OnDestroyDlg();
         break;
 
+    case WM_POWERRENAME_ITEMSREADY:
+        _AddEnumeratedItems(0);
+        break;
+
     default:
         bRet = FALSE;
     }
@@ -650,9 +734,30 @@ void CPowerRenameUI::_OnInitDlg()
     // Update UI elements that depend on number of items selected or to be renamed
     _UpdateCounts();
 
+    _RecoverInterruptedRenames();
+
     m_initialized = true;
 }
 
+void CPowerRenameUI::_RecoverInterruptedRenames()
+{
+    // Operations of PowerRename instances that crashed.  The user finishes them or
+    // gives the renamed items their original name, or is asked again next time.
+    for (const auto& rename : CPowerRenameManager::s_GetInterruptedRenames())
+    {
+        wchar_t messageFormat[300] = { 0 };
+        LoadString(g_hInst, IDS_INTERRUPTEDRENAMEFMT, messageFormat, ARRAYSIZE(messageFormat));
+
+        wchar_t message[400] = { 0 };
+        StringCchPrintf(message, ARRAYSIZE(message), messageFormat, static_cast<UINT>(rename.itemCount), static_cast<UINT>(rename.renamedCount));
+        const int choice = MessageBox(m_hwnd, message, GET_RESOURCE_STRING(IDS_APP_TITLE).c_str(), MB_YESNOCANCEL | MB_ICONWARNING);
+        if (choice == IDYES || choice == IDNO)
+        {
+            CPowerRenameManager::s_RecoverInterruptedRename(rename, choice == IDNO, m_hwnd);
+        }
+    }
+}
+
 void UpdateDlgControl(HWND dlg, int item_id, int string_id)
 {
     HWND control = GetDlgItem(dlg, item_id);
@@ -785,6 +890,15 @@ BOOL CPowerRenameUI::_OnNotify(_In_ WPARAM wParam, _In_ LPARAM lParam)
             }
             break;
 
+        case LVN_ODCACHEHINT:
+            if (m_spsrm)
+            {
+                // Let the manager know which items to preview first
+                NMLVCACHEHINT* cacheHint = (NMLVCACHEHINT*)lParam;
+                m_spsrm->PutViewport(cacheHint->iFrom, cacheHint->iTo);
+            }
+            break;
+
         case NM_CLICK:
         {
             if (m_spsrm)
@@ -1017,10 +1131,10 @@ void CPowerRenameUI::_UpdateCounts()
         StringCchPrintf(countsLabelRenaming, ARRAYSIZE(countsLabelRenaming), countsLabelFormatRenaming, renamingCount);
         SetDlgItemText(m_hwnd, IDC_STATUS_MESSAGE_SELECTED, countsLabelSelected);
         SetDlgItemText(m_hwnd, IDC_STATUS_MESSAGE_RENAMING, countsLabelRenaming);
-
-        // Update Rename button state
-        EnableWindow(GetDlgItem(m_hwnd, ID_RENAME), (renamingCount > 0));
     }
+
+    // Update Rename button state, items can't be renamed until they are all enumerated
+    EnableWindow(GetDlgItem(m_hwnd, ID_RENAME), (renamingCount > 0 && !m_enumerator));
 }
 
 void CPowerRenameUI::_CollectItemPosition(_In_ DWORD id)
@@ -1110,9 +1224,10 @@ void CPowerRenameListView::ToggleAll(_In_ IPowerRenameManager* psrm, _In_ bool s
         for (UINT i = 0; i < itemCount; i++)
         {
             CComPtr<IPowerRenameItem> spItem;
-            if (SUCCEEDED(psrm->GetItemByIndex(i, &spItem)))
+            int id = 0;
+            if (SUCCEEDED(psrm->GetItemByIndex(i, &spItem)) && SUCCEEDED(spItem->GetId(&id)))
             {
-                spItem->PutSelected(selected);
+                psrm->PutItemSelected(id, selected);
             }
         }
 
@@ -1128,8 +1243,10 @@ void CPowerRenameListView::ToggleItem(_In_ IPowerRenameManager* psrm, _In_ int i
     if (SUCCEEDED(psrm->GetVisibleItemByIndex(item, &spItem)))
     {
         bool selected = false;
+        int id = 0;
         spItem->GetSelected(&selected);
-        spItem->PutSelected(!selected);
+        spItem->GetId(&id);
+        psrm->PutItemSelected(id, !selected);
 
         UINT visibleItemCount = 0;
         psrm->GetVisibleItemCount(&visibleItemCount);
@@ -1175,7 +1292,9 @@ void CPowerRenameListView::UpdateItemCheckState(_In_ IPowerRenameManager* psrm,
         if (SUCCEEDED(psrm->GetVisibleItemByIndex(iItem, &spItem)))
         {
             bool checked = ListView_GetCheckState(m_hwndLV, iItem);
-            spItem->PutSelected(checked);
+            int id = 0;
+            spItem->GetId(&id);
+            psrm->PutItemSelected(id, checked);
 
             UINT uSelected = (checked) ? LVIS_SELECTED : 0;
             ListView_SetItemState(m_hwndLV, iItem, uSelected, LVIS_SELECTED);
@@ -1286,6 +1405,21 @@ void CPowerRenameListView::RedrawItems(_In_ int first, _In_ int last)
     ListView_RedrawItems(m_hwndLV, first, last);
 }
 
+// Redraws the items in [first, last] currently scrolled into view
+void CPowerRenameListView::RedrawVisibleItems(_In_ int first, _In_ int last)
+{
+    int topIndex = ListView_GetTopIndex(m_hwndLV);
+    // Include the partially visible item at the bottom
+    int bottomIndex = topIndex + ListView_GetCountPerPage(m_hwndLV);
+
+    first = max(first, topIndex);
+    last = min(last, bottomIndex);
+    if (first <= last)
+    {
+        ListView_RedrawItems(m_hwndLV, first, last);
+    }
+}
+
 void CPowerRenameListView::SetItemCount(_In_ UINT itemCount)
 {
     if (m_itemCount != itemCount)
@@ -1,5 +1,6 @@
 #pragma once
 #include <PowerRenameInterfaces.h>
+#include <PowerRenameEnum.h>
 #include <settings.h>
 #include <shldisp.h>
 
@@ -17,6 +18,7 @@ public:
     void ToggleItem(_In_ IPowerRenameManager* psrm, _In_ int item);
     void UpdateItemCheckState(_In_ IPowerRenameManager* psrm, _In_ int iItem);
     void RedrawItems(_In_ int first, _In_ int last);
+    void RedrawVisibleItems(_In_ int first, _In_ int last);
     void SetItemCount(_In_ UINT itemCount);
     void OnKeyDown(_In_ IPowerRenameManager* psrm, _In_ LV_KEYDOWN* lvKeyDown);
     void OnClickList(_In_ IPowerRenameManager* psrm, NM_LISTVIEW* pnmListView);
@@ -59,7 +61,7 @@ public:
 
     // IPowerRenameManagerEvents
     IFACEMETHODIMP OnItemAdded(_In_ IPowerRenameItem* renameItem);
-    IFACEMETHODIMP OnUpdate(_In_ IPowerRenameItem* renameItem);
+    IFACEMETHODIMP OnItemsUpdated(_In_ UINT firstIndex, _In_ UINT lastIndex);
     IFACEMETHODIMP OnError(_In_ IPowerRenameItem* renameItem);
     IFACEMETHODIMP OnRegExStarted(_In_ DWORD threadId);
     IFACEMETHODIMP OnRegExCanceled(_In_ DWORD threadId);
@@ -126,6 +128,7 @@ private:
     void _OnSize(_In_ WPARAM wParam);
     void _OnGetMinMaxInfo(_In_ LPARAM lParam);
     void _OnInitDlg();
+    void _RecoverInterruptedRenames();
     void _InitDlgText();
     void _OnRename();
     void _OnAbout();
@@ -142,6 +145,7 @@ private:
     void _ValidateFlagCheckbox(_In_ DWORD checkBoxId);
 
     void _EnumerateItems(_In_ IUnknown* pdtobj);
+    void _AddEnumeratedItems(_In_ DWORD timeoutMs);
     void _UpdateCounts();
 
     void _CollectItemPosition(_In_ DWORD id);
@@ -158,6 +162,8 @@ private:
     DWORD m_currentRegExId = 0;
     UINT m_selectedCount = 0;
     UINT m_renamingCount = 0;
+    // Item count when the new names were last updated during enumeration
+    UINT m_newNamesItemCount = 0;
     UINT m_initialDPI = 0;
     DialogItemsPositioning m_itemsPositioning {};
     int m_initialWidth = 0;
@@ -166,6 +172,8 @@ private:
     int m_lastHeight = 0;
     CComPtr<IPowerRenameManager> m_spsrm;
     CComPtr<IUnknown> m_dataSource;
+    // Set while the items of a data source are being enumerated
+    std::unique_ptr<CPowerRenameEnum> m_enumerator;
     CComPtr<IDropTargetHelper> m_spdth;
     CComPtr<IAutoComplete2> m_spSearchAC;
     CComPtr<IUnknown> m_spSearchACL;
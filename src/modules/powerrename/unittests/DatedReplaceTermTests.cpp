@@ -0,0 +1,69 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include <DatedReplaceTerm.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace DatedReplaceTermTests
+{
+    // 2020-07-22 13:04:05.067, a Wednesday
+    const SYSTEMTIME c_time = { 2020, 7, 3, 22, 13, 4, 5, 67 };
+
+    TEST_CLASS(DatedReplaceTermTests)
+    {
+    public:
+        TEST_METHOD(NumbersArePadded)
+        {
+            CDatedReplaceTerm term(L"$YYYY-$MM-$DD $hh.$mm.$ss.$fff");
+            Assert::IsTrue(term.IsDated());
+            Assert::AreEqual(L"2020-07-22 13.04.05.067", term.Format(c_time).c_str());
+
+            CDatedReplaceTerm shortTerm(L"$YY $Y $M $D $h $m $s $ff $f");
+            Assert::AreEqual(L"20 0 7 22 13 4 5 06 0", shortTerm.Format(c_time).c_str());
+        }
+
+        TEST_METHOD(AdjacentTokens)
+        {
+            CDatedReplaceTerm term(L"$Y$Y$MM$DD");
+            Assert::AreEqual(L"000722", term.Format(c_time).c_str());
+        }
+
+        TEST_METHOD(EscapedTokensAreKept)
+        {
+            CDatedReplaceTerm escaped(L"$$YYYY $$1");
+            Assert::IsFalse(escaped.IsDated());
+            Assert::AreEqual(L"$$YYYY $$1", escaped.Format(c_time).c_str());
+
+            CDatedReplaceTerm term(L"$1_$$$YYYY_$");
+            Assert::IsTrue(term.IsDated());
+            Assert::AreEqual(L"$1_$$2020_$", term.Format(c_time).c_str());
+        }
+
+        TEST_METHOD(NotDated)
+        {
+            Assert::IsFalse(CDatedReplaceTerm(L"bar").IsDated());
+            Assert::IsFalse(CDatedReplaceTerm(L"$1 $X").IsDated());
+            Assert::IsFalse(CDatedReplaceTerm(L"").IsDated());
+        }
+
+        TEST_METHOD(NamesFollowUserLocale)
+        {
+            wchar_t localeName[LOCALE_NAME_MAX_LENGTH];
+            if (GetUserDefaultLocaleName(localeName, LOCALE_NAME_MAX_LENGTH) == 0)
+            {
+                StringCchCopy(localeName, LOCALE_NAME_MAX_LENGTH, L"en_US");
+            }
+
+            wchar_t expected[MAX_PATH] = { 0 };
+            GetDateFormatEx(localeName, 0, &c_time, L"dddd MMMM", expected, ARRAYSIZE(expected), nullptr);
+            CDatedReplaceTerm term(L"$DDDD $MMMM");
+            // The names start with a capital letter, compare ignoring case
+            Assert::AreEqual(0, _wcsicmp(expected, term.Format(c_time).c_str()));
+
+            // wDayOfWeek isn't used, the day is computed from the date
+            SYSTEMTIME time = c_time;
+            time.wDayOfWeek = 0;
+            Assert::AreEqual(0, _wcsicmp(expected, term.Format(time).c_str()));
+        }
+    };
+}
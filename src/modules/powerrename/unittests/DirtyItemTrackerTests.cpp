@@ -0,0 +1,107 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include <DirtyItemTracker.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace DirtyItemTrackerTests
+{
+    // Marks distinct items until the tracker asks for a flush, returns the number of marks it took
+    UINT MarkUntilFlushRequested(CDirtyItemTracker& tracker, UINT firstIndex)
+    {
+        for (UINT i = 0; i < CDirtyItemTracker::c_flushItemThreshold; i++)
+        {
+            if (tracker.MarkDirty(firstIndex + i))
+            {
+                return i + 1;
+            }
+        }
+        return 0;
+    }
+
+    TEST_CLASS(DirtyItemTrackerTests)
+    {
+    public:
+        TEST_METHOD(FlushWithoutDirtyItems)
+        {
+            CDirtyItemTracker tracker;
+            tracker.Reset(100);
+
+            UINT first = 0, last = 0;
+            Assert::IsFalse(tracker.Flush(&first, &last));
+        }
+
+        TEST_METHOD(RepeatedMarksAreCoalesced)
+        {
+            CDirtyItemTracker tracker;
+            tracker.Reset(100);
+
+            tracker.MarkDirty(42);
+            for (int i = 0; i < 10; i++)
+            {
+                // Already dirty, never asks for another flush
+                Assert::IsFalse(tracker.MarkDirty(42));
+            }
+
+            UINT first = 0, last = 0;
+            Assert::IsTrue(tracker.Flush(&first, &last));
+            Assert::AreEqual(42u, first);
+            Assert::AreEqual(42u, last);
+            Assert::IsFalse(tracker.Flush(&first, &last));
+        }
+
+        TEST_METHOD(FlushReturnsDirtyItemsOnce)
+        {
+            CDirtyItemTracker tracker;
+            tracker.Reset(300);
+
+            tracker.MarkDirty(3);
+            tracker.MarkDirty(70);
+            tracker.MarkDirty(255);
+
+            UINT first = 0, last = 0;
+            Assert::IsTrue(tracker.Flush(&first, &last));
+            Assert::AreEqual(3u, first);
+            Assert::AreEqual(255u, last);
+
+            // Drained, nothing is returned a second time
+            Assert::IsFalse(tracker.Flush(&first, &last));
+
+            tracker.MarkDirty(70);
+            Assert::IsTrue(tracker.Flush(&first, &last));
+            Assert::AreEqual(70u, first);
+            Assert::AreEqual(70u, last);
+        }
+
+        TEST_METHOD(OutOfRangeIndexIsIgnored)
+        {
+            CDirtyItemTracker tracker;
+            tracker.Reset(10);
+
+            Assert::IsFalse(tracker.MarkDirty(64));
+
+            UINT first = 0, last = 0;
+            Assert::IsFalse(tracker.Flush(&first, &last));
+        }
+
+        TEST_METHOD(MarkAfterFlushRearmsNotification)
+        {
+            const UINT itemCount = 4 * CDirtyItemTracker::c_flushItemThreshold;
+            CDirtyItemTracker tracker;
+            tracker.Reset(itemCount);
+
+            // The threshold requests a flush even if the interval hasn't elapsed
+            Assert::AreNotEqual(0u, MarkUntilFlushRequested(tracker, 0));
+
+            // A flush is already pending, further marks don't request another one
+            Assert::AreEqual(0u, MarkUntilFlushRequested(tracker, CDirtyItemTracker::c_flushItemThreshold));
+
+            UINT first = 0, last = 0;
+            Assert::IsTrue(tracker.Flush(&first, &last));
+            Assert::AreEqual(0u, first);
+
+            // The flush re-arms the request
+            Assert::AreNotEqual(0u, MarkUntilFlushRequested(tracker, 2 * CDirtyItemTracker::c_flushItemThreshold));
+        }
+    };
+}
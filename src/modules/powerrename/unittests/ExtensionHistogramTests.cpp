@@ -0,0 +1,93 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include <ExtensionHistogram.h>
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <random>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace ExtensionHistogramTests
+{
+    TEST_CLASS(ExtensionHistogramTests)
+    {
+    public:
+        TEST_METHOD(ExtensionsLikeFilesystemPath)
+        {
+            PCWSTR names[] = { L"foo.txt", L"foo.tar.gz", L"foo", L".bashrc", L"..bashrc", L".", L"..", L"foo.", L"foo bar.TXT" };
+            for (PCWSTR name : names)
+            {
+                CExtensionHistogram histogram;
+                histogram.Add(name);
+                std::vector<CExtensionHistogram::Entry> top = histogram.GetTop();
+                Assert::AreEqual(static_cast<size_t>(1), top.size());
+                Assert::AreEqual(std::filesystem::path(name).extension().wstring().c_str(), top[0].extension);
+                Assert::AreEqual(1u, top[0].count);
+            }
+        }
+
+        TEST_METHOD(TopList)
+        {
+            CExtensionHistogram histogram;
+            histogram.Add(L"a.jpg");
+            histogram.Add(L"b.txt");
+            histogram.Add(L"c.jpg");
+            histogram.Add(L"d");
+            histogram.Add(L"e.jpg");
+            histogram.Add(L"f.txt");
+            Assert::AreEqual(std::wstring(L".jpg:3,.txt:2,:1,"), histogram.GetTopList());
+            Assert::AreEqual(6u, histogram.GetNameCount());
+
+            histogram.Clear();
+            Assert::AreEqual(std::wstring(), histogram.GetTopList());
+            Assert::AreEqual(0u, histogram.GetNameCount());
+        }
+
+        TEST_METHOD(TopMatchesFullCount)
+        {
+            // Skewed so the most used extensions change as the names are added
+            std::mt19937 random(7);
+            std::map<std::wstring, UINT> counts;
+            CExtensionHistogram histogram;
+            for (UINT i = 0; i < 20000; i++)
+            {
+                const UINT extension = (random() % 200) * (random() % 200) / 200;
+                const std::wstring name = L"name" + std::to_wstring(i) + L".e" + std::to_wstring(extension);
+                histogram.Add(name.c_str());
+                counts[L".e" + std::to_wstring(extension)]++;
+            }
+
+            std::vector<UINT> expected;
+            for (const auto& count : counts)
+            {
+                expected.push_back(count.second);
+            }
+            std::sort(expected.begin(), expected.end(), std::greater<UINT>());
+
+            std::vector<CExtensionHistogram::Entry> top = histogram.GetTop();
+            Assert::AreEqual(static_cast<size_t>(CExtensionHistogram::c_topCount), top.size());
+            for (UINT i = 0; i < top.size(); i++)
+            {
+                Assert::AreEqual(expected[i], top[i].count);
+                Assert::AreEqual(counts[top[i].extension], top[i].count);
+            }
+        }
+
+        TEST_METHOD(ExtensionsAboveLimitAreOthers)
+        {
+            CExtensionHistogram histogram;
+            for (UINT i = 0; i < CExtensionHistogram::c_maxExtensions + 10; i++)
+            {
+                const std::wstring name = L"name.e" + std::to_wstring(i);
+                histogram.Add(name.c_str());
+            }
+            histogram.Add(L"name.e0");
+
+            Assert::AreEqual(10u, histogram.GetOtherCount());
+            Assert::AreEqual(CExtensionHistogram::c_maxExtensions + 11, histogram.GetNameCount());
+            Assert::AreEqual(L".e0", histogram.GetTop()[0].extension);
+            Assert::AreEqual(2u, histogram.GetTop()[0].count);
+        }
+    };
+}
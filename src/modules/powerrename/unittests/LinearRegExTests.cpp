@@ -0,0 +1,257 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "powerrename/lib/Settings.h"
+#include <LinearRegEx.h>
+#include <PowerRenameInterfaces.h>
+#include <PowerRenameRegEx.h>
+#include <regex>
+#include <chrono>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace LinearRegExTests
+{
+    // Replaces with the linear engine and checks the result is the one of std::wregex
+    void VerifySameAsStd(PCWSTR pattern, PCWSTR replaceTerm, PCWSTR source, bool caseInsensitive, bool allOccurrences)
+    {
+        CLinearRegEx linear;
+        Assert::IsTrue(linear.Compile(pattern, caseInsensitive), pattern);
+        CLinearRegEx::Replacement replacement;
+        Assert::IsTrue(linear.PrepareReplacement(replaceTerm, replacement), replaceTerm);
+
+        std::wregex::flag_type syntax = std::regex_constants::ECMAScript;
+        if (caseInsensitive)
+        {
+            syntax |= std::regex_constants::icase;
+        }
+        const std::wregex stdPattern(pattern, syntax);
+        const std::wstring expected = std::regex_replace(std::wstring(source), stdPattern, replaceTerm, allOccurrences ? std::regex_constants::format_default : std::regex_constants::format_first_only);
+
+        Assert::AreEqual(expected, linear.Replace(source, replacement, allOccurrences), pattern);
+    }
+
+    TEST_CLASS(LinearRegExTests)
+    {
+    public:
+        TEST_METHOD(ReplaceMatchesStd)
+        {
+            static const PCWSTR patterns[] = {
+                L"Foo",
+                L"B",
+                L".*",
+                L".+",
+                L".*?",
+                L"(foo)(bar)",
+                L"^foo",
+                L"bar$",
+                L"^$",
+                L"a|b|",
+                L"(a|ab)(c|bcd)(d*)",
+                L"\\d+",
+                L"[a-c]+x?",
+                L"[^.]+",
+                L"\\bfoo\\b",
+                L"\\Bo",
+                L"(\\w+)\\.(\\w+)",
+                L"a{2,3}",
+                L"a{2,}?",
+                L"(?:ab)+",
+                L"x*",
+                L"(a+)+b",
+                L"(a)?b",
+                L"a??b",
+            };
+            static const PCWSTR sources[] = { L"", L"foo", L"FooBar", L"foobar.txt", L"aaab", L"ABBBA", L"abcd", L"abbcdd", L"x foo y", L"IMG_1234.jpg", L"a.b.c" };
+            static const PCWSTR replaceTerms[] = { L"", L"X", L"[$$]", L"$$", L"a$$$$b" };
+
+            for (PCWSTR pattern : patterns)
+            {
+                for (PCWSTR source : sources)
+                {
+                    for (PCWSTR replaceTerm : replaceTerms)
+                    {
+                        VerifySameAsStd(pattern, replaceTerm, source, false, false);
+                        VerifySameAsStd(pattern, replaceTerm, source, false, true);
+                        VerifySameAsStd(pattern, replaceTerm, source, true, true);
+                    }
+                }
+            }
+        }
+
+        TEST_METHOD(ReplaceGroups)
+        {
+            VerifySameAsStd(L"(foo)(bar)", L"$2_$1", L"foobar", false, false);
+            VerifySameAsStd(L"(\\w+)\\.(\\w+)", L"$2.$1", L"IMG_1234.jpg", false, true);
+            VerifySameAsStd(L"(a|ab)(c|bcd)(d*)", L"$3$2$1", L"abcd", false, true);
+            VerifySameAsStd(L"(x)?(b)", L"<$1|$2>", L"abab", false, true);
+            VerifySameAsStd(L"(?:(a)b)+", L"$1", L"ababab", false, true);
+        }
+
+        TEST_METHOD(UnsupportedPatterns)
+        {
+            static const PCWSTR patterns[] = {
+                L"(?<=E12).*",
+                L"(?<!E12).*",
+                L"(?=a)",
+                L"(a)\\1",
+                L"(?<name>a)",
+                L"(?:(a)|b)*",
+                L"(a*)*",
+                L"a{1000}",
+                L"a**",
+                L"[[:alpha:]]",
+                L"(foo",
+                L"\\",
+            };
+
+            for (PCWSTR pattern : patterns)
+            {
+                CLinearRegEx linear;
+                Assert::IsFalse(linear.Compile(pattern, false), pattern);
+                Assert::IsFalse(linear.IsCompiled(), pattern);
+            }
+        }
+
+        TEST_METHOD(UnsupportedReplaceTerms)
+        {
+            CLinearRegEx linear;
+            Assert::IsTrue(linear.Compile(L"(foo)(bar)", false));
+            CLinearRegEx::Replacement replacement;
+            Assert::IsTrue(linear.PrepareReplacement(L"$$$1_$2_$$0", replacement));
+            Assert::IsFalse(linear.PrepareReplacement(L"$0", replacement));
+            Assert::IsFalse(linear.PrepareReplacement(L"[$0]", replacement));
+            Assert::IsFalse(linear.PrepareReplacement(L"$12", replacement));
+            Assert::IsFalse(linear.PrepareReplacement(L"$3", replacement));
+            Assert::IsFalse(linear.PrepareReplacement(L"${1}", replacement));
+            Assert::IsFalse(linear.PrepareReplacement(L"$&", replacement));
+        }
+
+        TEST_METHOD(SearchCaptures)
+        {
+            CLinearRegEx linear;
+            Assert::IsTrue(linear.Compile(L"(\\d+)-(x)?(\\d+)", false));
+            Assert::AreEqual(3u, linear.GroupCount());
+
+            const std::wstring source = L"IMG 12-345";
+            CLinearRegEx::Match match;
+            Assert::IsTrue(linear.Search(source.c_str(), source.length(), 0, false, false, match));
+            Assert::AreEqual(size_t(4), match.start);
+            Assert::AreEqual(size_t(10), match.end);
+            Assert::AreEqual(size_t(4), match.groups[2]);
+            Assert::AreEqual(size_t(6), match.groups[3]);
+            Assert::AreEqual(std::wstring::npos, match.groups[4]);
+            Assert::AreEqual(size_t(7), match.groups[6]);
+
+            Assert::IsFalse(linear.Search(source.c_str(), source.length(), 7, false, true, match));
+        }
+
+        TEST_METHOD(LinearTimeOnPathologicalInput)
+        {
+            // Backtracking engines take exponential time on this one
+            CLinearRegEx linear;
+            Assert::IsTrue(linear.Compile(L"(a+)+b", false));
+            CLinearRegEx::Replacement replacement;
+            Assert::IsTrue(linear.PrepareReplacement(L"X", replacement));
+
+            const std::wstring source(10000, L'a');
+            const auto start = std::chrono::steady_clock::now();
+            Assert::AreEqual(source, linear.Replace(source, replacement, true));
+            Assert::IsTrue(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+        }
+    };
+
+    // Renames with the linear engine on and off and checks the results are the same
+    // for the replace terms of the users, rewritten by CPowerRenameRegEx
+    void VerifyEnginesAgree(bool useBoostLib, DWORD flags, PCWSTR pattern, PCWSTR replaceTerm, const std::vector<PCWSTR>& sources)
+    {
+        CComPtr<IPowerRenameRegEx> renameRegEx[2];
+        for (int i = 0; i < ARRAYSIZE(renameRegEx); i++)
+        {
+            CSettingsInstance().SetUseLinearRegEx(i == 0);
+            Assert::IsTrue(CPowerRenameRegEx::s_CreateInstance(&renameRegEx[i]) == S_OK);
+            Assert::IsTrue(renameRegEx[i]->PutFlags(flags) == S_OK);
+            Assert::IsTrue(renameRegEx[i]->PutSearchTerm(pattern) == S_OK);
+            Assert::IsTrue(renameRegEx[i]->PutReplaceTerm(replaceTerm) == S_OK);
+        }
+
+        for (PCWSTR source : sources)
+        {
+            PWSTR linearResult = nullptr;
+            PWSTR backtrackingResult = nullptr;
+            Assert::AreEqual(renameRegEx[1]->Replace(source, &backtrackingResult), renameRegEx[0]->Replace(source, &linearResult), pattern);
+            std::wstring message = std::wstring(useBoostLib ? L"boost " : L"std ") + pattern + L" " + replaceTerm + L" " + source;
+            Assert::AreEqual(std::wstring(backtrackingResult ? backtrackingResult : L""), std::wstring(linearResult ? linearResult : L""), message.c_str());
+            CoTaskMemFree(linearResult);
+            CoTaskMemFree(backtrackingResult);
+        }
+    }
+
+    TEST_CLASS(LinearRegExEngineTests)
+    {
+    public:
+        TEST_METHOD_CLEANUP(MethodCleanup)
+        {
+            CSettingsInstance().SetUseBoostLib(false);
+            CSettingsInstance().SetUseLinearRegEx(true);
+        }
+
+        TEST_METHOD(RenameMatchesBacktrackingEngines)
+        {
+            static const PCWSTR patterns[] = {
+                L"Foo",
+                L".*",
+                L".*?",
+                L"(foo)(bar)",
+                L"^foo",
+                L"bar$",
+                L"a|b|",
+                L"(a|ab)(c|bcd)(d*)",
+                L"(\\w+)\\.(\\w+)",
+                L"(\\d+)",
+                L"(a)?b",
+                L"x*",
+            };
+            static const PCWSTR replaceTerms[] = {
+                L"",
+                L"X",
+                L"$0",
+                L"[$0]",
+                L"$1",
+                L"$2_$1",
+                L"$1$1",
+                L"$$",
+                L"$$1",
+                L"$$$1",
+                L"$$$0",
+                L"$12",
+                L"$&",
+                L"${1}",
+                L"100$",
+                L"a\\nb",
+                L"a\\$1",
+            };
+            const std::vector<PCWSTR> sources = { L"foo", L"FooBar", L"foobar.txt", L"aaab", L"abcd", L"x foo y", L"IMG_1234.jpg", L"a.b.c" };
+            static const DWORD flagSets[] = {
+                UseRegularExpressions,
+                UseRegularExpressions | MatchAllOccurences,
+                UseRegularExpressions | MatchAllOccurences | CaseSensitive,
+            };
+
+            for (bool useBoostLib : { false, true })
+            {
+                CSettingsInstance().SetUseBoostLib(useBoostLib);
+                for (DWORD flags : flagSets)
+                {
+                    for (PCWSTR pattern : patterns)
+                    {
+                        for (PCWSTR replaceTerm : replaceTerms)
+                        {
+                            VerifyEnginesAgree(useBoostLib, flags, pattern, replaceTerm, sources);
+                        }
+                    }
+                }
+            }
+        }
+    };
+}
@@ -0,0 +1,101 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include <LiteralMatcher.h>
+#include <algorithm>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace LiteralMatcherTests
+{
+    // Reference search the matcher must agree with
+    size_t FindByCopy(std::wstring data, std::wstring toSearch, bool caseInsensitive, size_t pos)
+    {
+        if (caseInsensitive)
+        {
+            std::transform(data.begin(), data.end(), data.begin(), ::towlower);
+            std::transform(toSearch.begin(), toSearch.end(), toSearch.begin(), ::towlower);
+        }
+        return data.find(toSearch, pos);
+    }
+
+    TEST_CLASS(LiteralMatcherTests)
+    {
+    public:
+        TEST_METHOD(FindCaseInsensitive)
+        {
+            CLiteralMatcher matcher(L"FoO", true);
+            std::wstring data = L"xxfooXXFOOxx";
+            Assert::AreEqual(static_cast<size_t>(2), matcher.Find(data.c_str(), data.length(), 0));
+            Assert::AreEqual(static_cast<size_t>(7), matcher.Find(data.c_str(), data.length(), 3));
+            Assert::AreEqual(std::wstring::npos, matcher.Find(data.c_str(), data.length(), 8));
+        }
+
+        TEST_METHOD(FindCaseSensitive)
+        {
+            CLiteralMatcher matcher(L"FOO", false);
+            std::wstring data = L"xxfooXXFOOxx";
+            Assert::AreEqual(static_cast<size_t>(7), matcher.Find(data.c_str(), data.length(), 0));
+            Assert::IsFalse(matcher.Contains(L"foo", 3));
+        }
+
+        TEST_METHOD(FindAcrossSimdBlocks)
+        {
+            // Long enough for both the first unit scan and the compare to use whole blocks
+            std::wstring data(100, L'a');
+            data.replace(61, 20, L"ABCDEFGHIJKLMNOPQRST");
+            CLiteralMatcher matcher(L"abcdefghijklmnopqrst", true);
+            Assert::AreEqual(static_cast<size_t>(61), matcher.Find(data.c_str(), data.length(), 0));
+            Assert::AreEqual(std::wstring::npos, matcher.Find(data.c_str(), data.length() - 20, 0));
+        }
+
+        TEST_METHOD(FindAtEnd)
+        {
+            CLiteralMatcher matcher(L".JPG", true);
+            std::wstring data = L"IMG_20200101_123456.jpg";
+            Assert::AreEqual(data.length() - 4, matcher.Find(data.c_str(), data.length(), 0));
+        }
+
+        TEST_METHOD(FindNonAscii)
+        {
+            CLiteralMatcher matcher(L"\u00c9T\u00c9", true);
+            std::wstring data = L"Photos d'\u00e9t\u00e9 2020 - \u00c9t\u00e9 indien.jpg";
+            Assert::AreEqual(static_cast<size_t>(9), matcher.Find(data.c_str(), data.length(), 0));
+            Assert::AreEqual(static_cast<size_t>(20), matcher.Find(data.c_str(), data.length(), 10));
+        }
+
+        TEST_METHOD(FindEmptySearchTerm)
+        {
+            CLiteralMatcher matcher(L"", true);
+            Assert::AreEqual(static_cast<size_t>(0), matcher.Find(L"foo", 3, 0));
+            Assert::AreEqual(std::wstring::npos, matcher.Find(L"foo", 3, 4));
+        }
+
+        TEST_METHOD(FindMatchesReferenceSearch)
+        {
+            const PCWSTR names[] = {
+                L"IMG_20200514_123456.JPG",
+                L"Quarterly Report (final) v2 - quarterly REPORT.docx",
+                L"\u212aelvin kelvin KELVIN.txt",
+                L"R\u00e9sum\u00e9 - r\u00c9SUM\u00c9 - resume.pdf",
+                L"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab",
+            };
+            const PCWSTR searchTerms[] = { L"img", L"JPG", L"report", L"kelvin", L"K", L"r\u00e9sum\u00e9", L"aab", L"aaaaaaaaaaaaaaaaab", L"." };
+
+            for (auto name : names)
+            {
+                const std::wstring data(name);
+                for (auto searchTerm : searchTerms)
+                {
+                    for (bool caseInsensitive : { true, false })
+                    {
+                        CLiteralMatcher matcher(searchTerm, caseInsensitive);
+                        for (size_t pos = 0; pos <= data.length(); pos++)
+                        {
+                            Assert::AreEqual(FindByCopy(data, searchTerm, caseInsensitive, pos), matcher.Find(data.c_str(), data.length(), pos));
+                        }
+                    }
+                }
+            }
+        }
+    };
+}
@@ -0,0 +1,130 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include <MRUStore.h>
+#include "TestFileHelper.h"
+#include <fstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace MRUStoreTests
+{
+    void VerifyItems(const CMRUStore& store, const std::vector<std::wstring>& expected)
+    {
+        const std::vector<std::wstring> items = store.GetItems();
+        Assert::AreEqual(expected.size(), items.size());
+        for (size_t i = 0; i < expected.size(); i++)
+        {
+            Assert::AreEqual(expected[i].c_str(), items[i].c_str());
+        }
+    }
+
+    TEST_CLASS(MRUStoreTests)
+    {
+    public:
+        TEST_METHOD(PushMovesExistingOnTop)
+        {
+            CTestFileHelper testFileHelper;
+            CMRUStore store(3, testFileHelper.GetFullPath(L"mru.log"));
+            store.Load({ L"a", L"b" });
+            VerifyItems(store, { L"b", L"a" });
+
+            Assert::IsTrue(store.Push(L"c"));
+            Assert::IsFalse(store.Push(L"c"));
+            Assert::IsTrue(store.Push(L"a"));
+            VerifyItems(store, { L"a", L"c", L"b" });
+
+            Assert::IsTrue(store.Push(L"d"));
+            VerifyItems(store, { L"d", L"a", L"c" });
+
+            store.Resize(2);
+            VerifyItems(store, { L"d", L"a" });
+        }
+
+        TEST_METHOD(LoadReplaysLog)
+        {
+            CTestFileHelper testFileHelper;
+            const std::filesystem::path logPath = testFileHelper.GetFullPath(L"mru.log");
+            {
+                CMRUStore store(4, logPath);
+                store.Load({ L"a" });
+                store.Push(L"b");
+                store.Push(L"a");
+                store.Push(L"\x00E9t\x00E9");
+            }
+
+            CMRUStore store(4, logPath);
+            store.Load({ L"a" });
+            VerifyItems(store, { L"\x00E9t\x00E9", L"a", L"b" });
+
+            // Replaying over a snapshot that has the strings already gives the same list
+            store.Load({ L"b", L"a", L"\x00E9t\x00E9" });
+            VerifyItems(store, { L"\x00E9t\x00E9", L"a", L"b" });
+        }
+
+        TEST_METHOD(RefreshReadsOtherWriters)
+        {
+            CTestFileHelper testFileHelper;
+            const std::filesystem::path logPath = testFileHelper.GetFullPath(L"mru.log");
+            CMRUStore first(4, logPath);
+            CMRUStore second(4, logPath);
+            first.Load({ L"a" });
+            second.Load({ L"a" });
+
+            first.Push(L"b");
+            Assert::IsTrue(second.Refresh() == S_OK);
+            VerifyItems(second, { L"b", L"a" });
+
+            second.Push(L"c");
+            first.Push(L"d");
+            Assert::IsTrue(first.Refresh() == S_OK);
+            VerifyItems(first, { L"d", L"c", L"b", L"a" });
+
+            first.TruncateLog();
+            Assert::IsTrue(second.Refresh() == S_FALSE);
+            second.Load({ L"a", L"b", L"c", L"d" });
+            VerifyItems(second, { L"d", L"c", L"b", L"a" });
+        }
+
+        TEST_METHOD(TornRecordIsIgnored)
+        {
+            CTestFileHelper testFileHelper;
+            const std::filesystem::path logPath = testFileHelper.GetFullPath(L"mru.log");
+            {
+                CMRUStore store(4, logPath);
+                store.Load({});
+                store.Push(L"a");
+                store.Push(L"b");
+            }
+            {
+                // Length of a record whose string wasn't written
+                std::ofstream file(logPath, std::ios::binary | std::ios::app);
+                file.write("\x05\x00\x00\x00x", 5);
+            }
+
+            CMRUStore store(4, logPath);
+            store.Load({});
+            VerifyItems(store, { L"b", L"a" });
+            Assert::IsFalse(store.NeedsCompaction());
+        }
+
+        TEST_METHOD(NeedsCompactionOnceLogIsLong)
+        {
+            CTestFileHelper testFileHelper;
+            const std::filesystem::path logPath = testFileHelper.GetFullPath(L"mru.log");
+            CMRUStore store(2, logPath);
+            store.Load({});
+            for (int i = 0; i < 7; i++)
+            {
+                store.Push(std::to_wstring(i));
+            }
+            Assert::IsFalse(store.NeedsCompaction());
+            store.Push(L"7");
+            Assert::IsTrue(store.NeedsCompaction());
+
+            store.TruncateLog();
+            Assert::IsFalse(std::filesystem::exists(logPath));
+            Assert::IsFalse(store.NeedsCompaction());
+            VerifyItems(store, { L"7", L"6" });
+        }
+    };
+}
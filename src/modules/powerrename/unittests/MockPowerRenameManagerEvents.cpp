@@ -35,9 +35,12 @@ IFACEMETHODIMP CMockPowerRenameManagerEvents::OnItemAdded(_In_ IPowerRenameItem*
     return S_OK;
 }
 
-IFACEMETHODIMP CMockPowerRenameManagerEvents::OnUpdate(_In_ IPowerRenameItem* pItem)
+IFACEMETHODIMP CMockPowerRenameManagerEvents::OnItemsUpdated(_In_ UINT firstIndex, _In_ UINT lastIndex)
 {
-    m_itemUpdated = pItem;
+    m_itemsUpdated = true;
+    m_updatedFirstIndex = firstIndex;
+    m_updatedLastIndex = lastIndex;
+    m_updatedRanges.emplace_back(firstIndex, lastIndex);
     return S_OK;
 }
 
@@ -1,5 +1,6 @@
 #pragma once
 #include <PowerRenameInterfaces.h>
+#include <vector>
 
 class CMockPowerRenameManagerEvents :
     public IPowerRenameManagerEvents
@@ -19,7 +20,7 @@ public:
 
     // IPowerRenameManagerEvents
     IFACEMETHODIMP OnItemAdded(_In_ IPowerRenameItem* renameItem);
-    IFACEMETHODIMP OnUpdate(_In_ IPowerRenameItem* renameItem);
+    IFACEMETHODIMP OnItemsUpdated(_In_ UINT firstIndex, _In_ UINT lastIndex);
     IFACEMETHODIMP OnError(_In_ IPowerRenameItem* renameItem);
     IFACEMETHODIMP OnRegExStarted(_In_ DWORD threadId);
     IFACEMETHODIMP OnRegExCanceled(_In_ DWORD threadId);
@@ -34,7 +35,10 @@ public:
     }
 
     CComPtr<IPowerRenameItem> m_itemAdded;
-    CComPtr<IPowerRenameItem> m_itemUpdated;
+    bool m_itemsUpdated = false;
+    UINT m_updatedFirstIndex = 0;
+    UINT m_updatedLastIndex = 0;
+    std::vector<std::pair<UINT, UINT>> m_updatedRanges;
     CComPtr<IPowerRenameItem> m_itemError;
     bool m_regExStarted = false;
     bool m_regExCanceled = false;
@@ -0,0 +1,123 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "powerrename/lib/Settings.h"
+#include <PowerRenameEngine.h>
+#include <PowerRenameRegEx.h>
+#include "TestFileHelper.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace PowerRenameEngineTests
+{
+    CComPtr<IPowerRenameRegEx> CreateRegEx(PCWSTR searchTerm, PCWSTR replaceTerm, DWORD flags)
+    {
+        CComPtr<IPowerRenameRegEx> renameRegEx;
+        Assert::IsTrue(CPowerRenameRegEx::s_CreateInstance(&renameRegEx) == S_OK);
+        Assert::IsTrue(renameRegEx->PutFlags(flags) == S_OK);
+        Assert::IsTrue(renameRegEx->PutSearchTerm(searchTerm) == S_OK);
+        Assert::IsTrue(renameRegEx->PutReplaceTerm(replaceTerm) == S_OK);
+        return renameRegEx;
+    }
+
+    PowerRenameEngineItem CreateItem(PCWSTR path, bool isFolder = false, bool isSubFolderContent = false)
+    {
+        PowerRenameEngineItem item;
+        item.path = path;
+        item.isFolder = isFolder;
+        item.isSubFolderContent = isSubFolderContent;
+        return item;
+    }
+
+    TEST_CLASS(PowerRenameEngineTests)
+    {
+    public:
+        TEST_CLASS_INITIALIZE(ClassInitialize)
+        {
+            CSettingsInstance().SetUseBoostLib(false);
+        }
+
+        TEST_METHOD(RenamePlainPaths)
+        {
+            auto renameRegEx = CreateRegEx(L"foo", L"bar", 0);
+            std::vector<PowerRenameEngineItem> items = { CreateItem(L"c:\\test\\foo.txt"), CreateItem(L"c:\\test\\baz.txt"), CreateItem(L"foo2.txt") };
+            std::vector<std::optional<std::wstring>> newNames;
+            Assert::IsTrue(GetRenamedFileNames(renameRegEx, items, newNames) == S_OK);
+            Assert::AreEqual(items.size(), newNames.size());
+            Assert::IsTrue(newNames[0] && *newNames[0] == L"bar.txt");
+            Assert::IsFalse(newNames[1].has_value());
+            Assert::IsTrue(newNames[2] && *newNames[2] == L"bar2.txt");
+        }
+
+        TEST_METHOD(RenameNameOnlyAndExtensionOnly)
+        {
+            std::optional<std::wstring> newName;
+            auto nameOnly = CreateRegEx(L"txt", L"doc", NameOnly);
+            Assert::IsTrue(GetRenamedFileName(nameOnly, L"txt.txt", NameOnly, nullptr, nullptr, nullptr, newName) == S_OK);
+            Assert::IsTrue(newName && *newName == L"doc.txt");
+
+            auto extensionOnly = CreateRegEx(L"txt", L"doc", ExtensionOnly);
+            Assert::IsTrue(GetRenamedFileName(extensionOnly, L"txt.txt", ExtensionOnly, nullptr, nullptr, nullptr, newName) == S_OK);
+            Assert::IsTrue(newName && *newName == L"txt.doc");
+        }
+
+        TEST_METHOD(RenameWithExclusions)
+        {
+            const DWORD flags = ExcludeFolders | ExcludeSubfolders;
+            auto renameRegEx = CreateRegEx(L"foo", L"bar", flags);
+            std::vector<PowerRenameEngineItem> items = { CreateItem(L"foo", true), CreateItem(L"foo.txt"), CreateItem(L"foo\\foo.txt", false, true) };
+            std::vector<std::optional<std::wstring>> newNames;
+            Assert::IsTrue(GetRenamedFileNames(renameRegEx, items, newNames) == S_OK);
+            Assert::IsFalse(newNames[0].has_value());
+            Assert::IsTrue(newNames[1] && *newNames[1] == L"bar.txt");
+            Assert::IsFalse(newNames[2].has_value());
+        }
+
+        TEST_METHOD(RenameWithEnumeration)
+        {
+            auto renameRegEx = CreateRegEx(L"foo", L"bar", EnumerateItems);
+            std::vector<PowerRenameEngineItem> items = { CreateItem(L"foo.txt"), CreateItem(L"baz.txt"), CreateItem(L"foo.doc") };
+            std::vector<std::optional<std::wstring>> newNames;
+            Assert::IsTrue(GetRenamedFileNames(renameRegEx, items, newNames) == S_OK);
+            Assert::IsTrue(newNames[0] && *newNames[0] == L"bar (1).txt");
+            Assert::IsFalse(newNames[1].has_value());
+            Assert::IsTrue(newNames[2] && *newNames[2] == L"bar (2).doc");
+        }
+
+        TEST_METHOD(RenameAgainWithEnumeration)
+        {
+            // The items numbered by a previous rename keep their numbers
+            CTestFileHelper testFileHelper;
+            Assert::IsTrue(testFileHelper.AddFile(L"photo (1).jpg"));
+            Assert::IsTrue(testFileHelper.AddFile(L"photo (2).jpg"));
+            Assert::IsTrue(testFileHelper.AddFile(L"other.jpg"));
+
+            auto renameRegEx = CreateRegEx(L".*", L"photo", UseRegularExpressions | EnumerateItems | NameOnly);
+            std::vector<PowerRenameEngineItem> items = { CreateItem(testFileHelper.GetFullPath(L"photo (1).jpg").c_str()),
+                                                         CreateItem(testFileHelper.GetFullPath(L"photo (2).jpg").c_str()),
+                                                         CreateItem(testFileHelper.GetFullPath(L"other.jpg").c_str()) };
+            std::vector<std::optional<std::wstring>> newNames;
+            Assert::IsTrue(GetRenamedFileNames(renameRegEx, items, newNames) == S_OK);
+            Assert::IsFalse(newNames[0].has_value());
+            Assert::IsFalse(newNames[1].has_value());
+            Assert::IsTrue(newNames[2] && *newNames[2] == L"photo (3).jpg");
+        }
+
+        TEST_METHOD(RenameWithFileTime)
+        {
+            auto renameRegEx = CreateRegEx(L"foo", L"$YYYY-$MM-$DD", 0);
+            PowerRenameEngineItem item = CreateItem(L"foo.txt");
+            std::vector<std::optional<std::wstring>> newNames;
+
+            // Dated replace terms need the time of each item
+            Assert::IsTrue(GetRenamedFileNames(renameRegEx, { item }, newNames) == E_INVALIDARG);
+
+            SYSTEMTIME time = { 0 };
+            time.wYear = 2020;
+            time.wMonth = 7;
+            time.wDay = 22;
+            item.time = time;
+            Assert::IsTrue(GetRenamedFileNames(renameRegEx, { item }, newNames) == S_OK);
+            Assert::IsTrue(newNames[0] && *newNames[0] == L"2020-07-22.txt");
+        }
+    };
+}
@@ -0,0 +1,90 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include <PowerRenameEnum.h>
+#include <PowerRenameItem.h>
+#include "TestFileHelper.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace PowerRenameEnumTests
+{
+    TEST_CLASS(PowerRenameEnumTests)
+    {
+    public:
+        TEST_METHOD(EnumerateInDepthFirstOrder)
+        {
+            CTestFileHelper testFileHelper;
+            Assert::IsTrue(testFileHelper.AddFolder(L"root"));
+            Assert::IsTrue(testFileHelper.AddFolder(L"root\\a"));
+            Assert::IsTrue(testFileHelper.AddFile(L"root\\a\\a1.txt"));
+            Assert::IsTrue(testFileHelper.AddFolder(L"root\\a\\b"));
+            Assert::IsTrue(testFileHelper.AddFile(L"root\\a\\b\\b1.txt"));
+            Assert::IsTrue(testFileHelper.AddFile(L"root\\c.txt"));
+
+            CComPtr<IShellItem> rootItem;
+            Assert::IsTrue(SHCreateItemFromParsingName(testFileHelper.GetFullPath(L"root").c_str(), nullptr, IID_PPV_ARGS(&rootItem)) == S_OK);
+            CComPtr<IShellItemArray> dataSource;
+            Assert::IsTrue(SHCreateShellItemArrayFromShellItem(rootItem, IID_PPV_ARGS(&dataSource)) == S_OK);
+            CComPtr<IPowerRenameItemFactory> itemFactory;
+            Assert::IsTrue(CPowerRenameItem::s_CreateInstance(nullptr, IID_PPV_ARGS(&itemFactory)) == S_OK);
+
+            // Use a small chunk size to get the items over several calls
+            CPowerRenameEnum enumerator;
+            Assert::IsTrue(enumerator.Start(dataSource, itemFactory, nullptr, 0) == S_OK);
+            std::vector<CComPtr<IPowerRenameItem>> items;
+            HRESULT hr = S_OK;
+            while (hr == S_OK)
+            {
+                hr = enumerator.GetItems(items, 2, INFINITE);
+            }
+            Assert::IsTrue(hr == S_FALSE);
+
+            // Each folder is followed by its contents, in the order the folder lists them
+            Assert::AreEqual(size_t(6), items.size());
+            const std::vector<std::pair<std::wstring, UINT>> expected = {
+                { L"root", 0 }, { L"a", 1 }, { L"a1.txt", 2 }, { L"b", 2 }, { L"b1.txt", 3 }, { L"c.txt", 1 }
+            };
+            int previousId = 0;
+            for (size_t i = 0; i < items.size(); i++)
+            {
+                PWSTR originalName = nullptr;
+                Assert::IsTrue(items[i]->GetOriginalName(&originalName) == S_OK);
+                Assert::AreEqual(expected[i].first.c_str(), originalName);
+                CoTaskMemFree(originalName);
+
+                UINT depth = 0;
+                Assert::IsTrue(items[i]->GetDepth(&depth) == S_OK);
+                Assert::AreEqual(expected[i].second, depth);
+
+                // Ids follow the enumeration order, the manager sorts the items by id
+                int id = 0;
+                Assert::IsTrue(items[i]->GetId(&id) == S_OK);
+                Assert::IsTrue(id > previousId);
+                previousId = id;
+            }
+        }
+
+        TEST_METHOD(CancelStopsEnumeration)
+        {
+            CTestFileHelper testFileHelper;
+            Assert::IsTrue(testFileHelper.AddFolder(L"root"));
+            for (int i = 0; i < 20; i++)
+            {
+                Assert::IsTrue(testFileHelper.AddFile(L"root\\file" + std::to_wstring(i) + L".txt"));
+            }
+
+            CComPtr<IShellItem> rootItem;
+            Assert::IsTrue(SHCreateItemFromParsingName(testFileHelper.GetFullPath(L"root").c_str(), nullptr, IID_PPV_ARGS(&rootItem)) == S_OK);
+            CComPtr<IShellItemArray> dataSource;
+            Assert::IsTrue(SHCreateShellItemArrayFromShellItem(rootItem, IID_PPV_ARGS(&dataSource)) == S_OK);
+            CComPtr<IPowerRenameItemFactory> itemFactory;
+            Assert::IsTrue(CPowerRenameItem::s_CreateInstance(nullptr, IID_PPV_ARGS(&itemFactory)) == S_OK);
+
+            CPowerRenameEnum enumerator;
+            Assert::IsTrue(enumerator.Start(dataSource, itemFactory, nullptr, 0) == S_OK);
+            enumerator.Cancel();
+            std::vector<CComPtr<IPowerRenameItem>> items;
+            Assert::IsTrue(enumerator.GetItems(items, 100, INFINITE) == E_ABORT);
+        }
+    };
+}
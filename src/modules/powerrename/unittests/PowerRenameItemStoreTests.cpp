@@ -0,0 +1,186 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include <PowerRenameItemStore.h>
+#include <PowerRenameInterfaces.h>
+#include <RenameJournal.h>
+#include "MockPowerRenameItem.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace PowerRenameItemStoreTests
+{
+    CComPtr<IPowerRenameItem> CreateItem(PCWSTR name, UINT depth = 0, bool isFolder = false)
+    {
+        CComPtr<IPowerRenameItem> item;
+        SYSTEMTIME time = { 0 };
+        Assert::IsTrue(CMockPowerRenameItem::CreateInstance(name, name, depth, isFolder, time, &item) == S_OK);
+        return item;
+    }
+
+    TEST_CLASS(PowerRenameItemStoreTests)
+    {
+    public:
+        TEST_METHOD(AddKeepsIdOrder)
+        {
+            // Ids are assigned on creation
+            auto first = CreateItem(L"first");
+            auto second = CreateItem(L"second", 1, true);
+            auto third = CreateItem(L"third");
+
+            CPowerRenameItemStore store;
+            UINT index = 0;
+            Assert::IsTrue(store.Add(second, &index) == S_OK);
+            Assert::AreEqual(0u, index);
+            Assert::IsTrue(store.Add(third, &index) == S_OK);
+            Assert::AreEqual(1u, index);
+
+            int firstId = 0;
+            first->GetId(&firstId);
+            Assert::IsFalse(store.IsAppend(firstId));
+            Assert::IsTrue(store.Add(first, &index) == S_OK);
+            Assert::AreEqual(0u, index);
+
+            Assert::AreEqual(3u, store.Count());
+            Assert::AreEqual(L"first", store.GetOriginalName(0));
+            Assert::AreEqual(L"second", store.GetOriginalName(1));
+            Assert::AreEqual(L"third", store.GetOriginalName(2));
+            Assert::IsTrue(store.IsFolder(1));
+            Assert::AreEqual(1u, store.GetDepth(1));
+            Assert::IsTrue(store.GetItem(2) == third.p);
+            Assert::IsTrue(store.Contains(firstId));
+            Assert::AreEqual(0u, store.FindIndex(firstId));
+        }
+
+        TEST_METHOD(ItemsSpanSeveralBlocks)
+        {
+            CPowerRenameItemStore store;
+            const UINT itemCount = CPowerRenameItemStore::c_blockSize * 2 + 10;
+            for (UINT i = 0; i < itemCount; i++)
+            {
+                UINT index = 0;
+                Assert::IsTrue(store.Add(CreateItem(std::to_wstring(i).c_str()), &index) == S_OK);
+                Assert::AreEqual(i, index);
+            }
+
+            // A snapshot isn't affected by the items added after it
+            CPowerRenameItemColumns snapshot = store.GetSnapshot();
+            UINT index = 0;
+            Assert::IsTrue(store.Add(CreateItem(L"last"), &index) == S_OK);
+            Assert::AreEqual(itemCount, snapshot.Count());
+            Assert::AreEqual(itemCount + 1, store.Count());
+            Assert::AreEqual(std::to_wstring(itemCount - 1).c_str(), snapshot.GetOriginalName(itemCount - 1));
+        }
+
+        TEST_METHOD(PutNewName)
+        {
+            CPowerRenameItemStore store;
+            UINT index = 0;
+            Assert::IsTrue(store.Add(CreateItem(L"foo.txt"), &index) == S_OK);
+            CNamePool& pool = store.AddNewNamePool();
+
+            Assert::IsTrue(store.GetNewName(0) == nullptr);
+            Assert::IsTrue(store.PutNewName(0, L"bar.txt", pool));
+            Assert::AreEqual(L"bar.txt", store.GetNewName(0));
+            Assert::IsFalse(store.PutNewName(0, L"bar.txt", pool));
+            Assert::IsTrue(store.ShouldRename(0, 0));
+            Assert::IsFalse(store.ShouldRename(0, ExcludeFiles));
+
+            // Renaming to the original name is the same as keeping it
+            Assert::IsTrue(store.PutNewName(0, L"foo.txt", pool));
+            Assert::IsTrue(store.GetNewName(0) == nullptr);
+            Assert::IsFalse(store.PutNewName(0, nullptr, pool));
+            Assert::IsFalse(store.ShouldRename(0, 0));
+        }
+
+        TEST_METHOD(SelectionIsPartOfShouldRename)
+        {
+            CPowerRenameItemStore store;
+            UINT index = 0;
+            Assert::IsTrue(store.Add(CreateItem(L"foo.txt"), &index) == S_OK);
+            Assert::IsTrue(store.IsSelected(0));
+            Assert::IsTrue(store.PutNewName(0, L"bar.txt", store.AddNewNamePool()));
+
+            store.PutSelected(0, false);
+            Assert::IsFalse(store.IsSelected(0));
+            Assert::IsFalse(store.ShouldRename(0, 0));
+        }
+
+        TEST_METHOD(RenamePlanIsDeepestFirst)
+        {
+            struct
+            {
+                PCWSTR path;
+                UINT depth;
+                bool isFolder;
+                PCWSTR newName;
+            } items[] = {
+                { L"c:\\foo", 0, true, L"bar" },
+                { L"c:\\foo\\a.txt", 1, false, L"b.txt" },
+                { L"c:\\foo\\sub", 1, true, nullptr },
+                { L"c:\\foo\\sub\\c.txt", 2, false, L"d.txt" },
+                { L"c:\\foo\\e.txt", 1, false, L"f.txt" },
+                { L"c:\\x.txt", 0, false, L"y.txt" },
+            };
+
+            CPowerRenameItemStore store;
+            CNamePool& pool = store.AddNewNamePool();
+            for (const auto& item : items)
+            {
+                CComPtr<IPowerRenameItem> renameItem;
+                SYSTEMTIME time = { 0 };
+                Assert::IsTrue(CMockPowerRenameItem::CreateInstance(item.path, PathFindFileName(item.path), item.depth, item.isFolder, time, &renameItem) == S_OK);
+                UINT index = 0;
+                Assert::IsTrue(store.Add(renameItem, &index) == S_OK);
+                store.PutNewName(index, item.newName, pool);
+            }
+            store.PutSelected(4, false);
+
+            std::vector<RenamePlanItem> plan;
+            store.GetRenamePlan(0, plan);
+            Assert::AreEqual(size_t{ 4 }, plan.size());
+            Assert::AreEqual(L"c.txt", plan[0].originalName.c_str());
+            Assert::AreEqual(L"d.txt", plan[0].newName.c_str());
+            Assert::AreEqual(L"c:\\foo\\sub", plan[0].parentPath.c_str());
+            Assert::AreEqual(2u, plan[0].depth);
+            Assert::AreEqual(L"a.txt", plan[1].originalName.c_str());
+            Assert::AreEqual(L"foo", plan[2].originalName.c_str());
+            Assert::AreEqual(L"c:\\", plan[2].parentPath.c_str());
+            Assert::AreEqual(L"x.txt", plan[3].originalName.c_str());
+
+            plan.clear();
+            store.GetRenamePlan(ExcludeFolders, plan);
+            Assert::AreEqual(size_t{ 3 }, plan.size());
+            Assert::AreEqual(L"x.txt", plan[2].originalName.c_str());
+        }
+
+        TEST_METHOD(CompactNewNamesKeepsCurrentNames)
+        {
+            CPowerRenameItemStore store;
+            const UINT itemCount = 100;
+            for (UINT i = 0; i < itemCount; i++)
+            {
+                UINT index = 0;
+                Assert::IsTrue(store.Add(CreateItem(std::to_wstring(i).c_str()), &index) == S_OK);
+            }
+
+            // Enough passes to fill several segments of replaced names
+            CPowerRenameItemColumns snapshot = store.GetSnapshot();
+            std::wstring suffix(1000, L'x');
+            for (int pass = 0; pass < 10; pass++)
+            {
+                CNamePool& pool = store.AddNewNamePool();
+                for (UINT i = 0; i < itemCount; i++)
+                {
+                    const std::wstring newName = std::to_wstring(pass) + suffix + std::to_wstring(i);
+                    Assert::IsTrue(snapshot.PutNewName(i, newName.c_str(), pool));
+                }
+                store.CompactNewNames(snapshot);
+            }
+
+            for (UINT i = 0; i < itemCount; i++)
+            {
+                Assert::AreEqual((L"9" + suffix + std::to_wstring(i)).c_str(), store.GetNewName(i));
+            }
+        }
+    };
+}
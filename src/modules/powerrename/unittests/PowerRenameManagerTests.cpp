@@ -8,6 +8,9 @@
 #include "TestFileHelper.h"
 #include "Helpers.h"
 
+#include <algorithm>
+#include <map>
+
 #define DEFAULT_FLAGS MatchAllOccurences
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
@@ -18,6 +21,18 @@ EXTERN_C IMAGE_DOS_HEADER __ImageBase;
 
 HINSTANCE g_hInst = HINST_THISCOMPONENT;
 
+class CPowerRenameManagerTestAccess
+{
+public:
+    // Whether the last completed regex pass only evaluated the items that matched the
+    // previous search term.  Waits for the regex pass running.
+    static bool IsLastRegExPassIncremental(_In_ CPowerRenameManager* manager)
+    {
+        manager->_WaitForRegExWorkerThread();
+        return manager->m_regExMatchState.valid && manager->m_regExMatchState.incremental;
+    }
+};
+
 namespace PowerRenameManagerTests
 {
     TEST_CLASS(SimpleTests)
@@ -158,6 +173,55 @@ namespace PowerRenameManagerTests
             mockMgrEvents->Release();
         }
 
+        TEST_METHOD(VerifyCanceledPassUpdatesAreReported)
+        {
+            CComPtr<IPowerRenameManager> mgr;
+            Assert::IsTrue(CPowerRenameManager::s_CreateInstance(&mgr) == S_OK);
+            CMockPowerRenameManagerEvents* mockMgrEvents = new CMockPowerRenameManagerEvents();
+            CComPtr<IPowerRenameManagerEvents> mgrEvents;
+            Assert::IsTrue(mockMgrEvents->QueryInterface(IID_PPV_ARGS(&mgrEvents)) == S_OK);
+            DWORD cookie = 0;
+            Assert::IsTrue(mgr->Advise(mgrEvents, &cookie) == S_OK);
+
+            const UINT itemCount = 20000;
+            for (UINT i = 0; i < itemCount; i++)
+            {
+                const std::wstring name = L"a" + std::to_wstring(i) + L".txt";
+                CComPtr<IPowerRenameItem> item;
+                CMockPowerRenameItem::CreateInstance(name.c_str(), name.c_str(), 0, false, SYSTEMTIME{ 0 }, &item);
+                mgr->AddItem(item);
+            }
+
+            CComPtr<IPowerRenameRegEx> renRegEx;
+            Assert::IsTrue(mgr->GetRenameRegEx(&renRegEx) == S_OK);
+            renRegEx->PutFlags(0);
+            renRegEx->PutReplaceTerm(L"b");
+            renRegEx->PutSearchTerm(L"a");
+
+            // Cancels the pass, wherever it is, before its updates are reported.  The names
+            // are lower case, so the new pass finds the names the canceled pass already set
+            // and doesn't report those items again.
+            renRegEx->PutFlags(CaseSensitive);
+            std::vector<RenamePlanItem> plan;
+            Assert::IsTrue(static_cast<CPowerRenameManager*>(mgr.p)->GetRenamePlan(plan) == S_OK);
+            Assert::AreEqual(static_cast<size_t>(itemCount), plan.size());
+
+            MSG msg;
+            while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
+            {
+                DispatchMessage(&msg);
+            }
+
+            for (UINT i = 0; i < itemCount; i++)
+            {
+                const auto& ranges = mockMgrEvents->m_updatedRanges;
+                Assert::IsTrue(std::any_of(ranges.begin(), ranges.end(), [i](const auto& range) { return range.first <= i && i <= range.second; }));
+            }
+
+            Assert::IsTrue(mgr->Shutdown() == S_OK);
+            mockMgrEvents->Release();
+        }
+
         TEST_METHOD(VerifySingleRename)
         {
             // Create a single item and verify rename works as expected
@@ -342,4 +406,151 @@ namespace PowerRenameManagerTests
             RenameHelper(renamePairs, ARRAYSIZE(renamePairs), L"foo", L"bar$MMM-$MMMM-$DDD-$DDDD", SYSTEMTIME{ 2020, 1, 3, 1, 15, 6, 42, 453 }, DEFAULT_FLAGS);
         }
     };
+
+    // Manager with one item per name, the regex passes only compute the new names
+    struct RegExPreview
+    {
+        CTestFileHelper testFileHelper;
+        CComPtr<IPowerRenameManager> mgr;
+        CComPtr<IPowerRenameRegEx> renRegEx;
+
+        RegExPreview(_In_ const std::vector<std::wstring>& names, _In_ DWORD flags, _In_ PCWSTR replaceTerm)
+        {
+            Assert::IsTrue(CPowerRenameManager::s_CreateInstance(&mgr) == S_OK);
+            for (const auto& name : names)
+            {
+                Assert::IsTrue(testFileHelper.AddFile(name));
+                CComPtr<IPowerRenameItem> item;
+                CMockPowerRenameItem::CreateInstance(testFileHelper.GetFullPath(name).c_str(), name.c_str(), 0, false, SYSTEMTIME{ 0 }, &item);
+                mgr->AddItem(item);
+            }
+
+            Assert::IsTrue(mgr->GetRenameRegEx(&renRegEx) == S_OK);
+            renRegEx->PutFlags(flags);
+            renRegEx->PutReplaceTerm(replaceTerm);
+        }
+
+        ~RegExPreview()
+        {
+            mgr->Shutdown();
+        }
+
+        CPowerRenameManager* Manager()
+        {
+            return static_cast<CPowerRenameManager*>(mgr.p);
+        }
+
+        // New name of each item renamed, by original name, once the regex pass completed
+        std::map<std::wstring, std::wstring> Search(_In_ PCWSTR searchTerm)
+        {
+            renRegEx->PutSearchTerm(searchTerm);
+            return NewNames();
+        }
+
+        std::map<std::wstring, std::wstring> NewNames()
+        {
+            std::vector<RenamePlanItem> plan;
+            Assert::IsTrue(Manager()->GetRenamePlan(plan) == S_OK);
+
+            std::map<std::wstring, std::wstring> newNames;
+            for (const auto& item : plan)
+            {
+                newNames[item.originalName] = item.newName;
+            }
+            return newNames;
+        }
+    };
+
+    TEST_CLASS(IncrementalRegExTests)
+    {
+    public:
+        const std::vector<std::wstring> c_names = {
+            L"foo.txt", L"Foo.txt", L"foob.txt", L"FOOB.txt", L"foobar foob.txt", L"xfoobfoob.txt", L"foo_foo.txt", L"bar.txt"
+        };
+
+        // New names from a full pass of a new manager
+        std::map<std::wstring, std::wstring> FullPass(_In_ DWORD flags, _In_ PCWSTR searchTerm, _In_ PCWSTR replaceTerm)
+        {
+            RegExPreview preview(c_names, flags, replaceTerm);
+            auto newNames = preview.Search(searchTerm);
+            Assert::IsFalse(CPowerRenameManagerTestAccess::IsLastRegExPassIncremental(preview.Manager()));
+            return newNames;
+        }
+
+        void VerifyExtendedSearchTerm(_In_ DWORD flags)
+        {
+            RegExPreview preview(c_names, flags, L"x");
+            preview.Search(L"fo");
+            auto oldNames = preview.Search(L"foo");
+            Assert::IsTrue(oldNames.contains(L"foo.txt"));
+
+            auto newNames = preview.Search(L"foob");
+            Assert::IsTrue(CPowerRenameManagerTestAccess::IsLastRegExPassIncremental(preview.Manager()));
+            Assert::IsTrue(FullPass(flags, L"foob", L"x") == newNames);
+
+            // Matched the previous search term but not the new one
+            Assert::IsFalse(newNames.contains(L"foo.txt"));
+            Assert::IsFalse(newNames.contains(L"foo_foo.txt"));
+        }
+
+        TEST_METHOD(ExtendedSearchTerm)
+        {
+            VerifyExtendedSearchTerm(0);
+        }
+
+        TEST_METHOD(ExtendedSearchTermCaseSensitive)
+        {
+            VerifyExtendedSearchTerm(CaseSensitive);
+        }
+
+        TEST_METHOD(ExtendedSearchTermMatchAllOccurences)
+        {
+            VerifyExtendedSearchTerm(MatchAllOccurences);
+        }
+
+        TEST_METHOD(ExtendedSearchTermCaseSensitiveMatchAllOccurences)
+        {
+            VerifyExtendedSearchTerm(CaseSensitive | MatchAllOccurences);
+        }
+
+        TEST_METHOD(ChangedReplaceTermIsFullPass)
+        {
+            RegExPreview preview(c_names, MatchAllOccurences, L"x");
+            preview.Search(L"foo");
+            preview.renRegEx->PutReplaceTerm(L"y");
+            auto newNames = preview.NewNames();
+            Assert::IsFalse(CPowerRenameManagerTestAccess::IsLastRegExPassIncremental(preview.Manager()));
+            Assert::IsTrue(FullPass(MatchAllOccurences, L"foo", L"y") == newNames);
+        }
+
+        TEST_METHOD(ChangedFlagsIsFullPass)
+        {
+            RegExPreview preview(c_names, CaseSensitive, L"x");
+            preview.Search(L"foo");
+
+            // Items not matching the case sensitive search term match now
+            preview.renRegEx->PutFlags(0);
+            auto newNames = preview.NewNames();
+            Assert::IsFalse(CPowerRenameManagerTestAccess::IsLastRegExPassIncremental(preview.Manager()));
+            Assert::IsTrue(FullPass(0, L"foo", L"x") == newNames);
+            Assert::IsTrue(newNames.contains(L"Foo.txt"));
+        }
+
+        TEST_METHOD(EnumerateAgain)
+        {
+            // Items numbered by a previous rename keep their numbers, their current
+            // names don't count as taken
+            RegExPreview preview({ L"photo (1).jpg", L"photo (2).jpg", L"other.jpg" }, UseRegularExpressions | EnumerateItems | NameOnly, L"photo");
+            const std::map<std::wstring, std::wstring> expected = { { L"other.jpg", L"photo (3).jpg" } };
+            Assert::IsTrue(expected == preview.Search(L".*"));
+        }
+
+        TEST_METHOD(SameNameInFolderIsNumbered)
+        {
+            // The preview shows the number the rename gives to the later items
+            RegExPreview preview({ L"a.txt", L"b.txt", L"B.txt2", L"c.txt" }, UseRegularExpressions, L"x");
+            const std::map<std::wstring, std::wstring> expected = { { L"a.txt", L"x.txt" }, { L"b.txt", L"x (2).txt" }, { L"B.txt2", L"x.txt2" } };
+            Assert::IsTrue(expected == preview.Search(L"^[ab]"));
+        }
+    };
 }
@@ -418,6 +418,26 @@ TEST_METHOD (VerifyFileAttributesPadding)
     }
 }
 
+TEST_METHOD (VerifyReplaceWithFileTime)
+{
+    CComPtr<IPowerRenameRegEx> renameRegEx;
+    Assert::IsTrue(CPowerRenameRegEx::s_CreateInstance(&renameRegEx) == S_OK);
+    DWORD flags = MatchAllOccurences | UseRegularExpressions;
+    Assert::IsTrue(renameRegEx->PutFlags(flags) == S_OK);
+    Assert::IsTrue(renameRegEx->PutSearchTerm(L"(\\w+)") == S_OK);
+    Assert::IsTrue(renameRegEx->PutReplaceTerm(L"$YYYY-$MM-$DD_$1") == S_OK);
+
+    // Each call gets its own time, the state of the regex isn't changed
+    PWSTR result = nullptr;
+    Assert::IsTrue(renameRegEx->ReplaceWithFileTime(L"foo", SYSTEMTIME{ 2020, 7, 3, 22 }, &result) == S_OK);
+    Assert::IsTrue(wcscmp(result, L"2020-07-22_foo") == 0);
+    CoTaskMemFree(result);
+
+    Assert::IsTrue(renameRegEx->ReplaceWithFileTime(L"bar", SYSTEMTIME{ 2019, 1, 2, 1 }, &result) == S_OK);
+    Assert::IsTrue(wcscmp(result, L"2019-01-01_bar") == 0);
+    CoTaskMemFree(result);
+}
+
 TEST_METHOD (VerifyFileAttributesMonthandDayNames)
 {
     CComPtr<IPowerRenameRegEx> renameRegEx;
@@ -490,6 +510,36 @@ TEST_METHOD(VerifyLookbehindFails)
     }
 }
 
+TEST_METHOD(VerifyPatternRecompiledOnChange)
+{
+    CComPtr<IPowerRenameRegEx> renameRegEx;
+    Assert::IsTrue(CPowerRenameRegEx::s_CreateInstance(&renameRegEx) == S_OK);
+    Assert::IsTrue(renameRegEx->PutFlags(UseRegularExpressions | CaseSensitive) == S_OK);
+    Assert::IsTrue(renameRegEx->PutSearchTerm(L"(f)oo") == S_OK);
+    Assert::IsTrue(renameRegEx->PutReplaceTerm(L"$1ar") == S_OK);
+
+    PWSTR result = nullptr;
+    Assert::IsTrue(renameRegEx->Replace(L"Foo foo", &result) == S_OK);
+    Assert::IsTrue(wcscmp(result, L"Foo far") == 0);
+    CoTaskMemFree(result);
+
+    // Each change must invalidate the pattern compiled by the previous Replace call
+    Assert::IsTrue(renameRegEx->PutFlags(UseRegularExpressions | MatchAllOccurences) == S_OK);
+    Assert::IsTrue(renameRegEx->Replace(L"Foo foo", &result) == S_OK);
+    Assert::IsTrue(wcscmp(result, L"Far far") == 0);
+    CoTaskMemFree(result);
+
+    Assert::IsTrue(renameRegEx->PutSearchTerm(L"(o)o") == S_OK);
+    Assert::IsTrue(renameRegEx->Replace(L"Foo foo", &result) == S_OK);
+    Assert::IsTrue(wcscmp(result, L"Foar foar") == 0);
+    CoTaskMemFree(result);
+
+    Assert::IsTrue(renameRegEx->PutReplaceTerm(L"$1-$1") == S_OK);
+    Assert::IsTrue(renameRegEx->Replace(L"Foo foo", &result) == S_OK);
+    Assert::IsTrue(wcscmp(result, L"Fo-o fo-o") == 0);
+    CoTaskMemFree(result);
+}
+
 TEST_METHOD(VerifyEventsFire)
 {
     CComPtr<IPowerRenameRegEx> renameRegEx;
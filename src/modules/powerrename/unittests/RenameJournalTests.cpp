@@ -0,0 +1,210 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include <RenameJournal.h>
+#include "TestFileHelper.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace fs = std::filesystem;
+
+namespace RenameJournalTests
+{
+    // Renames the items of the folder tree of the test, deepest first
+    std::vector<RenamePlanItem> CreatePlan(CTestFileHelper& testFileHelper)
+    {
+        Assert::IsTrue(testFileHelper.AddFolder(L"foo"));
+        Assert::IsTrue(testFileHelper.AddFolder(L"foo\\sub"));
+        Assert::IsTrue(testFileHelper.AddFile(L"foo\\sub\\foo.txt"));
+        Assert::IsTrue(testFileHelper.AddFile(L"foo\\foo1.txt"));
+        Assert::IsTrue(testFileHelper.AddFile(L"foo\\foo2.txt"));
+        Assert::IsTrue(testFileHelper.AddFile(L"foo.txt"));
+
+        const fs::path directory = testFileHelper.GetTempDirectory();
+        std::vector<RenamePlanItem> plan = {
+            { 0, directory.wstring(), L"foo", L"bar" },
+            { 0, directory.wstring(), L"foo.txt", L"bar.txt" },
+            { 1, (directory / L"foo").wstring(), L"foo1.txt", L"bar1.txt" },
+            { 1, (directory / L"foo").wstring(), L"foo2.txt", L"bar2.txt" },
+            { 1, (directory / L"foo").wstring(), L"sub", L"bus" },
+            { 2, (directory / L"foo" / L"sub").wstring(), L"foo.txt", L"bar.txt" },
+        };
+        return plan;
+    }
+
+    TEST_CLASS(RenameJournalTests)
+    {
+    public:
+        TEST_METHOD(ExecutesDeepestFirst)
+        {
+            CTestFileHelper testFileHelper;
+            const std::vector<RenamePlanItem> plan = CreatePlan(testFileHelper);
+            const fs::path journalPath = testFileHelper.GetFullPath(L"journal.bin");
+
+            std::unique_ptr<CRenameJournal> journal;
+            Assert::IsTrue(CRenameJournal::s_Create(journalPath, plan, journal) == S_OK);
+            Assert::AreEqual(plan.size(), journal->GetEntryCount());
+            Assert::AreEqual(2u, journal->GetEntry(0).depth);
+            Assert::AreEqual(0u, journal->GetEntry(plan.size() - 1).depth);
+
+            CFileSystemRenameExecutor executor;
+            size_t calls = 0;
+            Assert::IsTrue(journal->Execute(executor, 2, [&](const RenameProgress& progress) {
+                calls++;
+                Assert::AreEqual(calls, progress.batches);
+                return true;
+            }) == S_OK);
+
+            const RenameProgress& progress = journal->GetProgress();
+            Assert::AreEqual(plan.size(), progress.done);
+            Assert::AreEqual(size_t{ 0 }, progress.failed);
+            Assert::AreEqual(size_t{ 3 }, calls);
+            Assert::IsTrue(testFileHelper.PathExists(L"bar\\bus\\bar.txt"));
+            Assert::IsTrue(testFileHelper.PathExists(L"bar\\bar1.txt"));
+            Assert::IsTrue(testFileHelper.PathExists(L"bar.txt"));
+            Assert::IsFalse(testFileHelper.PathExists(L"foo"));
+
+            Assert::IsTrue(journal->Finish() == S_OK);
+            Assert::IsFalse(fs::exists(journalPath));
+        }
+
+        TEST_METHOD(ResumesInterruptedPlan)
+        {
+            CTestFileHelper testFileHelper;
+            const std::vector<RenamePlanItem> plan = CreatePlan(testFileHelper);
+            const fs::path journalPath = testFileHelper.GetFullPath(L"journal.bin");
+
+            CFileSystemRenameExecutor executor;
+            {
+                std::unique_ptr<CRenameJournal> journal;
+                Assert::IsTrue(CRenameJournal::s_Create(journalPath, plan, journal) == S_OK);
+                Assert::IsTrue(journal->Execute(executor, 2, [](const RenameProgress&) { return false; }) == HRESULT_FROM_WIN32(ERROR_CANCELLED));
+            }
+
+            std::unique_ptr<CRenameJournal> journal;
+            Assert::IsTrue(CRenameJournal::s_Open(journalPath, journal) == S_OK);
+            Assert::AreEqual(size_t{ 2 }, journal->GetProgress().done);
+            Assert::IsTrue(journal->GetEntry(0).state == RenameJournalState::Done);
+            Assert::IsTrue(journal->GetEntry(2).state == RenameJournalState::Pending);
+
+            Assert::IsTrue(journal->Execute(executor, 2, nullptr) == S_OK);
+            Assert::AreEqual(plan.size(), journal->GetProgress().done);
+            Assert::AreEqual(size_t{ 4 }, journal->GetProgress().processed);
+            Assert::IsTrue(testFileHelper.PathExists(L"bar\\bus\\bar.txt"));
+            Assert::IsTrue(testFileHelper.PathExists(L"bar.txt"));
+        }
+
+        TEST_METHOD(SettlesBatchFromDisk)
+        {
+            CTestFileHelper testFileHelper;
+            const std::vector<RenamePlanItem> plan = CreatePlan(testFileHelper);
+            const fs::path journalPath = testFileHelper.GetFullPath(L"journal.bin");
+
+            std::unique_ptr<CRenameJournal> journal;
+            Assert::IsTrue(CRenameJournal::s_Create(journalPath, plan, journal) == S_OK);
+            journal.reset();
+
+            // The process died while the batch of the first two items ran, after the first
+            // one was renamed
+            fs::rename(testFileHelper.GetFullPath(L"foo\\sub\\foo.txt"), testFileHelper.GetFullPath(L"foo\\sub\\bar.txt"));
+            std::string batchRecord = { 'B', 12, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0 };
+            uint32_t checksum = 2166136261u;
+            for (size_t i = 0; i < batchRecord.size(); i++)
+            {
+                // The checksum skips the payload length
+                if (i == 0 || i > 4)
+                {
+                    checksum = (checksum ^ static_cast<unsigned char>(batchRecord[i])) * 16777619u;
+                }
+            }
+            for (int i = 0; i < 4; i++)
+            {
+                batchRecord += static_cast<char>((checksum >> (8 * i)) & 0xFF);
+            }
+            {
+                std::ofstream file(journalPath, std::ios::binary | std::ios::app);
+                file.write(batchRecord.data(), batchRecord.size());
+            }
+
+            Assert::IsTrue(CRenameJournal::s_Open(journalPath, journal) == S_OK);
+            Assert::IsTrue(journal->GetEntry(0).state == RenameJournalState::Pending);
+            CFileSystemRenameExecutor executor;
+            Assert::IsTrue(journal->Execute(executor, 2, nullptr) == S_OK);
+            Assert::IsTrue(journal->GetEntry(0).state == RenameJournalState::Done);
+            Assert::AreEqual(plan.size(), journal->GetProgress().done);
+            Assert::AreEqual(plan.size() - 1, journal->GetProgress().processed);
+            Assert::AreEqual(size_t{ 0 }, journal->GetProgress().failed);
+            Assert::IsTrue(testFileHelper.PathExists(L"bar\\bus\\bar.txt"));
+        }
+
+        TEST_METHOD(IgnoresTornRecord)
+        {
+            CTestFileHelper testFileHelper;
+            const std::vector<RenamePlanItem> plan = CreatePlan(testFileHelper);
+            const fs::path journalPath = testFileHelper.GetFullPath(L"journal.bin");
+
+            std::unique_ptr<CRenameJournal> journal;
+            Assert::IsTrue(CRenameJournal::s_Create(journalPath, plan, journal) == S_OK);
+            journal.reset();
+
+            // Cut in the middle of the record sealing the plan
+            fs::resize_file(journalPath, fs::file_size(journalPath) - 3);
+            Assert::IsTrue(CRenameJournal::s_Open(journalPath, journal) == S_FALSE);
+            Assert::AreEqual(size_t{ 0 }, journal->GetEntryCount());
+            journal.reset();
+
+            // A partial record at the end is dropped, the records before it are kept
+            Assert::IsTrue(CRenameJournal::s_Create(journalPath, plan, journal) == S_OK);
+            journal.reset();
+            {
+                std::ofstream file(journalPath, std::ios::binary | std::ios::app);
+                file.write("D\x08\x00", 3);
+            }
+            Assert::IsTrue(CRenameJournal::s_Open(journalPath, journal) == S_OK);
+            Assert::AreEqual(plan.size(), journal->GetEntryCount());
+
+            CFileSystemRenameExecutor executor;
+            Assert::IsTrue(journal->Execute(executor, 16, nullptr) == S_OK);
+            journal.reset();
+            Assert::IsTrue(CRenameJournal::s_Open(journalPath, journal) == S_OK);
+            Assert::AreEqual(plan.size(), journal->GetProgress().done);
+        }
+
+        TEST_METHOD(RollsBackRenamedItems)
+        {
+            CTestFileHelper testFileHelper;
+            const std::vector<RenamePlanItem> plan = CreatePlan(testFileHelper);
+            const fs::path journalPath = testFileHelper.GetFullPath(L"journal.bin");
+
+            // bar2.txt is taken, foo2.txt keeps its name
+            Assert::IsTrue(testFileHelper.AddFile(L"foo\\bar2.txt"));
+
+            CFileSystemRenameExecutor executor;
+            {
+                std::unique_ptr<CRenameJournal> journal;
+                Assert::IsTrue(CRenameJournal::s_Create(journalPath, plan, journal) == S_OK);
+                Assert::IsTrue(journal->Execute(executor, 4, nullptr) == S_OK);
+                Assert::AreEqual(size_t{ 1 }, journal->GetProgress().failed);
+                Assert::IsTrue(journal->GetEntry(2).result == HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS));
+            }
+
+            std::unique_ptr<CRenameJournal> journal;
+            Assert::IsTrue(CRenameJournal::s_Open(journalPath, journal) == S_OK);
+            size_t batches = 0;
+            Assert::IsTrue(journal->RollBack(executor, 4, [&](const RenameProgress& progress) {
+                batches = progress.batches;
+                return true;
+            }) == S_OK);
+
+            // One batch per depth
+            Assert::AreEqual(size_t{ 3 }, batches);
+            Assert::AreEqual(size_t{ 0 }, journal->GetProgress().done);
+            Assert::AreEqual(plan.size() - 1, journal->GetProgress().rolledBack);
+            Assert::IsTrue(testFileHelper.PathExists(L"foo\\sub\\foo.txt"));
+            Assert::IsTrue(testFileHelper.PathExists(L"foo\\foo1.txt"));
+            Assert::IsTrue(testFileHelper.PathExists(L"foo\\foo2.txt"));
+            Assert::IsTrue(testFileHelper.PathExists(L"foo\\bar2.txt"));
+            Assert::IsTrue(testFileHelper.PathExists(L"foo.txt"));
+            Assert::IsFalse(testFileHelper.PathExists(L"bar"));
+        }
+    };
+}
@@ -0,0 +1,106 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include <UniqueNameResolver.h>
+#include "TestFileHelper.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UniqueNameResolverTests
+{
+    TEST_CLASS(UniqueNameResolverTests)
+    {
+    public:
+        TEST_METHOD(SkipsNamesInDirectory)
+        {
+            CTestFileHelper testFileHelper;
+            Assert::IsTrue(testFileHelper.AddFile(L"bar (1).txt"));
+            Assert::IsTrue(testFileHelper.AddFile(L"BAR (2).TXT"));
+            const std::wstring directory = testFileHelper.GetTempDirectory().wstring();
+
+            CUniqueNameResolver resolver;
+            std::wstring uniqueName;
+            unsigned long numberUsed = 0;
+            Assert::IsTrue(resolver.GetEnumeratedName(directory.c_str(), L"bar.txt", 1, uniqueName, &numberUsed) == S_OK);
+            Assert::AreEqual(L"bar (3).txt", uniqueName.c_str());
+            Assert::AreEqual(3ul, numberUsed);
+        }
+
+        TEST_METHOD(SkipsNamesClaimedByBatch)
+        {
+            CTestFileHelper testFileHelper;
+            const std::wstring directory = testFileHelper.GetTempDirectory().wstring();
+
+            CUniqueNameResolver resolver;
+            std::wstring uniqueName;
+            unsigned long numberUsed = 0;
+            for (unsigned long expected = 1; expected <= 3; expected++)
+            {
+                Assert::IsTrue(resolver.GetEnumeratedName(directory.c_str(), L"bar.txt", 1, uniqueName, &numberUsed) == S_OK);
+                Assert::AreEqual(expected, numberUsed);
+            }
+
+            // Other folders and templates are numbered on their own
+            Assert::IsTrue(resolver.GetEnumeratedName(L"c:\\other", L"bar.txt", 1, uniqueName, &numberUsed) == S_OK);
+            Assert::AreEqual(1ul, numberUsed);
+            Assert::IsTrue(resolver.GetEnumeratedName(directory.c_str(), L"baz.txt", 1, uniqueName, &numberUsed) == S_OK);
+            Assert::AreEqual(L"baz (1).txt", uniqueName.c_str());
+        }
+
+        TEST_METHOD(NumberInTemplate)
+        {
+            CTestFileHelper testFileHelper;
+            Assert::IsTrue(testFileHelper.AddFile(L"photo (5) final.jpg"));
+            const std::wstring directory = testFileHelper.GetTempDirectory().wstring();
+
+            CUniqueNameResolver resolver;
+            std::wstring uniqueName;
+            unsigned long numberUsed = 0;
+            Assert::IsTrue(resolver.GetEnumeratedName(directory.c_str(), L"photo (1) final.jpg", 5, uniqueName, &numberUsed) == S_OK);
+            Assert::AreEqual(L"photo (6) final.jpg", uniqueName.c_str());
+        }
+
+        TEST_METHOD(ReleasedNamesAreFree)
+        {
+            // Numbering again the items already numbered gives them the same numbers
+            CTestFileHelper testFileHelper;
+            Assert::IsTrue(testFileHelper.AddFile(L"photo (1).jpg"));
+            Assert::IsTrue(testFileHelper.AddFile(L"photo (2).jpg"));
+            Assert::IsTrue(testFileHelper.AddFile(L"photo (3).jpg"));
+            const std::wstring directory = testFileHelper.GetTempDirectory().wstring();
+
+            CUniqueNameResolver resolver;
+            resolver.Release(directory.c_str(), L"photo (1).jpg");
+            resolver.Release(directory.c_str(), L"PHOTO (2).JPG");
+
+            std::wstring uniqueName;
+            unsigned long numberUsed = 0;
+            Assert::IsTrue(resolver.GetEnumeratedName(directory.c_str(), L"photo.jpg", 1, uniqueName, &numberUsed) == S_OK);
+            Assert::AreEqual(L"photo (1).jpg", uniqueName.c_str());
+            Assert::IsTrue(resolver.GetEnumeratedName(directory.c_str(), L"photo.jpg", 2, uniqueName, &numberUsed) == S_OK);
+            Assert::AreEqual(L"photo (2).jpg", uniqueName.c_str());
+
+            // Not released, still taken
+            Assert::IsTrue(resolver.GetEnumeratedName(directory.c_str(), L"photo.jpg", 3, uniqueName, &numberUsed) == S_OK);
+            Assert::AreEqual(L"photo (4).jpg", uniqueName.c_str());
+        }
+
+        TEST_METHOD(NumbersDontDependOnFolderDepth)
+        {
+            CUniqueNameResolver resolver;
+            const std::wstring directory = L"c:\\" + std::wstring(252, L'x');
+            std::wstring uniqueName;
+            unsigned long numberUsed = 0;
+            Assert::IsTrue(resolver.GetEnumeratedName(directory.c_str(), L"bar.txt", 1000, uniqueName, &numberUsed) == S_OK);
+            Assert::AreEqual(L"bar (1000).txt", uniqueName.c_str());
+        }
+
+        TEST_METHOD(ClaimFindsBatchCollisions)
+        {
+            CUniqueNameResolver resolver;
+            Assert::IsTrue(resolver.Claim(L"c:\\folder", L"bar.txt"));
+            Assert::IsTrue(resolver.Claim(L"c:\\other", L"bar.txt"));
+            Assert::IsFalse(resolver.Claim(L"C:\\Folder", L"BAR.txt"));
+            Assert::AreEqual(1u, resolver.GetCollisionCount());
+        }
+    };
+}
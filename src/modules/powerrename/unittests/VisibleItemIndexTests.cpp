@@ -0,0 +1,88 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include <VisibleItemIndex.h>
+#include <random>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace VisibleItemIndexTests
+{
+    // Compares every query of index against a plain bitmap
+    void VerifyIndex(const CVisibleItemIndex& index, const std::vector<bool>& isVisible)
+    {
+        Assert::AreEqual(static_cast<UINT>(isVisible.size()), index.Size());
+
+        std::vector<UINT> visibleItems;
+        for (UINT i = 0; i < isVisible.size(); i++)
+        {
+            Assert::AreEqual(static_cast<bool>(isVisible[i]), index.IsVisible(i));
+            Assert::AreEqual(static_cast<UINT>(visibleItems.size()), index.Rank(i));
+            if (isVisible[i])
+            {
+                visibleItems.push_back(i);
+            }
+        }
+
+        Assert::AreEqual(static_cast<UINT>(visibleItems.size()), index.Count());
+        for (UINT u = 0; u < visibleItems.size(); u++)
+        {
+            Assert::AreEqual(visibleItems[u], index.Select(u));
+        }
+    }
+
+    TEST_CLASS(VisibleItemIndexTests)
+    {
+    public:
+        TEST_METHOD(EmptyIndex)
+        {
+            CVisibleItemIndex index;
+            index.Update();
+            Assert::AreEqual(0u, index.Count());
+            Assert::AreEqual(0u, index.Size());
+        }
+
+        TEST_METHOD(AppendAndInsert)
+        {
+            std::mt19937 random(1);
+            CVisibleItemIndex index;
+            std::vector<bool> isVisible;
+            for (UINT i = 0; i < 5000; i++)
+            {
+                // Mostly appended, like the items of an enumeration
+                const UINT position = random() % 8 == 0 ? random() % (isVisible.size() + 1) : static_cast<UINT>(isVisible.size());
+                const bool visible = random() % 3 != 0;
+                index.Insert(position, visible);
+                isVisible.insert(isVisible.begin() + position, visible);
+            }
+
+            VerifyIndex(index, isVisible);
+        }
+
+        TEST_METHOD(SetThenUpdate)
+        {
+            CVisibleItemIndex index;
+            std::vector<bool> isVisible(3000, true);
+            for (UINT i = 0; i < isVisible.size(); i++)
+            {
+                index.Insert(i, true);
+            }
+
+            // A sparse filter, then a few changes far from the start
+            for (UINT i = 0; i < isVisible.size(); i++)
+            {
+                isVisible[i] = i % 700 == 0;
+                index.Set(i, isVisible[i]);
+            }
+            index.Update();
+            VerifyIndex(index, isVisible);
+
+            for (UINT i = 2000; i < 2010; i++)
+            {
+                isVisible[i] = true;
+                index.Set(i, true);
+            }
+            index.Update();
+            VerifyIndex(index, isVisible);
+        }
+    };
+}